@@ -17,6 +17,9 @@
 #include "seq.h"
 #include "libvtree.h"
 
+#include <ctype.h>
+#include <string.h>
+
 /*****************************************************************
  * display_usage - general instructions for running the program  *
  *****************************************************************/
@@ -24,10 +27,227 @@
 static void
 display_usage_and_exit()
 {
-  printf( "Usage: find file pattern\n" );
+  printf( "Usage: find [-i index [-m megabytes]] [-f | -c | -s step] file pattern...\n" );
+  printf( "       find [-t threads] -b patterns file\n" );
+  printf( "the index of file is saved to index, and reused by the next runs\n" );
+  printf( "-m builds the index file anew, sorting the suffixes in about megabytes\n" );
+  printf( "   of memory, through temporary files next to it, file is read as it goes\n" );
+  printf( "-f searches with the FM-index instead of the child table\n" );
+  printf( "-c only counts the occurrences, with the FM-index\n" );
+  printf( "-s searches a sparse suffix array of the suffixes starting at the\n" );
+  printf( "   multiples of step\n" );
+  printf( "-b searches all the sequences of file for the sequences of the fasta\n" );
+  printf( "   file patterns, printing one line per hit: pattern sequence position\n" );
+  printf( "-t number of threads of -b, 0 for one per processor\n" );
   exit( EXIT_SUCCESS );
 }
 
+/*****************************************************************
+ * fm_find - prints the positions of pattern, or only their      *
+ * number, found by backward search                              *
+ *****************************************************************/
+
+static void
+fm_find( vtree_t *v, dstring_t *pattern, int count_only )
+{
+  pos_t i, j, count = vtree_fm_count( v, pattern->text, pattern->length, &i, &j );
+
+  if ( count_only ) {
+
+    printf( "%ld\n", ( long ) count );
+
+  } else if ( count == 0 ) {
+
+    printf( "pattern P not found\n" );
+
+  } else {
+
+    printf( "query found a position(s): " );
+
+    for ( pos_t k=i; k<=j; k++ ) {
+      if ( k>i )
+	printf( ", " );
+      printf( "%ld", ( long ) vtree_fm_locate( v, k ) );
+    }
+    printf( "\n" );
+  }
+}
+
+/*****************************************************************
+ * sparse_find - prints the positions of pattern, found with a   *
+ * sparse suffix array                                           *
+ *****************************************************************/
+
+static void
+sparse_find( vtree_sparse_t *s, dstring_t *pattern )
+{
+  pos_t count, *pos = vtree_sparse_find( s, pattern->text, pattern->length, &count );
+
+  if ( count == 0 ) {
+
+    printf( "pattern P not found\n" );
+
+  } else {
+
+    printf( "query found a position(s): " );
+
+    for ( pos_t k=0; k<count; k++ ) {
+      if ( k>0 )
+	printf( ", " );
+      printf( "%ld", ( long ) pos[ k ] );
+    }
+    printf( "\n" );
+  }
+
+  dev_free( pos );
+}
+
+/*****************************************************************
+ * batch_find - prints the hits of the patterns of a fasta file  *
+ * in the sequences seqs                                         *
+ *****************************************************************/
+
+static void
+batch_find( char *filename, char **seqs, char **descs, int num_seqs )
+{
+  char **pseqs, **pdescs;
+  int num_patterns = bio_read_fasta( filename, &pseqs, &pdescs, isnuc );
+  dstring_t **texts, **patterns;
+  vtree_hit_t *hits;
+  pos_t num_hits;
+  vtree_t *v;
+
+  texts = ( dstring_t ** ) dev_malloc( num_seqs * sizeof( dstring_t * ) );
+
+  for ( int s=0; s<num_seqs; s++ )
+    texts[ s ] = dev_digitalize( &bio_nuc_alphabet, seqs[ s ] );
+
+  v = vtree_create_generalized( texts, num_seqs, VTREE_SUFTAB | VTREE_CHILDTAB );
+
+  patterns = ( dstring_t ** ) dev_malloc( MAX( num_patterns, 1 ) * sizeof( dstring_t * ) );
+
+  for ( int k=0; k<num_patterns; k++ ) {
+    patterns[ k ] = dev_digitalize( &bio_nuc_alphabet, pseqs[ k ] );
+    patterns[ k ]->length--; /* no terminator */
+  }
+
+  hits = vtree_find_batch( v, patterns, num_patterns, &num_hits );
+
+  for ( pos_t h=0; h<num_hits; h++ )
+    printf( "%s\t%s\t%ld\n", pdescs[ hits[ h ].pattern ], descs[ hits[ h ].seq ], ( long ) hits[ h ].pos );
+
+  dev_free( hits );
+  vtree_free( v );
+
+  for ( int k=0; k<num_patterns; k++ )
+    dev_free_dstring( patterns[ k ] );
+
+  for ( int s=0; s<num_seqs; s++ )
+    dev_free_dstring( texts[ s ] );
+
+  dev_free( patterns );
+  dev_free( texts );
+  dev_free_array( (void **) pdescs, num_patterns );
+  dev_free_array( (void **) pseqs, num_patterns );
+}
+
+/*****************************************************************
+ * fasta_t - the first sequence of a fasta file, read by parts   *
+ * by read_fasta for vtree_create_external_source                *
+ *****************************************************************/
+
+typedef struct {
+  FILE *fh;
+  char *name;
+  int line;
+  pos_t length;
+  int state; /* 0 before the description, 1 in the sequence, 2 read */
+} fasta_t;
+
+/*****************************************************************
+ * read_fasta - writes at most size symbols of the sequence to   *
+ * buf, followed by the terminator, and returns their number;    *
+ * the characters are checked as bio_read_fasta does             *
+ *****************************************************************/
+
+static pos_t
+read_fasta( symbol_t *buf, pos_t size, void *arg )
+{
+  fasta_t *f = ( fasta_t * ) arg;
+  pos_t num = 0;
+  int c;
+
+  if ( f->state == 0 ) { /* skips the description line */
+
+    while ( ( c = getc( f->fh ) ) != EOF && isspace( c ) )
+      if ( c == '\n' )
+	f->line++;
+
+    if ( c != '>' )
+      dev_die( "not a fasta file, %s line %d", f->name, f->line );
+
+    while ( ( c = getc( f->fh ) ) != EOF && c != '\n' )
+      ;
+
+    f->line++;
+    f->state = 1;
+  }
+
+  while ( f->state == 1 && num < size ) {
+
+    c = getc( f->fh );
+
+    if ( c == EOF || c == '>' ) { /* the next sequence is not read */
+
+      if ( f->length == 0 )
+	dev_die( "empty sequence, %s line %d", f->name, f->line );
+
+      buf[ num++ ] = bio_nuc_alphabet.size; /* terminator */
+      f->state = 2;
+
+    } else if ( c == '\n' ) {
+
+      f->line++;
+
+    } else if ( ! isspace( c ) ) {
+
+      c = toupper( c );
+
+      if ( ! isnuc( c ) )
+	dev_die( "not a valid character %c, %s line %d", c, f->name, f->line );
+
+      buf[ num++ ] = dev_encode( &bio_nuc_alphabet, c );
+      f->length++;
+    }
+  }
+
+  return num;
+}
+
+/*****************************************************************
+ * create_external - creates the index file of the first         *
+ * sequence of a fasta file, read as the suffixes are sorted     *
+ *****************************************************************/
+
+static vtree_t *
+create_external( char *filename, char *index, int megabytes )
+{
+  fasta_t f;
+  vtree_t *v;
+
+  f.fh = dev_fopen( filename, "r" );
+  f.name = filename;
+  f.line = 1;
+  f.length = 0;
+  f.state = 0;
+
+  v = vtree_create_external_source( read_fasta, &f, &bio_nuc_alphabet, index, ( size_t ) megabytes << 20 );
+
+  fclose( f.fh );
+
+  return v;
+}
+
 /*****************************************************************
  * main -                                                        *
  *****************************************************************/
@@ -41,9 +261,52 @@ main( int argc, char *argv[] )
   char **descs;
 
   dstring_t *db, *pattern;
-  vtree_t *v;
+  vtree_t *v = NULL;
+  vtree_sparse_t *sparse = NULL;
+  char *index = NULL, *batch = NULL;
+  int fm = FALSE, count_only = FALSE, step = 0, megabytes = 0;
+
+  while ( argc > 1 && argv[ 1 ][ 0 ] == '-' ) {
 
-  if ( argc != 3 )
+    if ( argc > 2 && strcmp( argv[ 1 ], "-i" ) == 0 ) {
+      index = argv[ 2 ];
+      argv++;
+      argc--;
+    } else if ( argc > 2 && strcmp( argv[ 1 ], "-m" ) == 0 ) {
+      megabytes = dev_parse_int( argv[ 2 ] );
+      argv++;
+      argc--;
+    } else if ( strcmp( argv[ 1 ], "-f" ) == 0 ) {
+      fm = TRUE;
+    } else if ( strcmp( argv[ 1 ], "-c" ) == 0 ) {
+      fm = count_only = TRUE;
+    } else if ( argc > 2 && strcmp( argv[ 1 ], "-s" ) == 0 ) {
+      step = dev_parse_int( argv[ 2 ] );
+      argv++;
+      argc--;
+    } else if ( argc > 2 && strcmp( argv[ 1 ], "-b" ) == 0 ) {
+      batch = argv[ 2 ];
+      argv++;
+      argc--;
+    } else if ( argc > 2 && strcmp( argv[ 1 ], "-t" ) == 0 ) {
+      vtree_set_num_threads( dev_parse_int( argv[ 2 ] ) );
+      argv++;
+      argc--;
+    } else {
+      display_usage_and_exit();
+    }
+
+    argv++;
+    argc--;
+  }
+
+  if ( batch != NULL ? argc != 2 || index != NULL || fm || step : argc < 3 )
+    display_usage_and_exit();
+
+  if ( step < 0 || ( step > 0 && ( index != NULL || fm ) ) )
+    display_usage_and_exit();
+
+  if ( megabytes < 0 || ( megabytes > 0 && index == NULL ) )
     display_usage_and_exit();
 
   /* initialisations */
@@ -52,22 +315,62 @@ main( int argc, char *argv[] )
 
   /* reading data */
 
-  num_seqs = bio_read_fasta( argv[ 1 ], &seqs, &descs, isnuc );
+  if ( megabytes > 0 ) { /* the sequence is read as the index is built */
+
+    num_seqs = 0;
+    seqs = descs = NULL;
+    db = NULL;
+
+  } else {
+
+    num_seqs = bio_read_fasta( argv[ 1 ], &seqs, &descs, isnuc );
 
-  db = dev_digitalize( &bio_nuc_alphabet, seqs[ 0 ] );
+    if ( batch != NULL ) {
+      batch_find( batch, seqs, descs, num_seqs );
+      dev_free_array( (void **) descs, num_seqs );
+      dev_free_array( (void **) seqs, num_seqs );
+      exit( EXIT_SUCCESS );
+    }
 
-  v = vtree_create( db );
+    db = dev_digitalize( &bio_nuc_alphabet, seqs[ 0 ] );
+  }
 
-  pattern = dev_digitalize( &bio_nuc_alphabet, argv[ 2 ] );
-  pattern->length--; /* no terminator */
+  if ( step > 0 )
+    sparse = vtree_create_sparse( db, step );
+  else if ( megabytes > 0 )
+    v = create_external( argv[ 1 ], index, megabytes );
+  else if ( index != NULL )
+    v = vtree_open_index( index, db );
+  else if ( fm )
+    v = vtree_create_tables( db, VTREE_FMTAB ); /* neither suftab nor childtab */
+  else
+    v = vtree_create( db );
 
-  vtree_find_exact_match( v, pattern );
+  for ( int k=2; k<argc; k++ ) {
+
+    pattern = dev_digitalize( &bio_nuc_alphabet, argv[ k ] );
+    pattern->length--; /* no terminator */
+
+    if ( sparse != NULL )
+      sparse_find( sparse, pattern );
+    else if ( fm )
+      fm_find( v, pattern, count_only );
+    else
+      vtree_find_exact_match( v, pattern );
+
+    dev_free_dstring( pattern );
+  }
 
   /* post-processings */
 
-  vtree_free( v );
-  dev_free_dstring( db );
-  dev_free_dstring( pattern );
+  if ( sparse != NULL )
+    vtree_free_sparse( sparse );
+  else
+    vtree_free( v );
+
+  if ( db != NULL )
+    dev_free_dstring( db );
+
   dev_free_array( (void **) descs, num_seqs );
   dev_free_array( (void **) seqs, num_seqs );
 
@@ -35,19 +35,57 @@
 #endif
 
 /*****************************************************************
- * make_all_vtrees -                                             *
+ * global variables                                              *
+ *                                                               *
+ * gsa is the generalized vtree of all the input sequences, the  *
+ * support of a motif is computed by a single traversal of gsa,  *
+ * or of their bidirectional index gbi with --bidirectional.     *
+ *****************************************************************/
+
+static vtree_t *gsa = NULL;
+
+static vtree_bidir_t *gbi = NULL;
+
+static bitset_t *gsa_seqs = NULL;
+
+/*****************************************************************
+ * match_tables - tables read by the motif matcher, the node     *
+ * table with --node_table rather than the lcp and child tables  *
+ *****************************************************************/
+
+static int
+match_tables( param_t *params )
+{
+  if ( params->node_table )
+    return VTREE_SUFTAB | VTREE_NODETAB;
+
+  return VTREE_SUFTAB | VTREE_LCPTAB | VTREE_CHILDTAB;
+}
+
+/*****************************************************************
+ * make_all_vtrees - creates the vtrees of the input sequences,  *
+ * or maps them from the index files prefixed by params->index   *
  *****************************************************************/
 
 vector_t *
-make_all_vtrees( char *seqs[], int num_seqs )
+make_all_vtrees( char *seqs[], int num_seqs, param_t *params )
 {
   vector_t *vs = dev_new_vector( num_seqs, 1 );
+  vtree_builder_t *b = vtree_new_builder();
 
   for ( int i=0; i < num_seqs; i++ ) {
 
     dstring_t *ds = dev_digitalize( &bio_nuc_alphabet, seqs[ i ] );
 
-    vtree_t *v = vtree_create( ds );
+    vtree_t *v;
+
+    if ( params->index != NULL ) {
+      char *filename = vtree_index_filename( params->index, i );
+      v = vtree_open_index( filename, ds );
+      vtree_require( v, match_tables( params ) );
+      dev_free( filename );
+    } else
+      v = vtree_build( b, ds, match_tables( params ) );
 
     vtree_set_id( v, i );
 
@@ -56,23 +94,102 @@ make_all_vtrees( char *seqs[], int num_seqs )
     dev_free_dstring( ds );
   }
 
+  vtree_free_builder( b );
+
   dev_vector_trim( vs );
 
   return vs;
 }
 
 /*****************************************************************
- * calculate_support -                                           *
+ * index_filename - name of an index of all the input sequences, *
+ * prefix.suffix                                                 *
+ *****************************************************************/
+
+static char *
+index_filename( char *prefix, char *suffix )
+{
+  char *filename = ( char * ) dev_malloc( strlen( prefix ) + strlen( suffix ) + 2 );
+
+  sprintf( filename, "%s.%s", prefix, suffix );
+
+  return filename;
+}
+
+/*****************************************************************
+ * make_generalized_vtree - creates the generalized vtree of the *
+ * input sequences, or maps it from the index file prefix.all    *
+ *****************************************************************/
+
+vtree_t *
+make_generalized_vtree( char *seqs[], int num_seqs, param_t *params )
+{
+  dstring_t **ds = ( dstring_t ** ) dev_malloc( num_seqs * sizeof( dstring_t * ) );
+  vtree_t *g;
+
+  for ( int i=0; i < num_seqs; i++ )
+    ds[ i ] = dev_digitalize( &bio_nuc_alphabet, seqs[ i ] );
+
+  if ( params->index != NULL ) {
+    char *filename = index_filename( params->index, "all" );
+    g = vtree_open_generalized_index( filename, ds, num_seqs, match_tables( params ) );
+    dev_free( filename );
+  } else
+    g = vtree_create_generalized( ds, num_seqs, match_tables( params ) );
+
+  for ( int i=0; i < num_seqs; i++ )
+    dev_free_dstring( ds[ i ] );
+
+  dev_free( ds );
+
+  return g;
+}
+
+/*****************************************************************
+ * make_bidir_index - creates the bidirectional index of the     *
+ * input sequences, or maps it from the index files prefix.fwd   *
+ * and prefix.rev                                                *
+ *****************************************************************/
+
+vtree_bidir_t *
+make_bidir_index( char *seqs[], int num_seqs, param_t *params )
+{
+  dstring_t **ds = ( dstring_t ** ) dev_malloc( num_seqs * sizeof( dstring_t * ) );
+  vtree_bidir_t *b;
+
+  for ( int i=0; i < num_seqs; i++ )
+    ds[ i ] = dev_digitalize( &bio_nuc_alphabet, seqs[ i ] );
+
+  if ( params->index != NULL )
+    b = vtree_open_bidir_index( params->index, ds, num_seqs );
+  else
+    b = vtree_create_bidir( ds, num_seqs );
+
+  for ( int i=0; i < num_seqs; i++ )
+    dev_free_dstring( ds[ i ] );
+
+  dev_free( ds );
+
+  return b;
+}
+
+/*****************************************************************
+ * calculate_support - fraction of the input sequences that      *
+ * contain the motif, counted on gbi or gsa                      *
  *****************************************************************/
 
 void
-calculate_support( motif_t *m, vector_t *vs, param_t *params )
+calculate_support( motif_t *m, param_t *params )
 {
-  int matches = 0, n = dev_vector_size( vs );
+  int matches, n;
 
-  for ( int i=0; i < n; i++ )
-    if ( occurs( ( vtree_t * ) dev_vector_get( vs, i ), m, params ) )
-      matches++;
+  if ( gbi != NULL ) {
+    matches = occurrences_bidir( gbi, m, gsa_seqs, params );
+    n = gbi->forward->num_seqs;
+  } else {
+    matches = occurrences( gsa, m, gsa_seqs, params );
+    n = gsa->num_seqs;
+  }
 
   m->support = ( float ) matches / ( float ) n;
 
@@ -83,7 +200,7 @@ calculate_support( motif_t *m, vector_t *vs, param_t *params )
  *****************************************************************/
 
 list_t *
-filter_by_support( list_t *in, vector_t *vs, param_t *params )
+filter_by_support( list_t *in, param_t *params )
 {
   list_t *out = dev_new_list();
 
@@ -93,7 +210,7 @@ filter_by_support( list_t *in, vector_t *vs, param_t *params )
 
     motif_t *m = dev_list_serve( in );
 
-    calculate_support( m, vs, params );
+    calculate_support( m, params );
 
     if ( m->support >= params->min_support )
       dev_list_add( out, m );
@@ -163,7 +280,7 @@ filter_keep_longest_stems( list_t *in, param_t *params )
  *****************************************************************/
 
 list_t *
-fix_all( list_t *open, vector_t *vs, param_t *params )
+fix_all( list_t *open, param_t *params )
 {
   list_t *out = dev_new_list();
 
@@ -185,7 +302,7 @@ fix_all( list_t *open, vector_t *vs, param_t *params )
 	dev_bitset_set( new->expression->mask, i );
 
 	new->num_fixed_pos++;
-	calculate_support( new, vs, params );
+	calculate_support( new, params );
 
 	if ( new->support < params->min_support )
 	  free_motif( new );
@@ -215,7 +332,7 @@ fix_all( list_t *open, vector_t *vs, param_t *params )
  *****************************************************************/
 
 vector_t *
-fix_all2( list_t *open, vector_t *vs, param_t *params )
+fix_all2( list_t *open, param_t *params )
 {
   vector_t *out = dev_new_vector( 1000, 200 ); /* tune me! */
   list_t *tmp = dev_new_list(), *res = NULL;
@@ -235,7 +352,7 @@ fix_all2( list_t *open, vector_t *vs, param_t *params )
 
     dev_list_add( tmp, m );
 
-    res = fix_all( tmp, vs, params );
+    res = fix_all( tmp, params );
 
     last = first + dev_list_size( tmp );
 
@@ -272,7 +389,7 @@ fix_all2( list_t *open, vector_t *vs, param_t *params )
  *****************************************************************/
 
 void
-combine_allall( vector_t *motifs, vector_t *vs, param_t *params )
+combine_allall( vector_t *motifs, param_t *params )
 {
   int n = dev_vector_size( motifs ), first = 0, last = n, num_stem = 1;
   int done = params->max_num_stem < 2;
@@ -297,7 +414,7 @@ combine_allall( vector_t *motifs, vector_t *vs, param_t *params )
 
 	if ( new != NULL ) {
 
-	  calculate_support( new, vs, params );
+	  calculate_support( new, params );
 
 	  if ( new->support < params->min_support ) {
 
@@ -457,46 +574,69 @@ display_statistics( param_t *params )
 
 /*****************************************************************
  * ida_discover -                                                *
+ *                                                               *
+ * The support is counted on gsa, or gbi.  The vtrees of the     *
+ * sequences are only read to save the matches, they are made    *
+ * once the search is over and gsa or gbi released, hence both   *
+ * are never in memory at the same time.                         *
  *****************************************************************/
 
 void
 ida_discover( char *seqs[], int num_seqs, param_t *params ) 
 {
-  vector_t *vs, *m3, *m4;
+  vector_t *vs = NULL, *m3, *m4;
   list_t *m0, *m1, *m2;
   dstring_t *dseed;
 
   dseed = dev_digitalize( &bio_nuc_alphabet, seqs[ params->seed ] );
 
-  vs = make_all_vtrees( seqs, num_seqs );
+  if ( params->bidirectional )
+    gbi = make_bidir_index( seqs, num_seqs, params );
+  else
+    gsa = make_generalized_vtree( seqs, num_seqs, params );
+
+  gsa_seqs = dev_new_bitset( num_seqs );
 
   m0 = find_all_stems( dseed, params );
 
-  m1 = filter_by_support( m0, vs, params );
+  m1 = filter_by_support( m0, params );
 
   m2 = filter_keep_longest_stems( m1, params );
 
-  m3 = fix_all2( m2, vs, params );
+  m3 = fix_all2( m2, params );
 
-  combine_allall( m3, vs, params );
+  combine_allall( m3, params );
 
   display_statistics( params );
 
   m4 = postprocess( m3, params );
 
+  if ( gbi != NULL )
+    vtree_free_bidir( gbi );
+  else
+    vtree_free( gsa );
+  dev_free_bitset( gsa_seqs );
+  gsa = NULL;
+  gbi = NULL;
+  gsa_seqs = NULL;
+
+  if ( params->match_file != NULL || params->save_as_ct )
+    vs = make_all_vtrees( seqs, num_seqs, params );
+
   if ( params->match_file != NULL )
     save_matches( m4, vs, params );
 
   if ( params->save_as_ct ) {
     save_matches_as_ct( m4, vs, params );
   } else if ( params->save_motifs ) {
-    save_motifs( m4, vs, params );
+    save_motifs( m4, vs, params ); /* reads the motifs only */
   }
 
   /* cleaning up */
 
   dev_free_dstring( dseed );
-  dev_free_vector( vs, ( void ( * )( void * ) ) vtree_free );
+  if ( vs != NULL )
+    dev_free_vector( vs, ( void ( * )( void * ) ) vtree_free );
   dev_free_list( m0, ( void ( * )( void * ) ) free_motif );
   dev_free_list( m1, ( void ( * )( void * ) ) free_motif );
   dev_free_list( m2, ( void ( * )( void * ) ) free_motif );
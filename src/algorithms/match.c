@@ -17,6 +17,8 @@
 #include "libdev.h"
 #include "vector.h"
 #include "ivector.h"
+#include "list.h"
+#include "thread.h"
 #include "seq.h"
 #include "libvtree.h"
 
@@ -38,6 +40,114 @@ typedef struct {
   int length;
 } pattern_t;
 
+/*****************************************************************
+ * sec_task_t - a subtree of the search, see match_sec_struc     *
+ *****************************************************************/
+
+#define SEC_TASK_GRAIN 4096 /* smallest interval split among tasks */
+
+typedef struct sec_task_s sec_task_t;
+
+struct sec_task_s {
+  interval2_t interval;
+  int pos, m;
+  int node;          /* starts at a node rather than on an edge */
+  pos_t label;       /* suftab[ interval.i ], for an edge */
+  ivector_t *stack;
+  list_t *current;   /* hit_t, found since the last split */
+  list_t *parts;     /* part_t, in the order of the sequential search */
+  dev_pool_t *pool;
+  int worker;        /* the thread running the task */
+};
+
+/*****************************************************************
+ * hit_t - an interval of matches, reported once all the tasks   *
+ * are done                                                      *
+ *****************************************************************/
+
+typedef struct {
+  interval2_t interval;
+  int m;
+} hit_t;
+
+/*****************************************************************
+ * part_t - hits, or the task that finds them                    *
+ *****************************************************************/
+
+typedef struct {
+  list_t *hits;
+  sec_task_t *task;
+} part_t;
+
+static void
+add_part( list_t *parts, list_t *hits, sec_task_t *task )
+{
+  part_t *part = ( part_t * ) dev_malloc( sizeof( part_t ) );
+
+  part->hits = hits;
+  part->task = task;
+
+  dev_list_add( parts, part );
+}
+
+/*****************************************************************
+ * new_task - a task that searches the pattern from the interval *
+ *****************************************************************/
+
+static sec_task_t *
+new_task( interval2_t *interval, int pos, int m, ivector_t *stack )
+{
+  sec_task_t *task = ( sec_task_t * ) dev_malloc( sizeof( sec_task_t ) );
+
+  task->interval = *interval;
+  task->pos = pos;
+  task->m = m;
+  task->node = FALSE;
+
+  task->stack = dev_new_ivector();
+
+  for ( int k=0; k<dev_ivector_size( stack ); k++ )
+    dev_ivector_add( task->stack, dev_ivector_get( stack, k ) );
+
+  task->current = NULL;
+  task->parts = dev_new_list();
+
+  return task;
+}
+
+/*****************************************************************
+ * split_task - spawns a task per child of the interval; the     *
+ * hits found so far come before those of the children, and the  *
+ * next ones after                                               *
+ *****************************************************************/
+
+static void
+split_task( vtree_t *v, interval2_t *interval, int pos, int m, ivector_t *stack, sec_task_t *task )
+{
+  vtree_child_iter_t it;
+  interval2_t child;
+
+  add_part( task->parts, task->current, NULL );
+
+  for ( int more = vtree_child_first( v, interval->i, interval->j, &it ); more; more = vtree_child_next( &it ) ) {
+
+    sec_task_t *t;
+
+    child.i = it.i;
+    child.j = it.j;
+    child.node = -1;
+
+    t = new_task( &child, pos, m, stack );
+    t->label = it.label;
+
+    add_part( task->parts, NULL, t );
+
+    dev_pool_spawn( task->pool, task->worker, t );
+  }
+
+  task->current = dev_new_list();
+}
+
 /*****************************************************************
  * report_matches -                                              *
  *****************************************************************/
@@ -45,27 +155,41 @@ typedef struct {
 void
 report_matches( vtree_t *v, interval2_t *interval, pattern_t *p, int m )
 {
+  pos_t suf[ VTREE_SUFFIX_BLOCK ];
+
   printf( "query found at:\n" );
 
-  for ( pos_t k=interval->i; k<=interval->j; k++ ) {
-    printf( "  pos = %d, seq = ", v->suftab[ k ] );
-    for ( pos_t i=0; i<p->length; i++ )
-      printf( "%c", bio_nuc_tochar( v->text[ v->suftab[ k ] + i ] ) );
-    if ( m > 0 )
-      printf( ", mismatch = %d", m );
-    printf( "\n" );
+  for ( pos_t a=interval->i; a<=interval->j; a+=VTREE_SUFFIX_BLOCK ) {
+
+    pos_t b = MIN( interval->j, a + VTREE_SUFFIX_BLOCK - 1 );
+
+    vtree_get_suffixes( v, a, b, suf );
+
+    for ( pos_t k=a; k<=b; k++ ) {
+      pos_t q = suf[ k-a ];
+      printf( "  pos = %ld, seq = ", ( long ) q );
+      for ( pos_t i=0; i<p->length; i++ )
+	printf( "%c", bio_nuc_tochar( v->text[ q + i ] ) );
+      if ( m > 0 )
+	printf( ", mismatch = %d", m );
+      printf( "\n" );
+    }
   }
 }
 
 /*****************************************************************
  * match_sec_struc_edge - recursive function matching a secondary*
  * structure within an edge label.                               *
+ * label : text of the first suffix of interval, read once by    *
+ *         match_sec_struc_node for the whole edge               *
+ * task  : with task != NULL, the hits go to task->current, and  *
+ *         the large intervals are searched by new tasks         *
  *****************************************************************/
 
-static int match_sec_struc_node( vtree_t *v, interval2_t *interval, pattern_t *p, int pos, int mismatch, int m, int count, ivector_t *stack );
+static int match_sec_struc_node( vtree_t *v, interval2_t *interval, pattern_t *p, int pos, int mismatch, int m, int count, ivector_t *stack, sec_task_t *task );
 
 int
-match_sec_struc_edge( vtree_t *v, interval2_t *interval, pattern_t *p, int pos, int max, int mismatch, int m, int count, ivector_t *stack )
+match_sec_struc_edge( vtree_t *v, interval2_t *interval, symbol_t *label, pattern_t *p, int pos, int max, int mismatch, int m, int count, ivector_t *stack, sec_task_t *task )
 {
   symbol_t a, b, left;
   char s;
@@ -76,7 +200,12 @@ match_sec_struc_edge( vtree_t *v, interval2_t *interval, pattern_t *p, int pos,
     if ( dev_ivector_size( stack ) != 0 )
       dev_die( "invalid input pattern" );
 
-    if ( count )
+    if ( task != NULL ) {
+      hit_t *hit = ( hit_t * ) dev_malloc( sizeof( hit_t ) );
+      hit->interval = *interval;
+      hit->m = m;
+      dev_list_add( task->current, hit );
+    } else if ( count )
       return interval->j - interval->i + 1;
     else
       report_matches( v, interval, p, m );
@@ -85,9 +214,9 @@ match_sec_struc_edge( vtree_t *v, interval2_t *interval, pattern_t *p, int pos,
   }
 
   if ( pos == max )
-    return match_sec_struc_node( v, interval, p, pos, mismatch, m, count, stack );
+    return match_sec_struc_node( v, interval, p, pos, mismatch, m, count, stack, task );
 
-  a = v->text[ v->suftab[ interval->i ] + pos ];
+  a = label[ pos ];
   b = p->sequence[ pos ];
 
   if ( ister( a ) )
@@ -102,7 +231,7 @@ match_sec_struc_edge( vtree_t *v, interval2_t *interval, pattern_t *p, int pos,
       result = FALSE;
     } else {
       dev_ivector_add( stack, a );
-      result = match_sec_struc_edge( v, interval, p, pos+1, max, mismatch, m, count, stack );
+      result = match_sec_struc_edge( v, interval, label, p, pos+1, max, mismatch, m, count, stack, task );
       dev_ivector_remove( stack );
     }
     break;
@@ -113,7 +242,7 @@ match_sec_struc_edge( vtree_t *v, interval2_t *interval, pattern_t *p, int pos,
     if ( ( ( ! bio_nuc_cmp( a, b ) ) || ( ! bio_nuc_isbp( left, a, TRUE ) ) ) && ( ++m > mismatch ) ) {
       result = FALSE;
     } else {
-      result = match_sec_struc_edge( v, interval, p, pos+1, max, mismatch, m, count, stack );
+      result = match_sec_struc_edge( v, interval, label, p, pos+1, max, mismatch, m, count, stack, task );
     }
     dev_ivector_add( stack, left );
     break;
@@ -122,7 +251,7 @@ match_sec_struc_edge( vtree_t *v, interval2_t *interval, pattern_t *p, int pos,
     if ( ( ! bio_nuc_cmp( a, b ) ) && ( ++m > mismatch ) ) {
       result = FALSE;
     } else {
-      result = match_sec_struc_edge( v, interval, p, pos+1, max, mismatch, m, count, stack );
+      result = match_sec_struc_edge( v, interval, label, p, pos+1, max, mismatch, m, count, stack, task );
     }
     break;
 
@@ -133,42 +262,143 @@ match_sec_struc_edge( vtree_t *v, interval2_t *interval, pattern_t *p, int pos,
   return result;
 }
 
+/*****************************************************************
+ * edge_label - text of the first suffix of child, which starts  *
+ * at suf, and the depth at which its edge ends, or the length   *
+ * of the pattern                                                *
+ *****************************************************************/
+
+static symbol_t *
+edge_label( vtree_t *v, interval2_t *child, pos_t suf, pattern_t *p, pos_t *max )
+{
+  *max = p->length;
+
+  if ( child->i != child->j ) {
+    pos_t l = vtree_getlcp( v, child->i, child->j );
+    *max = MIN( l, p->length );
+  }
+
+  return v->text + suf;
+}
+
 /*****************************************************************
  * match_sec_struc_node - recursive function matching a secondary*
  * structure at an internal node                                 *
  *****************************************************************/
 
 int
-match_sec_struc_node( vtree_t *v, interval2_t *interval, pattern_t *p, int pos, int mismatch, int m, int count, ivector_t *stack )
+match_sec_struc_node( vtree_t *v, interval2_t *interval, pattern_t *p, int pos, int mismatch, int m, int count, ivector_t *stack, sec_task_t *task )
 {
-  vector_t *childs;
+  vtree_child_iter_t it;
+  interval2_t child;
+  symbol_t *label;
   int queryFound = FALSE;
 
-  childs = vtree_getChildIntervals( v, interval );
+  if ( task != NULL && interval->j - interval->i + 1 >= SEC_TASK_GRAIN ) {
+    split_task( v, interval, pos, m, stack, task );
+    return FALSE; /* unknown, the hits are counted afterwards */
+  }
 
-  for ( int c=0; c < dev_vector_size( childs ); c++ ) {
+  for ( int more = vtree_child_first( v, interval->i, interval->j, &it ); more; more = vtree_child_next( &it ) ) {
 
-    interval2_t *child = ( interval2_t * ) dev_vector_get( childs, c );
-    pos_t min = p->length;
+    pos_t min;
 
-    if ( child->i != child->j ) {
-      pos_t l = vtree_getlcp( v, child->i, child->j );
-      min = MIN( l, p->length );
-    }
+    child.i = it.i;
+    child.j = it.j;
+    label = edge_label( v, &child, it.label, p, &min );
 
-    if ( match_sec_struc_edge( v, child, p, pos, min, mismatch, m, count, stack ) )
+    if ( match_sec_struc_edge( v, &child, label, p, pos, min, mismatch, m, count, stack, task ) )
       queryFound = TRUE;
 
-    dev_free( child );
-
   }
 
   return queryFound;
 }
 
+/*****************************************************************
+ * sec_context_t - shared by the tasks of match_sec_struc        *
+ *****************************************************************/
+
+typedef struct {
+  vtree_t *v;
+  pattern_t *p;
+  int mismatch;
+  int count;
+} sec_context_t;
+
+/*****************************************************************
+ * run_task - body of the jobs of match_sec_struc                *
+ *****************************************************************/
+
+static void
+run_task( dev_pool_t *pool, int id, void *job, void *arg )
+{
+  sec_context_t *c = ( sec_context_t * ) arg;
+  sec_task_t *t = ( sec_task_t * ) job;
+
+  t->pool = pool;
+  t->worker = id;
+  t->current = dev_new_list();
+
+  if ( t->node )
+    ( void ) match_sec_struc_node( c->v, &t->interval, c->p, t->pos, c->mismatch, t->m, c->count, t->stack, t );
+  else {
+    pos_t min;
+    symbol_t *label = edge_label( c->v, &t->interval, t->label, c->p, &min );
+    ( void ) match_sec_struc_edge( c->v, &t->interval, label, c->p, t->pos, min, c->mismatch, t->m, c->count, t->stack, t );
+  }
+
+  add_part( t->parts, t->current, NULL );
+
+  dev_free_ivector( t->stack );
+}
+
+/*****************************************************************
+ * collect_parts - reports the hits of task, in the order of the *
+ * sequential search, frees the task, and returns the number of  *
+ * hits                                                          *
+ *****************************************************************/
+
+static int
+collect_parts( vtree_t *v, pattern_t *p, int count, sec_task_t *task )
+{
+  int n = 0;
+
+  while ( dev_list_size( task->parts ) > 0 ) {
+
+    part_t *part = ( part_t * ) dev_list_serve( task->parts );
+
+    if ( part->task != NULL ) {
+      n += collect_parts( v, p, count, part->task );
+    } else {
+      while ( dev_list_size( part->hits ) > 0 ) {
+	hit_t *hit = ( hit_t * ) dev_list_serve( part->hits );
+	if ( ! count )
+	  report_matches( v, &hit->interval, p, hit->m );
+	dev_free( hit );
+	n++;
+      }
+      dev_free_list( part->hits, dev_free );
+    }
+
+    dev_free( part );
+  }
+
+  dev_free_list( task->parts, dev_free );
+  dev_free( task );
+
+  return n;
+}
+
 /*****************************************************************
  * match_sec_struc -                                             *
  * returns true if an occurrence the pattern was found           * 
+ *                                                               *
+ * On vtree_get_num_threads() threads, the search starts as a    *
+ * single task; a task that reaches an interval of               *
+ * SEC_TASK_GRAIN suffixes or more spawns a task per child,      *
+ * which idle threads steal.  The hits are reported afterwards,  *
+ * in the order of the sequential search.                        *
  *****************************************************************/
 
 int
@@ -186,7 +416,24 @@ match_sec_struc( vtree_t *v, char *sequence, char *structure, int mismatch, int
   pat.structure = structure;
   pat.length = ds->length-1;
 
-  result = match_sec_struc_node( v, i0, &pat, 0, mismatch, 0, count, stack );
+  if ( vtree_get_num_threads() > 1 ) {
+
+    sec_context_t context;
+    sec_task_t *root = new_task( i0, 0, 0, stack );
+
+    root->node = TRUE;
+
+    context.v = v;
+    context.p = &pat;
+    context.mismatch = mismatch;
+    context.count = count;
+
+    dev_steal_run( vtree_get_num_threads(), run_task, ( void ** ) &root, 1, &context );
+
+    result = collect_parts( v, &pat, count, root ) > 0;
+
+  } else
+    result = match_sec_struc_node( v, i0, &pat, 0, mismatch, 0, count, stack, NULL );
 
   dev_free_dstring( ds );
   dev_free( i0 );
@@ -220,13 +467,28 @@ main( int argc, char *argv[] )
 
   char **seq_pat, **seq_db, **desc_pat, **desc_db;
 
-  int num_seqs;
+  char *index = NULL;
+
+  int num_seqs, num_threads = 1;
+
+  while ( argc > 3 && ( strcmp( argv[ 1 ], "-i" ) == 0 || strcmp( argv[ 1 ], "-t" ) == 0 ) ) {
+    if ( argv[ 1 ][ 1 ] == 'i' )
+      index = argv[ 2 ];
+    else
+      num_threads = atoi( argv[ 2 ] );
+    argv += 2;
+    argc -= 2;
+  }
 
-  if ( argc != 3 ) {
-    fprintf( stderr, "Usage: match pat.fa db.fa\n" );
+  if ( argc != 3 || num_threads < 1 ) {
+    fprintf( stderr, "Usage: match [-i index] [-t threads] pat.fa db.fa\n" );
+    fprintf( stderr, "the index of the i-th sequence of db.fa is saved to index.i\n" );
+    fprintf( stderr, "the vtrees are made and searched by threads threads\n" );
     exit( EXIT_FAILURE );
   }
 
+  vtree_set_num_threads( num_threads );
+
   if ( bio_read_fasta( argv[ 1 ], &seq_pat, &desc_pat, isnuc_or_struc ) != 2 ) {
     fprintf( stderr, "not a valid pattern %s\n", argv[ 1 ] );
     exit( EXIT_FAILURE );
@@ -248,7 +510,12 @@ main( int argc, char *argv[] )
 
     t0 =  clock();
 
-    vtree = vtree_create( dstring );
+    if ( index != NULL ) {
+      char *filename = vtree_index_filename( index, i );
+      vtree = vtree_open_index( filename, dstring );
+      dev_free( filename );
+    } else
+      vtree = vtree_create( dstring );
 
     t1 = clock();
 
@@ -12,6 +12,7 @@
 
 #include "ivector.h"
 #include "list.h"
+#include "thread.h"
 #include "seq.h"
 #include "motif.h"
 #include <string.h>
@@ -253,13 +254,15 @@ clone_motif( motif_t *m )
 }
 
 /*****************************************************************
- * add_match - creates and adds matches to a list                *
+ * add_match - creates and adds matches to a list, offset is     *
+ * suftab[ interval->i ]                                         *
  *****************************************************************/
 
 void
 add_match( list_t *matches,
 	   vtree_t *v,
 	   interval2_t *interval,
+	   pos_t offset,
 	   symbol_t *sbuf,
 	   char *bbuf,
 	   int length,
@@ -289,7 +292,7 @@ add_match( list_t *matches,
 
     m = ( match_t * ) dev_malloc( sizeof( match_t ) );
 
-    m->offset = v->suftab[ interval->i ];
+    m->offset = offset;
     m->length = length;
     m->sequence = sequence;
     m->structure = structure;
@@ -300,8 +303,255 @@ add_match( list_t *matches,
   }
 }
 
+/*****************************************************************
+ * edge_t - the first suffix of an interval, whose symbols label *
+ * the edge that leads to it, and the end of its sequence        *
+ *****************************************************************/
+
+typedef struct {
+  pos_t p;
+  pos_t end; /* in a generalized vtree only */
+} edge_t;
+
+/*****************************************************************
+ * edge_of - resolves the sequence of the first suffix of an     *
+ * interval, which starts at p, see vtree_child_iter_t, once for *
+ * all the symbols read along the edge                           *
+ *****************************************************************/
+
+static inline void
+edge_of( vtree_t *v, pos_t p, edge_t *edge )
+{
+  edge->p = p;
+  edge->end = v->num_seqs > 1 ? vtree_seq_end( v, vtree_seq_of( v, edge->p ) ) : v->length;
+}
+
+/*****************************************************************
+ * symbol_at - symbol at the position pos of the edge            *
+ *                                                               *
+ * In a generalized vtree, the separator of a sequence reads as  *
+ * its terminator, and the positions beyond it as gaps, like the *
+ * padding that follows the text of an ordinary vtree.           *
+ *****************************************************************/
+
+static inline symbol_t
+symbol_at( vtree_t *v, edge_t *edge, pos_t pos )
+{
+  if ( v->num_seqs > 1 ) {
+
+    if ( edge->p + pos == edge->end )
+      return SYM_TER;
+
+    if ( edge->p + pos > edge->end )
+      return SYM_GAP;
+  }
+
+  return v->text[ edge->p + pos ];
+}
+
+/*****************************************************************
+ * interval_lcp - lcp-value of an interval, not a singleton      *
+ *****************************************************************/
+
+static inline pos_t
+interval_lcp( vtree_t *v, interval2_t *interval )
+{
+  if ( interval->node >= 0 )
+    return vtree_get_node( v, interval->node )->lcp;
+
+  return vtree_getlcp( v, interval->i, interval->j );
+}
+
+/*****************************************************************
+ * child_first - starts an iteration over the children of        *
+ * interval, from the node table if its node is known, see       *
+ * vtree_node_first                                              *
+ *****************************************************************/
+
+static inline int
+child_first( vtree_t *v, interval2_t *interval, vtree_child_iter_t *it )
+{
+  if ( interval->node >= 0 )
+    return vtree_node_first( v, interval->node, it );
+
+  return vtree_child_first( v, interval->i, interval->j, it );
+}
+
+/*****************************************************************
+ * found_t - sequences of a generalized vtree that contain a     *
+ * match                                                         *
+ *****************************************************************/
+
+typedef struct {
+  bitset_t *seqs;
+  int count; /* number of elements of seqs */
+} found_t;
+
+/*****************************************************************
+ * all_found - true if all the sequences were found              *
+ *****************************************************************/
+
+static inline int
+all_found( found_t *found )
+{
+  return found->count == dev_bitset_size( found->seqs );
+}
+
+/*****************************************************************
+ * mark_found - adds the sequences of the suffixes of interval   *
+ * to found                                                      *
+ *****************************************************************/
+
+static void
+mark_found( vtree_t *v, interval2_t *interval, found_t *found )
+{
+  pos_t suf[ VTREE_SUFFIX_BLOCK ];
+
+  for ( pos_t a=interval->i; a<=interval->j && ! all_found( found ); a+=VTREE_SUFFIX_BLOCK ) {
+
+    pos_t b = MIN( interval->j, a + VTREE_SUFFIX_BLOCK - 1 );
+
+    vtree_get_suffixes( v, a, b, suf );
+
+    for ( pos_t k=a; k<=b && ! all_found( found ); k++ ) {
+
+      int s = vtree_seq_of( v, suf[ k-a ] );
+
+      if ( ! dev_bitset_get( found->seqs, s ) ) {
+	dev_bitset_set( found->seqs, s );
+	found->count++;
+      }
+    }
+  }
+}
+
+/*****************************************************************
+ * match_task_t - a subtree of the search, see match_parallel    *
+ *****************************************************************/
+
+#define MATCH_TASK_GRAIN 4096 /* smallest interval split among tasks */
+
+typedef struct match_task_s match_task_t;
+
+struct match_task_s {
+  interval2_t interval;
+  expression_t *e;
+  int pos, offset, m, ibuf;
+  int node;          /* starts at a node rather than on an edge */
+  pos_t label;       /* suftab[ interval.i ], for an edge */
+  int size;          /* of sbuf and bbuf */
+  symbol_t *sbuf;
+  char *bbuf;
+  ivector_t *stack;
+  list_t *current;   /* the matches found since the last split */
+  list_t *parts;     /* part_t, in the order of the sequential search */
+  dev_pool_t *pool;
+  int worker;        /* the thread running the task */
+};
+
+/*****************************************************************
+ * part_t - matches, or the task that finds them                 *
+ *****************************************************************/
+
+typedef struct {
+  list_t *matches;
+  match_task_t *task;
+} part_t;
+
+static void
+add_part( list_t *parts, list_t *matches, match_task_t *task )
+{
+  part_t *part = ( part_t * ) dev_malloc( sizeof( part_t ) );
+
+  part->matches = matches;
+  part->task = task;
+
+  dev_list_add( parts, part );
+}
+
+/*****************************************************************
+ * new_task - a task that searches e from the interval, with the *
+ * state of the search that leads there                          *
+ *****************************************************************/
+
+static match_task_t *
+new_task( interval2_t *interval, expression_t *e, int pos, int offset, int m,
+	  symbol_t *sbuf, char *bbuf, int ibuf, ivector_t *stack, int size )
+{
+  match_task_t *task = ( match_task_t * ) dev_malloc( sizeof( match_task_t ) );
+
+  task->interval = *interval;
+  task->e = e;
+  task->pos = pos;
+  task->offset = offset;
+  task->m = m;
+  task->ibuf = ibuf;
+  task->node = FALSE;
+  task->size = size;
+
+  task->sbuf = ( symbol_t * ) dev_malloc( ( size + 1 ) * sizeof( symbol_t ) );
+  task->bbuf = ( char * ) dev_malloc( ( size + 1 ) * sizeof( char ) );
+
+  if ( ibuf > 0 ) {
+    memcpy( task->sbuf, sbuf, ibuf * sizeof( symbol_t ) );
+    memcpy( task->bbuf, bbuf, ibuf * sizeof( char ) );
+  }
+
+  task->stack = dev_new_ivector();
+
+  for ( int k=0; k<dev_ivector_size( stack ); k++ )
+    dev_ivector_add( task->stack, dev_ivector_get( stack, k ) );
+
+  task->current = NULL;
+  task->parts = dev_new_list();
+
+  return task;
+}
+
+/*****************************************************************
+ * split_task - spawns a task per child of the interval, which   *
+ * task reaches with the current search state; the matches found *
+ * so far come before those of the children, and the next ones   *
+ * after                                                         *
+ *****************************************************************/
+
+static void
+split_task( vtree_t *v, interval2_t *interval, expression_t *e, int pos, int offset, int m,
+	    int ibuf, match_task_t *task )
+{
+  vtree_child_iter_t it;
+  interval2_t child;
+
+  add_part( task->parts, task->current, NULL );
+
+  for ( int more = child_first( v, interval, &it ); more; more = vtree_child_next( &it ) ) {
+
+    match_task_t *t;
+
+    child.i = it.i;
+    child.j = it.j;
+    child.node = it.node;
+
+    t = new_task( &child, e, pos, offset, m, task->sbuf, task->bbuf, ibuf, task->stack, task->size );
+    t->label = it.label;
+
+    add_part( task->parts, NULL, t );
+
+    dev_pool_spawn( task->pool, task->worker, t );
+  }
+
+  task->current = dev_new_list();
+}
+
 /*****************************************************************
  * Mutually recursive functions                                  *
+ *                                                               *
+ * With found != NULL, the search continues after a match, since *
+ * the sequences of the other matches count too, until all the   *
+ * sequences are found.                                          *
+ *                                                               *
+ * With task != NULL, the matches go to task->current, and the   *
+ * large intervals are searched by new tasks, see match_parallel *
  *****************************************************************/
 
 static int 
@@ -312,16 +562,21 @@ match_node( vtree_t *v,
 	    symbol_t *sbuf, char *bbuf, int ibuf,
 	    ivector_t *stack, 
 	    list_t *matches,
+	    found_t *found,
+	    match_task_t *task,
 	    param_t *params );
 
 static int 
 match_edge( vtree_t *v, 
 	    interval2_t *interval, 
+	    edge_t *edge,
 	    expression_t *e, 
 	    int pos, int offset, int m, int save_all, int decision_mode,
 	    symbol_t *sbuf, char *bbuf, int ibuf,
 	    ivector_t *stack, 
 	    list_t *matches,
+	    found_t *found,
+	    match_task_t *task,
 	    param_t *params );
 
 /*****************************************************************
@@ -332,11 +587,14 @@ match_edge( vtree_t *v,
 int
 match_edge( vtree_t *v, 
 	    interval2_t *interval, 
+	    edge_t *edge,
 	    expression_t *e,
 	    int pos, int offset, int m, int save_all, int decision_mode,
 	    symbol_t *sbuf, char *bbuf, int ibuf,
 	    ivector_t *stack, 
 	    list_t *matches,
+	    found_t *found,
+	    match_task_t *task,
 	    param_t *params )
 {
   symbol_t a, b, c;
@@ -349,16 +607,18 @@ match_edge( vtree_t *v,
     if ( dev_ivector_size( stack ) != 0 )
       dev_die( "internal error, invalid expression" );
 
-    if ( ! decision_mode )
-      add_match( matches, v, interval, sbuf, bbuf, ibuf, save_all );
+    if ( found != NULL )
+      mark_found( v, interval, found );
+    else if ( ! decision_mode )
+      add_match( task != NULL ? task->current : matches, v, interval, edge->p, sbuf, bbuf, ibuf, save_all );
 
     return TRUE;
   }
 
   /* at an internal node? */
 
-  if ( interval->i != interval->j && pos == vtree_getlcp( v, interval->i, interval->j ) ) {
-    return match_node( v, interval, e, pos, offset, m, save_all, decision_mode, sbuf, bbuf, ibuf, stack, matches, params );
+  if ( interval->i != interval->j && pos == interval_lcp( v, interval ) ) {
+    return match_node( v, interval, e, pos, offset, m, save_all, decision_mode, sbuf, bbuf, ibuf, stack, matches, found, task, params );
   }
 
   /* else */
@@ -367,9 +627,9 @@ match_edge( vtree_t *v,
   case left:
 
     if ( offset >= e->length )
-      return match_edge( v, interval, e->nested, pos, 0, m, save_all, decision_mode, sbuf, bbuf, ibuf, stack, matches, params );
+      return match_edge( v, interval, edge, e->nested, pos, 0, m, save_all, decision_mode, sbuf, bbuf, ibuf, stack, matches, found, task, params );
 
-    a = v->text[ v->suftab[ interval->i ] + pos ];
+    a = symbol_at( v, edge, pos );
 
     if ( a == SYM_GAP )
       return FALSE;
@@ -400,7 +660,7 @@ match_edge( vtree_t *v,
 
       dev_ivector_add( stack, a );
 
-      result = match_edge( v, interval, e, pos+1, offset+1, m, save_all, decision_mode, sbuf, bbuf, ibuf, stack, matches, params );
+      result = match_edge( v, interval, edge, e, pos+1, offset+1, m, save_all, decision_mode, sbuf, bbuf, ibuf, stack, matches, found, task, params );
 
       dev_ivector_remove( stack );
     }
@@ -409,9 +669,9 @@ match_edge( vtree_t *v,
   case right:
 
     if ( offset >= e->length )
-      return match_edge( v, interval, e->adjacent, pos, 0, m, save_all, decision_mode, sbuf, bbuf, ibuf, stack, matches, params );
+      return match_edge( v, interval, edge, e->adjacent, pos, 0, m, save_all, decision_mode, sbuf, bbuf, ibuf, stack, matches, found, task, params );
 
-    a = v->text[ v->suftab[ interval->i ] + pos ];
+    a = symbol_at( v, edge, pos );
 
     if ( a == SYM_GAP )
       return FALSE;
@@ -442,7 +702,7 @@ match_edge( vtree_t *v,
 	ibuf++;
       }
 
-      result = match_edge( v, interval, e, pos+1, offset+1, m, save_all, decision_mode, sbuf, bbuf, ibuf, stack, matches, params );
+      result = match_edge( v, interval, edge, e, pos+1, offset+1, m, save_all, decision_mode, sbuf, bbuf, ibuf, stack, matches, found, task, params );
     }
 
     dev_ivector_add( stack, c );
@@ -453,13 +713,13 @@ match_edge( vtree_t *v,
 
     if ( offset >= e->length ) {
 
-      result = match_edge( v, interval, e->adjacent, pos, 0, m, save_all, decision_mode, sbuf, bbuf, ibuf, stack, matches, params );
+      result = match_edge( v, interval, edge, e->adjacent, pos, 0, m, save_all, decision_mode, sbuf, bbuf, ibuf, stack, matches, found, task, params );
 
-      if ( ( ( ! result ) || ( save_all ) ) && ( offset < e->length + params->range ) ) {
+      if ( ( ( ! result ) || save_all || ( found != NULL && ! all_found( found ) ) ) && ( offset < e->length + params->range ) ) {
 
 	/* Gready matching strategy - we might want to revisit that choice */
 	
-	a = v->text[ v->suftab[ interval->i ] + pos ];
+	a = symbol_at( v, edge, pos );
 
 	if ( sbuf != NULL ) { 
 	  sbuf[ ibuf ] = a; 
@@ -467,13 +727,13 @@ match_edge( vtree_t *v,
 	  ibuf++; 
 	}
       
-	result = match_edge( v, interval, e, pos+1, offset+1, m, save_all, decision_mode, sbuf, bbuf, ibuf, stack, matches, params );
+	result = match_edge( v, interval, edge, e, pos+1, offset+1, m, save_all, decision_mode, sbuf, bbuf, ibuf, stack, matches, found, task, params );
 
       }
 
     } else {
 
-      a = v->text[ v->suftab[ interval->i ] + pos ];
+      a = symbol_at( v, edge, pos );
 
       if ( a == SYM_GAP )
 	return FALSE;
@@ -485,7 +745,7 @@ match_edge( vtree_t *v,
 
       if ( sbuf != NULL ) { sbuf[ ibuf ] = a; bbuf[ ibuf ] = '.'; ibuf++; }
 
-      result = match_edge( v, interval, e, pos+1, offset+1, m, save_all, decision_mode, sbuf, bbuf, ibuf, stack, matches, params );
+      result = match_edge( v, interval, edge, e, pos+1, offset+1, m, save_all, decision_mode, sbuf, bbuf, ibuf, stack, matches, found, task, params );
 
     }
 
@@ -511,31 +771,157 @@ match_node( vtree_t *v,
 	    symbol_t *sbuf, char *bbuf, int ibuf,
 	    ivector_t *stack, 
 	    list_t *matches,
+	    found_t *found,
+	    match_task_t *task,
 	    param_t *params )
 {
-  vector_t *childs;
+  vtree_child_iter_t it;
+  interval2_t child;
+  edge_t edge;
   int queryFound = FALSE;
 
-  childs = vtree_getChildIntervals( v, interval );
+  if ( task != NULL && interval->j - interval->i + 1 >= MATCH_TASK_GRAIN ) {
+    split_task( v, interval, e, pos, offset, m, ibuf, task );
+    return FALSE; /* unknown, but save_all ignores it */
+  }
 
-  while ( dev_vector_size( childs ) > 0 && ( ( ! queryFound ) || save_all ) ) {
+  for ( int more = child_first( v, interval, &it );
+	more && ( ( ! queryFound ) || save_all || ( found != NULL && ! all_found( found ) ) );
+	more = vtree_child_next( &it ) ) {
 
-    interval2_t *child = ( interval2_t * ) dev_vector_serve( childs );
+    child.i = it.i;
+    child.j = it.j;
+    child.node = it.node;
   
-    if ( match_edge( v, child, e, pos, offset, m, save_all, decision_mode, sbuf, bbuf, ibuf, stack, matches, params ) )
+    edge_of( v, it.label, &edge );
+
+    if ( match_edge( v, &child, &edge, e, pos, offset, m, save_all, decision_mode, sbuf, bbuf, ibuf, stack, matches, found, task, params ) )
       queryFound = TRUE;
 
-    dev_free( child );
+  }
+
+  return queryFound;
+}
+
+/*****************************************************************
+ * match_context_t - shared by the tasks of match_parallel       *
+ *****************************************************************/
+
+typedef struct {
+  vtree_t *v;
+  param_t *params;
+} match_context_t;
 
+/*****************************************************************
+ * run_task - body of the jobs of match_parallel                 *
+ *****************************************************************/
+
+static void
+run_task( dev_pool_t *pool, int id, void *job, void *arg )
+{
+  match_context_t *context = ( match_context_t * ) arg;
+  match_task_t *t = ( match_task_t * ) job;
+  edge_t edge;
+
+  t->pool = pool;
+  t->worker = id;
+  t->current = dev_new_list();
+
+  if ( t->node )
+    ( void ) match_node( context->v, &t->interval, t->e, t->pos, t->offset, t->m, TRUE, FALSE,
+			 t->sbuf, t->bbuf, t->ibuf, t->stack, NULL, NULL, t, context->params );
+  else {
+    edge_of( context->v, t->label, &edge );
+    ( void ) match_edge( context->v, &t->interval, &edge, t->e, t->pos, t->offset, t->m, TRUE, FALSE,
+			 t->sbuf, t->bbuf, t->ibuf, t->stack, NULL, NULL, t, context->params );
   }
 
-  dev_free_vector( childs, dev_free );
+  add_part( t->parts, t->current, NULL );
 
-  return queryFound;
+  dev_free( t->sbuf );
+  dev_free( t->bbuf );
+  dev_free_ivector( t->stack );
+}
+
+/*****************************************************************
+ * collect_parts - moves the matches of task to matches, in the  *
+ * order of the sequential search, and frees the task            *
+ *****************************************************************/
+
+static void
+collect_parts( match_task_t *task, list_t *matches )
+{
+  while ( dev_list_size( task->parts ) > 0 ) {
+
+    part_t *part = ( part_t * ) dev_list_serve( task->parts );
+
+    if ( part->task != NULL ) {
+      collect_parts( part->task, matches );
+    } else {
+      while ( dev_list_size( part->matches ) > 0 )
+	dev_list_add( matches, dev_list_serve( part->matches ) );
+      dev_free_list( part->matches, ( void ( * )( void * ) ) free_match );
+    }
+
+    dev_free( part );
+  }
+
+  dev_free_list( task->parts, dev_free );
+  dev_free( task );
+}
+
+/*****************************************************************
+ * match_parallel - match with save_all, on several threads      *
+ *                                                               *
+ * The search starts as a single task; a task that reaches an    *
+ * interval of MATCH_TASK_GRAIN suffixes or more spawns a task   *
+ * per child, which idle threads steal.  Each task records its   *
+ * matches and its children in the order the sequential search   *
+ * visits them, hence the list returned is the one of match, for *
+ * any number of threads.  Without save_all, the search of a     *
+ * subtree depends on the matches of its siblings, and is done   *
+ * by match.                                                     *
+ *****************************************************************/
+
+static list_t *
+match_parallel( vtree_t *v, motif_t *m, param_t *params )
+{
+  match_context_t context;
+  match_task_t *root;
+  interval2_t i0;
+  ivector_t *stack = dev_new_ivector();
+  list_t *matches = dev_new_list();
+  int size = 0;
+
+  /* the longest match */
+
+  for ( expression_t *e = m->expression; e != NULL; e = expression_next( e ) )
+    size += e->length + ( e->type == range ? params->range : 0 );
+
+  i0.i = 0;
+  i0.j = v->length;
+  i0.node = v->nodetab != NULL ? 0 : -1;
+
+  root = new_task( &i0, m->expression, 0, 0, 0, NULL, NULL, 0, stack, size );
+  root->node = TRUE;
+
+  context.v = v;
+  context.params = params;
+
+  dev_steal_run( vtree_get_num_threads(), run_task, ( void ** ) &root, 1, &context );
+
+  collect_parts( root, matches );
+
+  dev_free_ivector( stack );
+
+  return matches;
 }
 
 /*****************************************************************
  * match - returns a list of matches                             *
+ *                                                               *
+ * With save_all, the search is done by vtree_get_num_threads()  *
+ * threads, see match_parallel.                                  *
  *****************************************************************/
 
 list_t *
@@ -547,13 +933,16 @@ match( vtree_t *v, motif_t *m, int save_all, param_t *params )
   char *bbuf;
   list_t *matches;
 
-  i0 = new_interval2( 0, v->length );
+  if ( save_all && vtree_get_num_threads() > 1 )
+    return match_parallel( v, m, params );
+
+  i0 = vtree_root_interval( v );
   sbuf = ( symbol_t * ) dev_malloc( ( v->length + 1 ) * sizeof( symbol_t ) );
   bbuf = ( char * ) dev_malloc( ( v->length + 1 ) * sizeof( char ) );
   stack = dev_new_ivector();
   matches = dev_new_list();
 
-  ( void ) match_node( v, i0, m->expression, 0, 0, 0, save_all, FALSE, sbuf, bbuf, 0, stack, matches, params );
+  ( void ) match_node( v, i0, m->expression, 0, 0, 0, save_all, FALSE, sbuf, bbuf, 0, stack, matches, NULL, NULL, params );
 
   dev_free( i0 );
   dev_free( sbuf );
@@ -572,20 +961,497 @@ match( vtree_t *v, motif_t *m, int save_all, param_t *params )
 int
 occurs( vtree_t *v, motif_t *m, param_t *params )
 {
-  interval2_t *i0 = new_interval2( 0, v->length );
+  interval2_t *i0 = vtree_root_interval( v );
+
+  ivector_t *stack = dev_new_ivector();
+
+  int result = match_node( v, i0, m->expression, 0, 0, 0, FALSE, TRUE, NULL, NULL, 0, stack, NULL, NULL, NULL, params );
+
+  dev_free( i0 );
+  dev_free_ivector( stack );
+
+  params->match_count++;
+
+  return result;
+}
+
+/*****************************************************************
+ * occurrences - sets in seqs the sequences of the generalized   *
+ * vtree g that contain at least one match of the motif, and     *
+ * returns their number.  One traversal replaces the calls to    *
+ * occurs for each sequence.                                     *
+ *****************************************************************/
+
+int
+occurrences( vtree_t *g, motif_t *m, bitset_t *seqs, param_t *params )
+{
+  interval2_t *i0 = vtree_root_interval( g );
 
   ivector_t *stack = dev_new_ivector();
 
-  int result = match_node( v, i0, m->expression, 0, 0, 0, FALSE, TRUE, NULL, NULL, 0, stack, NULL, params );
+  found_t found;
+
+  assert( dev_bitset_size( seqs ) == g->num_seqs );
+
+  for ( int s=0; s < g->num_seqs; s++ )
+    dev_bitset_clear( seqs, s );
+
+  found.seqs = seqs;
+  found.count = 0;
+
+  ( void ) match_node( g, i0, m->expression, 0, 0, 0, FALSE, TRUE, NULL, NULL, 0, stack, NULL, &found, NULL, params );
 
   dev_free( i0 );
   dev_free_ivector( stack );
 
   params->match_count++;
 
+  return found.count;
+}
+
+/*****************************************************************
+ * column_t - a column of a stem, or a range, of a motif read    *
+ * 5' to 3', see bidir_columns                                   *
+ *****************************************************************/
+
+typedef struct {
+  element_t type;
+  symbol_t sym;    /* of a column of a stem */
+  int partner;     /* the column it pairs with */
+  int min, max;    /* lengths of a range */
+} column_t;
+
+/*****************************************************************
+ * bidir_t - search of a motif with a bidirectional index        *
+ *                                                               *
+ * The columns are read in the order of dir, starting between    *
+ * the columns anchor-1 and anchor, and the matched string is    *
+ * always that of the columns lo..hi-1.                          *
+ *****************************************************************/
+
+typedef struct {
+  vtree_bidir_t *b;
+  column_t *columns;
+  int num_columns;
+  int anchor;
+  int *dir;        /* -1 extends to the left, +1 to the right */
+  symbol_t *read;  /* symbol matched by each column of a stem */
+  int *nt_match;   /* that symbol matches the one of the motif */
+  found_t *found;
+  param_t *params;
+} bidir_t;
+
+/*****************************************************************
+ * bidir_columns - the columns of a motif, or NULL if one of its *
+ * symbols is a terminator, which matches nothing                *
+ *****************************************************************/
+
+static column_t *
+bidir_columns( motif_t *m, int *num_columns, param_t *params )
+{
+  ivector_t *stack = dev_new_ivector();
+  column_t *columns;
+  int n = 0, valid = TRUE;
+
+  for ( expression_t *e = m->expression; e != NULL; e = expression_next( e ) )
+    n += e->type == range ? 1 : e->length;
+
+  columns = ( column_t * ) dev_malloc( MAX( n, 1 ) * sizeof( column_t ) );
+
+  n = 0;
+
+  for ( expression_t *e = m->expression; e != NULL; e = expression_next( e ) ) {
+
+    if ( e->type == range ) {
+      columns[ n ].type = range;
+      columns[ n ].min = e->length;
+      columns[ n ].max = e->length + params->range;
+      n++;
+      continue;
+    }
+
+    for ( int offset=0; offset < e->length; offset++ ) {
+
+      columns[ n ].type = e->type;
+      columns[ n ].sym = get_sym_5_to_3( e, offset );
+
+      if ( dev_isspecial( &bio_nuc_alphabet, columns[ n ].sym ) )
+	valid = FALSE;
+
+      if ( e->type == left )
+	dev_ivector_add( stack, n );
+      else {
+	columns[ n ].partner = dev_ivector_remove( stack );
+	columns[ columns[ n ].partner ].partner = n;
+      }
+
+      n++;
+    }
+  }
+
+  if ( dev_ivector_size( stack ) != 0 )
+    dev_die( "internal error, invalid expression" );
+
+  dev_free_ivector( stack );
+
+  if ( ! valid ) {
+    dev_free( columns );
+    return NULL;
+  }
+
+  *num_columns = n;
+
+  return columns;
+}
+
+/*****************************************************************
+ * bidir_anchor - the loop of the most constrained hairpin, the  *
+ * one whose stem has the most columns and fixed symbols, or the *
+ * first column if there is no hairpin                           *
+ *****************************************************************/
+
+static int
+bidir_anchor( column_t *columns, int n )
+{
+  int anchor = 0, best = 0;
+
+  for ( int k=1; k<n-1; k++ ) {
+
+    int score = 0;
+
+    if ( columns[ k ].type != range )
+      continue;
+
+    for ( int d=1; k-d >= 0 && k+d < n && columns[ k-d ].type == left && columns[ k-d ].partner == k+d; d++ )
+      score += 2 + ( columns[ k-d ].sym != SYM_NUC_N ) + ( columns[ k+d ].sym != SYM_NUC_N );
+
+    if ( score > best ) {
+      anchor = k;
+      best = score;
+    }
+  }
+
+  return anchor;
+}
+
+/*****************************************************************
+ * bidir_schedule - order in which the columns are read          *
+ *                                                               *
+ * A column whose partner was read is taken first, since the     *
+ * base pair prunes at once, then a column of the left arm whose *
+ * partner is the next one on the right.  Otherwise the search   *
+ * goes on to the right over the ranges and the left arms, and   *
+ * to the left when it reaches a right arm.                      *
+ *****************************************************************/
+
+static void
+bidir_schedule( bidir_t *s )
+{
+  column_t *c = s->columns;
+  int lo = s->anchor, hi = s->anchor;
+
+  for ( int step=0; step < s->num_columns; step++ ) {
+
+    int l = lo - 1, r = hi < s->num_columns ? hi : -1;
+
+    if ( r >= 0 && c[ r ].type == right && c[ r ].partner >= lo )
+      s->dir[ step ] = 1;
+    else if ( l >= 0 && c[ l ].type == left && c[ l ].partner < hi )
+      s->dir[ step ] = -1;
+    else if ( l >= 0 && c[ l ].type == left && c[ l ].partner == r )
+      s->dir[ step ] = -1;
+    else if ( r >= 0 && c[ r ].type != right )
+      s->dir[ step ] = 1;
+    else
+      s->dir[ step ] = l >= 0 ? -1 : 1;
+
+    if ( s->dir[ step ] < 0 )
+      lo--;
+    else
+      hi++;
+  }
+}
+
+/*****************************************************************
+ * bidir_mismatch - mismatches of the symbol a read by column k  *
+ *                                                               *
+ * Those of match_edge.  A column of a right arm read before its *
+ * partner counts the base pair once the left one is read,       *
+ * unless its own symbol already counted.                        *
+ *****************************************************************/
+
+static inline int
+bidir_mismatch( bidir_t *s, int k, symbol_t a, int lo, int hi )
+{
+  column_t *c = &s->columns[ k ];
+  int p = c->partner, paired = p >= lo && p < hi;
+
+  s->nt_match[ k ] = bio_nuc_cmp( a, c->sym );
+
+  if ( c->type == left )
+    return ( ! s->nt_match[ k ] ) + ( paired && s->nt_match[ p ] && ! bio_nuc_isbp( a, s->read[ p ], ! s->params->nogu ) );
+
+  return ( ! s->nt_match[ k ] ) || ( paired && ! bio_nuc_isbp( s->read[ p ], a, ! s->params->nogu ) );
+}
+
+/*****************************************************************
+ * bidir_text - recursive function reading the column of step in *
+ * the text, for the occurrence at p of length len               *
+ *                                                               *
+ * count symbols of a range were read so far.  Returns as soon   *
+ * as the occurrence matches, its sequence is then found.        *
+ *****************************************************************/
+
+static int
+bidir_text( bidir_t *s, pos_t p, pos_t len, int step, int lo, int hi, int m, int count )
+{
+  vtree_t *v = s->b->forward;
+  column_t *c;
+  symbol_t a;
+  int k, to_left;
+
+  if ( step == s->num_columns ) {
+
+    if ( s->found != NULL ) {
+
+      int seq = vtree_seq_of( v, p );
+
+      if ( ! dev_bitset_get( s->found->seqs, seq ) ) {
+	dev_bitset_set( s->found->seqs, seq );
+	s->found->count++;
+      }
+    }
+
+    return TRUE;
+  }
+
+  to_left = s->dir[ step ] < 0;
+  k = to_left ? lo-1 : hi;
+  c = &s->columns[ k ];
+
+  if ( c->type == range ) {
+
+    if ( count >= c->min && bidir_text( s, p, len, step+1, to_left ? lo-1 : lo, to_left ? hi : hi+1, m, 0 ) )
+      return TRUE;
+
+    if ( count == c->max )
+      return FALSE;
+  }
+
+  a = to_left ? ( p > 0 ? v->text[ p-1 ] : SYM_TER ) : v->text[ p+len ];
+
+  if ( a < SYM_NUC_A || a > SYM_NUC_N )
+    return FALSE; /* a gap, terminator or separator */
+
+  if ( to_left )
+    p--;
+
+  if ( c->type == range )
+    return bidir_text( s, p, len+1, step, lo, hi, m, count+1 );
+
+  m += bidir_mismatch( s, k, a, lo, hi );
+
+  if ( m > s->params->max_mismatch )
+    return FALSE;
+
+  s->read[ k ] = a;
+
+  return bidir_text( s, p, len+1, step+1, to_left ? lo-1 : lo, to_left ? hi : hi+1, m, 0 );
+}
+
+/*****************************************************************
+ * bidir_step - recursive function reading the column of step,   *
+ * for the occurrences of x, of length len                       *
+ *                                                               *
+ * count symbols of a range were read so far.  The occurrences   *
+ * of an interval of at most BIDIR_TEXT rows are read in the     *
+ * text, see bidir_text: one symbol per step rather than an      *
+ * extension by every symbol.                                    *
+ *****************************************************************/
+
+#define BIDIR_TEXT 16
+
+static int
+bidir_step( bidir_t *s, vtree_bi_interval_t *x, pos_t len, int step, int lo, int hi, int m, int count )
+{
+  vtree_bi_interval_t y[ ALPHABET_SIZE ];
+  pos_t suf[ BIDIR_TEXT ]; /* small, the calls are nested */
+  column_t *c;
+  int k, to_left, result = FALSE;
+
+  if ( x->j - x->i < BIDIR_TEXT ) {
+
+    vtree_get_suffixes( s->b->forward, x->i, x->j, suf );
+
+    for ( pos_t r=x->i; r<=x->j && ( ( ! result ) || ( s->found != NULL && ! all_found( s->found ) ) ); r++ ) {
+
+      pos_t p = suf[ r - x->i ];
+
+      if ( s->found != NULL && dev_bitset_get( s->found->seqs, vtree_seq_of( s->b->forward, p ) ) )
+	continue;
+
+      if ( bidir_text( s, p, len, step, lo, hi, m, count ) )
+	result = TRUE;
+    }
+
+    return result;
+  }
+
+  if ( step == s->num_columns ) {
+
+    for ( pos_t a=x->i; a<=x->j && s->found != NULL && ! all_found( s->found ); a+=BIDIR_TEXT ) {
+
+      pos_t b = MIN( x->j, a + BIDIR_TEXT - 1 );
+
+      vtree_get_suffixes( s->b->forward, a, b, suf );
+
+      for ( pos_t r=a; r<=b && ! all_found( s->found ); r++ )
+	( void ) bidir_text( s, suf[ r-a ], len, step, lo, hi, m, 0 );
+    }
+
+    return TRUE;
+  }
+
+  to_left = s->dir[ step ] < 0;
+  k = to_left ? lo-1 : hi;
+  c = &s->columns[ k ];
+
+  if ( c->type == range ) {
+
+    if ( count >= c->min ) {
+
+      result = bidir_step( s, x, len, step+1, to_left ? lo-1 : lo, to_left ? hi : hi+1, m, 0 );
+
+      if ( result && ( s->found == NULL || all_found( s->found ) ) )
+	return TRUE;
+    }
+
+    if ( count == c->max )
+      return result;
+  }
+
+  if ( to_left )
+    vtree_bidir_extend_left( s->b, x, y );
+  else
+    vtree_bidir_extend_right( s->b, x, y );
+
+  for ( symbol_t a=SYM_NUC_A; a <= SYM_NUC_N && ( ( ! result ) || ( s->found != NULL && ! all_found( s->found ) ) ); a++ ) {
+
+    int mm = m;
+
+    if ( y[ a ].i > y[ a ].j )
+      continue;
+
+    if ( c->type == range ) {
+
+      if ( bidir_step( s, &y[ a ], len+1, step, lo, hi, m, count+1 ) )
+	result = TRUE;
+
+      continue;
+    }
+
+    mm += bidir_mismatch( s, k, a, lo, hi );
+
+    if ( mm > s->params->max_mismatch )
+      continue;
+
+    s->read[ k ] = a;
+
+    if ( bidir_step( s, &y[ a ], len+1, step+1, to_left ? lo-1 : lo, to_left ? hi : hi+1, mm, 0 ) )
+      result = TRUE;
+  }
+
+  return result;
+}
+
+/*****************************************************************
+ * match_bidir - true if b contains a match of the motif, and    *
+ * with found != NULL, the sequences that contain one            *
+ *                                                               *
+ * Rather than reading the motif 5' to 3' like match_edge, the   *
+ * search starts at the loop of its most constrained hairpin and *
+ * extends the match on both sides, so that each column of a     *
+ * stem is checked against its partner as soon as it is read.    *
+ *****************************************************************/
+
+static int
+match_bidir( vtree_bidir_t *b, motif_t *m, found_t *found, param_t *params )
+{
+  vtree_bi_interval_t x;
+  bidir_t s;
+  int result;
+
+  assert( b->sigma == ALPHABET_SIZE );
+
+  s.columns = bidir_columns( m, &s.num_columns, params );
+
+  if ( s.columns == NULL ) {
+    dev_log( 4, "not a valid expression, contains a terminator" );
+    return FALSE;
+  }
+
+  s.b = b;
+  s.anchor = bidir_anchor( s.columns, s.num_columns );
+  s.dir = ( int * ) dev_malloc( MAX( s.num_columns, 1 ) * sizeof( int ) );
+  s.read = ( symbol_t * ) dev_malloc( MAX( s.num_columns, 1 ) * sizeof( symbol_t ) );
+  s.nt_match = ( int * ) dev_malloc( MAX( s.num_columns, 1 ) * sizeof( int ) );
+  s.found = found;
+  s.params = params;
+
+  bidir_schedule( &s );
+
+  vtree_bidir_root( b, &x );
+
+  result = bidir_step( &s, &x, 0, 0, s.anchor, s.anchor, 0, 0 );
+
+  dev_free( s.columns );
+  dev_free( s.dir );
+  dev_free( s.read );
+  dev_free( s.nt_match );
+
+  return result;
+}
+
+/*****************************************************************
+ * occurs_bidir - occurs, with a bidirectional index of one      *
+ * sequence                                                      *
+ *****************************************************************/
+
+int
+occurs_bidir( vtree_bidir_t *b, motif_t *m, param_t *params )
+{
+  int result = match_bidir( b, m, NULL, params );
+
+  params->match_count++;
+
   return result;
 }
 
+/*****************************************************************
+ * occurrences_bidir - occurrences, with the bidirectional index *
+ * of the sequences                                              *
+ *****************************************************************/
+
+int
+occurrences_bidir( vtree_bidir_t *b, motif_t *m, bitset_t *seqs, param_t *params )
+{
+  found_t found;
+
+  assert( dev_bitset_size( seqs ) == b->forward->num_seqs );
+
+  for ( int s=0; s < b->forward->num_seqs; s++ )
+    dev_bitset_clear( seqs, s );
+
+  found.seqs = seqs;
+  found.count = 0;
+
+  ( void ) match_bidir( b, m, &found, params );
+
+  params->match_count++;
+
+  return found.count;
+}
+
 /*****************************************************************
  * free_match -                                                  *
  *****************************************************************/
@@ -1373,7 +2239,7 @@ save_matches( vector_t *ms, vector_t *vs, param_t *params )
 	}
 #endif
 	fprintf( fh, "    <match id=\"%d\">\n", k );
-	fprintf( fh, "       <offset>%d</offset>\n", match->offset );
+	fprintf( fh, "       <offset>%ld</offset>\n", ( long ) match->offset );
 	fprintf( fh, "       <energy>%.1f</energy>\n", e );
 	fprintf( fh, "       <seq>%s</seq>\n", match->sequence );
 	fprintf( fh, "       <sec>%s</sec>\n", match->structure );
@@ -1504,7 +2370,7 @@ save_motif( motif_t *m, int i, char *dir )
 
   fh = dev_fopen( filename, "w" );
  
-  fprintf( fh, "<motif id=\"%d\" offset=\"%d\">\n", i, m->expression->start );
+  fprintf( fh, "<motif id=\"%d\" offset=\"%ld\">\n", i, ( long ) m->expression->start );
   fprintf( fh, "  <seq>%s</seq>\n", seq );
   fprintf( fh, "  <sec>%s</sec>\n", sec );
   fprintf( fh, "</motif>\n" );
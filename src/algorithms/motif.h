@@ -81,6 +81,12 @@ extern list_t *match( vtree_t *v, motif_t *m, int save_all, param_t *params );
 
 extern int occurs( vtree_t *v, motif_t *m, param_t *params );
 
+extern int occurrences( vtree_t *g, motif_t *m, bitset_t *seqs, param_t *params );
+
+extern int occurs_bidir( vtree_bidir_t *b, motif_t *m, param_t *params );
+
+extern int occurrences_bidir( vtree_bidir_t *b, motif_t *m, bitset_t *seqs, param_t *params );
+
 extern void free_match( match_t *m );
 
 extern int motif_num_base_pair( motif_t *m );
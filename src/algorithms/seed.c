@@ -12,6 +12,7 @@
 
 #include "libdev.h"
 #include "seq.h"
+#include "libvtree.h"
 #include "ida.h"
 #include "stems.h"
 #include "seed.h"
@@ -66,6 +67,10 @@ Options:\n\
      --save_motifs             (default false)\n\
   -m --match_file <file>       (no default)\n\
   -d --destination <dir>       (default .)\n\
+  -i --index <prefix>          (no default, files prefix.*)\n\
+     --num_threads <n>         (default 1, 0 for one per processor)\n\
+     --bidirectional           (default false)\n\
+     --node_table              (default false)\n\
   -p --print_level <n>         (default 1)\n\
   -q --quiet                   (default false)\n\
   -v --version\n\
@@ -104,11 +109,15 @@ param_init( param_t *params )
   params->min_base_pair = MIN_BASE_PAIR;
   params->min_support = MIN_SUPPORT;
   params->time_limit = TIME_LIMIT;
+  params->num_threads = NUM_THREADS;
+  params->bidirectional = BIDIRECTIONAL;
+  params->node_table = NODE_TABLE;
   params->save_all_matches = SAVE_ALL_MATCHES;
   params->save_as_ct = SAVE_AS_CT;
   params->save_motifs = SAVE_MOTIFS;
   params->match_file = MATCH_FILE;
   params->destination = DESTINATION;
+  params->index = INDEX;
   params->filename = FILENAME;
   params->print_level = PRINT_LEVEL;
 
@@ -197,6 +206,18 @@ process_argv( int argc, char *argv[], param_t *params )
 
       params->time_limit = dev_parse_int( argv[ ++i ] );
 
+    } else if ( strcmp( "--num_threads", argv[ i ] ) == 0 ) {
+
+      params->num_threads = dev_parse_int( argv[ ++i ] );
+
+    } else if ( strcmp( "--bidirectional", argv[ i ] ) == 0 ) {
+
+      params->bidirectional = TRUE;
+
+    } else if ( strcmp( "--node_table", argv[ i ] ) == 0 ) {
+
+      params->node_table = TRUE;
+
     } else if ( strcmp( "--save_all_matches", argv[ i ] ) == 0 ) {
 
       params->save_all_matches = TRUE;
@@ -222,6 +243,10 @@ process_argv( int argc, char *argv[], param_t *params )
       if ( ! dev_isdir( params->destination ) )
 	dev_die( "no such directory %s", params->destination );
 
+    } else if ( strcmp( "-i", argv[ i ] ) == 0 || strcmp( "--index", argv[ i ] ) == 0 ) {
+
+      params->index = argv[ ++i ];
+
     } else if ( strcmp( "-p", argv[ i ] ) == 0 || strcmp( "--print_level", argv[ i ] ) == 0 ) {
 
       params->print_level = dev_parse_int( argv[ ++i ] );
@@ -297,6 +322,9 @@ save_params( FILE *fh, const char *indent, param_t *params )
   if ( params->destination != DESTINATION )
     fprintf( fh, "%s  <param name=\"destination\">%s</param>\n", indent, params->destination );
 
+  if ( params->index != INDEX )
+    fprintf( fh, "%s  <param name=\"index\">%s</param>\n", indent, params->index );
+
   if ( params->filename != FILENAME )
     fprintf( fh, "%s  <param name=\"filename\">%s</param>\n", indent, params->filename );
 
@@ -332,6 +360,8 @@ main( int argc, char *argv[] )
 
   process_argv( argc, argv, &params );
 
+  vtree_set_num_threads( params.num_threads );
+
   /* reading data */
 
   num_seqs = bio_read_fasta( params.filename, &seqs, &descs, isnuc );
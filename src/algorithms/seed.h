@@ -39,11 +39,15 @@ typedef struct {
   int min_base_pair;
   float min_support;
   int time_limit;
+  int num_threads;
+  int bidirectional;
+  int node_table;
   int save_all_matches;
   int save_as_ct;
   int save_motifs;
   char *match_file;
   char *destination;
+  char *index;
   char *filename;
   int print_level;
   char *version;
@@ -72,11 +76,15 @@ typedef struct {
 #define MIN_BASE_PAIR 5
 #define MIN_SUPPORT 0.70
 #define TIME_LIMIT 0
+#define NUM_THREADS 1
+#define BIDIRECTIONAL FALSE
+#define NODE_TABLE FALSE
 #define SAVE_ALL_MATCHES FALSE
 #define SAVE_AS_CT FALSE
 #define SAVE_MOTIFS FALSE
 #define MATCH_FILE NULL
 #define DESTINATION NULL
+#define INDEX NULL
 #define FILENAME NULL
 #define PRINT_LEVEL 1
 #define QUIET FALSE
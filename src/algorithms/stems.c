@@ -43,47 +43,34 @@ make_dpalindrome( dstring_t *forward )
 }
 
 /*****************************************************************
- * get_all_stems - wrapper for vtree_lce allowing for GU pairs   *
+ * gu_pair - true if a and b form a GU pair                      *
+ *                                                               *
+ * GU pair implies G matches A in the reverse complement         *
+ * UG pair implies U matches C in the reverse complement         *
  *****************************************************************/
 
-pos_t
-get_lce( vtree_t *v, pos_t i, pos_t j, param_t *params )
+static int
+gu_pair( symbol_t a, symbol_t b, void *data )
 {
-  pos_t lce = 0, ii = i, jj = j, size = 0;
-  int done = FALSE, gu_allowed = ! params->nogu, num_gu = 0;
-
-  while ( ! done ) {
-
-    lce = vtree_lce( v, ii, jj );
-
-    symbol_t a = v->text[ ii + lce ];
-    symbol_t b = v->text[ jj + lce ];
-
-    /* GU pair implies G matches A in the reverse complement
-     * UG pair implies U matches C in the reverse complement
-     */
-
-    if ( ( gu_allowed ) && 
-	 ( num_gu < params->stem_max_gu ) &&
-	 ( ( a == SYM_NUC_G && b == SYM_NUC_A ) || ( a == SYM_NUC_U && b == SYM_NUC_C ) ) ) {
-
-      lce++;
-      num_gu++;
-      
-    } else {
+  ( void ) data; /* unused */
 
-      done = TRUE;
-
-    }
+  return ( a == SYM_NUC_G && b == SYM_NUC_A ) || ( a == SYM_NUC_U && b == SYM_NUC_C );
+}
 
-    ii += lce;
-    jj += lce;
+/*****************************************************************
+ * get_lce - wrapper for vtree_lce allowing for GU pairs         *
+ *****************************************************************/
 
-    size += lce;
+pos_t
+get_lce( vtree_t *v, pos_t i, pos_t j, param_t *params )
+{
+  lce_policy_t policy;
 
-  }
+  policy.compatible = gu_pair;
+  policy.max_compatible = params->nogu ? 0 : params->stem_max_gu;
+  policy.data = NULL;
 
-  return size;
+  return vtree_lce_k( v, i, j, 0, &policy );
 }
 
 /*****************************************************************
@@ -101,7 +88,7 @@ find_all_stems( dstring_t *forward, param_t *params )
 
   dstring_t *dstring = make_dpalindrome( forward );
 
-  vtree_t *v = vtree_create( dstring );
+  vtree_t *v = vtree_create_tables( dstring, VTREE_ISUFTAB | VTREE_LCPTAB | VTREE_RMQTAB );
 
   pos_t mindist = 2 * params->stem_min_len + params->loop_min_len - 1;
 
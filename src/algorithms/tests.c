@@ -0,0 +1,377 @@
+/*                               -*- Mode: C -*-
+ * tests.c --- tests driver
+ * Author          : Marcel Turcotte
+ * Created On      : Sat Oct 17 15:12:40 2026
+ * Last Modified By: Marcel Turcotte
+ * Last Modified On: Sat Oct 17 15:12:40 2026
+ *
+ * This copyrighted source code is freely distributed under the terms
+ * of the GNU General Public License.
+ * See the files COPYRIGHT and LICENSE for details.
+ */
+
+#include "libdev.h"
+#include "list.h"
+#include "seq.h"
+#include "libvtree.h"
+#include "motif.h"
+#include "seed.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*****************************************************************
+ * banner -                                                      *
+ *****************************************************************/
+
+static void
+banner( void )
+{
+  printf( "* algorithms - tests driver *\n" );
+}
+
+/*****************************************************************
+ * save_params - stands for the one of seed.c, which holds main; *
+ * the tests save no matches                                     *
+ *****************************************************************/
+
+void
+save_params( FILE *fh, const char *indent, param_t *params )
+{
+  ( void ) fh; /* unused */
+  ( void ) indent;
+  ( void ) params;
+
+  dev_die( "not available in the tests driver" );
+}
+
+/*****************************************************************
+ * same_matches - the two lists hold the same matches, in the    *
+ * same order                                                    *
+ *****************************************************************/
+
+static void
+same_matches( list_t *a, list_t *b )
+{
+  assert( dev_list_size( a ) == dev_list_size( b ) );
+
+  while ( dev_list_size( a ) > 0 ) {
+
+    match_t *x = ( match_t * ) dev_list_serve( a );
+    match_t *y = ( match_t * ) dev_list_serve( b );
+
+    assert( x->offset == y->offset );
+    assert( x->length == y->length );
+    assert( strcmp( x->sequence, y->sequence ) == 0 );
+    assert( strcmp( x->structure, y->structure ) == 0 );
+
+    free_match( x );
+    free_match( y );
+  }
+}
+
+/*****************************************************************
+ * random_texts - num random RNA sequences, the k-th one of      *
+ * length[ k ]                                                   *
+ *****************************************************************/
+
+static char **
+random_texts( int num, int length[] )
+{
+  char **texts = ( char ** ) dev_malloc( num * sizeof( char * ) );
+
+  for ( int k=0; k<num; k++ ) {
+
+    texts[ k ] = ( char * ) dev_malloc( length[ k ] + 1 );
+
+    for ( int i=0; i<length[ k ]; i++ )
+      texts[ k ][ i ] = "ACGU"[ rand() % 4 ];
+    texts[ k ][ length[ k ] ] = '\0';
+  }
+
+  return texts;
+}
+
+/*****************************************************************
+ * new_test_motifs - two hairpins of ds, one with a fixed base,  *
+ * and both of them; ds holds at least 45 symbols                *
+ *****************************************************************/
+
+static void
+new_test_motifs( dstring_t *ds, motif_t *motifs[ 3 ] )
+{
+  motifs[ 0 ] = new_stem_motif( 10, 22, 4, 0, ds );
+  motifs[ 1 ] = new_stem_motif( 30, 44, 5, 0, ds );
+  dev_bitset_set( motifs[ 1 ]->expression->mask, 0 );
+  motifs[ 1 ]->num_fixed_pos++;
+  motifs[ 2 ] = combine( motifs[ 0 ], motifs[ 1 ] );
+
+  assert( motifs[ 2 ] != NULL );
+}
+
+/*****************************************************************
+ * compare_num_threads - match_parallel must return the matches  *
+ * of the sequential search, in the same order                   *
+ *****************************************************************/
+
+static void
+compare_num_threads( void )
+{
+  int n = 40000;
+  int threads[] = { 2, 3, 8 };
+  char *text = ( char * ) dev_malloc( n+1 );
+  dstring_t *ds;
+  vtree_t *v;
+  motif_t *motifs[ 3 ];
+  param_t params;
+
+  dev_log( 0, "comparing serial and parallel matching" );
+
+  srand( 5 );
+
+  for ( int i=0; i<n; i++ )
+    text[ i ] = "ACGU"[ rand() % 4 ];
+  text[ n ] = '\0';
+
+  ds = dev_digitalize( &bio_nuc_alphabet, text );
+  v = vtree_create( ds );
+
+  memset( &params, 0, sizeof( param_t ) );
+  params.range = 1;
+  params.max_mismatch = 1;
+
+  new_test_motifs( ds, motifs );
+
+  for ( int k=0; k<3; k++ )
+    for ( int t=0; t < sizeof( threads ) / sizeof( int ); t++ ) {
+
+      int old = vtree_set_num_threads( 1 );
+      list_t *m1, *m2;
+
+      m1 = match( v, motifs[ k ], TRUE, &params );
+
+      vtree_set_num_threads( threads[ t ] );
+      m2 = match( v, motifs[ k ], TRUE, &params );
+      vtree_set_num_threads( old );
+
+      assert( dev_list_size( m1 ) > 0 );
+
+      same_matches( m1, m2 );
+
+      dev_free_list( m1, ( void ( * )( void * ) ) free_match );
+      dev_free_list( m2, ( void ( * )( void * ) ) free_match );
+    }
+
+  for ( int k=0; k<3; k++ )
+    free_motif( motifs[ k ] );
+
+  vtree_free( v );
+  dev_free_dstring( ds );
+  dev_free( text );
+
+  dev_log( 0, "done!" );
+}
+
+/*****************************************************************
+ * compare_occurrences - the sequences found by occurrences on   *
+ * the generalized vtree, and by occurrences_bidir on the        *
+ * bidirectional index, must be those in which occurs finds the  *
+ * motif, exactly or with mismatches; so must occurs_bidir on    *
+ * the index of each sequence                                    *
+ *****************************************************************/
+
+static void
+compare_occurrences( void )
+{
+  int length[] = { 300, 120, 800, 60, 2000, 500 };
+  int num = sizeof( length ) / sizeof( int );
+  int ranges[] = { 0, 1 }, mismatches[] = { 0, 1 };
+  char **texts;
+  dstring_t **ds = ( dstring_t ** ) dev_malloc( num * sizeof( dstring_t * ) );
+  vtree_t **vs = ( vtree_t ** ) dev_malloc( num * sizeof( vtree_t * ) );
+  vtree_bidir_t **bs = ( vtree_bidir_t ** ) dev_malloc( num * sizeof( vtree_bidir_t * ) );
+  bitset_t *seqs = dev_new_bitset( num ), *seqs2 = dev_new_bitset( num );
+  vtree_t *g;
+  vtree_bidir_t *b;
+  motif_t *motifs[ 3 ];
+  param_t params;
+
+  dev_log( 0, "comparing occurrences, occurrences_bidir and occurs" );
+
+  srand( 7 );
+
+  texts = random_texts( num, length );
+
+  for ( int k=0; k<num; k++ ) {
+    ds[ k ] = dev_digitalize( &bio_nuc_alphabet, texts[ k ] );
+    vs[ k ] = vtree_create( ds[ k ] );
+    bs[ k ] = vtree_create_bidir( &ds[ k ], 1 );
+  }
+
+  g = vtree_create_generalized( ds, num, VTREE_SUFTAB | VTREE_LCPTAB | VTREE_CHILDTAB );
+  b = vtree_create_bidir( ds, num );
+
+  new_test_motifs( ds[ 0 ], motifs );
+
+  memset( &params, 0, sizeof( param_t ) );
+
+  for ( int c=0; c < sizeof( ranges ) / sizeof( int ); c++ ) {
+
+    params.range = ranges[ c ];
+    params.max_mismatch = mismatches[ c ];
+
+    for ( int k=0; k<3; k++ ) {
+
+      int count = occurrences( g, motifs[ k ], seqs, &params );
+
+      assert( count == dev_bitset_cardinality( seqs ) );
+      assert( occurrences_bidir( b, motifs[ k ], seqs2, &params ) == count );
+      assert( dev_bitset_equals( seqs, seqs2 ) );
+
+      for ( int s=0; s<num; s++ ) {
+	int found = occurs( vs[ s ], motifs[ k ], &params );
+	assert( ! dev_bitset_get( seqs, s ) == ! found );
+	assert( ! occurs_bidir( bs[ s ], motifs[ k ], &params ) == ! found );
+      }
+    }
+  }
+
+  for ( int k=0; k<3; k++ )
+    free_motif( motifs[ k ] );
+
+  for ( int k=0; k<num; k++ ) {
+    vtree_free( vs[ k ] );
+    vtree_free_bidir( bs[ k ] );
+    dev_free_dstring( ds[ k ] );
+    dev_free( texts[ k ] );
+  }
+
+  vtree_free( g );
+  vtree_free_bidir( b );
+  dev_free_bitset( seqs );
+  dev_free_bitset( seqs2 );
+  dev_free( texts );
+  dev_free( vs );
+  dev_free( bs );
+  dev_free( ds );
+
+  dev_log( 0, "done!" );
+}
+
+/*****************************************************************
+ * compare_node_table - the matcher must find the same matches,  *
+ * in the same order, and the same sequences, when it follows    *
+ * the node table rather than the child table                    *
+ *****************************************************************/
+
+static void
+compare_node_table( void )
+{
+  int length[] = { 5000, 300, 1200, 80 };
+  int num = sizeof( length ) / sizeof( int );
+  int ranges[] = { 0, 1 }, mismatches[] = { 0, 1 };
+  int tables = VTREE_SUFTAB | VTREE_NODETAB;
+  char **texts;
+  dstring_t **ds = ( dstring_t ** ) dev_malloc( num * sizeof( dstring_t * ) );
+  vtree_t **vs = ( vtree_t ** ) dev_malloc( num * sizeof( vtree_t * ) );
+  vtree_t **ws = ( vtree_t ** ) dev_malloc( num * sizeof( vtree_t * ) );
+  bitset_t *seqs = dev_new_bitset( num );
+  vtree_t *g;
+  motif_t *motifs[ 3 ];
+  param_t params;
+
+  dev_log( 0, "comparing matching with and without the node table" );
+
+  srand( 11 );
+
+  texts = random_texts( num, length );
+
+  for ( int k=0; k<num; k++ ) {
+    ds[ k ] = dev_digitalize( &bio_nuc_alphabet, texts[ k ] );
+    vs[ k ] = vtree_create( ds[ k ] );
+    ws[ k ] = vtree_create_tables( ds[ k ], tables );
+  }
+
+  g = vtree_create_generalized( ds, num, tables );
+
+  new_test_motifs( ds[ 0 ], motifs );
+
+  memset( &params, 0, sizeof( param_t ) );
+
+  for ( int c=0; c < sizeof( ranges ) / sizeof( int ); c++ ) {
+
+    params.range = ranges[ c ];
+    params.max_mismatch = mismatches[ c ];
+
+    for ( int k=0; k<3; k++ ) {
+
+      int count = occurrences( g, motifs[ k ], seqs, &params );
+
+      assert( count == dev_bitset_cardinality( seqs ) );
+
+      for ( int s=0; s<num; s++ ) {
+
+	list_t *m1 = match( vs[ s ], motifs[ k ], TRUE, &params );
+	list_t *m2 = match( ws[ s ], motifs[ k ], TRUE, &params );
+
+	assert( ! dev_bitset_get( seqs, s ) == ( dev_list_size( m1 ) == 0 ) );
+	assert( ! occurs( ws[ s ], motifs[ k ], &params ) == ( dev_list_size( m1 ) == 0 ) );
+
+	same_matches( m1, m2 );
+
+	dev_free_list( m1, ( void ( * )( void * ) ) free_match );
+	dev_free_list( m2, ( void ( * )( void * ) ) free_match );
+      }
+    }
+  }
+
+  for ( int k=0; k<3; k++ )
+    free_motif( motifs[ k ] );
+
+  for ( int k=0; k<num; k++ ) {
+    vtree_free( vs[ k ] );
+    vtree_free( ws[ k ] );
+    dev_free_dstring( ds[ k ] );
+    dev_free( texts[ k ] );
+  }
+
+  vtree_free( g );
+  dev_free_bitset( seqs );
+  dev_free( texts );
+  dev_free( vs );
+  dev_free( ws );
+  dev_free( ds );
+
+  dev_log( 0, "done!" );
+}
+
+/*****************************************************************
+ * main -                                                        *
+ *****************************************************************/
+
+int
+main( void )
+{
+  dev_init();
+
+  banner();
+
+  printf( "\n" );
+
+  dev_set_debug_level( 2 );
+
+  compare_num_threads();
+
+  printf( "\n" );
+
+  compare_occurrences();
+
+  printf( "\n" );
+
+  compare_node_table();
+
+  printf( "\n" );
+
+  return EXIT_SUCCESS;
+}
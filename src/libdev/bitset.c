@@ -139,7 +139,7 @@ dev_bitset_set( bitset_t *b, int i )
   int u = i / BITS_PER_UNIT;
   unit_t mask = (unit_t) 1;
 
-  mask = mask << i;
+  mask = mask << ( i % BITS_PER_UNIT );
 
   b->units[ u ] = b->units[ u ] | mask; 
 }
@@ -156,7 +156,7 @@ dev_bitset_get( bitset_t *b, int i )
   int u = i / BITS_PER_UNIT;
   unit_t mask = (unit_t) 1;
 
-  mask = mask << i;
+  mask = mask << ( i % BITS_PER_UNIT );
 
   return b->units[ u ] & mask; 
 }
@@ -171,9 +171,9 @@ dev_bitset_clear( bitset_t *b, int i )
   int u = i / BITS_PER_UNIT;
   unit_t mask = (unit_t) 1;
 
-  mask = mask << i;
+  mask = mask << ( i % BITS_PER_UNIT );
 
-  b->units[ u ] = b->units[ u ] ^ mask; 
+  b->units[ u ] = b->units[ u ] & ~mask;
 
 }
 
@@ -403,7 +403,7 @@ dev_strcpy( const char *s )
  *****************************************************************/
 
 symbol_t *
-dev_symcpy( const symbol_t *s, int length )
+dev_symcpy( const symbol_t *s, pos_t length )
 {
   symbol_t *new;
 
@@ -412,7 +412,7 @@ dev_symcpy( const symbol_t *s, int length )
 
   new = dev_malloc( length * sizeof( symbol_t ) );
 
-  for ( int i=0; i<length; i++ )
+  for ( pos_t i=0; i<length; i++ )
     new[ i ] = s[ i ];
 
   return new;
@@ -513,7 +513,7 @@ dev_decode_dstring( dstring_t *ds )
 {
   char *s = dev_malloc( ds->length );
 
-  for ( int i=0; i< ( ds->length - 1 ); i++ )
+  for ( pos_t i=0; i< ( ds->length - 1 ); i++ )
     if ( dev_isspecial( ds->alphabet, ds->text[ i ] ) )
       s[ i ] = '$'; /* fix me */
     else
@@ -531,7 +531,7 @@ dev_decode_dstring( dstring_t *ds )
 dstring_t *
 dev_digitalize( alphabet_t *a, char *seq )
 {
-  int i, n = strlen( seq );
+  pos_t i, n = strlen( seq );
   dstring_t *dstring;
 
   dstring = ( dstring_t * ) dev_malloc( sizeof( dstring_t ) );
@@ -582,7 +582,7 @@ dev_to_string( alphabet_t *a, symbol_t *dtext )
  *****************************************************************/
 
 dstring_t *
-dev_new_dstring( alphabet_t *a, int n, symbol_t c )
+dev_new_dstring( alphabet_t *a, pos_t n, symbol_t c )
 {
   dstring_t *dstring;
 
@@ -594,7 +594,7 @@ dev_new_dstring( alphabet_t *a, int n, symbol_t c )
 
   dstring->alphabet = a;
 
-  for ( int i=0; i<(n-1); i++ )
+  for ( pos_t i=0; i<(n-1); i++ )
     dstring->text[ i ] = c;
 
   dstring->text[ n-1 ] = a->size; /* terminator */
@@ -609,7 +609,7 @@ dev_new_dstring( alphabet_t *a, int n, symbol_t c )
 dstring_t *
 dev_dstring_append( dstring_t *a, dstring_t *b )
 {
-  int m = a->length, n = b->length;
+  pos_t m = a->length, n = b->length;
   dstring_t *dstring;
   pos_t pos;
 
@@ -625,12 +625,12 @@ dev_dstring_append( dstring_t *a, dstring_t *b )
 
   pos = 0;
 
-  for ( int i=0; i<(m-1); i++ )
+  for ( pos_t i=0; i<(m-1); i++ )
     dstring->text[ pos++ ] = a->text[ i ];
 
   /* dstring->text[ pos++ ] = a->alphabet->size; */
   
-  for ( int i=0; i<(n-1); i++ )
+  for ( pos_t i=0; i<(n-1); i++ )
     dstring->text[ pos++ ] = b->text[ i ];
 
   dstring->text[ pos++ ] = a->alphabet->size;
@@ -56,10 +56,20 @@
  *                                                               *
  * Nota: for compatibility with the suffix array library (vtree) *
  * the definition of the symbols and indices must be the same.   *
+ *                                                               *
+ * With -DPOS64, the indices have 64 bits, for texts of 2^31     *
+ * symbols or more; the symbols remain int, the suffix array     *
+ * library widens the text where it needs indices.               *
  *****************************************************************/
 
 typedef int symbol_t;
+
+#ifdef POS64
+#include <stdint.h>
+typedef int64_t pos_t;
+#else
 typedef int pos_t;
+#endif
 
 /*****************************************************************
  * code_t - mapping characters to integer values                 *
@@ -89,7 +99,7 @@ typedef struct {
 
 typedef struct {
   symbol_t *text;
-  int length;
+  pos_t length;
   alphabet_t *alphabet;
 } dstring_t;
 
@@ -141,7 +151,7 @@ extern float dev_parse_float( const char *s );
 
 extern char *dev_strcpy( const char *s );
 
-extern symbol_t *dev_symcpy( const symbol_t *s, int length );
+extern symbol_t *dev_symcpy( const symbol_t *s, pos_t length );
 
 extern int dev_isnewline( char c );
 
@@ -157,7 +167,7 @@ extern char *dev_to_string( alphabet_t *a, symbol_t *dtext );
 
 extern dstring_t *dev_digitalize( alphabet_t *a, char *seq );
 
-extern dstring_t *dev_new_dstring( alphabet_t *a, int n, symbol_t c );
+extern dstring_t *dev_new_dstring( alphabet_t *a, pos_t n, symbol_t c );
 
 extern dstring_t *dev_dstring_append( dstring_t *a, dstring_t *b );
 
@@ -14,6 +14,7 @@
 #include "vector.h"
 #include "list.h"
 #include "bitset.h"
+#include "thread.h"
 
 /*****************************************************************
  * banner -                                                      *
@@ -154,6 +155,95 @@ bitset_test( void )
   printf( "done\n" );
 }
 
+/*****************************************************************
+ * thread_test -                                                 *
+ *****************************************************************/
+
+static void
+sum_block( int id, int n, void *arg )
+{
+  long *partial = ( long * ) arg;
+  pos_t lo, hi;
+
+  dev_block_range( id, n, 1000000, &lo, &hi );
+
+  partial[ id ] = 0;
+
+  for ( pos_t i=lo; i<hi; i++ )
+    partial[ id ] += i;
+}
+
+void
+thread_test( void )
+{
+  long partial[ 8 ];
+
+  printf( "testing thread ...\n" );
+
+  for ( int n=1; n<=8; n++ ) {
+
+    long sum = 0;
+
+    dev_parallel_run( n, sum_block, partial );
+
+    for ( int i=0; i<n; i++ )
+      sum += partial[ i ];
+
+    if ( sum != 1000000L * 999999L / 2 )
+      dev_die( "dev_parallel_run failed" );
+  }
+
+  printf( "done\n" );
+}
+
+/*****************************************************************
+ * steal_test - each job of height h > 1 spawns two jobs of      *
+ * height h-1, counted by the thread that runs it                *
+ *****************************************************************/
+
+static void
+count_job( dev_pool_t *pool, int id, void *job, void *arg )
+{
+  long *counts = ( long * ) arg;
+  long h = ( long ) job;
+
+  counts[ id ]++;
+
+  if ( h > 1 ) {
+    dev_pool_spawn( pool, id, ( void * ) ( h - 1 ) );
+    dev_pool_spawn( pool, id, ( void * ) ( h - 1 ) );
+  }
+}
+
+void
+steal_test( void )
+{
+  long counts[ 8 ];
+  void *jobs[ 3 ] = { ( void * ) 16L, ( void * ) 1L, ( void * ) 12L };
+
+  printf( "testing work stealing ...\n" );
+
+  for ( int n=1; n<=8; n++ ) {
+
+    long sum = 0;
+
+    for ( int i=0; i<n; i++ )
+      counts[ i ] = 0;
+
+    dev_steal_run( n, count_job, jobs, 3, counts );
+
+    for ( int i=0; i<n; i++ )
+      sum += counts[ i ];
+
+    if ( sum != ( 1L << 16 ) - 1 + 1 + ( 1L << 12 ) - 1 )
+      dev_die( "dev_steal_run failed" );
+  }
+
+  dev_steal_run( 4, count_job, jobs, 0, counts );
+
+  printf( "done\n" );
+}
+
 /*****************************************************************
  * main - main program                                           *
  *****************************************************************/
@@ -189,6 +279,10 @@ main( void )
 
   bitset_test();
 
+  thread_test();
+
+  steal_test();
+
   exit( EXIT_SUCCESS );
 }
 
@@ -0,0 +1,322 @@
+/*                               -*- Mode: C -*-
+ * thread.c --- minimal fork/join parallelism on top of POSIX threads
+ * Author          : Marcel Turcotte
+ * Created On      : Sat Oct 17 11:02:14 2026
+ * Last Modified By: Marcel Turcotte
+ * Last Modified On: Sat Oct 17 11:02:14 2026
+ *
+ * This copyrighted source code is freely distributed under the terms
+ * of the GNU General Public License.
+ * See the files COPYRIGHT and LICENSE for details.
+ */
+
+#include "libdev.h"
+#include "thread.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+/*****************************************************************
+ * task_t - arguments of one thread of a parallel region         *
+ *****************************************************************/
+
+typedef struct {
+  int id;
+  int n;
+  task_fn_t f;
+  void *arg;
+} task_t;
+
+/*****************************************************************
+ * run_task - pthread entry point                                *
+ *****************************************************************/
+
+static void *
+run_task( void *p )
+{
+  task_t *t = ( task_t * ) p;
+
+  t->f( t->id, t->n, t->arg );
+
+  return NULL;
+}
+
+/*****************************************************************
+ * dev_num_cpus - number of processors currently online          *
+ *****************************************************************/
+
+int
+dev_num_cpus( void )
+{
+  long n = sysconf( _SC_NPROCESSORS_ONLN );
+
+  return n < 1 ? 1 : ( int ) n;
+}
+
+/*****************************************************************
+ * dev_parallel_run - calls f( id, n, arg ) for id = 0..n-1, each *
+ * call in its own thread, and returns when all of them are done *
+ *                                                               *
+ * The calling thread executes id 0.  If a thread cannot be      *
+ * created, its share of the work is executed by the caller,     *
+ * therefore the region always completes.                        *
+ *****************************************************************/
+
+void
+dev_parallel_run( int n, task_fn_t f, void *arg )
+{
+  pthread_t *threads;
+  task_t *tasks;
+  int *started;
+
+  if ( n <= 1 ) {
+    f( 0, 1, arg );
+    return;
+  }
+
+  threads = ( pthread_t * ) dev_malloc( n * sizeof( pthread_t ) );
+  tasks = ( task_t * ) dev_malloc( n * sizeof( task_t ) );
+  started = ( int * ) dev_malloc( n * sizeof( int ) );
+
+  for ( int i=0; i<n; i++ ) {
+    tasks[ i ].id = i;
+    tasks[ i ].n = n;
+    tasks[ i ].f = f;
+    tasks[ i ].arg = arg;
+    started[ i ] = FALSE;
+  }
+
+  for ( int i=1; i<n; i++ )
+    started[ i ] = pthread_create( &threads[ i ], NULL, run_task, &tasks[ i ] ) == 0;
+
+  f( 0, n, arg );
+
+  for ( int i=1; i<n; i++ )
+    if ( started[ i ] )
+      pthread_join( threads[ i ], NULL );
+    else
+      f( i, n, arg );
+
+  dev_free( started );
+  dev_free( tasks );
+  dev_free( threads );
+}
+
+/*****************************************************************
+ * dev_block_range - splits 0..length-1 into n contiguous blocks *
+ * and returns the bounds [lo,hi) of the block id                *
+ *****************************************************************/
+
+void
+dev_block_range( int id, int n, pos_t length, pos_t *lo, pos_t *hi )
+{
+  long long q = length;
+
+  *lo = ( pos_t ) ( q * id / n );
+  *hi = ( pos_t ) ( q * ( id+1 ) / n );
+}
+
+/*****************************************************************
+ * Work-stealing pool                                            *
+ *                                                               *
+ * Each thread has a deque of jobs.  It runs the jobs it spawns  *
+ * last in first out, from the tail of its deque, and when the   *
+ * deque is empty it steals the oldest job of another thread,    *
+ * from the head, which in a recursive search is the largest     *
+ * one left.  pending counts the jobs spawned and not finished,  *
+ * the pool is done when it drops to 0; queued counts the jobs   *
+ * waiting in the deques, the idle threads sleep while it is 0.  *
+ *****************************************************************/
+
+typedef struct {
+  void **jobs;
+  int head;     /* first job */
+  int tail;     /* one past the last job */
+  int capacity;
+  pthread_mutex_t lock;
+} deque_t;
+
+struct dev_pool_s {
+  int n;
+  job_fn_t f;
+  void *arg;
+  deque_t *deques;
+  long pending;
+  long queued;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+};
+
+/*****************************************************************
+ * deque_push - adds job at the tail of d                        *
+ *****************************************************************/
+
+static void
+deque_push( deque_t *d, void *job )
+{
+  pthread_mutex_lock( &d->lock );
+
+  if ( d->tail == d->capacity ) {
+
+    int size = d->tail - d->head;
+
+    if ( d->head > 0 && size < d->capacity / 2 ) { /* reclaims the stolen slots */
+      memmove( d->jobs, d->jobs + d->head, size * sizeof( void * ) );
+    } else {
+      d->capacity = MAX( 2 * d->capacity, 16 );
+      d->jobs = ( void ** ) dev_realloc( d->jobs, d->capacity * sizeof( void * ) );
+      memmove( d->jobs, d->jobs + d->head, size * sizeof( void * ) );
+    }
+
+    d->head = 0;
+    d->tail = size;
+  }
+
+  d->jobs[ d->tail++ ] = job;
+
+  pthread_mutex_unlock( &d->lock );
+}
+
+/*****************************************************************
+ * deque_take - removes a job from the tail of d, or from its    *
+ * head if steal is true; NULL if d is empty                     *
+ *****************************************************************/
+
+static void *
+deque_take( deque_t *d, int steal )
+{
+  void *job = NULL;
+
+  pthread_mutex_lock( &d->lock );
+
+  if ( d->head < d->tail )
+    job = steal ? d->jobs[ d->head++ ] : d->jobs[ --d->tail ];
+
+  pthread_mutex_unlock( &d->lock );
+
+  return job;
+}
+
+/*****************************************************************
+ * dev_pool_spawn - adds a job to the pool, from the thread id   *
+ * of the job running                                            *
+ *****************************************************************/
+
+void
+dev_pool_spawn( dev_pool_t *pool, int id, void *job )
+{
+  pthread_mutex_lock( &pool->lock );
+  pool->pending++; /* before the job can be stolen and finished */
+  pthread_mutex_unlock( &pool->lock );
+
+  deque_push( pool->deques + id, job );
+
+  pthread_mutex_lock( &pool->lock );
+  pool->queued++;
+  pthread_cond_signal( &pool->cond );
+  pthread_mutex_unlock( &pool->lock );
+}
+
+/*****************************************************************
+ * next_job - a job of the deque of id, or stolen from another   *
+ * thread; waits while there is none; NULL when the pool is done *
+ *****************************************************************/
+
+static void *
+next_job( dev_pool_t *pool, int id )
+{
+  for ( ;; ) {
+
+    void *job = deque_take( pool->deques + id, FALSE );
+
+    for ( int k=1; job == NULL && k < pool->n; k++ )
+      job = deque_take( pool->deques + ( id + k ) % pool->n, TRUE );
+
+    pthread_mutex_lock( &pool->lock );
+
+    if ( job != NULL ) {
+      pool->queued--;
+      pthread_mutex_unlock( &pool->lock );
+      return job;
+    }
+
+    while ( pool->pending > 0 && pool->queued <= 0 )
+      pthread_cond_wait( &pool->cond, &pool->lock );
+
+    if ( pool->pending == 0 ) {
+      pthread_mutex_unlock( &pool->lock );
+      return NULL;
+    }
+
+    pthread_mutex_unlock( &pool->lock );
+  }
+}
+
+/*****************************************************************
+ * steal_worker - body of the threads of dev_steal_run           *
+ *****************************************************************/
+
+static void
+steal_worker( int id, int n, void *arg )
+{
+  dev_pool_t *pool = ( dev_pool_t * ) arg;
+  void *job;
+
+  ( void ) n; /* unused, the jobs are taken from the pool */
+
+  while ( ( job = next_job( pool, id ) ) != NULL ) {
+
+    pool->f( pool, id, job, pool->arg );
+
+    pthread_mutex_lock( &pool->lock );
+    if ( --pool->pending == 0 )
+      pthread_cond_broadcast( &pool->cond );
+    pthread_mutex_unlock( &pool->lock );
+  }
+}
+
+/*****************************************************************
+ * dev_steal_run - runs jobs on a work-stealing pool of n        *
+ * threads, and returns when all of them are done                *
+ * f : called as f( pool, id, job, arg ) for each job, by the    *
+ *     thread id, it may spawn more jobs with dev_pool_spawn     *
+ * jobs, num_jobs : the initial jobs, dealt to the threads       *
+ *****************************************************************/
+
+void
+dev_steal_run( int n, job_fn_t f, void *jobs[], int num_jobs, void *arg )
+{
+  dev_pool_t pool;
+
+  pool.n = MAX( n, 1 );
+  pool.f = f;
+  pool.arg = arg;
+  pool.pending = pool.queued = num_jobs;
+  pool.deques = ( deque_t * ) dev_malloc( pool.n * sizeof( deque_t ) );
+
+  pthread_mutex_init( &pool.lock, NULL );
+  pthread_cond_init( &pool.cond, NULL );
+
+  for ( int i=0; i<pool.n; i++ ) {
+    pool.deques[ i ].jobs = NULL;
+    pool.deques[ i ].head = pool.deques[ i ].tail = pool.deques[ i ].capacity = 0;
+    pthread_mutex_init( &pool.deques[ i ].lock, NULL );
+  }
+
+  for ( int k=0; k<num_jobs; k++ )
+    deque_push( pool.deques + k % pool.n, jobs[ k ] );
+
+  if ( num_jobs > 0 )
+    dev_parallel_run( pool.n, steal_worker, &pool );
+
+  for ( int i=0; i<pool.n; i++ ) {
+    pthread_mutex_destroy( &pool.deques[ i ].lock );
+    dev_free( pool.deques[ i ].jobs );
+  }
+
+  pthread_mutex_destroy( &pool.lock );
+  pthread_cond_destroy( &pool.cond );
+
+  dev_free( pool.deques );
+}
@@ -0,0 +1,45 @@
+/*                               -*- Mode: C -*-
+ * thread.h --- minimal fork/join parallelism on top of POSIX threads
+ * Author          : Marcel Turcotte
+ * Created On      : Sat Oct 17 11:02:14 2026
+ * Last Modified By: Marcel Turcotte
+ * Last Modified On: Sat Oct 17 11:02:14 2026
+ *
+ * This copyrighted source code is freely distributed under the terms
+ * of the GNU General Public License.
+ * See the files COPYRIGHT and LICENSE for details.
+ */
+
+#ifndef THREAD_H
+#define THREAD_H
+
+/*****************************************************************
+ * task_fn_t - body of a parallel region, invoked once for each  *
+ * thread id in 0..n-1                                           *
+ *****************************************************************/
+
+typedef void ( *task_fn_t )( int id, int n, void *arg );
+
+/*****************************************************************
+ * dev_pool_t - work-stealing pool, see dev_steal_run            *
+ *****************************************************************/
+
+typedef struct dev_pool_s dev_pool_t;
+
+typedef void ( *job_fn_t )( dev_pool_t *pool, int id, void *job, void *arg );
+
+/*****************************************************************
+ * interface                                                     *
+ *****************************************************************/
+
+extern int dev_num_cpus( void );
+
+extern void dev_parallel_run( int n, task_fn_t f, void *arg );
+
+extern void dev_block_range( int id, int n, pos_t length, pos_t *lo, pos_t *hi );
+
+extern void dev_steal_run( int n, job_fn_t f, void *jobs[], int num_jobs, void *arg );
+
+extern void dev_pool_spawn( dev_pool_t *pool, int id, void *job );
+
+#endif
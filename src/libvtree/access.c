@@ -12,8 +12,11 @@
 
 #include "libdev.h"
 #include "vector.h"
+#include "thread.h"
 #include "libvtree.h"
 
+#include <string.h>
+
 /*****************************************************************
  * new_interval3 - allocates and initialises an interval3 struct *
  *****************************************************************/
@@ -30,6 +33,116 @@ new_interval3( pos_t lcp, pos_t lb, pos_t rb )
   return i;
 }
 
+/*****************************************************************
+ * new_interval4 - allocates and initialises an interval4 struct *
+ *****************************************************************/
+
+static inline interval4_t *
+new_interval4( pos_t lcp, pos_t lb, pos_t rb )
+{
+  interval4_t *i = ( interval4_t * ) dev_malloc( sizeof( interval4_t ) );
+
+  i->lcp = lcp;
+  i->lb = lb;
+  i->rb = rb;
+
+  i->childList = dev_new_vector();
+
+  return i;
+}
+
+/*****************************************************************
+ * new_interval2 - allocates and initialises an interval2 struct *
+ *****************************************************************/
+
+interval2_t *
+new_interval2( pos_t i, pos_t j )
+{
+  interval2_t *interval = ( interval2_t * ) dev_malloc( sizeof( interval2_t ) );
+
+  interval->i = i;
+  interval->j = j;
+  interval->node = -1;
+
+  return interval;
+}
+
+/*****************************************************************
+ * trivial_cmp -                                                 *
+ *****************************************************************/
+
+static inline int
+trivial_cmp( symbol_t a, symbol_t b )
+{
+  return a == b;
+}
+
+/*****************************************************************
+ * vtree_lcp_exception - returns an lcp-value that does not fit  *
+ * into lcptab (binary search of the exception table)            *
+ * v : enhanced suffix array                                     *
+ * i : index into the lcptab                                     *
+ *****************************************************************/
+
+pos_t
+vtree_lcp_exception( vtree_t *v, pos_t i )
+{
+  pos_t lo = 0, hi = v->lcpexc_size - 1;
+
+  while ( lo <= hi ) {
+
+    pos_t mid = lo + ( hi - lo )/2;
+
+    if ( v->lcpexc[ mid ].i < i )
+      lo = mid + 1;
+    else if ( v->lcpexc[ mid ].i > i )
+      hi = mid - 1;
+    else
+      return v->lcpexc[ mid ].lcp;
+  }
+
+  dev_die( "vtree_lcp_exception: no exception for index %ld", ( long ) i );
+
+  return -1;
+}
+
+/*****************************************************************
+ * Specializations for each width of the index tables            *
+ *****************************************************************/
+
+#define INDEX_T uint16_t
+#define DECODE( x ) vtree_decode16( x )
+#define SPECIALIZE( name ) name##_16
+#include "access_impl.h"
+#undef INDEX_T
+#undef DECODE
+#undef SPECIALIZE
+
+#define INDEX_T int32_t
+#define DECODE( x ) ( ( pos_t ) ( x ) )
+#define SPECIALIZE( name ) name##_32
+#include "access_impl.h"
+#undef INDEX_T
+#undef DECODE
+#undef SPECIALIZE
+
+#define INDEX_T int64_t
+#define DECODE( x ) ( ( pos_t ) ( x ) )
+#define SPECIALIZE( name ) name##_64
+#include "access_impl.h"
+#undef INDEX_T
+#undef DECODE
+#undef SPECIALIZE
+
+/*****************************************************************
+ * dispatch - calls the specialization of name for the width of  *
+ * the tables of v                                               *
+ *****************************************************************/
+
+#define dispatch( v, name, args )					\
+  ( ( v )->width == VTREE_WIDTH_16 ? name##_16 args :			\
+    ( v )->width == VTREE_WIDTH_32 ? name##_32 args : name##_64 args )
+
 /*****************************************************************
  * vtree_traverse_with_array - bottom-up traversal of the vtree  *
  * v : enhanced suffix array                                     *
@@ -53,72 +166,28 @@ new_interval3( pos_t lcp, pos_t lb, pos_t rb )
  * }                                                             *
  *****************************************************************/
 
-#define push( elem ) dev_vector_add( stack, elem )
-#define pop() dev_vector_remove( stack )
-#define peek() dev_vector_get_last( stack )
-
-void
-vtree_traverse_with_array( vtree_t *v, void ( *f )( vtree_t *, interval3_t * ) )
+static void
+visit_with_array( vtree_t *v, vtree_node_t *node, vtree_node_t *parent, void *arg )
 {
-  vector_t *stack = ( vector_t * ) dev_new_vector( 5, 5 );
-  interval3_t *top, *interval = NULL;
-
-  top = new_interval3( 0, 0, -1 );
-  push( top );
-
-  for ( pos_t i=1; i<= v->length; i++ ) {
-
-    pos_t lb = i-1;
-
-    while ( v->lcptab[ i ] < top->lcp ) {
+  void ( *f )( vtree_t *, interval3_t * ) = *( void ( ** )( vtree_t *, interval3_t * ) ) arg;
+  interval3_t interval;
 
-      top->rb = i-1;
+  if ( parent == NULL ) /* the root is not processed */
+    return;
 
-      if ( interval != NULL )
-	dev_free( interval );
+  interval.lcp = node->lcp;
+  interval.lb = node->lb;
+  interval.rb = node->rb;
 
-      interval = pop();
-
-      f( v, interval );
-
-      top = peek();
-
-      lb = top->lb;
-    }
-
-    if ( v->lcptab[ i ] > top->lcp ) {
-      top = new_interval3( v->lcptab[ i ], lb, -1 );
-      push( top );
-    }
-
-  }
-
-  top = pop();
-  dev_free( top );
-
-  dev_free_vector( stack, free );
+  f( v, &interval );
 }
 
-#undef push
-#undef pop
-#undef peek
-
-/*****************************************************************
- * new_interval4 - allocates and initialises an interval4 struct *
- *****************************************************************/
-
-static inline interval4_t *
-new_interval4( pos_t lcp, pos_t lb, pos_t rb )
+void
+vtree_traverse_with_array( vtree_t *v, void ( *f )( vtree_t *, interval3_t * ) )
 {
-  interval4_t *i = ( interval4_t * ) dev_malloc( sizeof( interval4_t ) );
+  vtree_bottom_up_t t = { visit_with_array, NULL, 0 };
 
-  i->lcp = lcp;
-  i->lb = lb;
-  i->rb = rb;
-
-  i->childList = dev_new_vector();
-
-  return i;
+  vtree_bottom_up( v, &t, &f );
 }
 
 /*****************************************************************
@@ -143,83 +212,238 @@ new_interval4( pos_t lcp, pos_t lb, pos_t rb )
  *  }								 *
  *****************************************************************/
 
-#define push( elem ) dev_vector_add( stack, elem )
-#define pop() dev_vector_remove( stack )
-#define peek() dev_vector_get_last( stack )
-#define add( list, elem ) dev_vector_add( list, elem )
-
 void
 vtree_traverse_and_process( vtree_t *v, void ( *f )( vtree_t *, interval4_t * ) )
 {
-  vector_t *stack = ( vector_t * ) dev_new_vector( 5, 5 );
-  interval4_t *top, *lastInterval = NULL;
+  vtree_require( v, VTREE_LCPTAB );
+
+  dispatch( v, traverse_and_process, ( v, f ) );
+}
+
+/*****************************************************************
+ * node_stack_t - stack of the open lcp-intervals of a bottom-up *
+ * traversal, with data_size bytes for each one; it only grows,  *
+ * so a traversal allocates O( log n ) times                     *
+ *****************************************************************/
+
+typedef struct {
+  vtree_node_t *nodes;
+  char *data;
+  size_t data_size;
+  pos_t size;
+  pos_t capacity;
+} node_stack_t;
+
+static void
+node_stack_push( node_stack_t *s, pos_t lcp, pos_t lb )
+{
+  vtree_node_t *node;
 
-  top = new_interval4( 0, 0, -1 );
-  push( top );
+  if ( s->size == s->capacity ) {
+    s->capacity = MAX( 2 * s->capacity, 64 );
+    s->nodes = ( vtree_node_t * ) dev_realloc( s->nodes, s->capacity * sizeof( vtree_node_t ) );
+    s->data = ( char * ) dev_realloc( s->data, s->capacity * MAX( s->data_size, 1 ) );
+  }
+
+  node = s->nodes + s->size++;
+
+  node->lcp = lcp;
+  node->lb = lb;
+  node->rb = -1;
+
+  if ( s->data_size > 0 )
+    memset( s->data + ( s->size - 1 ) * s->data_size, 0, s->data_size );
+}
+
+/*****************************************************************
+ * node_stack_top - the interval on top of the stack, its data   *
+ * pointer is valid until the next push                          *
+ *****************************************************************/
+
+static inline vtree_node_t *
+node_stack_top( node_stack_t *s )
+{
+  vtree_node_t *node = s->nodes + s->size - 1;
 
-  for ( pos_t i=1; i <= v->length; i++ ) {
+  node->data = s->data_size > 0 ? s->data + ( s->size - 1 ) * s->data_size : NULL;
 
-    pos_t lb = i-1;
+  return node;
+}
 
-    while ( v->lcptab[ i ] < top->lcp ) {
+/*****************************************************************
+ * bottom_up_range - bottom-up traversal of the ranks a..b       *
+ *                                                               *
+ * a..b is the root, or a union of children of the root, hence   *
+ * lcp( a ) and lcp( b+1 ) are 0.  When an interval is closed    *
+ * its parent is either the interval below it on the stack, or   *
+ * an interval that starts at its left bound and is opened right *
+ * away, before the visit.  The closed interval is copied aside  *
+ * since the parent may take its place on the stack.             *
+ *****************************************************************/
 
-      top->rb = i-1;
+static void
+bottom_up_range( vtree_t *v, vtree_bottom_up_t *t, pos_t a, pos_t b, void *arg )
+{
+  node_stack_t s;
+  vtree_node_t child, *top;
+  char *scratch = t->data_size > 0 ? ( char * ) dev_malloc( t->data_size ) : NULL;
 
-      if ( lastInterval != NULL )
-	dev_free( lastInterval );
+  s.nodes = NULL;
+  s.data = NULL;
+  s.data_size = t->data_size;
+  s.size = s.capacity = 0;
 
-      lastInterval = pop();
-      top = peek();
+  node_stack_push( &s, 0, a );
+  top = node_stack_top( &s );
 
-      f( v, lastInterval );
+  for ( pos_t i=a+1; i<=b+1; i++ ) {
 
-      lb = lastInterval->lb;
+    pos_t l = i <= b ? vtree_get_lcptab( v, i ) : 0, lb = i-1;
 
-      if ( v->lcptab[ i ] <= top->lcp ) {
-	add( top->childList, lastInterval );
-	lastInterval = NULL;
-      }
+    if ( t->leaf != NULL && l <= top->lcp && i-1 < v->length )
+      t->leaf( v, i-1, top, arg );
 
-    }
+    while ( l < top->lcp ) {
+
+      child = *top;
+      child.rb = i-1;
 
-    if ( v->lcptab[ i ] > top->lcp ) {
+      if ( scratch != NULL ) {
+	memcpy( scratch, child.data, t->data_size );
+	child.data = scratch;
+      }
 
-      top = new_interval4( v->lcptab[ i ], lb, -1 );
+      s.size--;
+      top = node_stack_top( &s );
+      lb = child.lb;
 
-      if ( lastInterval != NULL ) {
-	add( top->childList, lastInterval );
-	lastInterval = NULL;
+      if ( l > top->lcp ) {
+	node_stack_push( &s, l, lb );
+	top = node_stack_top( &s );
       }
 
-      push( top );
+      t->visit( v, &child, top, arg );
+    }
+
+    if ( l > top->lcp ) {
 
+      node_stack_push( &s, l, lb );
+      top = node_stack_top( &s );
+
+      if ( t->leaf != NULL && i-1 < v->length )
+	t->leaf( v, i-1, top, arg );
     }
   }
 
-  top = pop();
-  dev_free( top );
+  top->rb = b;
+  t->visit( v, top, NULL, arg );
 
-  dev_free_vector( stack, free );
+  dev_free( s.nodes );
+  dev_free( s.data );
+  dev_free( scratch );
 }
 
-#undef push
-#undef pop
-#undef peek
-#undef add
+/*****************************************************************
+ * vtree_bottom_up - bottom-up traversal of the lcp-intervals    *
+ * v : enhanced suffix array                                     *
+ * t : callbacks                                                 *
+ * arg : passed to the callbacks                                 *
+ *                                                               *
+ * t->visit is called for each lcp-interval after its children,  *
+ * with its parent, which is still open: its right bound is not  *
+ * known yet.  The root [0..n] comes last, its parent is NULL.   *
+ * If t->leaf is not NULL, it is called for each rank i < n with *
+ * the smallest interval that contains i, before that interval   *
+ * is visited.  Each interval carries t->data_size bytes, zeroed *
+ * when it is opened, through which the children and the leaves  *
+ * pass their results to their parent.                           *
+ *                                                               *
+ * The open intervals are kept in a stack that is allocated once *
+ * and grows by doubling, nothing is allocated per interval.     *
+ *****************************************************************/
+
+void
+vtree_bottom_up( vtree_t *v, vtree_bottom_up_t *t, void *arg )
+{
+  vtree_require( v, VTREE_LCPTAB );
+
+  bottom_up_range( v, t, 0, v->length, arg );
+}
 
 /*****************************************************************
- * new_interval2 - allocates and initialises an interval2 struct *
+ * bottom_up_arg_t - the ranges of vtree_bottom_up_parallel      *
  *****************************************************************/
 
-interval2_t *
-new_interval2( pos_t i, pos_t j )
+typedef struct {
+  vtree_t *v;
+  vtree_bottom_up_t *t;
+  pos_t *cuts; /* range k is cuts[ k ]..cuts[ k+1 ]-1 */
+  void **args;
+} bottom_up_arg_t;
+
+static void
+bottom_up_block( int id, int nt, void *arg )
 {
-  interval2_t *interval = ( interval2_t * ) dev_malloc( sizeof( interval2_t ) );
+  bottom_up_arg_t *a = ( bottom_up_arg_t * ) arg;
 
-  interval->i = i;
-  interval->j = j;
+  ( void ) nt; /* unused, the ranges are cut beforehand */
 
-  return interval;
+  bottom_up_range( a->v, a->t, a->cuts[ id ], a->cuts[ id+1 ] - 1, a->args[ id ] );
+}
+
+/*****************************************************************
+ * vtree_bottom_up_parallel - bottom-up traversal of independent *
+ * ranges of the suffix array on several threads                 *
+ * v : enhanced suffix array                                     *
+ * t : callbacks, see vtree_bottom_up                            *
+ * args : args[ k ] is passed to the callbacks of range k        *
+ * n : maximum number of ranges, one thread each                 *
+ * return : the number of ranges                                 *
+ *                                                               *
+ * The ranges are cut where the lcp-value is 0, each one is a    *
+ * union of children of the root.  Every interval but the root   *
+ * is visited as with vtree_bottom_up, by the thread of its      *
+ * range; the root is replaced by one partial root per range,    *
+ * [lb..rb] with an lcp-value of 0 and no parent.  The callbacks  *
+ * of different ranges run concurrently, hence each range should *
+ * have its own args[ k ], which the caller combines afterwards. *
+ * There are fewer ranges than n if the root has few children.   *
+ *****************************************************************/
+
+int
+vtree_bottom_up_parallel( vtree_t *v, vtree_bottom_up_t *t, void *args[], int n )
+{
+  bottom_up_arg_t a;
+  int num_ranges = 1;
+
+  vtree_require( v, VTREE_LCPTAB );
+
+  a.v = v;
+  a.t = t;
+  a.args = args;
+  a.cuts = ( pos_t * ) dev_malloc( ( MAX( n, 1 ) + 1 ) * sizeof( pos_t ) );
+  a.cuts[ 0 ] = 0;
+
+  for ( int k=1; k<n; k++ ) {
+
+    pos_t r = MAX( ( pos_t ) ( ( long ) k * ( v->length + 1 ) / n ), a.cuts[ num_ranges-1 ] + 1 );
+
+    while ( r < v->length && vtree_get_lcptab( v, r ) != 0 )
+      r++;
+
+    if ( r >= v->length )
+      break;
+
+    a.cuts[ num_ranges++ ] = r;
+  }
+
+  a.cuts[ num_ranges ] = v->length + 1;
+
+  dev_parallel_run( num_ranges, bottom_up_block, &a );
+
+  dev_free( a.cuts );
+
+  return num_ranges;
 }
 
 /*****************************************************************
@@ -246,74 +470,177 @@ new_interval2( pos_t i, pos_t j )
 vector_t *
 vtree_getChildIntervals( vtree_t *v, interval2_t *i0 )
 {
-  /* tuned for nucleotides alphabet */
-  vector_t *intervalList = dev_new_vector( 5, 5 );
-  pos_t i1, i2, val;
+  vtree_require( v, VTREE_CHILDTAB );
 
-  assert( i0->i != i0->j );
+  return dispatch( v, getChildIntervals, ( v, i0 ) );
+}
 
-  /* special case for 0-[0..n] -- root of the tree */
+/*****************************************************************
+ * vtree_child_first - starts an iteration over the child        *
+ * intervals of the lcp-interval i..j                            *
+ * v : enhanced suffix array                                     *
+ * it : the iterator, usually a local variable                   *
+ * return : FALSE if i..j has no child (singleton), otherwise    *
+ *          the first child is it->i..it->j                      *
+ *                                                               *
+ * vtree_child_next moves to the next child and returns FALSE    *
+ * after the last one.  The children are those of                *
+ * vtree_getChildIntervals, in the same order, but nothing is    *
+ * allocated:                                                    *
+ *                                                               *
+ *   for ( int more = vtree_child_first( v, i, j, &it ); more;   *
+ *         more = vtree_child_next( &it ) )                      *
+ *     ... it.i, it.j ...                                        *
+ *                                                               *
+ * it.label is suftab[ it.i ], decoded with the rest of the      *
+ * iteration, or -1 if suftab was released.                      *
+ *****************************************************************/
 
-  if ( i0->j == v->length ) {
+int
+vtree_child_first( vtree_t *v, pos_t i, pos_t j, vtree_child_iter_t *it )
+{
+  vtree_require( v, VTREE_CHILDTAB );
 
-    i1 = vtree_get_childtab_next( v, i0->i );
-    dev_vector_add( intervalList, new_interval2( i0->i, i1 - 1 ) );
+  it->node = -1;
 
-    while ( vtree_get_childtab_next( v, i1 ) != -1 ) {
-      i2 = vtree_get_childtab_next( v, i1 );
-      dev_vector_add( intervalList, new_interval2( i1, i2 - 1 ) );
-      i1 = i2;
-    }
+  return dispatch( v, child_first, ( v, i, j, it ) );
+}
 
-    return intervalList;
-  }
+/*****************************************************************
+ * node_child - moves it to the child c, and prefetches the node *
+ * of its next sibling, which is usually far away                *
+ *****************************************************************/
 
-  /* general case -- internal node */
+static inline int
+node_child( vtree_child_iter_t *it, pos_t c )
+{
+  dfs_node_t *node = vtree_get_node( it->v, c );
 
-  val = vtree_get_childtab_up( v, i0->j+1 );
+  it->node = c;
+  it->i = node->lb;
+  it->j = node->rb;
+  it->label = node->label;
 
-  if ( i0->i < val && val <= i0->j )
-    i1 = val;
-  else
-    i1 = vtree_get_childtab_down( v, i0->i );
+#ifdef __GNUC__
+  if ( node->next < it->end )
+    __builtin_prefetch( vtree_get_node( it->v, node->next ) );
+#endif
 
-  dev_vector_add( intervalList, new_interval2( i0->i, i1 - 1 ) );
+  return TRUE;
+}
+
+int
+vtree_child_next( vtree_child_iter_t *it )
+{
+  vtree_t *v = it->v;
 
-  while ( vtree_get_childtab_next( v, i1 ) != -1 ) {
-    i2 = vtree_get_childtab_next( v, i1 );
-    dev_vector_add( intervalList, new_interval2( i1, i2 - 1 ) );
-    i1 = i2;
+  if ( it->node >= 0 ) {
+
+    pos_t c = vtree_get_node( v, it->node )->next;
+
+    return c < it->end ? node_child( it, c ) : FALSE;
   }
 
-  dev_vector_add( intervalList, new_interval2( i1, i0->j ) );
+  return dispatch( v, child_next, ( it ) );
+}
+
+/*****************************************************************
+ * vtree_node_first - starts an iteration over the children of   *
+ * the node k of nodetab                                         *
+ * v : enhanced suffix array                                     *
+ * k : a node, 0 for the root                                    *
+ * it : the iterator                                             *
+ *                                                               *
+ * Like vtree_child_first, but the children are read from the    *
+ * node table, it->node is the current one; vtree_child_next     *
+ * moves to the next one.  The children are the same, in the     *
+ * same order.                                                   *
+ *****************************************************************/
+
+int
+vtree_node_first( vtree_t *v, pos_t k, vtree_child_iter_t *it )
+{
+  dfs_node_t *node;
+
+  vtree_require( v, VTREE_NODETAB );
+
+  node = vtree_get_node( v, k );
+
+  if ( node->lb == node->rb )
+    return FALSE;
 
-  return intervalList;
+  it->v = v;
+  it->rb = node->rb;
+  it->root = k == 0;
+  it->end = node->next;
+
+  return node_child( it, k+1 );
 }
 
 /*****************************************************************
- * vtree_getlcp - returns the lcp-value of an interval           *
+ * vtree_kmer_interval - lcp-interval of the first symbols of a  *
+ * pattern, read from the prefix table                           *
  * v : enhanced suffix array                                     *
+ * p, m : pattern and its length                                 *
+ * i, j : set to the interval of the suffixes that start with    *
+ *        the first k symbols of p                               *
+ *                                                               *
+ * Returns k if these symbols occur, -1 if they do not, hence    *
+ * the pattern does not occur either, and 0 if the table cannot  *
+ * answer: there is no table, p is shorter than k, or one of the *
+ * symbols is a terminator.  The search of the pattern then      *
+ * continues from [i..j] at depth k, instead of descending from  *
+ * the root one symbol at a time.                                *
+ *                                                               *
+ * The table is built on first use if vtree_set_kmer_length was  *
+ * called with k > 0.                                            *
  *****************************************************************/
 
 pos_t
-vtree_getlcp( vtree_t *v, pos_t i, pos_t j )
+vtree_kmer_interval( vtree_t *v, symbol_t *p, pos_t m, pos_t *i, pos_t *j )
 {
-  pos_t val = vtree_get_childtab_up( v, j+1 );
+  kmer_table_t *t;
+  long c = 0;
+
+  if ( vtree_get_kmer_length() > 0 )
+    vtree_require( v, VTREE_KMERTAB );
+
+  t = v->kmertab;
+
+  if ( t == NULL || m < t->k )
+    return 0;
+
+  for ( int d=0; d<t->k; d++ ) {
 
-  if ( i < val && val <= j )
-    return v->lcptab[ val ];
+    if ( p[ d ] < 0 || p[ d ] >= t->code_size )
+      return 0;
 
-  return v->lcptab[ vtree_get_childtab_down( v, i ) ];
+    if ( t->code[ p[ d ] ] < 0 )
+      return -1; /* a symbol that does not occur in the text */
+
+    c = c * t->sigma + t->code[ p[ d ] ];
+  }
+
+  if ( t->bounds[ 2*c ] < 0 )
+    return -1;
+
+  *i = t->bounds[ 2*c ];
+  *j = t->bounds[ 2*c+1 ];
+
+  return t->k;
 }
 
 /*****************************************************************
- * trivial_cmp -                                                 *
+ * vtree_getlcp - returns the lcp-value of an interval           *
+ * v : enhanced suffix array                                     *
  *****************************************************************/
 
-static inline int
-trivial_cmp( symbol_t a, symbol_t b )
+pos_t
+vtree_getlcp( vtree_t *v, pos_t i, pos_t j )
 {
-  return a == b;
+  vtree_require( v, VTREE_CHILDTAB );
+
+  return dispatch( v, getlcp, ( v, i, j ) );
 }
 
 /*****************************************************************
@@ -326,60 +653,57 @@ trivial_cmp( symbol_t a, symbol_t b )
 interval2_t *
 vtree_getInterval( vtree_t *v, pos_t i, pos_t j, symbol_t a, int ( *cmp )( symbol_t, symbol_t ) )
 {
-  pos_t i1, i2, val, l;
+  vtree_require( v, VTREE_SUFTAB | VTREE_CHILDTAB );
 
-  assert( i != j );
-
-  if ( cmp == NULL )
-    cmp = trivial_cmp;
+  return dispatch( v, getInterval, ( v, i, j, a, cmp ) );
+}
 
-  /* special case for 0-[0..n] -- root of the tree */
+/*****************************************************************
+ * vtree_getChildInterval - vtree_getInterval for the            *
+ * children of an interval, read from the node table if          *
+ * interval->node is known, the result then has its node too     *
+ *****************************************************************/
 
-  if ( j == v->length ) {
+interval2_t *
+vtree_getChildInterval( vtree_t *v, interval2_t *interval, symbol_t a, int ( *cmp )( symbol_t, symbol_t ) )
+{
+  vtree_child_iter_t it;
+  pos_t l;
 
-    i1 = vtree_get_childtab_next( v, i );
+  if ( interval->node < 0 || v->nodetab == NULL )
+    return vtree_getInterval( v, interval->i, interval->j, a, cmp );
 
-    if ( cmp( v->text[ v->suftab[ i ] ], a ) )
-      return new_interval2( i, i1 - 1 );
+  assert( interval->i != interval->j );
 
-    while ( vtree_get_childtab_next( v, i1 ) != -1 ) {
-      i2 = vtree_get_childtab_next( v, i1 );
+  if ( cmp == NULL )
+    cmp = trivial_cmp;
 
-      if ( cmp( v->text[ v->suftab[ i1 ] ], a ) )
-	return new_interval2( i1, i2 - 1 );
+  l = vtree_get_node( v, interval->node )->lcp;
 
-      i1 = i2;
+  for ( int more = vtree_node_first( v, interval->node, &it ); more; more = vtree_child_next( &it ) )
+    if ( cmp( v->text[ vtree_get_node( v, it.node )->label + l ], a ) ) {
+      interval2_t *child = new_interval2( it.i, it.j );
+      child->node = it.node;
+      return child;
     }
 
-    return NULL;
-  }
-
-  /* general case -- internal node */
-
-  val = vtree_get_childtab_up( v, j+1 );
-  l = vtree_getlcp( v, i, j );
-
-  if ( i < val && val <= j )
-    i1 = val;
-  else
-    i1 = vtree_get_childtab_down( v, i );
-
-  if ( cmp( v->text[ v->suftab[ i ] + l ], a ) )
-    return new_interval2( i, i1 - 1 );
-
-  while ( vtree_get_childtab_next( v, i1 ) != -1 ) {
-    i2 = vtree_get_childtab_next( v, i1 );
+  return NULL;
+}
 
-      if ( cmp( v->text[ v->suftab[ i1 ] + l ], a ) )
-	return new_interval2( i1, i2 - 1 );
+/*****************************************************************
+ * vtree_root_interval - the interval 0..n of the root, with its *
+ * node if v has a node table                                    *
+ *****************************************************************/
 
-    i1 = i2;
-  }
+interval2_t *
+vtree_root_interval( vtree_t *v )
+{
+  interval2_t *root = new_interval2( 0, v->length );
 
-  if ( cmp( v->text[ v->suftab[ i1 ] + l ], a ) )
-    return new_interval2( i1, j );
+  if ( v->nodetab != NULL )
+    root->node = 0;
 
-  return NULL;
+  return root;
 }
 
 /*****************************************************************
@@ -407,67 +731,112 @@ vtree_getInterval( vtree_t *v, pos_t i, pos_t j, symbol_t a, int ( *cmp )( symbo
 void
 vtree_find_exact_match( vtree_t *v, dstring_t *p )
 {
-  int c=0;
-  int queryFound = TRUE;
-  interval2_t *interval;
-  pos_t i, j, m = p->length;
+  vtree_require( v, VTREE_SUFTAB | VTREE_CHILDTAB );
 
-  interval = vtree_getInterval( v, 0, v->length, p->text[ c ], NULL );
+  dispatch( v, find_exact_match, ( v, p ) );
+}
 
-  if ( interval == NULL ) {
-    queryFound = FALSE;
-  }
+/*****************************************************************
+ * vtree_lindex - first l-index of an lcp-interval               *
+ * v : enhanced suffix array                                     *
+ * i, j : bounds of the interval, i < j                          *
+ *                                                               *
+ * The l-indices of [i..j] are the ranks k in i+1..j with        *
+ * lcp[ k ] equal to its lcp-value; the first one is found with  *
+ * the child table, and identifies the interval among all the    *
+ * lcp-intervals.                                                *
+ *****************************************************************/
 
-  while ( ( interval != NULL ) && ( c < m ) && ( queryFound ) ) {
+pos_t
+vtree_lindex( vtree_t *v, pos_t i, pos_t j )
+{
+  vtree_require( v, VTREE_CHILDTAB );
 
-    i = interval->i;
-    j = interval->j;
+  assert( i < j );
 
-    if ( i != j ) {
+  return dispatch( v, lindex, ( v, i, j ) );
+}
 
-      pos_t l = vtree_getlcp( v, i, j );
-      pos_t min = MIN( l, m );
+/*****************************************************************
+ * vtree_get_suffixes - decodes suftab[ i..j ] into pos          *
+ * v : enhanced suffix array                                     *
+ * i, j : range of ranks                                         *
+ * pos : j-i+1 entries                                           *
+ *                                                               *
+ * The width of the tables is tested once for the range, rather  *
+ * than once per entry as by vtree_get_suftab; the loops over    *
+ * the suffixes of an interval decode them by blocks of          *
+ * VTREE_SUFFIX_BLOCK.                                           *
+ *****************************************************************/
 
-      for ( pos_t k=c; k < min && queryFound; k++ )
-	if ( v->text[ v->suftab[ i ] + k ] != p->text[ k ] )
-	  queryFound = FALSE;
+void
+vtree_get_suffixes( vtree_t *v, pos_t i, pos_t j, pos_t *pos )
+{
+  vtree_require( v, VTREE_SUFTAB );
 
-      c = min;
+  dispatch( v, get_suffixes, ( v, i, j, pos ) );
+}
 
-      if ( c < m ) {
+/*****************************************************************
+ * vtree_childtab_up - up-value of the child table               *
+ * vtree_childtab_down - down-value of the child table           *
+ * vtree_childtab_next - next l-index of the child table         *
+ * v : enhanced suffix array                                     *
+ * i : index into the childtab                                   *
+ *****************************************************************/
 
-	interval = vtree_getInterval( v, i, j,  p->text[ c ], NULL );
+pos_t
+vtree_childtab_up( vtree_t *v, pos_t i )
+{
+  vtree_require( v, VTREE_CHILDTAB );
 
-	if ( interval == NULL ) {
-	  queryFound = FALSE;
-	}
+  return dispatch( v, cld_up, ( v, i ) );
+}
 
-      }
+pos_t
+vtree_childtab_down( vtree_t *v, pos_t i )
+{
+  vtree_require( v, VTREE_CHILDTAB );
 
-    } else {
+  return dispatch( v, cld_down, ( v, i ) );
+}
 
-      for ( pos_t k=c+1; k < m && queryFound; k++ )
-	if ( v->text[ v->suftab[ i ] + k ] != p->text[ k ] )
-	  queryFound = FALSE;
-      c = m; /* forces exit */
-    }
-  }
+pos_t
+vtree_childtab_next( vtree_t *v, pos_t i )
+{
+  vtree_require( v, VTREE_CHILDTAB );
 
-  if ( ! queryFound ) {
+  return dispatch( v, cld_next, ( v, i ) );
+}
 
-    printf( "pattern P not found" );
+/*****************************************************************
+ * vtree_seq_of - text containing the position p of a            *
+ * generalized vtree (0 for an ordinary vtree)                   *
+ *****************************************************************/
 
-  } else {
+int
+vtree_seq_of( vtree_t *v, pos_t p )
+{
+  int lo = 0, hi = v->num_seqs - 1;
+
+  while ( lo < hi ) { /* last s such that seqstart[ s ] <= p */
+    int mid = ( lo + hi + 1 ) / 2;
+    if ( v->seqstart[ mid ] <= p )
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
 
-    printf( "query found a position(s): " );
+  return lo;
+}
 
-    for ( pos_t k=i; k<=j; k++ ) {
-      if ( k>i )
-	printf( ", " );
-      printf( "%d", v->suftab[ k ] );
-    }
-    printf( "\n" );
+/*****************************************************************
+ * vtree_seq_end - position of the separator (terminator) of the *
+ * text s                                                        *
+ *****************************************************************/
 
-  }
+pos_t
+vtree_seq_end( vtree_t *v, int s )
+{
+  return v->seqstart == NULL ? v->length - 1 : v->seqstart[ s+1 ] - 1;
 }
-
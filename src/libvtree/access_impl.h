@@ -0,0 +1,365 @@
+/*                               -*- Mode: C -*-
+ * access_impl.h --- access functions specialized for one table width
+ * Author          : Marcel Turcotte
+ * Created On      : Sat Oct 17 14:20:05 2026
+ * Last Modified By: Marcel Turcotte
+ * Last Modified On: Sat Oct 17 14:20:05 2026
+ *
+ * This copyrighted source code is freely distributed under the terms
+ * of the GNU General Public License.
+ * See the files COPYRIGHT and LICENSE for details.
+ *
+ * This file is included by access.c once per width of the index
+ * tables, with the following macros defined:
+ *
+ *   INDEX_T       type of the entries of the tables
+ *   DECODE( x )   converts an entry into a pos_t
+ *   SPECIALIZE( name ) name of the specialized function
+ *
+ * The documentation of the algorithms is found with the public
+ * functions in access.c.
+ */
+
+#define SUF( i ) DECODE( ( ( INDEX_T * ) v->suftab )[ i ] )
+#define LCP( i ) vtree_get_lcptab( v, i )
+#define CLD( i ) DECODE( ( ( INDEX_T * ) v->childtab )[ i ] )
+#define UP( i ) SPECIALIZE( cld_up )( v, i )
+#define DOWN( i ) SPECIALIZE( cld_down )( v, i )
+#define NEXT( i ) SPECIALIZE( cld_next )( v, i )
+#define LABEL( i ) ( v->suftab != NULL ? SUF( i ) : -1 )
+
+/*****************************************************************
+ * cld_up, cld_next, cld_down - decoding of the one-field child  *
+ * table, see libvtree.h                                         *
+ *****************************************************************/
+
+static inline pos_t
+SPECIALIZE( cld_up )( vtree_t *v, pos_t i )
+{
+  return i > 0 && LCP( i-1 ) > LCP( i ) ? CLD( i-1 ) : -1;
+}
+
+static inline pos_t
+SPECIALIZE( cld_next )( vtree_t *v, pos_t i )
+{
+  pos_t c = CLD( i );
+
+  return c > i && LCP( c ) == LCP( i ) ? c : -1;
+}
+
+static inline pos_t
+SPECIALIZE( cld_down )( vtree_t *v, pos_t i )
+{
+  pos_t c = CLD( i );
+
+  if ( c <= i )
+    return -1;
+
+  if ( LCP( c ) > LCP( i ) )
+    return c;
+
+  return SPECIALIZE( cld_up )( v, c ); /* next(i) is defined */
+}
+
+/*****************************************************************
+ * traverse_and_process - see vtree_traverse_and_process         *
+ *****************************************************************/
+
+#define push( elem ) dev_vector_add( stack, elem )
+#define pop() dev_vector_remove( stack )
+#define peek() dev_vector_get_last( stack )
+#define add( list, elem ) dev_vector_add( list, elem )
+
+static void
+SPECIALIZE( traverse_and_process )( vtree_t *v, void ( *f )( vtree_t *, interval4_t * ) )
+{
+  vector_t *stack = ( vector_t * ) dev_new_vector( 5, 5 );
+  interval4_t *top, *lastInterval = NULL;
+
+  top = new_interval4( 0, 0, -1 );
+  push( top );
+
+  for ( pos_t i=1; i <= v->length; i++ ) {
+
+    pos_t lb = i-1;
+
+    while ( LCP( i ) < top->lcp ) {
+
+      top->rb = i-1;
+
+      if ( lastInterval != NULL )
+	dev_free( lastInterval );
+
+      lastInterval = pop();
+      top = peek();
+
+      f( v, lastInterval );
+
+      lb = lastInterval->lb;
+
+      if ( LCP( i ) <= top->lcp ) {
+	add( top->childList, lastInterval );
+	lastInterval = NULL;
+      }
+
+    }
+
+    if ( LCP( i ) > top->lcp ) {
+
+      top = new_interval4( LCP( i ), lb, -1 );
+
+      if ( lastInterval != NULL ) {
+	add( top->childList, lastInterval );
+	lastInterval = NULL;
+      }
+
+      push( top );
+
+    }
+  }
+
+  top = pop();
+  dev_free( top );
+
+  dev_free_vector( stack, free );
+}
+
+#undef push
+#undef pop
+#undef peek
+#undef add
+
+/*****************************************************************
+ * child_first, child_next - see vtree_child_first               *
+ *****************************************************************/
+
+static inline int
+SPECIALIZE( child_first )( vtree_t *v, pos_t i, pos_t j, vtree_child_iter_t *it )
+{
+  pos_t i1, val;
+
+  if ( i == j )
+    return FALSE;
+
+  it->v = v;
+  it->rb = j;
+  it->root = j == v->length;
+
+  if ( it->root )
+    i1 = NEXT( i ); /* special case for 0-[0..n] -- root of the tree */
+  else {
+    val = UP( j+1 );
+    i1 = i < val && val <= j ? val : DOWN( i );
+  }
+
+  it->i = i;
+  it->j = i1 - 1;
+  it->next = i1;
+  it->label = LABEL( i );
+
+  return TRUE;
+}
+
+static inline int
+SPECIALIZE( child_next )( vtree_child_iter_t *it )
+{
+  vtree_t *v = it->v;
+  pos_t i1 = it->next, i2;
+
+  if ( i1 < 0 )
+    return FALSE;
+
+  i2 = NEXT( i1 );
+
+  if ( i2 != -1 ) {
+    it->i = i1;
+    it->j = i2 - 1;
+    it->next = i2;
+    it->label = LABEL( i1 );
+    return TRUE;
+  }
+
+  it->next = -1;
+
+  if ( it->root )
+    return FALSE;
+
+  it->i = i1; /* last child of an internal node */
+  it->j = it->rb;
+  it->label = LABEL( i1 );
+
+  return TRUE;
+}
+
+/*****************************************************************
+ * getChildIntervals - see vtree_getChildIntervals               *
+ *****************************************************************/
+
+static vector_t *
+SPECIALIZE( getChildIntervals )( vtree_t *v, interval2_t *i0 )
+{
+  /* tuned for nucleotides alphabet */
+  vector_t *intervalList = dev_new_vector( 5, 5 );
+  vtree_child_iter_t it;
+
+  assert( i0->i != i0->j );
+
+  for ( int more = SPECIALIZE( child_first )( v, i0->i, i0->j, &it ); more; more = SPECIALIZE( child_next )( &it ) )
+    dev_vector_add( intervalList, new_interval2( it.i, it.j ) );
+
+  return intervalList;
+}
+
+/*****************************************************************
+ * lindex - see vtree_lindex                                     *
+ *****************************************************************/
+
+static inline pos_t
+SPECIALIZE( lindex )( vtree_t *v, pos_t i, pos_t j )
+{
+  pos_t val;
+
+  if ( i == 0 && j == v->length )
+    return NEXT( 0 );
+
+  val = UP( j+1 );
+
+  return i < val && val <= j ? val : DOWN( i );
+}
+
+/*****************************************************************
+ * getlcp - see vtree_getlcp                                     *
+ *****************************************************************/
+
+static inline pos_t
+SPECIALIZE( getlcp )( vtree_t *v, pos_t i, pos_t j )
+{
+  pos_t val = UP( j+1 );
+
+  if ( i < val && val <= j )
+    return LCP( val );
+
+  return LCP( DOWN( i ) );
+}
+
+/*****************************************************************
+ * getInterval - see vtree_getInterval                           *
+ *****************************************************************/
+
+static interval2_t *
+SPECIALIZE( getInterval )( vtree_t *v, pos_t i, pos_t j, symbol_t a, int ( *cmp )( symbol_t, symbol_t ) )
+{
+  vtree_child_iter_t it;
+  pos_t l;
+
+  assert( i != j );
+
+  if ( cmp == NULL )
+    cmp = trivial_cmp;
+
+  l = j == v->length ? 0 : SPECIALIZE( getlcp )( v, i, j );
+
+  for ( int more = SPECIALIZE( child_first )( v, i, j, &it ); more; more = SPECIALIZE( child_next )( &it ) )
+    if ( cmp( v->text[ it.label + l ], a ) )
+      return new_interval2( it.i, it.j );
+
+  return NULL;
+}
+
+/*****************************************************************
+ * find_exact_match - see vtree_find_exact_match                 *
+ *****************************************************************/
+
+static void
+SPECIALIZE( find_exact_match )( vtree_t *v, dstring_t *p )
+{
+  pos_t c=0;
+  int queryFound = TRUE;
+  interval2_t *interval, start;
+  pos_t i, j, m = p->length;
+  pos_t k = vtree_kmer_interval( v, p->text, m, &start.i, &start.j );
+
+  if ( k > 0 ) {
+    interval = &start; /* the first k symbols are matched */
+    c = k-1;
+  } else if ( k < 0 ) {
+    interval = NULL;
+  } else {
+    interval = SPECIALIZE( getInterval )( v, 0, v->length, p->text[ c ], NULL );
+  }
+
+  if ( interval == NULL ) {
+    queryFound = FALSE;
+  }
+
+  while ( ( interval != NULL ) && ( c < m ) && ( queryFound ) ) {
+
+    i = interval->i;
+    j = interval->j;
+
+    if ( i != j ) {
+
+      pos_t l = SPECIALIZE( getlcp )( v, i, j );
+      pos_t min = MIN( l, m );
+
+      for ( pos_t k=c; k < min && queryFound; k++ )
+	if ( v->text[ SUF( i ) + k ] != p->text[ k ] )
+	  queryFound = FALSE;
+
+      c = min;
+
+      if ( c < m ) {
+
+	interval = SPECIALIZE( getInterval )( v, i, j,  p->text[ c ], NULL );
+
+	if ( interval == NULL ) {
+	  queryFound = FALSE;
+	}
+
+      }
+
+    } else {
+
+      for ( pos_t k=c+1; k < m && queryFound; k++ )
+	if ( v->text[ SUF( i ) + k ] != p->text[ k ] )
+	  queryFound = FALSE;
+      c = m; /* forces exit */
+    }
+  }
+
+  if ( ! queryFound ) {
+
+    printf( "pattern P not found\n" );
+
+  } else {
+
+    printf( "query found a position(s): " );
+
+    for ( pos_t k=i; k<=j; k++ ) {
+      if ( k>i )
+	printf( ", " );
+      printf( "%ld", ( long ) SUF( k ) );
+    }
+    printf( "\n" );
+
+  }
+}
+
+/*****************************************************************
+ * get_suffixes - see vtree_get_suffixes                         *
+ *****************************************************************/
+
+static void
+SPECIALIZE( get_suffixes )( vtree_t *v, pos_t i, pos_t j, pos_t *pos )
+{
+  for ( pos_t k=i; k<=j; k++ )
+    pos[ k-i ] = SUF( k );
+}
+
+#undef SUF
+#undef LCP
+#undef CLD
+#undef UP
+#undef DOWN
+#undef NEXT
+#undef LABEL
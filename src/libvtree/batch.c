@@ -0,0 +1,326 @@
+/*                               -*- Mode: C -*-
+ * batch.c --- exact search of many patterns in one traversal
+ * Author          : Marcel Turcotte
+ * Created On      : Sat Oct 17 19:26:48 2026
+ * Last Modified By: Marcel Turcotte
+ * Last Modified On: Sat Oct 17 19:26:48 2026
+ *
+ * This copyrighted source code is freely distributed under the terms
+ * of the GNU General Public License.
+ * See the files COPYRIGHT and LICENSE for details.
+ *
+ * The patterns are sorted, which makes them the leaves of a trie in
+ * depth-first order: the patterns below a node are consecutive, and
+ * the depth of the branching node of two neighbours is their lcp.
+ * This implicit trie is walked together with the lcp-interval tree,
+ * hence the symbols of a prefix shared by several patterns are
+ * compared once, and each interval is visited once for all the
+ * patterns that reach it.
+ */
+
+#include "libdev.h"
+#include "thread.h"
+#include "libvtree.h"
+
+#include <string.h>
+
+/*****************************************************************
+ * hits_t - growing array of the hits of one thread              *
+ *****************************************************************/
+
+typedef struct {
+  vtree_hit_t *hits;
+  pos_t size;
+  pos_t capacity;
+} hits_t;
+
+/*****************************************************************
+ * batch_t - state of vtree_find_batch, the threads own disjoint *
+ * ranges of order and plcp                                      *
+ *****************************************************************/
+
+typedef struct {
+  vtree_t *v;
+  dstring_t **patterns;
+  int num_patterns; /* those searched, the empty ones are left out */
+  int *order;    /* indices of the patterns, in lexicographic order */
+  pos_t *plcp;   /* plcp[ k ], lcp of the patterns order[ k-1 ] and order[ k ] */
+  pos_t *end;    /* end[ k ], depth of the first mismatch of order[ k ] */
+  hits_t *hits;  /* one per thread */
+} batch_t;
+
+/*****************************************************************
+ * compare_patterns - lexicographic order of the patterns a and  *
+ * b point to, a prefix comes first, then by index               *
+ *****************************************************************/
+
+static int
+compare_patterns( const void *a, const void *b )
+{
+  dstring_t **x = *( dstring_t *** ) a, **y = *( dstring_t *** ) b;
+  dstring_t *p = *x, *q = *y;
+  pos_t m = MIN( p->length, q->length );
+
+  for ( pos_t k=0; k<m; k++ )
+    if ( p->text[ k ] != q->text[ k ] )
+      return p->text[ k ] < q->text[ k ] ? -1 : 1;
+
+  if ( p->length != q->length )
+    return p->length < q->length ? -1 : 1;
+
+  return x < y ? -1 : ( x > y );
+}
+
+/*****************************************************************
+ * compare_hits - by pattern, text and position                  *
+ *****************************************************************/
+
+static int
+compare_hits( const void *a, const void *b )
+{
+  const vtree_hit_t *x = a, *y = b;
+
+  if ( x->pattern != y->pattern )
+    return x->pattern < y->pattern ? -1 : 1;
+
+  if ( x->seq != y->seq )
+    return x->seq < y->seq ? -1 : 1;
+
+  return x->pos < y->pos ? -1 : ( x->pos > y->pos );
+}
+
+/*****************************************************************
+ * add_hits - records the occurrences of pattern at the suffixes *
+ * of ranks i..j                                                 *
+ *****************************************************************/
+
+static void
+add_hits( vtree_t *v, hits_t *h, int pattern, pos_t i, pos_t j )
+{
+  pos_t suf[ VTREE_SUFFIX_BLOCK ];
+
+  if ( h->size + ( j - i + 1 ) > h->capacity ) {
+    h->capacity = MAX( 2 * h->capacity, h->size + ( j - i + 1 ) );
+    h->hits = ( vtree_hit_t * ) dev_realloc( h->hits, h->capacity * sizeof( vtree_hit_t ) );
+  }
+
+  for ( pos_t a=i; a<=j; a+=VTREE_SUFFIX_BLOCK ) {
+
+    pos_t b = MIN( j, a + VTREE_SUFFIX_BLOCK - 1 );
+
+    vtree_get_suffixes( v, a, b, suf );
+
+    for ( pos_t r=a; r<=b; r++ ) {
+
+      vtree_hit_t *x = h->hits + h->size++;
+      pos_t p = suf[ r-a ];
+
+      x->pattern = pattern;
+      x->seq = v->num_seqs > 1 ? vtree_seq_of( v, p ) : 0;
+      x->pos = v->num_seqs > 1 ? p - v->seqstart[ x->seq ] : p;
+    }
+  }
+}
+
+/*****************************************************************
+ * search - resolves the patterns order[ lo..hi-1 ], which match *
+ * the first d symbols of the suffixes of ranks i..j             *
+ *                                                               *
+ * The symbols d..l-1 of each pattern, l being the lcp-value of  *
+ * the interval, are compared with the text; a pattern starts    *
+ * from the depth where its predecessor stopped matching, unless *
+ * the two differ before.  The patterns that end within the      *
+ * interval are reported, the others are compacted at the start  *
+ * of the range and sent down to the children, whose first       *
+ * symbols come in the same order as theirs.                     *
+ *****************************************************************/
+
+static void
+search( batch_t *b, hits_t *h, pos_t i, pos_t j, pos_t d, int lo, int hi )
+{
+  vtree_t *v = b->v;
+  pos_t suf = vtree_get_suftab( v, i ), l, lcp_kept = 0;
+  int w = lo;
+  vtree_child_iter_t it;
+
+  if ( i == j )
+    l = v->length - suf; /* the symbols left in the text */
+  else
+    l = j == v->length ? 0 : vtree_getlcp( v, i, j );
+
+  for ( int k=lo; k<hi; k++ ) {
+
+    dstring_t *p = b->patterns[ b->order[ k ] ];
+    pos_t e = MIN( l, p->length ), f = d;
+
+    if ( k > lo ) {
+
+      pos_t q = b->plcp[ k ];
+
+      lcp_kept = MIN( lcp_kept, q );
+
+      if ( q < b->end[ k-1 ] && q < e ) {
+	b->end[ k ] = q; /* differs from its predecessor where the latter matched */
+	continue;
+      }
+
+      f = MIN( q, b->end[ k-1 ] );
+    }
+
+    while ( f < e && p->text[ f ] == v->text[ suf + f ] )
+      f++;
+
+    b->end[ k ] = f;
+
+    if ( f < e ) /* mismatch */
+      continue;
+
+    if ( p->length <= l ) {
+      add_hits( v, h, b->order[ k ], i, j );
+      continue;
+    }
+
+    if ( i == j ) /* beyond the end of the text */
+      continue;
+
+    /* kept for the children, plcp[ w ] becomes the lcp with the previous one kept */
+
+    b->order[ w ] = b->order[ k ];
+    if ( w > lo )
+      b->plcp[ w ] = lcp_kept;
+    lcp_kept = v->length;
+    w++;
+  }
+
+  /* the children and the patterns kept are both ordered by their symbol at depth l */
+
+  if ( w > lo )
+    for ( int more = vtree_child_first( v, i, j, &it ), k = lo; more && k < w; more = vtree_child_next( &it ) ) {
+
+      symbol_t a = v->text[ it.label + l ];
+      int r;
+
+      while ( k < w && b->patterns[ b->order[ k ] ]->text[ l ] < a )
+	k++;
+
+      for ( r=k; r < w && b->patterns[ b->order[ r ] ]->text[ l ] == a; r++ )
+	;
+
+      if ( r > k )
+	search( b, h, it.i, it.j, l, k, r );
+
+      k = r;
+    }
+}
+
+/*****************************************************************
+ * search_block - body of the threads of vtree_find_batch, each  *
+ * one searches a range of the sorted patterns from the root     *
+ *****************************************************************/
+
+static void
+search_block( int id, int nt, void *arg )
+{
+  batch_t *b = ( batch_t * ) arg;
+  pos_t lo, hi;
+
+  dev_block_range( id, nt, b->num_patterns, &lo, &hi );
+
+  if ( lo < hi )
+    search( b, b->hits + id, 0, b->v->length, 0, lo, hi );
+}
+
+/*****************************************************************
+ * vtree_find_batch - occurrences of many patterns               *
+ * v : enhanced suffix array, generalized or not                 *
+ * patterns : digital strings, without terminator                *
+ * num_patterns : number of patterns                             *
+ * num_hits : set to the number of hits returned                 *
+ *                                                               *
+ * Returns the hits sorted by pattern, text and position, in an  *
+ * array that the caller frees with dev_free.  The patterns are  *
+ * split among vtree_get_num_threads() threads; the tables are   *
+ * built beforehand.  An empty pattern has no hit.               *
+ *****************************************************************/
+
+vtree_hit_t *
+vtree_find_batch( vtree_t *v, dstring_t *patterns[], int num_patterns, pos_t *num_hits )
+{
+  dstring_t ***refs;
+  vtree_hit_t *result;
+  batch_t b;
+  int nt;
+
+  vtree_require( v, VTREE_SUFTAB | VTREE_CHILDTAB );
+
+  /* the patterns in lexicographic order */
+
+  refs = ( dstring_t *** ) dev_malloc( MAX( num_patterns, 1 ) * sizeof( dstring_t ** ) );
+
+  b.v = v;
+  b.patterns = patterns;
+  b.num_patterns = 0;
+
+  for ( int k=0; k<num_patterns; k++ )
+    if ( patterns[ k ]->length > 0 )
+      refs[ b.num_patterns++ ] = patterns + k;
+
+  qsort( refs, b.num_patterns, sizeof( dstring_t ** ), compare_patterns );
+
+  b.order = ( int * ) dev_malloc( MAX( b.num_patterns, 1 ) * sizeof( int ) );
+  b.plcp = ( pos_t * ) dev_malloc( MAX( b.num_patterns, 1 ) * sizeof( pos_t ) );
+  b.end = ( pos_t * ) dev_malloc( MAX( b.num_patterns, 1 ) * sizeof( pos_t ) );
+
+  for ( int k=0; k<b.num_patterns; k++ ) {
+
+    b.order[ k ] = refs[ k ] - patterns;
+    b.plcp[ k ] = 0;
+
+    if ( k > 0 ) {
+      dstring_t *p = patterns[ b.order[ k-1 ] ], *q = patterns[ b.order[ k ] ];
+      while ( b.plcp[ k ] < p->length && b.plcp[ k ] < q->length &&
+	      p->text[ b.plcp[ k ] ] == q->text[ b.plcp[ k ] ] )
+	b.plcp[ k ]++;
+    }
+  }
+
+  dev_free( refs );
+
+  /* each thread searches a range of the sorted patterns */
+
+  nt = MAX( 1, MIN( vtree_get_num_threads(), b.num_patterns ) );
+
+  b.hits = ( hits_t * ) dev_malloc( nt * sizeof( hits_t ) );
+
+  for ( int t=0; t<nt; t++ ) {
+    b.hits[ t ].hits = NULL;
+    b.hits[ t ].size = b.hits[ t ].capacity = 0;
+  }
+
+  dev_parallel_run( nt, search_block, &b );
+
+  *num_hits = 0;
+
+  for ( int t=0; t<nt; t++ )
+    *num_hits += b.hits[ t ].size;
+
+  result = ( vtree_hit_t * ) dev_malloc( MAX( *num_hits, 1 ) * sizeof( vtree_hit_t ) );
+
+  *num_hits = 0;
+
+  for ( int t=0; t<nt; t++ ) {
+    if ( b.hits[ t ].size > 0 )
+      memcpy( result + *num_hits, b.hits[ t ].hits, b.hits[ t ].size * sizeof( vtree_hit_t ) );
+    *num_hits += b.hits[ t ].size;
+    dev_free( b.hits[ t ].hits );
+  }
+
+  qsort( result, *num_hits, sizeof( vtree_hit_t ), compare_hits );
+
+  dev_free( b.hits );
+  dev_free( b.order );
+  dev_free( b.plcp );
+  dev_free( b.end );
+
+  return result;
+}
@@ -24,6 +24,8 @@
  *   note = {\url{http://www.springerlink.com/openurl.asp?genre=article&issn=0302-9743&volume=2719&spage=943}}
  * }
  *
+ * See also sais.c for the induced sorting algorithm (SA-IS).
+ *
  * @InProceedings{Kasai2001,
  *   author =	 {Kasai, Toru and Lee, Gunho and Arimura, Hiroki and
  *               Arikawa, Setsuo and Park, Kunsoo},
@@ -42,9 +44,221 @@
 
 #include "libdev.h"
 #include "ivector.h"
+#include "thread.h"
 #include "libvtree.h"
 
 #include <string.h>
+#include <sys/mman.h>
+
+#include "merge_impl.h"
+#include "construct_impl.h"
+
+/*****************************************************************
+ * global variables                                              *
+ *****************************************************************/
+
+static int sa_algorithm = VTREE_SA_AUTO;
+
+static int num_threads = 1;
+
+static int table_width = VTREE_WIDTH_AUTO;
+
+static int rmq_block = VTREE_RMQ_BLOCK;
+
+static int kmer_length = 0;
+
+static int fm_step = VTREE_FM_STEP;
+
+/*****************************************************************
+ * vtree_set_sa_algorithm - selects the suffix array construction*
+ * algorithm used by vtree_create                                *
+ * algorithm : VTREE_SA_AUTO, VTREE_SA_SKEW or VTREE_SA_SAIS     *
+ * return : the previous algorithm                               *
+ *****************************************************************/
+
+int
+vtree_set_sa_algorithm( int algorithm )
+{
+  int old = sa_algorithm;
+
+  if ( algorithm != VTREE_SA_AUTO && algorithm != VTREE_SA_SKEW && algorithm != VTREE_SA_SAIS )
+    dev_die( "vtree_set_sa_algorithm: unknown algorithm %d", algorithm );
+
+  sa_algorithm = algorithm;
+
+  return old;
+}
+
+/*****************************************************************
+ * vtree_get_sa_algorithm -                                      *
+ *****************************************************************/
+
+int
+vtree_get_sa_algorithm( void )
+{
+  return sa_algorithm;
+}
+
+/*****************************************************************
+ * vtree_set_num_threads - sets the number of threads used by    *
+ * vtree_create, 0 (or less) means one thread per processor      *
+ * return : the previous number of threads                       *
+ *****************************************************************/
+
+int
+vtree_set_num_threads( int n )
+{
+  int old = num_threads;
+
+  num_threads = n > 0 ? n : dev_num_cpus();
+
+  return old;
+}
+
+/*****************************************************************
+ * vtree_get_num_threads -                                       *
+ *****************************************************************/
+
+int
+vtree_get_num_threads( void )
+{
+  return num_threads;
+}
+
+/*****************************************************************
+ * vtree_set_width - sets the number of bytes per entry of the   *
+ * index tables built by vtree_create                            *
+ * width : VTREE_WIDTH_AUTO, VTREE_WIDTH_16, VTREE_WIDTH_32 or   *
+ *         VTREE_WIDTH_64                                        *
+ * return : the previous width                                   *
+ *                                                               *
+ * VTREE_WIDTH_AUTO selects the smallest width that can hold the *
+ * indices of the text.  A fixed width that is too small for a   *
+ * given text is silently widened.                               *
+ *****************************************************************/
+
+int
+vtree_set_width( int width )
+{
+  int old = table_width;
+
+  if ( width != VTREE_WIDTH_AUTO && width != VTREE_WIDTH_16 && width != VTREE_WIDTH_32 && width != VTREE_WIDTH_64 )
+    dev_die( "vtree_set_width: unknown width %d", width );
+
+  table_width = width;
+
+  return old;
+}
+
+/*****************************************************************
+ * vtree_get_width -                                             *
+ *****************************************************************/
+
+int
+vtree_get_width( void )
+{
+  return table_width;
+}
+
+/*****************************************************************
+ * vtree_set_rmq_block - sets the block size of the range        *
+ * minimum query index used by vtree_lce                         *
+ * block : entries of lcptab per block, 0 disables the index     *
+ * return : the previous block size                              *
+ *                                                               *
+ * With block 1 the index is a sparse table of n log n values    *
+ * and a query reads two of them, see rmq_t.                     *
+ *****************************************************************/
+
+int
+vtree_set_rmq_block( int block )
+{
+  int old = rmq_block;
+
+  if ( block < 0 )
+    dev_die( "vtree_set_rmq_block: invalid block size %d", block );
+
+  rmq_block = block;
+
+  return old;
+}
+
+/*****************************************************************
+ * vtree_get_rmq_block -                                         *
+ *****************************************************************/
+
+int
+vtree_get_rmq_block( void )
+{
+  return rmq_block;
+}
+
+/*****************************************************************
+ * vtree_set_kmer_length - sets the length of the k-mers of the  *
+ * prefix table built by vtree_create                            *
+ * k : length of the k-mers, 0 for no prefix table               *
+ * return : the previous length                                  *
+ *                                                               *
+ * The table has sigma^k entries, where sigma is the number of   *
+ * symbols that occur in the text, k is reduced for a given text *
+ * so that the table is no larger than the text.                 *
+ *****************************************************************/
+
+int
+vtree_set_kmer_length( int k )
+{
+  int old = kmer_length;
+
+  if ( k < 0 )
+    dev_die( "vtree_set_kmer_length: invalid length %d", k );
+
+  kmer_length = k;
+
+  return old;
+}
+
+/*****************************************************************
+ * vtree_get_kmer_length -                                       *
+ *****************************************************************/
+
+int
+vtree_get_kmer_length( void )
+{
+  return kmer_length;
+}
+
+/*****************************************************************
+ * vtree_set_fm_step - sets the distance between the positions   *
+ * kept by the FM-indexes built afterwards                       *
+ * step : 1 keeps the whole suffix array                         *
+ * return : the previous distance                                *
+ *                                                               *
+ * vtree_fm_locate takes at most step - 1 steps back in the      *
+ * text, and the positions kept use n / step entries.            *
+ *****************************************************************/
+
+int
+vtree_set_fm_step( int step )
+{
+  int old = fm_step;
+
+  if ( step < 1 )
+    dev_die( "vtree_set_fm_step: invalid step %d", step );
+
+  fm_step = step;
+
+  return old;
+}
+
+/*****************************************************************
+ * vtree_get_fm_step -                                           *
+ *****************************************************************/
+
+int
+vtree_get_fm_step( void )
+{
+  return fm_step;
+}
 
 /*****************************************************************
  * vtree_set_id -                                                *
@@ -68,35 +282,220 @@ vtree_get_id( vtree_t *v )
 
 
 /*****************************************************************
- * vtree_init - allocates memory for all the arrays              *
+ * select_width - smallest width of the index tables that can    *
+ * hold the indices of a text of length n (or the one set by     *
+ * vtree_set_width); 64 bits need a pos_t of 64 bits             *
+ *****************************************************************/
+
+static int
+select_width( size_t n )
+{
+  int width;
+
+  if ( n < VTREE_MAX_16 )
+    width = VTREE_WIDTH_16;
+  else if ( n < VTREE_MAX_32 )
+    width = VTREE_WIDTH_32;
+  else if ( sizeof( pos_t ) < VTREE_WIDTH_64 )
+    dev_die( "select_width: a text of length %lu needs -DPOS64", ( unsigned long ) n );
+  else
+    width = VTREE_WIDTH_64;
+
+  return MAX( width, table_width );
+}
+
+/*****************************************************************
+ * Workspace                                                     *
+ *                                                               *
+ * The temporary arrays of the construction are taken from the   *
+ * scratch area of a builder, when there is one, and released in *
+ * the reverse order of their allocation: work_free( b, p )      *
+ * releases p and everything allocated after p.                  *
+ *****************************************************************/
+
+#define WORK_ALIGN( x ) ( ( ( size_t ) ( x ) + 15 ) & ~( size_t ) 15 )
+
+static void *
+work_alloc( vtree_builder_t *b, size_t bytes )
+{
+  void *p;
+
+  if ( b == NULL )
+    return dev_malloc( bytes );
+
+  assert( b->top + WORK_ALIGN( bytes ) <= b->size );
+
+  p = b->scratch + b->top;
+  b->top += WORK_ALIGN( bytes );
+
+  return p;
+}
+
+static void
+work_free( vtree_builder_t *b, void *p )
+{
+  if ( b == NULL )
+    dev_free( p );
+  else
+    b->top = ( char * ) p - b->scratch;
+}
+
+/*****************************************************************
+ * pack_table - stores a table of pos_t using width bytes per    *
+ * entry                                                         *
+ * p : destination                                               *
+ * t : table                                                     *
+ * n : number of entries                                         *
+ * width : number of bytes per entry                             *
+ *****************************************************************/
+
+static void
+pack_table( void *p, pos_t *t, size_t n, int width )
+{
+  switch ( width ) {
+  case VTREE_WIDTH_16:
+    for ( size_t i=0; i<n; i++ )
+      ( ( uint16_t * ) p )[ i ] = ( uint16_t ) t[ i ];
+    break;
+  case VTREE_WIDTH_32:
+    for ( size_t i=0; i<n; i++ )
+      ( ( int32_t * ) p )[ i ] = ( int32_t ) t[ i ];
+    break;
+  default:
+    for ( size_t i=0; i<n; i++ )
+      ( ( int64_t * ) p )[ i ] = ( int64_t ) t[ i ];
+  }
+}
+
+/*****************************************************************
+ * store_table - returns table t packed into the space reserved  *
+ * for it in the block of v, or into a new allocation; t itself  *
+ * is returned when it can be kept as is, otherwise the caller   *
+ * releases it                                                   *
+ * table : VTREE_SUFTAB, VTREE_ISUFTAB or VTREE_CHILDTAB         *
+ * slot : reserved space                                         *
+ *****************************************************************/
+
+static void *
+store_table( vtree_t *v, int table, void *slot, pos_t *t, size_t n, vtree_builder_t *b )
+{
+  if ( ! ( v->embedded & table ) ) {
+
+    if ( b == NULL && v->width == sizeof( pos_t ) )
+      return t;
+
+    slot = dev_malloc( n * v->width );
+  }
+
+  pack_table( slot, t, n, v->width );
+
+  return slot;
+}
+
+/*****************************************************************
+ * table_size - number of bytes of a table of v in its block     *
+ *****************************************************************/
+
+static size_t
+table_size( vtree_t *v, int table )
+{
+  size_t n = v->length + 1;
+
+  switch ( table ) {
+  case VTREE_LCPTAB:
+    return WORK_ALIGN( n * sizeof( uint8_t ) );
+  case VTREE_BWTAB:
+    return WORK_ALIGN( n * sizeof( symbol_t ) );
+  default:
+    return WORK_ALIGN( n * v->width );
+  }
+}
+
+/*****************************************************************
+ * vtree_init - allocates a vtree holding a copy of the text      *
  * dtext :                                                       *
+ * tables : tables for which space is reserved                   *
+ *                                                               *
+ * The vtree, its text and the given tables share a single       *
+ * allocation, the tables are built by vtree_require.            *
  *****************************************************************/
 
-vtree_t *
-vtree_init( dstring_t *dtext )
+static vtree_t *
+vtree_init( dstring_t *dtext, int tables )
 {
-  vtree_t *v;
-  int n = dtext->length;
+  vtree_t header, *v;
+  pos_t n = dtext->length;
+  size_t size;
+  char *p;
+
+  header.length = n;
+  header.width = select_width( n );
+
+  size = WORK_ALIGN( sizeof( vtree_t ) ) + WORK_ALIGN( ( n + 3 ) * sizeof( symbol_t ) );
+
+  for ( int t=VTREE_SUFTAB; t<=VTREE_CHILDTAB; t <<= 1 )
+    if ( tables & t )
+      size += table_size( &header, t );
+
+  p = ( char * ) dev_malloc( size );
+
+  v = ( vtree_t * ) p;
+  *v = header;
+  p += WORK_ALIGN( sizeof( vtree_t ) );
+
+  v->text = ( symbol_t * ) p;
+  p += WORK_ALIGN( ( n + 3 ) * sizeof( symbol_t ) );
+
+  v->suftab = NULL;
+  v->isuftab = NULL;
+  v->lcptab = NULL;
+  v->lcpexc = NULL;
+  v->lcpexc_size = 0;
+  v->bwtab = NULL;
+  v->childtab = NULL;
+  v->rmqtab = NULL;
+  v->kmertab = NULL;
+  v->fmtab = NULL;
+  v->sltab = NULL;
+  v->nodetab = NULL;
+  v->num_nodes = 0;
+  v->tables = 0;
+  v->embedded = tables;
+  v->map = NULL;
+  v->map_size = 0;
+  v->num_seqs = 1;
+  v->seqstart = NULL;
+
+  /* the space of the tables is assigned in advance */
+
+  if ( tables & VTREE_SUFTAB ) {
+    v->suftab = p;
+    p += table_size( v, VTREE_SUFTAB );
+  }
 
-  size_t array_size = ( n + 1 ) 
-* sizeof( pos_t ); /* check this */
+  if ( tables & VTREE_ISUFTAB ) {
+    v->isuftab = p;
+    p += table_size( v, VTREE_ISUFTAB );
+  }
+
+  if ( tables & VTREE_LCPTAB ) {
+    v->lcptab = ( uint8_t * ) p;
+    p += table_size( v, VTREE_LCPTAB );
+  }
 
-  v = ( vtree_t * ) dev_malloc( sizeof( vtree_t ) );
+  if ( tables & VTREE_BWTAB ) {
+    v->bwtab = ( symbol_t * ) p;
+    p += table_size( v, VTREE_BWTAB );
+  }
 
-  v->suftab = ( pos_t * ) dev_malloc( array_size );
-  v->lcptab = ( pos_t * ) dev_malloc( array_size );
-  v->isuftab = ( pos_t * ) dev_malloc( array_size );
-  v->bwtab = ( symbol_t * ) dev_malloc( n * sizeof( symbol_t ) );
-  v->childtab = ( node_t * ) dev_malloc( ( n + 1 ) * sizeof( node_t ) );
+  if ( tables & VTREE_CHILDTAB )
+    v->childtab = p;
 
-  v->text = ( symbol_t * ) dev_malloc( ( n + 3 ) * sizeof( symbol_t ) );
-  for ( int i=0; i<n; i++ )
+  for ( pos_t i=0; i<n; i++ )
     v->text[ i ] = dtext->text[ i ];
 
   v->text[ n ] = v->text[ n+1 ] = v->text[ n+2 ] = 0;
 
-  v->length = dtext->length;
-
   v->alphabet_size = dtext->alphabet->size;
 
   v->id = -1;
@@ -111,12 +510,13 @@ vtree_init( dstring_t *dtext )
 void
 vtree_free( vtree_t *v )
 {
-  dev_free( v->suftab );
-  dev_free( v->isuftab );
-  dev_free( v->lcptab );
-  dev_free( v->bwtab );
-  dev_free( v->childtab );
-  dev_free( v->text );
+  vtree_release( v, VTREE_ALL | VTREE_RMQTAB | VTREE_KMERTAB | VTREE_FMTAB | VTREE_SLTAB | VTREE_NODETAB );
+
+  if ( v->map != NULL )
+    munmap( v->map, v->map_size );
+  else
+    dev_free( v->seqstart );
+
   dev_free( v );
 }
 
@@ -130,32 +530,34 @@ vtree_free( vtree_t *v )
 #define peek() dev_ivector_get_last( stack )
 
 static void 
-create_childtab_updown( vtree_t *v )
+create_childtab_updown( vtree_t *v, node_t *childtab )
 {
   ivector_t *stack = dev_new_ivector();
   pos_t lastIndex = -1;
   pos_t top = 0;
 
   for ( pos_t i=0; i <= v->length; i++ ) { /* initialization */
-    v->childtab[ i ].up = -1; 
-    v->childtab[ i ].down = -1; 
+    childtab[ i ].up = -1; 
+    childtab[ i ].down = -1; 
   }
 
   push( top );
 
   for ( pos_t i=1; i <= v->length; i++ ) {
+
+    pos_t lcp = vtree_get_lcptab( v, i );
     
-    while ( v->lcptab[ i ] < v->lcptab[ top ] ) {
+    while ( lcp < vtree_get_lcptab( v, top ) ) {
       assert( dev_ivector_size( stack ) > 0 );
       lastIndex = pop();
       top = peek();
-      if ( v->lcptab[ i ] <= v->lcptab[ top ] && v->lcptab[ top ] != v->lcptab[ lastIndex ] ) {
-	v->childtab[ top ].down = lastIndex;
+      if ( lcp <= vtree_get_lcptab( v, top ) && vtree_get_lcptab( v, top ) != vtree_get_lcptab( v, lastIndex ) ) {
+	childtab[ top ].down = lastIndex;
       }
     }
 
     if ( lastIndex != -1 ) {
-      v->childtab[ i ].up = lastIndex;
+      childtab[ i ].up = lastIndex;
       lastIndex = -1;
     }
 
@@ -180,28 +582,30 @@ create_childtab_updown( vtree_t *v )
 #define peek() dev_ivector_get_last( stack )
 
 static void
-create_childtab_next( vtree_t *v )
+create_childtab_next( vtree_t *v, node_t *childtab )
 {
   ivector_t *stack = dev_new_ivector();
   pos_t lastIndex = -1;
   pos_t top = 0;
 
   for ( pos_t i=0; i <= v->length; i++ ) { /* initialization */
-    v->childtab[ i ].next = -1; 
+    childtab[ i ].next = -1; 
   }
 
   push( top );
 
   for ( pos_t i=1; i <= v->length; i++ ) {
+
+    pos_t lcp = vtree_get_lcptab( v, i );
     
-    while ( v->lcptab[ i ] < v->lcptab[ top ] ) {
+    while ( lcp < vtree_get_lcptab( v, top ) ) {
       pop();
       top = peek();
     }
 
-    if ( v->lcptab[ i ] == v->lcptab[ top ] ) {
+    if ( lcp == vtree_get_lcptab( v, top ) ) {
       lastIndex = pop();
-      v->childtab[ lastIndex ].next = i;
+      childtab[ lastIndex ].next = i;
     }
 
     push( i );
@@ -216,15 +620,50 @@ create_childtab_next( vtree_t *v )
 #undef pop
 #undef peek
 
+/*****************************************************************
+ * compact_childtab - replaces up, down and next by a single     *
+ * field (Abouelhoda et al., section 6.5)                        *
+ *                                                               *
+ * cld[i] holds next(i) if it is defined, and down(i) otherwise. *
+ * When up(i) is defined, lcp[i-1] > lcp[i], therefore neither   *
+ * next(i-1) nor down(i-1) is defined and up(i) goes to cld[i-1].*
+ * See access_impl.h for the decoding.                           *
+ *****************************************************************/
+
+static void
+compact_childtab( vtree_t *v, node_t *childtab, vtree_builder_t *b )
+{
+  pos_t *cld = ( pos_t * ) work_alloc( b, ( v->length + 1 ) * sizeof( pos_t ) );
+
+  for ( pos_t i=0; i <= v->length; i++ )
+    cld[ i ] = childtab[ i ].next != -1 ? childtab[ i ].next : childtab[ i ].down;
+
+  for ( pos_t i=1; i <= v->length; i++ )
+    if ( childtab[ i ].up != -1 ) {
+      assert( cld[ i-1 ] == -1 );
+      cld[ i-1 ] = childtab[ i ].up;
+    }
+
+  v->childtab = store_table( v, VTREE_CHILDTAB, v->childtab, cld, v->length + 1, b );
+
+  if ( v->childtab != cld )
+    work_free( b, cld );
+}
+
 /*****************************************************************
  * create_childtab - create the child-table                      *
  *****************************************************************/
 
 static inline void
-create_childtab( vtree_t *v )
+create_childtab( vtree_t *v, vtree_builder_t *b )
 {
-  create_childtab_updown( v );
-  create_childtab_next( v );
+  node_t *childtab = ( node_t * ) work_alloc( b, ( v->length + 1 ) * sizeof( node_t ) );
+
+  create_childtab_updown( v, childtab );
+  create_childtab_next( v, childtab );
+  compact_childtab( v, childtab, b );
+
+  work_free( b, childtab );
 }
 
 /*****************************************************************
@@ -237,49 +676,44 @@ create_bw_array( vtree_t *v )
 {
    pos_t i;
 
+   if ( ! ( v->embedded & VTREE_BWTAB ) )
+     v->bwtab = ( symbol_t * ) dev_malloc( ( v->length + 1 ) * sizeof( symbol_t ) );
+
    for( i = 0; i < v->length; i++ ) {
 
-      if( v->suftab[ i ] == 0 )
+      pos_t pos = vtree_get_suftab( v, i );
+
+      if( pos == 0 )
 	v->bwtab[ i ] = -1;
       else
-	v->bwtab[ i ] = v->text[ v->suftab[ i ] - 1 ];
+	v->bwtab[ i ] = v->text[ pos - 1 ];
    }
 }
 
 /*****************************************************************
- * create_lcp_array - creates LCP array for adjacent prefixes    *
- *                                                               *
+ * set_lcp - stores an lcp-value, the large ones are appended to *
+ * the exception table                                           *
+ * capacity : allocated size of the exception table              *
  *****************************************************************/
 
-static void 
-create_lcp_array( vtree_t *v )
+static inline void
+set_lcp( vtree_t *v, pos_t i, pos_t lcp, pos_t *capacity )
 {
-   pos_t i, adjlcp = 0, prev;
-
-   v->lcptab[ 0 ] = 0; /* by definition */
-   v->lcptab[ v->length ] = 0;
-
-   for( i = 0; i < v->length; i++ ) {
-
-      if( v->isuftab[ i ] > 0 ) {
-
-         /* Obtain the adjacent (previous) suffix in the suffix array */
-
-         prev = v->suftab[ v->isuftab[ i ] - 1 ];
-
-         /* By Kasai's Theorem 1, only need to start comparing at lcp */
+  if ( lcp < VTREE_LCP_MAX ) {
+    v->lcptab[ i ] = ( uint8_t ) lcp;
+    return;
+  }
 
-         while( v->text[ i + adjlcp ] == v->text[ prev + adjlcp ] ) {
-	   adjlcp++;
-         }
+  v->lcptab[ i ] = VTREE_LCP_MAX;
 
-         v->lcptab[ v->isuftab[ i ] ] = adjlcp;
+  if ( v->lcpexc_size == *capacity ) {
+    *capacity = 2 * *capacity + 16;
+    v->lcpexc = ( lcp_exception_t * ) dev_realloc( v->lcpexc, *capacity * sizeof( lcp_exception_t ) );
+  }
 
-         if( adjlcp > 0 ) {
-	   adjlcp--;
-         }
-      }
-   }
+  v->lcpexc[ v->lcpexc_size ].i = i;
+  v->lcpexc[ v->lcpexc_size ].lcp = lcp;
+  v->lcpexc_size++;
 }
 
 /*****************************************************************
@@ -287,7 +721,7 @@ create_lcp_array( vtree_t *v )
  *****************************************************************/
 
 static inline int
-leq2( int a1, int a2, int b1, int b2 )
+leq2( pos_t a1, pos_t a2, pos_t b1, pos_t b2 )
 {
   return ( ( a1 < b1 ) || ( a1 == b1 && a2 <= b2 ) );
 }
@@ -297,7 +731,7 @@ leq2( int a1, int a2, int b1, int b2 )
  *****************************************************************/
 
 static inline int
-leq3( int a1, int a2, int a3, int b1, int b2, int b3 )
+leq3( pos_t a1, pos_t a2, pos_t a3, pos_t b1, pos_t b2, pos_t b3 )
 {
   return ( ( a1 < b1 ) || ( a1 == b1 && leq2( a2, a3, b2, b3 ) ) );
 }
@@ -312,219 +746,1706 @@ leq3( int a1, int a2, int a3, int b1, int b2, int b3 )
  *****************************************************************/
 
 static void
-radix_pass( pos_t *a, pos_t *b, pos_t *r, int n, int K )
+radix_pass( pos_t *a, pos_t *b, pos_t *r, pos_t n, pos_t K )
 {
+  pos_t *c = ( pos_t * ) dev_malloc( ( K+1 ) * sizeof( pos_t ) ); /* K is up to n/3 */
 
-  pos_t c[ K+1 ];
-
-  for ( int i=0; i<=K; i++ ) /* reset counters */
+  for ( pos_t i=0; i<=K; i++ ) /* reset counters */
     c[ i ] = 0;
 
-  for ( int i=0; i<n; i++ ) /* count occurrences */
+  for ( pos_t i=0; i<n; i++ ) /* count occurrences */
     c[ r[ a[ i ] ] ]++;
 
-  for ( int i=0, sum=0; i<=K; i++ ) { /* exclusive prefix sum */
-    int t = c[ i ];
+  for ( pos_t i=0, sum=0; i<=K; i++ ) { /* exclusive prefix sum */
+    pos_t t = c[ i ];
     c[ i ] = sum;
     sum += t;
   }
 
-  for ( int i=0; i<n; i++ ) /* sorting */
+  for ( pos_t i=0; i<n; i++ ) /* sorting */
     b[ c[ r[ a[ i ] ] ]++ ] = a[ i ];
+
+  dev_free( c );
 }
 
 /*****************************************************************
- * create_suffix_array -                                         *
- * s : source array                                              *
- * SA : suffix array                                             *
- * ra : rank array                                               *
- * n : suffix array length                                       *
- * k : number of keys (size of the alphabet)                     *
- *                                                               *
- * Note that this function is invoked recursively.               *
+ * Parallel construction - every pass splits its input into      *
+ * contiguous blocks, one per thread.  The blocks are processed  *
+ * in the same order as the serial code would, therefore the     *
+ * parallel passes produce exactly the same arrays.              *
  *****************************************************************/
 
-static void
-skew( pos_t *s, pos_t *SA, pos_t *ra, int n, int K )
+/*****************************************************************
+ * threads_for - number of threads for a pass over n elements    *
+ *****************************************************************/
+
+static inline int
+threads_for( pos_t n )
 {
-  pos_t n0 = ( n+2 )/3; /* number of mod 0 suffixes */
-  pos_t n1 = ( n+1 )/3; /* number of mod 1 suffixes */
-  pos_t n2 = n/3;       /* number of mod 2 suffixes */
-  pos_t n02 = n0+n2;
+  return n < VTREE_PAR_MIN_LENGTH ? 1 : num_threads;
+}
 
-  pos_t *s12, *SA12; /* arrays for the mod 1 and mod 2 suffixes */
-  pos_t *s0, *SA0; /* arrays for mod 0 suffixes */
+/*****************************************************************
+ * radix_arg_t - shared state of a parallel radix pass           *
+ *****************************************************************/
 
-  s12 = ( pos_t * ) dev_malloc( ( n02 + 3 ) * sizeof( pos_t ) );
-  s12[ n02 ] = s12[ n02+1 ] = s12[ n02+2 ] = 0;
+typedef struct {
+  pos_t *a, *b, *r;
+  pos_t n, K;
+  pos_t *c; /* one row of K+1 counters per thread */
+} radix_arg_t;
 
-  SA12 = ( pos_t * ) dev_malloc( ( n02 + 3 ) * sizeof( pos_t ) );
-  SA12[ n02 ] = SA12[ n02+1 ] = SA12[ n02+2 ] = 0;
+/*****************************************************************
+ * radix_count - counts the keys of one block                    *
+ *****************************************************************/
 
-  s0 = ( pos_t * ) dev_malloc( n0 * sizeof( pos_t ) );
-  SA0 = ( pos_t * ) dev_malloc( n0 * sizeof( pos_t ) );
+static void
+radix_count( int id, int nt, void *p )
+{
+  radix_arg_t *arg = ( radix_arg_t * ) p;
+  pos_t *c = arg->c + ( long ) id * ( arg->K+1 );
+  pos_t lo, hi;
 
-  /* Generate the positions of the suffixes that are mod 1 and mod 2 */
+  dev_block_range( id, nt, arg->n, &lo, &hi );
 
-  for ( int i = 0, j = 0; i < n+( n0-n1 ); i++ ) {
-    if ( i%3 != 0 ) {
-      s12[ j++ ] = i;
-    }
-  }
+  for ( pos_t i=0; i<=arg->K; i++ )
+    c[ i ] = 0;
 
-  /* Sort s12 triples based on s[ i+2 ] */
-  radix_pass( s12, SA12, s + 2, n02, K );
-   
-  /* Sort SA12 triples based on s[ i+1 ] */
-  radix_pass( SA12, s12, s + 1, n02, K );
+  for ( pos_t i=lo; i<hi; i++ )
+    c[ arg->r[ arg->a[ i ] ] ]++;
+}
 
-  /* Sort s12 triples based on s[ i ] */
-  radix_pass( s12, SA12, s, n02, K );
+/*****************************************************************
+ * radix_scatter - moves the elements of one block to their      *
+ * final position                                                *
+ *****************************************************************/
 
-  /* Find the lexicographic names of the triples */
+static void
+radix_scatter( int id, int nt, void *p )
+{
+  radix_arg_t *arg = ( radix_arg_t * ) p;
+  pos_t *c = arg->c + ( long ) id * ( arg->K+1 );
+  pos_t lo, hi;
 
-  int name = 0, c0 = -1, c1 = -1, c2 = -1;
+  dev_block_range( id, nt, arg->n, &lo, &hi );
 
-  for ( int i=0;  i<n02;  i++ ) {
+  for ( pos_t i=lo; i<hi; i++ )
+    arg->b[ c[ arg->r[ arg->a[ i ] ] ]++ ] = arg->a[ i ];
+}
 
-    if ( s[ SA12[ i ] ]!=c0 || s[ SA12[ i ]+1 ]!=c1 || s[ SA12 [ i ]+ 2 ]!=c2 ) { 
-      name++;
-      c0 = s[ SA12[ i ] ];
-      c1 = s[ SA12[ i ]+1 ];
-      c2 = s[ SA12[ i ]+2 ];
+/*****************************************************************
+ * sort_pass - stable counting sort of a into b, in parallel for *
+ * large arrays                                                  *
+ *                                                               *
+ * The counters of key k for block t start after all the keys   *
+ * smaller than k and after the keys k of the blocks 0..t-1,     *
+ * hence the pass is stable.  The number of threads is reduced   *
+ * when the alphabet is large so that the counters never need    *
+ * more than 2n cells.                                           *
+ *****************************************************************/
+
+static void
+sort_pass( pos_t *a, pos_t *b, pos_t *r, pos_t n, pos_t K )
+{
+  int nt = threads_for( n );
+  radix_arg_t arg;
+  long sum = 0;
+
+  nt = ( int ) MIN( ( long ) nt, 2L * n / ( K+1 ) );
+
+  if ( nt <= 1 ) {
+    radix_pass( a, b, r, n, K );
+    return;
+  }
+
+  arg.a = a;
+  arg.b = b;
+  arg.r = r;
+  arg.n = n;
+  arg.K = K;
+  arg.c = ( pos_t * ) dev_malloc( ( long ) nt * ( K+1 ) * sizeof( pos_t ) );
+
+  dev_parallel_run( nt, radix_count, &arg );
+
+  for ( pos_t k=0; k<=K; k++ ) /* exclusive prefix sum, key major */
+    for ( int t=0; t<nt; t++ ) {
+      pos_t *c = arg.c + ( long ) t * ( K+1 ) + k;
+      pos_t count = *c;
+      *c = sum;
+      sum += count;
     }
 
+  dev_parallel_run( nt, radix_scatter, &arg );
+
+  dev_free( arg.c );
+}
+
+/*****************************************************************
+ * name_arg_t - shared state of the parallel naming of triples   *
+ *****************************************************************/
+
+typedef struct {
+  pos_t *s, *s12, *SA12;
+  pos_t n02, n0;
+  char *head; /* TRUE if the triple differs from its predecessor */
+  pos_t *base; /* number of names before each block */
+} name_arg_t;
+
+/*****************************************************************
+ * name_heads - marks the first triple of each group             *
+ *****************************************************************/
+
+static void
+name_heads( int id, int nt, void *p )
+{
+  name_arg_t *arg = ( name_arg_t * ) p;
+  pos_t *s = arg->s, *SA12 = arg->SA12;
+  pos_t lo, hi, count = 0;
+
+  dev_block_range( id, nt, arg->n02, &lo, &hi );
+
+  for ( pos_t i=lo; i<hi; i++ ) {
+    arg->head[ i ] = i == 0 ||
+      s[ SA12[ i ] ] != s[ SA12[ i-1 ] ] ||
+      s[ SA12[ i ]+1 ] != s[ SA12[ i-1 ]+1 ] ||
+      s[ SA12[ i ]+2 ] != s[ SA12[ i-1 ]+2 ];
+    count += arg->head[ i ];
+  }
+
+  arg->base[ id ] = count;
+}
+
+/*****************************************************************
+ * name_assign - stores the names of one block into s12          *
+ *****************************************************************/
+
+static void
+name_assign( int id, int nt, void *p )
+{
+  name_arg_t *arg = ( name_arg_t * ) p;
+  pos_t *SA12 = arg->SA12;
+  pos_t lo, hi, name = arg->base[ id ];
+
+  dev_block_range( id, nt, arg->n02, &lo, &hi );
+
+  for ( pos_t i=lo; i<hi; i++ ) {
+
+    name += arg->head[ i ];
+
     if ( SA12[ i ] % 3 == 1)
-      s12[ SA12[ i ]/3 ] = name; /* left half */
+      arg->s12[ SA12[ i ]/3 ] = name; /* left half */
+    else
+      arg->s12[ SA12[ i ]/3 + arg->n0 ] = name; /* right half */
+  }
+}
+
+/*****************************************************************
+ * name_triples - finds the lexicographic names of the sorted    *
+ * triples                                                       *
+ * return : the highest name                                     *
+ *****************************************************************/
+
+static pos_t
+name_triples( pos_t *s, pos_t *s12, pos_t *SA12, pos_t n02, pos_t n0 )
+{
+  int nt = threads_for( n02 );
+  name_arg_t arg;
+  pos_t name = 0;
+
+  if ( nt <= 1 ) {
+
+    pos_t c0 = -1, c1 = -1, c2 = -1;
+
+    for ( pos_t i=0;  i<n02;  i++ ) {
+
+      if ( s[ SA12[ i ] ]!=c0 || s[ SA12[ i ]+1 ]!=c1 || s[ SA12 [ i ]+ 2 ]!=c2 ) { 
+	name++;
+	c0 = s[ SA12[ i ] ];
+	c1 = s[ SA12[ i ]+1 ];
+	c2 = s[ SA12[ i ]+2 ];
+      }
+
+      if ( SA12[ i ] % 3 == 1)
+	s12[ SA12[ i ]/3 ] = name; /* left half */
+      else
+	s12[ SA12[ i ]/3 + n0 ] = name; /* right half */
+
+    }
+
+    return name;
+  }
+
+  arg.s = s;
+  arg.s12 = s12;
+  arg.SA12 = SA12;
+  arg.n02 = n02;
+  arg.n0 = n0;
+  arg.head = ( char * ) dev_malloc( n02 );
+  arg.base = ( pos_t * ) dev_malloc( nt * sizeof( pos_t ) );
+
+  dev_parallel_run( nt, name_heads, &arg );
+
+  for ( int t=0; t<nt; t++ ) {
+    pos_t count = arg.base[ t ];
+    arg.base[ t ] = name;
+    name += count;
+  }
+
+  dev_parallel_run( nt, name_assign, &arg );
+
+  dev_free( arg.base );
+  dev_free( arg.head );
+
+  return name;
+}
+
+/*****************************************************************
+ * merge_arg_t - shared state of the merge of the sorted mod 0   *
+ * and mod 1-2 suffixes                                          *
+ *****************************************************************/
+
+typedef struct {
+  pos_t *s, *s12, *SA12, *SA0, *SA, *ra;
+  pos_t n, n0, n02;
+  pos_t t0; /* first non-dummy entry of SA12 */
+} merge_arg_t;
+
+/*****************************************************************
+ * pos12 - text position of the t-th sorted mod 1-2 suffix       *
+ *****************************************************************/
+
+static inline pos_t
+pos12( merge_arg_t *arg, pos_t t )
+{
+  pos_t *SA12 = arg->SA12;
+
+  return SA12[ t ] < arg->n0 ? SA12[ t ] * 3 + 1 : ( SA12[ t ] - arg->n0 ) * 3 + 2;
+}
+
+/*****************************************************************
+ * less12 - true if the t-th mod 1-2 suffix is smaller than the  *
+ * p-th mod 0 suffix                                             *
+ *****************************************************************/
+
+static inline int
+less12( merge_arg_t *arg, pos_t t, pos_t p )
+{
+  pos_t *s = arg->s, *s12 = arg->s12, *SA12 = arg->SA12;
+  pos_t n0 = arg->n0;
+  pos_t i = pos12( arg, t ); /* pos of current offset 12 suffix */
+  pos_t j = arg->SA0[ p ]; /* pos of current offset 0 suffix */
+
+  return SA12[ t ] < n0 ?
+    leq2( s[ i ], s12[ SA12[ t ] + n0 ], s[ j ], s12[ j/3 ] ) :
+    leq3( s[ i ], s[ i + 1 ], s12[ SA12[ t ] - n0 + 1 ], s[ j ], s[ j + 1 ], s12[ j/3 + n0 ] );
+}
+
+/*****************************************************************
+ * merge_split - number of mod 1-2 suffixes among the k smallest *
+ * suffixes (binary search along the merge path)                 *
+ *****************************************************************/
+
+static pos_t
+merge_split( merge_arg_t *arg, pos_t k )
+{
+  pos_t nA = arg->n02 - arg->t0, nB = arg->n0;
+  pos_t lo = MAX( 0, k - nB ), hi = MIN( k, nA );
+
+  while ( lo < hi ) {
+    pos_t mid = ( lo+hi )/2;
+    if ( less12( arg, arg->t0 + mid, k - mid - 1 ) )
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+/*****************************************************************
+ * merge_block - merges the suffixes of ranks lo..hi-1, fills    *
+ * both SA and the rank array                                    *
+ *****************************************************************/
+
+static void
+merge_block( int id, int nt, void *p )
+{
+  merge_arg_t *arg = ( merge_arg_t * ) p;
+  pos_t lo, hi, t, q;
+
+  dev_block_range( id, nt, arg->n, &lo, &hi );
+
+  t = merge_split( arg, lo );
+  q = lo - t;
+  t += arg->t0;
+
+  for ( pos_t k=lo; k<hi; k++ ) {
+    pos_t i;
+    if ( q == arg->n0 || ( t < arg->n02 && less12( arg, t, q ) ) )
+      i = pos12( arg, t++ ); /* suffix from SA12 is smaller */
     else
-      s12[ SA12[ i ]/3 + n0 ] = name; /* right half */
+      i = arg->SA0[ q++ ]; /* suffix from SA0 is smaller */
+    arg->SA[ k ] = i;
+    arg->ra[ i ] = k;
+  }
+}
+
+/*****************************************************************
+ * create_suffix_array -                                         *
+ * s : source array                                              *
+ * SA : suffix array                                             *
+ * ra : rank array                                               *
+ * n : suffix array length                                       *
+ * k : number of keys (size of the alphabet)                     *
+ *                                                               *
+ * Note that this function is invoked recursively.               *
+ *****************************************************************/
+
+static void
+skew( pos_t *s, pos_t *SA, pos_t *ra, pos_t n, pos_t K, vtree_builder_t *b )
+{
+  pos_t n0 = ( n+2 )/3; /* number of mod 0 suffixes */
+  pos_t n1 = ( n+1 )/3; /* number of mod 1 suffixes */
+  pos_t n2 = n/3;       /* number of mod 2 suffixes */
+  pos_t n02 = n0+n2;
+
+  pos_t *s12, *SA12; /* arrays for the mod 1 and mod 2 suffixes */
+  pos_t *s0, *SA0; /* arrays for mod 0 suffixes */
+
+  /* The merge below assumes at least one mod 1 suffix */
+
+  if ( n == 1 ) {
+    SA[ 0 ] = ra[ 0 ] = 0;
+    return;
+  }
+
+  s12 = ( pos_t * ) work_alloc( b, ( n02 + 3 ) * sizeof( pos_t ) );
+  s12[ n02 ] = s12[ n02+1 ] = s12[ n02+2 ] = 0;
+
+  SA12 = ( pos_t * ) work_alloc( b, ( n02 + 3 ) * sizeof( pos_t ) );
+  SA12[ n02 ] = SA12[ n02+1 ] = SA12[ n02+2 ] = 0;
+
+  s0 = ( pos_t * ) work_alloc( b, n0 * sizeof( pos_t ) );
+  SA0 = ( pos_t * ) work_alloc( b, n0 * sizeof( pos_t ) );
+
+  /* Generate the positions of the suffixes that are mod 1 and mod 2 */
 
+  for ( pos_t i = 0, j = 0; i < n+( n0-n1 ); i++ ) {
+    if ( i%3 != 0 ) {
+      s12[ j++ ] = i;
+    }
   }
 
+  /* Sort s12 triples based on s[ i+2 ] */
+  sort_pass( s12, SA12, s + 2, n02, K );
+   
+  /* Sort SA12 triples based on s[ i+1 ] */
+  sort_pass( SA12, s12, s + 1, n02, K );
+
+  /* Sort s12 triples based on s[ i ] */
+  sort_pass( s12, SA12, s, n02, K );
+
+  /* Find the lexicographic names of the triples */
+
+  pos_t name = name_triples( s, s12, SA12, n02, n0 );
+
   /* If the highest name assigned is less than the size of the mod 2 
    * suffix array, recursively apply skew. 
    */
 
   if( name < n02 ) {
 
-    skew( s12, SA12, ra, n02, name );
+    skew( s12, SA12, ra, n02, name, b );
 
-    for( int i = 0; i < n02; i++ )
+    for( pos_t i = 0; i < n02; i++ )
       s12[ SA12[ i ] ] = i + 1;
 
   } else {
       
     /* Generate the suffix array from the name array */
-    for( int i=0; i<n02; i++ )
+    for( pos_t i=0; i<n02; i++ )
       SA12[ s12[ i ] - 1 ] = i;
 
   }
 
   /* Now sort the mod 0 suffixes */
 
-  for( int i=0, j=0; i < n02; i++ ) {
+  for( pos_t i=0, j=0; i < n02; i++ ) {
     if( SA12[ i ] < n0 ) {
       s0[ j++ ] = 3*SA12[ i ];
     }
   }
 
-  radix_pass( s0, SA0, s, n0, K );
+  sort_pass( s0, SA0, s, n0, K );
 
   /* Merge the sorted SA0 and sorted SA12 suffixes */
 
-  for ( int p = 0, t = n0 - n1, k = 0; k < n; k++ ) {
-
-#define GetI() ( SA12[ t ] < n0 ? SA12[ t ] * 3 + 1 : ( SA12[ t ] - n0 ) * 3 + 2 )
-
-    int i = GetI(); /* pos of current offset 12 suffix */
-    int j = SA0[ p ]; /* pos of current offset 0 suffix */
-
-    if ( SA12[ t ] < n0 ?
-	leq2( s[ i ], s12[ SA12[ t ] + n0 ], s[ j ], s12[ j/3 ] ) :
-	leq3( s[ i ], s[ i + 1 ], s12[ SA12[ t ] - n0 + 1 ], s[ j ], s[ j + 1 ], s12[ j/3 + n0 ] ) ) {
-      /* Suffix from SA12 is smaller */
-      SA[ k ] = i;
-      ra[ i ] = k;
-      t++;
-      if ( t == n02 ) {	/* done - only SA0 suffixes left */
-	for ( k++; p < n0; k++, p++ ) {
-	  SA[ k ] = SA0[ p ];
-	  ra[ SA0[ p ] ] = k; /* set the rank array too */
-	}
-      }
+  merge_arg_t arg = { s, s12, SA12, SA0, SA, ra, n, n0, n02, n0 - n1 };
 
-    } else { /* Suffix from SA0 is smaller */
+  dev_parallel_run( threads_for( n ), merge_block, &arg );
 
-      SA[ k ] = j;
-      ra[ j ] = k;
-      p++;
-      
-      if ( p == n0 ) { /* done - only SA12 suffixes left */
-	for ( k++; t < n02; k++, t++ ) {
-	      SA[ k ] = GetI();
-	      ra[ GetI() ] = k; /* set the rank array too */
-	}
-      }
+  work_free( b, SA0 );
+  work_free( b, s0 );
+  work_free( b, SA12 );
+  work_free( b, s12 );
+}
+
+/*****************************************************************
+ * lcp_arg_t - shared state of the parallel lcp construction     *
+ *****************************************************************/
+
+typedef struct {
+  vtree_t *v;
+  pos_t *plcp; /* phi, then the permuted lcp array */
+} lcp_arg_t;
+
+/*****************************************************************
+ * lcp_phi - phi[ suftab[ k ] ] = suftab[ k-1 ] for the ranks k   *
+ * of one block                                                  *
+ *****************************************************************/
+
+static void
+lcp_phi( int id, int nt, void *p )
+{
+  lcp_arg_t *arg = ( lcp_arg_t * ) p;
+  vtree_t *v = arg->v;
+  pos_t lo, hi;
+
+  dev_block_range( id, nt, v->length, &lo, &hi );
+
+  for ( pos_t k=lo; k<hi; k++ )
+    arg->plcp[ vtree_get_suftab( v, k ) ] = k == 0 ? -1 : vtree_get_suftab( v, k-1 );
+}
+
+/*****************************************************************
+ * lcp_plcp - replaces phi[ i ] by the lcp of the suffix i and   *
+ * its predecessor, for the positions i of one block             *
+ *                                                               *
+ * The text is scanned left to right, plcp[ i ] >= plcp[ i-1 ]-1 *
+ * hence the comparisons start at the previous value minus one.  *
+ * A block starts from 0, which is a valid lower bound.          *
+ *****************************************************************/
+
+static void
+lcp_plcp( int id, int nt, void *p )
+{
+  lcp_arg_t *arg = ( lcp_arg_t * ) p;
+  symbol_t *text = arg->v->text;
+  pos_t l = 0;
+  pos_t lo, hi;
+
+  dev_block_range( id, nt, arg->v->length, &lo, &hi );
+
+  for ( pos_t i=lo; i<hi; i++ ) {
+
+    pos_t j = arg->plcp[ i ];
+
+    if ( j < 0 ) {
+      arg->plcp[ i ] = l = 0;
+      continue;
     }
-  }
 
-  free( s12 );
-  free( SA12 );
-  free( SA0 );
-  free( s0 );
+    while ( text[ i + l ] == text[ j + l ] )
+      l++;
+
+    arg->plcp[ i ] = l;
+
+    if ( l > 0 )
+      l--;
+  }
 }
 
 /*****************************************************************
- * create_suffix_array -                                         *
+ * lcp_store - lcptab[ k ] = plcp[ suftab[ k ] ] for the ranks k  *
+ * of one block, the large values are marked VTREE_LCP_MAX       *
  *****************************************************************/
 
-static inline void
-create_suffix_array( vtree_t *v , dstring_t *dtext )
+static void
+lcp_store( int id, int nt, void *p )
 {
-  skew( v->text,
-	v->suftab,
-	v->isuftab,
-	dtext->length,
-	dtext->alphabet->size );
+  lcp_arg_t *arg = ( lcp_arg_t * ) p;
+  vtree_t *v = arg->v;
+  pos_t lo, hi;
+
+  dev_block_range( id, nt, v->length, &lo, &hi );
+
+  for ( pos_t k=lo; k<hi; k++ ) {
+    pos_t lcp = arg->plcp[ vtree_get_suftab( v, k ) ];
+    v->lcptab[ k ] = lcp < VTREE_LCP_MAX ? ( uint8_t ) lcp : VTREE_LCP_MAX;
+  }
 }
 
 /*****************************************************************
- * vtree_create - creates a suffix array and associated tables   *
- * dtext : a digital string                                      *
+ * create_lcp_array - creates LCP array for adjacent prefixes    *
+ * b : a builder providing the workspace, or NULL                *
  *                                                               *
- * 1. Generate the suffix array and associated data structures   *
- *    based upon the input string;                               *
+ * The Phi algorithm of Karkkainen, Manzini and Puglisi replaces *
+ * Kasai's: phi[ i ] is the suffix that precedes the suffix i in *
+ * suftab, the lcp-values are computed in text order, from the   *
+ * text and phi that are both read sequentially, and permuted    *
+ * into rank order at the end.  Only suftab is used, isuftab is  *
+ * not needed.  Each pass is split into blocks for the threads.  *
+ * The exceptions are collected in rank order, thus sorted.      *
+ *****************************************************************/
+
+static void
+create_lcp_array( vtree_t *v, vtree_builder_t *b )
+{
+  pos_t n = v->length, capacity = 0;
+  int nt = threads_for( n );
+  lcp_arg_t arg;
+
+  if ( ! ( v->embedded & VTREE_LCPTAB ) )
+    v->lcptab = ( uint8_t * ) dev_malloc( ( n + 1 ) * sizeof( uint8_t ) );
+  v->lcpexc = NULL;
+  v->lcpexc_size = 0;
+
+  arg.v = v;
+  arg.plcp = ( pos_t * ) work_alloc( b, ( n + 1 ) * sizeof( pos_t ) );
+
+  dev_parallel_run( nt, lcp_phi, &arg );
+  dev_parallel_run( nt, lcp_plcp, &arg );
+  dev_parallel_run( nt, lcp_store, &arg );
+
+  v->lcptab[ 0 ] = 0; /* by definition */
+  v->lcptab[ n ] = 0;
+
+  for ( pos_t k=1; k<n; k++ )
+    if ( v->lcptab[ k ] == VTREE_LCP_MAX )
+      set_lcp( v, k, arg.plcp[ vtree_get_suftab( v, k ) ], &capacity );
+
+  if ( v->lcpexc_size > 0 )
+    v->lcpexc = ( lcp_exception_t * ) dev_realloc( v->lcpexc, v->lcpexc_size * sizeof( lcp_exception_t ) );
+
+  work_free( b, arg.plcp );
+}
+
+/*****************************************************************
+ * create_rmqtab - creates the range minimum query index of the  *
+ * lcp table                                                     *
  *                                                               *
- * 2. Generate a treap and associated data structures based upon *
- *    the adjacent LCP array of the suffix tree;                 *
+ * Row 0 holds the minimum of each block, row k the minimum of   *
+ * the rows k-1 of two blocks 2^(k-1) apart.  The exceptions are *
+ * looked up only for the blocks whose values all exceed         *
+ * VTREE_LCP_MAX - 1.                                            *
+ *****************************************************************/
+
+static void
+create_rmqtab( vtree_t *v )
+{
+  rmq_t *rmq = ( rmq_t * ) dev_malloc( sizeof( rmq_t ) );
+  pos_t n = v->length + 1, *row;
+  int block = rmq_block > 0 ? rmq_block : VTREE_RMQ_BLOCK;
+
+  rmq->block = block;
+  rmq->num_blocks = ( n + block - 1 ) / block;
+
+  rmq->levels = 1;
+  while ( ( ( pos_t ) 1 << rmq->levels ) <= rmq->num_blocks )
+    rmq->levels++;
+
+  rmq->minima = ( pos_t * ) dev_malloc( ( long ) rmq->levels * rmq->num_blocks * sizeof( pos_t ) );
+
+  for ( pos_t b=0; b<rmq->num_blocks; b++ ) {
+
+    pos_t lo = b * block, hi = MIN( lo + block, n ), min = VTREE_LCP_MAX;
+
+    for ( pos_t k=lo; k<hi; k++ )
+      if ( v->lcptab[ k ] < min )
+	min = v->lcptab[ k ];
+
+    if ( min == VTREE_LCP_MAX ) {
+      min = vtree_lcp_exception( v, lo );
+      for ( pos_t k=lo+1; k<hi; k++ )
+	min = MIN( min, vtree_lcp_exception( v, k ) );
+    }
+
+    rmq->minima[ b ] = min;
+  }
+
+  row = rmq->minima;
+
+  for ( int l=1; l<rmq->levels; l++ ) {
+
+    pos_t half = ( pos_t ) 1 << ( l-1 );
+
+    for ( pos_t b=0; b + 2*half <= rmq->num_blocks; b++ )
+      row[ rmq->num_blocks + b ] = MIN( row[ b ], row[ b + half ] );
+
+    row += rmq->num_blocks;
+  }
+
+  v->rmqtab = rmq;
+}
+
+/*****************************************************************
+ * create_kmertab - creates the prefix table                     *
  *                                                               *
- * 3. Using the treap information, generate all of the rmq data  *
- *    structures required to perform RMQ queries on the adjacent *
- *    LCP array.                                                 *
+ * The symbols of the text are numbered in increasing order,     *
+ * hence the k-mers in lexicographic order.  The suffixes that   *
+ * share a k-mer are consecutive in suftab, which is scanned     *
+ * once; those that end before k symbols, or contain a           *
+ * terminator, are not indexed.                                  *
  *****************************************************************/
 
-vtree_t *
-vtree_create( dstring_t *dtext )
+static void
+create_kmertab( vtree_t *v )
 {
-  vtree_t *v;
+  kmer_table_t *t = ( kmer_table_t * ) dev_malloc( sizeof( kmer_table_t ) );
+  pos_t n = v->length;
+  int size = v->alphabet_size - ( v->num_seqs - 1 ); /* smallest terminator */
+  long entries;
 
-  v = vtree_init( dtext );
+  t->code_size = size;
+  t->code = ( int * ) dev_malloc( size * sizeof( int ) );
 
-  create_suffix_array( v, dtext );
+  for ( int a=0; a<size; a++ )
+    t->code[ a ] = -1;
 
-  create_lcp_array( v );
+  for ( pos_t p=0; p<n; p++ )
+    if ( v->text[ p ] >= 0 && v->text[ p ] < size )
+      t->code[ v->text[ p ] ] = 0;
 
-  create_bw_array( v );
+  t->sigma = 0;
 
-  create_childtab( v );
+  for ( int a=0; a<size; a++ )
+    if ( t->code[ a ] == 0 )
+      t->code[ a ] = t->sigma++;
 
-  /*
-   * TREAP_createTreap( suffInfo->adjLcpArray, suffInfo->len, treapInfo );
-   * 
-   * TREAP_eulerTour( treapInfo );
-   * 
-   * RMQ_preProcessData( treapInfo->levelArray, treapInfo->arrayLen,  rmqInfo );
-   */
+  t->sigma = MAX( t->sigma, 1 );
 
-  return v;
+  /* the largest k up to kmer_length such that sigma^k <= max( n, sigma ) */
+
+  t->k = 1;
+  entries = t->sigma;
+
+  while ( t->k < MAX( kmer_length, 1 ) && entries * t->sigma <= n ) {
+    t->k++;
+    entries *= t->sigma;
+  }
+
+  t->bounds = ( pos_t * ) dev_malloc( 2 * entries * sizeof( pos_t ) );
+
+  for ( long c=0; c<entries; c++ )
+    t->bounds[ 2*c ] = -1;
+
+  for ( pos_t r=0; r<n; r++ ) {
+
+    pos_t p = vtree_get_suftab( v, r );
+    long c = 0;
+    int d;
+
+    if ( p + t->k > n )
+      continue;
+
+    for ( d=0; d<t->k; d++ ) {
+      symbol_t a = v->text[ p+d ];
+      if ( a < 0 || a >= size )
+	break;
+      c = c * t->sigma + t->code[ a ];
+    }
+
+    if ( d < t->k )
+      continue;
+
+    if ( t->bounds[ 2*c ] < 0 )
+      t->bounds[ 2*c ] = r;
+
+    t->bounds[ 2*c+1 ] = r;
+  }
+
+  v->kmertab = t;
+}
+
+/*****************************************************************
+ * create_fmtab - creates the FM-index, from suftab and bwtab    *
+ *                                                               *
+ * The rows whose suffix starts the text, or follows a           *
+ * separator, are always sampled, so that vtree_fm_locate never  *
+ * steps back over a symbol that is not counted.                 *
+ *****************************************************************/
+
+static void
+create_fmtab( vtree_t *v )
+{
+  fm_index_t *t = ( fm_index_t * ) dev_malloc( sizeof( fm_index_t ) );
+  pos_t n = v->length, *occ, num_samples = 0;
+  pos_t words = n / 64 + 1;
+  int sigma = v->alphabet_size - ( v->num_seqs - 1 );
+
+  t->sigma = sigma;
+  t->step = fm_step;
+
+  /* count[ a ] is first the number of occurrences of a - 1 */
+
+  t->count = ( pos_t * ) dev_malloc( ( sigma + 1 ) * sizeof( pos_t ) );
+
+  for ( int a=0; a<=sigma; a++ )
+    t->count[ a ] = 0;
+
+  for ( pos_t p=0; p<n; p++ )
+    if ( v->text[ p ] >= 0 && v->text[ p ] < sigma )
+      t->count[ v->text[ p ] + 1 ]++;
+
+  for ( int a=1; a<=sigma; a++ )
+    t->count[ a ] += t->count[ a-1 ];
+
+  /* occurrences in bwtab, the last sample is that of row n */
+
+  t->occ = ( pos_t * ) dev_malloc( ( ( long ) n / VTREE_FM_BLOCK + 1 ) * sigma * sizeof( pos_t ) );
+
+  occ = ( pos_t * ) dev_malloc( sigma * sizeof( pos_t ) );
+
+  for ( int a=0; a<sigma; a++ )
+    occ[ a ] = 0;
+
+  for ( pos_t r=0; r<=n; r++ ) {
+
+    if ( r % VTREE_FM_BLOCK == 0 )
+      memcpy( t->occ + ( long ) ( r / VTREE_FM_BLOCK ) * sigma, occ, sigma * sizeof( pos_t ) );
+
+    if ( r < n && v->bwtab[ r ] >= 0 && v->bwtab[ r ] < sigma )
+      occ[ v->bwtab[ r ] ]++;
+  }
+
+  dev_free( occ );
+
+  /* sampled positions */
+
+  t->sampled = ( uint64_t * ) dev_malloc( words * sizeof( uint64_t ) );
+  t->sampled_rank = ( pos_t * ) dev_malloc( words * sizeof( pos_t ) );
+
+  for ( pos_t w=0; w<words; w++ )
+    t->sampled[ w ] = 0;
+
+  for ( pos_t r=0; r<n; r++ ) {
+    symbol_t a = v->bwtab[ r ];
+    if ( vtree_get_suftab( v, r ) % t->step == 0 || a < 0 || a >= sigma ) {
+      t->sampled[ r / 64 ] |= ( uint64_t ) 1 << ( r % 64 );
+      num_samples++;
+    }
+  }
+
+  t->samples = ( pos_t * ) dev_malloc( MAX( num_samples, 1 ) * sizeof( pos_t ) );
+
+  num_samples = 0;
+
+  for ( pos_t r=0; r<n; r++ ) {
+
+    if ( r % 64 == 0 )
+      t->sampled_rank[ r / 64 ] = num_samples;
+
+    if ( t->sampled[ r / 64 ] & ( ( uint64_t ) 1 << ( r % 64 ) ) )
+      t->samples[ num_samples++ ] = vtree_get_suftab( v, r );
+  }
+
+  if ( n % 64 == 0 )
+    t->sampled_rank[ n / 64 ] = num_samples;
+
+  v->fmtab = t;
+}
+
+/*****************************************************************
+ * interval_lb, interval_rb - bounds of the lcp-interval of      *
+ * lcp-value m > 0 that contains the ranks a..b                  *
+ *                                                               *
+ * lb is the last rank k <= a with lcp[ k ] < m, rb + 1 the      *
+ * first rank k > b with lcp[ k ] < m; both exist since lcp[ 0 ] *
+ * and lcp[ n ] are 0.  The rank is approached by doubling steps *
+ * of range minimum queries, then by bisection, which costs      *
+ * O( log d ) queries for a distance d.                          *
+ *****************************************************************/
+
+static pos_t
+interval_lb( vtree_t *v, pos_t a, pos_t m )
+{
+  pos_t lo, hi = a, step = 1; /* lcp[ hi..a ] >= m */
+
+  if ( vtree_get_lcptab( v, a ) < m )
+    return a;
+
+  for ( ;; step *= 2 ) {
+    lo = MAX( hi - step, 0 );
+    if ( vtree_rmq( v, lo, hi-1 ) < m )
+      break;
+    hi = lo;
+  }
+
+  while ( lo < hi-1 ) { /* lcp[ lo..hi-1 ] has a value < m, lcp[ hi..a ] none */
+    pos_t mid = lo + ( hi - lo ) / 2;
+    if ( vtree_rmq( v, mid, hi-1 ) < m )
+      lo = mid;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+static pos_t
+interval_rb( vtree_t *v, pos_t b, pos_t m )
+{
+  pos_t lo = b+1, hi, step = 1; /* lcp[ b+1..lo-1 ] >= m */
+
+  if ( vtree_get_lcptab( v, lo ) < m )
+    return b;
+
+  for ( ;; step *= 2 ) {
+    hi = MIN( lo + step, v->length );
+    if ( vtree_rmq( v, lo+1, hi ) < m )
+      break;
+    lo = hi;
+  }
+
+  while ( lo+1 < hi ) { /* lcp[ lo+1..hi ] has a value < m, lcp[ b+1..lo ] none */
+    pos_t mid = lo + ( hi - lo ) / 2;
+    if ( vtree_rmq( v, lo+1, mid ) < m )
+      hi = mid;
+    else
+      lo = mid;
+  }
+
+  return hi-1;
+}
+
+/*****************************************************************
+ * link_interval - bottom-up visit of create_sltab               *
+ *****************************************************************/
+
+static void
+link_interval( vtree_t *v, vtree_node_t *node, vtree_node_t *parent, void *arg )
+{
+  pos_t a, b, k;
+
+  ( void ) arg; /* unused */
+
+  if ( parent == NULL ) /* the root has no suffix link */
+    return;
+
+  k = vtree_lindex( v, node->lb, node->rb );
+
+  if ( node->lcp == 1 ) {
+    v->sltab[ 2*k ] = 0;
+    v->sltab[ 2*k+1 ] = v->length;
+    return;
+  }
+
+  a = vtree_get_isuftab( v, vtree_get_suftab( v, node->lb ) + 1 );
+  b = vtree_get_isuftab( v, vtree_get_suftab( v, node->rb ) + 1 );
+
+  v->sltab[ 2*k ] = interval_lb( v, a, node->lcp - 1 );
+  v->sltab[ 2*k+1 ] = interval_rb( v, b, node->lcp - 1 );
+}
+
+/*****************************************************************
+ * create_sltab - creates the suffix links of the lcp-intervals  *
+ *                                                               *
+ * The suffix link of an lcp-interval of lcp-value l, for the    *
+ * string aw of length l, is the lcp-interval of w, of lcp-value *
+ * l-1.  It contains the successors, by isuftab, of the first    *
+ * and last suffixes of the interval, and its bounds are found   *
+ * from these two ranks with the range minimum query index.      *
+ * Each interval is identified by its first l-index, see         *
+ * vtree_lindex, and its link is stored at sltab[ 2k ] and       *
+ * sltab[ 2k+1 ].                                                *
+ *****************************************************************/
+
+static void
+create_sltab( vtree_t *v )
+{
+  vtree_bottom_up_t t = { link_interval, NULL, 0 };
+  pos_t n = v->length;
+
+  v->sltab = ( pos_t * ) dev_malloc( 2 * ( n + 1 ) * sizeof( pos_t ) );
+
+  for ( pos_t k=0; k<2*(n+1); k++ )
+    v->sltab[ k ] = -1;
+
+  vtree_bottom_up( v, &t, NULL );
+}
+
+/*****************************************************************
+ * set_node - node k of nodetab, for the interval i..j           *
+ *****************************************************************/
+
+static void
+set_node( vtree_t *v, pos_t k, pos_t i, pos_t j )
+{
+  dfs_node_t *node = v->nodetab + k;
+
+  node->lb = i;
+  node->rb = j;
+  node->label = vtree_get_suftab( v, i );
+  node->next = k+1;
+
+  if ( i == j )
+    node->lcp = v->length - node->label;
+  else
+    node->lcp = j == v->length ? 0 : vtree_getlcp( v, i, j );
+}
+
+/*****************************************************************
+ * create_nodetab - creates the node table, the lcp-interval     *
+ * tree in depth-first order                                     *
+ *                                                               *
+ * The children of each interval are those of the child table,   *
+ * in the same order.  The stack holds the iterators of the      *
+ * intervals whose subtree is not complete, each one on the      *
+ * child that comes next.  There are at most 2n+1 nodes.         *
+ *****************************************************************/
+
+static void
+create_nodetab( vtree_t *v )
+{
+  pos_t n = v->length, k = 1;
+  int size = 64, top = 0;
+  vtree_child_iter_t *stack = ( vtree_child_iter_t * ) dev_malloc( size * sizeof( vtree_child_iter_t ) );
+  pos_t *open = ( pos_t * ) dev_malloc( size * sizeof( pos_t ) );
+  int *more = ( int * ) dev_malloc( size * sizeof( int ) );
+
+  v->nodetab = ( dfs_node_t * ) dev_malloc( ( 2 * ( long ) n + 1 ) * sizeof( dfs_node_t ) );
+
+  set_node( v, 0, 0, n );
+
+  open[ 0 ] = 0;
+  more[ 0 ] = vtree_child_first( v, 0, n, &stack[ 0 ] );
+  top = 1;
+
+  while ( top > 0 ) {
+
+    pos_t i, j;
+
+    if ( ! more[ top-1 ] ) {
+      v->nodetab[ open[ --top ] ].next = k;
+      continue;
+    }
+
+    i = stack[ top-1 ].i;
+    j = stack[ top-1 ].j;
+
+    more[ top-1 ] = vtree_child_next( &stack[ top-1 ] );
+
+    set_node( v, k, i, j );
+
+    if ( i != j ) {
+
+      if ( top == size ) {
+	size *= 2;
+	stack = ( vtree_child_iter_t * ) dev_realloc( stack, size * sizeof( vtree_child_iter_t ) );
+	open = ( pos_t * ) dev_realloc( open, size * sizeof( pos_t ) );
+	more = ( int * ) dev_realloc( more, size * sizeof( int ) );
+      }
+
+      open[ top ] = k;
+      more[ top ] = vtree_child_first( v, i, j, &stack[ top ] );
+      top++;
+    }
+
+    k++;
+  }
+
+  v->num_nodes = k;
+  v->nodetab = ( dfs_node_t * ) dev_realloc( v->nodetab, k * sizeof( dfs_node_t ) );
+
+  dev_free( stack );
+  dev_free( open );
+  dev_free( more );
+}
+
+/*****************************************************************
+ * skew_workspace - upper bound on the scratch space used by the *
+ * recursion of skew for a text of length n                      *
+ *****************************************************************/
+
+static size_t
+skew_workspace( pos_t n )
+{
+  size_t size = 0;
+
+  while ( n > 1 ) {
+    pos_t n0 = ( n+2 )/3, n02 = n0 + n/3;
+    size += 2 * WORK_ALIGN( ( n02 + 3 ) * sizeof( pos_t ) ) + 2 * WORK_ALIGN( n0 * sizeof( pos_t ) );
+    n = n02;
+  }
+
+  return size;
+}
+
+/*****************************************************************
+ * create_suffix_array - dispatches to skew or SA-IS, both fill  *
+ * SA and ra identically.                                        *
+ * s, n : the string, followed by three 0, and its length        *
+ * K : largest symbol                                            *
+ *                                                               *
+ * SA-IS is inherently sequential, when more than one thread is  *
+ * available VTREE_SA_AUTO selects the parallel skew.            *
+ *****************************************************************/
+
+static inline void
+create_suffix_array( pos_t *s, pos_t n, pos_t K, pos_t *SA, pos_t *ra, vtree_builder_t *b )
+{
+  int algorithm = sa_algorithm;
+
+  if ( algorithm == VTREE_SA_AUTO )
+    algorithm = n >= VTREE_SAIS_MIN_LENGTH && threads_for( n ) == 1 ?
+      VTREE_SA_SAIS : VTREE_SA_SKEW;
+
+  if ( algorithm == VTREE_SA_SAIS )
+    vtree_sais( s, SA, ra, n, K );
+  else
+    skew( s, SA, ra, n, K, b );
+}
+
+/*****************************************************************
+ * widen_text - the text of v as pos_t, for create_suffix_array; *
+ * a copy with -DPOS64, to be released by the caller             *
+ *****************************************************************/
+
+static pos_t *
+widen_text( vtree_t *v )
+{
+  pos_t *s;
+
+  if ( sizeof( pos_t ) == sizeof( symbol_t ) )
+    return ( pos_t * ) v->text;
+
+  s = ( pos_t * ) dev_malloc( ( v->length + 3 ) * sizeof( pos_t ) );
+
+  for ( pos_t i=0; i<v->length+3; i++ )
+    s[ i ] = v->text[ i ];
+
+  return s;
+}
+
+/*****************************************************************
+ * create_suffix_tables - builds suftab and/or isuftab           *
+ *                                                               *
+ * When one of the two tables already exists, the other one is   *
+ * obtained by inverting it, otherwise the suffix array is       *
+ * constructed and the tables that were not asked for are        *
+ * discarded.                                                    *
+ *****************************************************************/
+
+static void
+create_suffix_tables( vtree_t *v, int tables, vtree_builder_t *b )
+{
+  pos_t n = v->length;
+  pos_t *SA, *ra;
+
+  if ( v->tables & VTREE_SUFTAB ) {
+
+    ra = ( pos_t * ) work_alloc( b, ( n + 1 ) * sizeof( pos_t ) );
+    for ( pos_t i=0; i<n; i++ )
+      ra[ vtree_get_suftab( v, i ) ] = i;
+    ra[ n ] = n;
+
+    v->isuftab = store_table( v, VTREE_ISUFTAB, v->isuftab, ra, n + 1, b );
+
+    if ( v->isuftab != ra )
+      work_free( b, ra );
+
+  } else if ( v->tables & VTREE_ISUFTAB ) {
+
+    SA = ( pos_t * ) work_alloc( b, ( n + 1 ) * sizeof( pos_t ) );
+    for ( pos_t i=0; i<n; i++ )
+      SA[ vtree_get_isuftab( v, i ) ] = i;
+    SA[ n ] = n;
+
+    v->suftab = store_table( v, VTREE_SUFTAB, v->suftab, SA, n + 1, b );
+
+    if ( v->suftab != SA )
+      work_free( b, SA );
+
+  } else {
+
+    SA = ( pos_t * ) work_alloc( b, ( n + 1 ) * sizeof( pos_t ) );
+    ra = ( pos_t * ) work_alloc( b, ( n + 1 ) * sizeof( pos_t ) );
+
+    pos_t *s = widen_text( v );
+
+    create_suffix_array( s, v->length, v->alphabet_size, SA, ra, b );
+
+    if ( s != ( pos_t * ) v->text )
+      dev_free( s );
+
+    SA[ n ] = ra[ n ] = n;
+
+    if ( tables & VTREE_SUFTAB )
+      v->suftab = store_table( v, VTREE_SUFTAB, v->suftab, SA, n + 1, b );
+
+    if ( tables & VTREE_ISUFTAB )
+      v->isuftab = store_table( v, VTREE_ISUFTAB, v->isuftab, ra, n + 1, b );
+
+    if ( v->isuftab != ra )
+      work_free( b, ra );
+
+    if ( v->suftab != SA )
+      work_free( b, SA );
+  }
+
+  v->tables |= tables;
+}
+
+/*****************************************************************
+ * build_tables - builds the tables that are missing             *
+ * b : a builder providing the workspace, or NULL                *
+ *****************************************************************/
+
+static void
+build_tables( vtree_t *v, int tables, vtree_builder_t *b )
+{
+  int needed, temporary;
+
+  if ( tables & VTREE_SLTAB )
+    tables |= VTREE_CHILDTAB;
+
+  if ( tables & ( VTREE_CHILDTAB | VTREE_RMQTAB ) )
+    tables |= VTREE_LCPTAB;
+
+  if ( tables & VTREE_FMTAB )
+    tables |= VTREE_BWTAB;
+
+  needed = tables;
+
+  if ( ( tables & ~v->tables ) & ( VTREE_LCPTAB | VTREE_BWTAB | VTREE_KMERTAB | VTREE_FMTAB ) )
+    needed |= VTREE_SUFTAB;
+
+  if ( tables & ~v->tables & VTREE_SLTAB )
+    needed |= VTREE_SUFTAB | VTREE_ISUFTAB | VTREE_RMQTAB;
+
+  if ( tables & ~v->tables & VTREE_NODETAB )
+    needed |= VTREE_SUFTAB | VTREE_LCPTAB | VTREE_CHILDTAB;
+
+  temporary = needed & ~tables & ~v->tables;
+
+  if ( needed & ~v->tables & ( VTREE_SUFTAB | VTREE_ISUFTAB ) )
+    create_suffix_tables( v, needed & ~v->tables & ( VTREE_SUFTAB | VTREE_ISUFTAB ), b );
+
+  if ( needed & ~v->tables & VTREE_LCPTAB ) {
+    create_lcp_array( v, b );
+    v->tables |= VTREE_LCPTAB;
+  }
+
+  if ( needed & ~v->tables & VTREE_BWTAB ) {
+    create_bw_array( v );
+    v->tables |= VTREE_BWTAB;
+  }
+
+  if ( needed & ~v->tables & VTREE_CHILDTAB ) {
+    create_childtab( v, b );
+    v->tables |= VTREE_CHILDTAB;
+  }
+
+  if ( needed & ~v->tables & VTREE_RMQTAB ) {
+    create_rmqtab( v );
+    v->tables |= VTREE_RMQTAB;
+  }
+
+  if ( needed & ~v->tables & VTREE_KMERTAB ) {
+    create_kmertab( v );
+    v->tables |= VTREE_KMERTAB;
+  }
+
+  if ( needed & ~v->tables & VTREE_FMTAB ) {
+    create_fmtab( v );
+    v->tables |= VTREE_FMTAB;
+  }
+
+  if ( needed & ~v->tables & VTREE_SLTAB ) {
+    create_sltab( v );
+    v->tables |= VTREE_SLTAB;
+  }
+
+  if ( needed & ~v->tables & VTREE_NODETAB ) {
+    create_nodetab( v );
+    v->tables |= VTREE_NODETAB;
+  }
+
+  vtree_release( v, temporary );
+}
+
+/*****************************************************************
+ * _vtree_require - builds the tables that are missing, use the  *
+ * macro vtree_require, which returns at once when all the       *
+ * tables are present                                           *
+ * tables : a combination of VTREE_SUFTAB, VTREE_ISUFTAB, ...    *
+ *****************************************************************/
+
+void
+_vtree_require( vtree_t *v, int tables )
+{
+  build_tables( v, tables, NULL );
+}
+
+/*****************************************************************
+ * vtree_release - frees tables that are no longer needed, they  *
+ * are rebuilt if they are used again                            *
+ *****************************************************************/
+
+void
+vtree_release( vtree_t *v, int tables )
+{
+  int owned;
+
+  if ( tables & VTREE_LCPTAB )
+    tables |= VTREE_CHILDTAB | VTREE_RMQTAB;
+
+  if ( tables & VTREE_CHILDTAB )
+    tables |= VTREE_SLTAB;
+
+  if ( tables & VTREE_BWTAB )
+    tables |= VTREE_FMTAB;
+
+  tables &= v->tables;
+
+  owned = tables & ~v->embedded; /* the other ones are part of the block or mapping of v */
+
+  if ( owned & VTREE_SUFTAB )
+    dev_free( v->suftab );
+
+  if ( owned & VTREE_ISUFTAB )
+    dev_free( v->isuftab );
+
+  if ( owned & VTREE_LCPTAB )
+    dev_free( v->lcptab );
+
+  if ( owned & VTREE_BWTAB )
+    dev_free( v->bwtab );
+
+  if ( owned & VTREE_CHILDTAB )
+    dev_free( v->childtab );
+
+  if ( tables & VTREE_SUFTAB )
+    v->suftab = NULL;
+
+  if ( tables & VTREE_ISUFTAB )
+    v->isuftab = NULL;
+
+  if ( tables & VTREE_LCPTAB ) {
+    if ( v->map == NULL || ! ( v->embedded & VTREE_LCPTAB ) )
+      dev_free( v->lcpexc );
+    v->lcptab = NULL;
+    v->lcpexc = NULL;
+    v->lcpexc_size = 0;
+  }
+
+  if ( tables & VTREE_BWTAB )
+    v->bwtab = NULL;
+
+  if ( tables & VTREE_CHILDTAB )
+    v->childtab = NULL;
+
+  if ( tables & VTREE_RMQTAB ) {
+    dev_free( v->rmqtab->minima );
+    dev_free( v->rmqtab );
+    v->rmqtab = NULL;
+  }
+
+  if ( tables & VTREE_KMERTAB ) {
+    dev_free( v->kmertab->code );
+    dev_free( v->kmertab->bounds );
+    dev_free( v->kmertab );
+    v->kmertab = NULL;
+  }
+
+  if ( tables & VTREE_FMTAB ) {
+    dev_free( v->fmtab->count );
+    dev_free( v->fmtab->occ );
+    dev_free( v->fmtab->sampled );
+    dev_free( v->fmtab->sampled_rank );
+    dev_free( v->fmtab->samples );
+    dev_free( v->fmtab );
+    v->fmtab = NULL;
+  }
+
+  if ( tables & VTREE_SLTAB ) {
+    dev_free( v->sltab );
+    v->sltab = NULL;
+  }
+
+  if ( tables & VTREE_NODETAB ) {
+    dev_free( v->nodetab );
+    v->nodetab = NULL;
+    v->num_nodes = 0;
+  }
+
+  v->tables &= ~tables;
+  v->embedded &= ~tables;
+}
+
+/*****************************************************************
+ * vtree_new_builder - creates a builder, its workspace is kept  *
+ * from one construction to the next                             *
+ *****************************************************************/
+
+vtree_builder_t *
+vtree_new_builder( void )
+{
+  vtree_builder_t *b = ( vtree_builder_t * ) dev_malloc( sizeof( vtree_builder_t ) );
+
+  b->scratch = NULL;
+  b->size = 0;
+  b->top = 0;
+
+  return b;
+}
+
+/*****************************************************************
+ * vtree_free_builder -                                          *
+ *****************************************************************/
+
+void
+vtree_free_builder( vtree_builder_t *b )
+{
+  dev_free( b->scratch );
+  dev_free( b );
+}
+
+/*****************************************************************
+ * reserve_workspace - makes the workspace of b large enough for *
+ * the construction of v                                         *
+ *****************************************************************/
+
+static void
+reserve_workspace( vtree_builder_t *b, vtree_t *v )
+{
+  size_t n = v->length + 1, size;
+
+  size = 2 * WORK_ALIGN( n * sizeof( pos_t ) ) + skew_workspace( v->length );
+  size = MAX( size, WORK_ALIGN( n * sizeof( node_t ) ) + WORK_ALIGN( n * sizeof( pos_t ) ) );
+
+  assert( b->top == 0 );
+
+  if ( size > b->size ) {
+    dev_free( b->scratch );
+    b->scratch = ( char * ) dev_malloc( size );
+    b->size = size;
+  }
+}
+
+/*****************************************************************
+ * vtree_build - creates a vtree using the workspace of b        *
+ * b : a builder                                                 *
+ * dtext : a digital string                                      *
+ * tables : a combination of VTREE_SUFTAB, VTREE_ISUFTAB, ...    *
+ *                                                               *
+ * The vtree, its text and the requested tables are stored in a  *
+ * single allocation.                                            *
+ *****************************************************************/
+
+vtree_t *
+vtree_build( vtree_builder_t *b, dstring_t *dtext, int tables )
+{
+  vtree_t *v;
+
+  if ( tables & VTREE_SLTAB )
+    tables |= VTREE_CHILDTAB;
+
+  if ( tables & ( VTREE_CHILDTAB | VTREE_RMQTAB ) )
+    tables |= VTREE_LCPTAB;
+
+  v = vtree_init( dtext, tables );
+
+  if ( b != NULL )
+    reserve_workspace( b, v );
+
+  build_tables( v, tables, b );
+
+  return v;
+}
+
+/*****************************************************************
+ * vtree_create_tables - creates a vtree with the given tables,  *
+ * the other ones are built on demand                            *
+ * dtext : a digital string                                      *
+ * tables : a combination of VTREE_SUFTAB, VTREE_ISUFTAB, ...    *
+ *****************************************************************/
+
+vtree_t *
+vtree_create_tables( dstring_t *dtext, int tables )
+{
+  vtree_t *v;
+
+  v = vtree_build( NULL, dtext, tables );
+
+  return v;
+}
+
+/*****************************************************************
+ * vtree_create - creates a suffix array and associated tables   *
+ * dtext : a digital string                                      *
+ *                                                               *
+ * 1. Generate the suffix array and associated data structures   *
+ *    based upon the input string;                               *
+ *                                                               *
+ * 2. The range minimum query index of the LCP array, used for   *
+ *    the longest common extensions, is built on first use by    *
+ *    vtree_lce, see vtree_set_rmq_block.                        *
+ *                                                               *
+ * 3. The prefix table is built if vtree_set_kmer_length was     *
+ *    called with k > 0.                                         *
+ *****************************************************************/
+
+vtree_t *
+vtree_create( dstring_t *dtext )
+{
+  vtree_t *v;
+
+  v = vtree_create_tables( dtext, kmer_length > 0 ? VTREE_ALL | VTREE_KMERTAB : VTREE_ALL );
+
+  return v;
+}
+
+/*****************************************************************
+ * vtree_create_generalized - creates the generalized vtree of   *
+ * several texts                                                 *
+ * texts : digital strings, each one ending with its terminator  *
+ * num_texts : number of texts                                   *
+ * tables : a combination of VTREE_SUFTAB, VTREE_ISUFTAB, ...    *
+ *                                                               *
+ * The texts are concatenated, the terminator of text s is       *
+ * replaced by the separator size + s, where size is the size of *
+ * the alphabet.  The separators are unique, hence no common     *
+ * prefix extends over a separator and the suffixes of each text *
+ * are in the same order as in the vtree of the text alone.  The *
+ * first separator is the terminator itself.                     *
+ *****************************************************************/
+
+vtree_t *
+vtree_create_generalized( dstring_t *texts[], int num_texts, int tables )
+{
+  alphabet_t alphabet = *texts[ 0 ]->alphabet;
+  dstring_t ds;
+  pos_t *seqstart;
+  vtree_t *v;
+  pos_t n = 0;
+
+  seqstart = ( pos_t * ) dev_malloc( ( num_texts + 1 ) * sizeof( pos_t ) );
+
+  for ( int s=0; s<num_texts; s++ ) {
+    seqstart[ s ] = n;
+    n += texts[ s ]->length;
+  }
+
+  seqstart[ num_texts ] = n;
+
+  ds.text = ( symbol_t * ) dev_malloc( n * sizeof( symbol_t ) );
+  ds.length = n;
+  ds.alphabet = &alphabet;
+
+  for ( int s=0; s<num_texts; s++ ) {
+
+    dstring_t *t = texts[ s ];
+
+    assert( t->alphabet->size == alphabet.size );
+    assert( dev_isspecial( t->alphabet, t->text[ t->length - 1 ] ) );
+
+    memcpy( ds.text + seqstart[ s ], t->text, ( t->length - 1 ) * sizeof( symbol_t ) );
+    ds.text[ seqstart[ s+1 ] - 1 ] = alphabet.size + s;
+  }
+
+  alphabet.size += num_texts - 1; /* largest symbol */
+
+  v = vtree_create_tables( &ds, tables & VTREE_ALL );
+
+  v->num_seqs = num_texts;
+  v->seqstart = seqstart;
+
+  vtree_require( v, tables ); /* the optional ones depend on the separators */
+
+  dev_free( ds.text );
+
+  return v;
+}
+
+/*****************************************************************
+ * vtree_extend - creates the generalized vtree of the texts of g*
+ * followed by new texts                                         *
+ * g : a vtree or a generalized vtree, its texts end with their  *
+ *     terminator                                                *
+ * texts : the new texts, see vtree_create_generalized           *
+ * num_texts : number of new texts                               *
+ * tables : a combination of VTREE_SUFTAB, VTREE_ISUFTAB, ...    *
+ *                                                               *
+ * Only the suffixes of the new texts are sorted, their array is *
+ * then merged with the one of g.  The merge keeps the lcp-values*
+ * of the two heads with the last suffix output, see first_of: a *
+ * comparison resumes where these values leave off, and the      *
+ * lcp-values of the merged array come for free.  The other      *
+ * tables are derived from the merged tables.  g is left         *
+ * unchanged, it can be mapped from an index file.               *
+ *                                                               *
+ * The child table is built again from the merged lcp table, in  *
+ * O(n) for the n symbols of all the texts, rather than updated: *
+ * the suffixes of g move to new ranks, so that all its entries  *
+ * change.  The merge is O(n) as well, the sort of the new       *
+ * suffixes is what the extension saves.                         *
+ *****************************************************************/
+
+vtree_t *
+vtree_extend( vtree_t *g, dstring_t *texts[], int num_texts, int tables )
+{
+  int size = g->alphabet_size - ( g->num_seqs - 1 ), num_seqs = g->num_seqs + num_texts;
+  pos_t n0 = g->length, n, i, j, k, capacity = 0, *SA;
+  pos_t ha, hb, l = 0; /* lcp-values of the heads with the last suffix output */
+  alphabet_t alphabet;
+  dstring_t ds;
+  vtree_t *h, *v;
+
+  assert( dev_isspecial( texts[ 0 ]->alphabet, g->text[ n0 - 1 ] ) );
+  assert( texts[ 0 ]->alphabet->size == size );
+
+  vtree_require( g, VTREE_SUFTAB | VTREE_LCPTAB );
+
+  /* the new texts alone, their separators are renumbered below */
+
+  h = vtree_create_generalized( texts, num_texts, VTREE_SUFTAB | VTREE_LCPTAB );
+
+  n = n0 + h->length;
+
+  alphabet = *texts[ 0 ]->alphabet;
+  alphabet.size = size + num_seqs - 1; /* largest symbol */
+
+  ds.text = ( symbol_t * ) dev_malloc( n * sizeof( symbol_t ) );
+  ds.length = n;
+  ds.alphabet = &alphabet;
+
+  memcpy( ds.text, g->text, n0 * sizeof( symbol_t ) );
+
+  for ( pos_t p=0; p<h->length; p++ )
+    ds.text[ n0 + p ] = h->text[ p ] >= size ? h->text[ p ] + g->num_seqs : h->text[ p ];
+
+  if ( tables & VTREE_SLTAB )
+    tables |= VTREE_CHILDTAB;
+
+  if ( tables & ( VTREE_CHILDTAB | VTREE_RMQTAB ) )
+    tables |= VTREE_LCPTAB;
+
+  v = vtree_init( &ds, tables );
+
+  dev_free( ds.text );
+
+  v->num_seqs = num_seqs;
+  v->seqstart = ( pos_t * ) dev_malloc( ( num_seqs + 1 ) * sizeof( pos_t ) );
+
+  for ( int s=0; s<g->num_seqs; s++ )
+    v->seqstart[ s ] = g->seqstart == NULL ? 0 : g->seqstart[ s ];
+
+  for ( int s=0; s<=num_texts; s++ )
+    v->seqstart[ g->num_seqs + s ] = n0 + h->seqstart[ s ];
+
+  /* merging the suffix arrays */
+
+  if ( ! ( v->embedded & VTREE_LCPTAB ) )
+    v->lcptab = ( uint8_t * ) dev_malloc( ( n + 1 ) * sizeof( uint8_t ) );
+
+  SA = ( pos_t * ) dev_malloc( ( n + 1 ) * sizeof( pos_t ) );
+
+  i = j = 0;
+  ha = hb = 0;
+
+  for ( k=0; k<n; k++ ) {
+
+    pos_t p = i < n0 ? vtree_get_suftab( g, i ) : -1;
+    pos_t q = j < h->length ? n0 + vtree_get_suftab( h, j ) : -1;
+    int from_g;
+
+    if ( p < 0 )
+      from_g = FALSE;
+    else if ( q < 0 )
+      from_g = TRUE;
+    else
+      from_g = first_of( v->text, p, q, ha, hb, &l );
+
+    if ( from_g ) {
+      SA[ k ] = p;
+      set_lcp( v, k, ha, &capacity );
+      hb = l;
+      ha = ++i < n0 ? vtree_get_lcptab( g, i ) : 0;
+    } else {
+      SA[ k ] = q;
+      set_lcp( v, k, hb, &capacity );
+      ha = l;
+      hb = ++j < h->length ? vtree_get_lcptab( h, j ) : 0;
+    }
+  }
+
+  SA[ n ] = n;
+  v->lcptab[ n ] = 0;
+
+  if ( v->lcpexc_size > 0 ) /* already sorted */
+    v->lcpexc = ( lcp_exception_t * ) dev_realloc( v->lcpexc, v->lcpexc_size * sizeof( lcp_exception_t ) );
+
+  v->suftab = store_table( v, VTREE_SUFTAB, v->suftab, SA, n + 1, NULL );
+
+  if ( v->suftab != SA )
+    dev_free( SA );
+
+  v->tables = VTREE_SUFTAB | VTREE_LCPTAB;
+
+  vtree_free( h );
+
+  build_tables( v, tables, NULL );
+
+  vtree_release( v, ( VTREE_SUFTAB | VTREE_LCPTAB ) & ~tables );
+
+  return v;
+}
+
+/*****************************************************************
+ * vtree_init_text, vtree_suffix_array, vtree_sparse_tables -    *
+ * the steps of the construction that sparse.c builds upon, see  *
+ * construct_impl.h                                              *
+ *****************************************************************/
+
+vtree_t *
+vtree_init_text( dstring_t *dtext )
+{
+  return vtree_init( dtext, 0 );
+}
+
+void
+vtree_suffix_array( pos_t *s, pos_t n, pos_t K, pos_t *SA, pos_t *ra )
+{
+  create_suffix_array( s, n, K, SA, ra, NULL );
+}
+
+/*****************************************************************
+ * vtree_sparse_tables - the tables of the size suffixes of SA   *
+ * v : the vtree of the text, without tables                     *
+ * SA : the suffixes in lexicographic order, one more entry, set *
+ *      to the length of the text                                *
+ * lcp : lcp[ r ], lcp-value of SA[ r-1 ] and SA[ r ]            *
+ *                                                               *
+ * SA is kept or released, lcp is left to the caller.            *
+ *****************************************************************/
+
+void
+vtree_sparse_tables( vtree_t *v, pos_t *SA, pos_t *lcp, pos_t size )
+{
+  pos_t capacity = 0;
+
+  SA[ size ] = v->length;
+
+  v->length = size; /* the width is that of the text */
+
+  v->lcptab = ( uint8_t * ) dev_malloc( ( size + 1 ) * sizeof( uint8_t ) );
+  v->lcptab[ 0 ] = v->lcptab[ size ] = 0;
+
+  for ( pos_t r=1; r<size; r++ )
+    set_lcp( v, r, lcp[ r ], &capacity );
+
+  if ( v->lcpexc_size > 0 )
+    v->lcpexc = ( lcp_exception_t * ) dev_realloc( v->lcpexc, v->lcpexc_size * sizeof( lcp_exception_t ) );
+
+  v->suftab = store_table( v, VTREE_SUFTAB, NULL, SA, size + 1, NULL );
+
+  if ( v->suftab != SA )
+    dev_free( SA );
+
+  v->tables = VTREE_SUFTAB | VTREE_LCPTAB;
+
+  create_childtab( v, NULL );
+
+  v->tables |= VTREE_CHILDTAB;
 }
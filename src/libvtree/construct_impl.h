@@ -0,0 +1,23 @@
+/*                               -*- Mode: C -*-
+ * construct_impl.h --- steps of the construction shared within libvtree
+ * Author          : Marcel Turcotte
+ * Created On      : Sat Oct 17 16:40:27 2026
+ * Last Modified By: Marcel Turcotte
+ * Last Modified On: Sat Oct 17 16:40:27 2026
+ *
+ * This copyrighted source code is freely distributed under the terms
+ * of the GNU General Public License.
+ * See the files COPYRIGHT and LICENSE for details.
+ *
+ * Included by the files of libvtree that build upon the steps of
+ * construct.c, see sparse.c; not part of the interface of the
+ * library.
+ */
+
+/* construct.c */
+
+extern vtree_t *vtree_init_text( dstring_t *text );
+
+extern void vtree_suffix_array( pos_t *s, pos_t n, pos_t K, pos_t *SA, pos_t *ra );
+
+extern void vtree_sparse_tables( vtree_t *v, pos_t *SA, pos_t *lcp, pos_t size );
@@ -20,10 +20,12 @@
 void
 vtree_print_tables( alphabet_t *alphabet, vtree_t *v )
 {
+  vtree_require( v, VTREE_ALL );
+
   printf( "* enhanced suffix array *\n\n" );
   printf( "        s   ds   sa   ra  lcp   bw    ^    v    > \n" );
 
-  for ( int i=0; i<v->length; i++ ) {
+  for ( pos_t i=0; i<v->length; i++ ) {
 
     char c;
 
@@ -32,20 +34,20 @@ vtree_print_tables( alphabet_t *alphabet, vtree_t *v )
     else
       c = dev_decode( alphabet, v->text[ i ] );
 
-    printf( " %3d ", i );
+    printf( " %3ld ", ( long ) i );
     printf( "[%3c]", c );
     printf( "[%3d]", v->text[ i ] );
-    printf( "[%3d]", v->suftab[ i ] );
-    printf( "[%3d]", v->isuftab[ i ] );
-    printf( "[%3d]", v->lcptab[ i ] );
+    printf( "[%3ld]", ( long ) vtree_get_suftab( v, i ) );
+    printf( "[%3ld]", ( long ) vtree_get_isuftab( v, i ) );
+    printf( "[%3ld]", ( long ) vtree_get_lcptab( v, i ) );
     printf( "[%3d]", v->bwtab[ i ] );
-    printf( "[%3d]", v->childtab[ i ].up );
-    printf( "[%3d]", v->childtab[ i ].down );
-    printf( "[%3d]", v->childtab[ i ].next );
+    printf( "[%3ld]", ( long ) vtree_get_childtab_up( v, i ) );
+    printf( "[%3ld]", ( long ) vtree_get_childtab_down( v, i ) );
+    printf( "[%3ld]", ( long ) vtree_get_childtab_next( v, i ) );
 
     printf( " " );
 
-    for ( int j=v->suftab[ i ]; j<v->length; j++ ) {
+    for ( pos_t j=vtree_get_suftab( v, i ); j<v->length; j++ ) {
       if  ( dev_isspecial( alphabet, v->text[ j ] ) )
 	c = '$';
       else
@@ -0,0 +1,632 @@
+/*                               -*- Mode: C -*-
+ * external.c --- construction of an index file in bounded memory
+ * Author          : Marcel Turcotte
+ * Created On      : Sat Oct 17 23:37:52 2026
+ * Last Modified By: Marcel Turcotte
+ * Last Modified On: Sat Oct 17 23:37:52 2026
+ *
+ * The suffixes are sorted by an external merge sort.  Each run
+ * holds the suffixes starting in a block of the text, as many as the
+ * memory allows; it is sorted in memory and written to a temporary
+ * file.  The runs are then merged all at once, up to
+ * EXTERNAL_FAN_IN of them, by a tournament tree over their heads,
+ * reading each file sequentially.  The last merge writes suftab and
+ * lcptab.  A run is a sequence of pairs, a suffix and its lcp-value
+ * with the previous one: both the sort of a run and the merges keep
+ * the lcp-values of the heads with the last suffix written, hence a
+ * comparison of two suffixes resumes where these values leave off,
+ * and the lcp-values of the result come for free.  The child table
+ * is derived from lcptab in a single pass.
+ *
+ * The text is read from a source straight into a temporary file,
+ * which is mapped; the tables are written to temporary files next to
+ * the index, then mapped to be saved by vtree_save_tables.  The
+ * memory in use is that of a run, plus the stack of the child
+ * table.  The time is O( n log n ) comparisons, plus the symbols
+ * compared, at most the sum of the lcp-values.
+ *
+ * @article{NK08,
+ *  author = {Waihong Ng and Katsuhiko Kakehi},
+ *  title = {Merging string sequences by longest common prefixes},
+ *  journal = {IPSJ Digital Courier},
+ *  volume = {4},
+ *  year = {2008},
+ *  pages = {69--78}
+ *  }
+ */
+
+#include "libdev.h"
+#include "libvtree.h"
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "merge_impl.h"
+
+/*****************************************************************
+ * run_t - a run read from its file, head is the next entry      *
+ *****************************************************************/
+
+typedef struct {
+  FILE *fh;
+  char *filename;
+  entry_t head;
+  int more;
+} run_t;
+
+/*****************************************************************
+ * sink_t - destination of a merge: the file of a run, or the    *
+ * files of suftab, lcptab and of the lcp exceptions             *
+ *****************************************************************/
+
+typedef struct {
+  FILE *fh;
+  FILE *suf, *lcp, *exc;
+  int width;
+  pos_t size;        /* entries written */
+  pos_t lcpexc_size;
+} sink_t;
+
+/*****************************************************************
+ * temporary_name - name of a temporary file of the index        *
+ *****************************************************************/
+
+static char *
+temporary_name( char *filename, char *tag, int k )
+{
+  char *name = ( char * ) dev_malloc( strlen( filename ) + strlen( tag ) + 48 );
+
+  sprintf( name, "%s.%s%d.%ld", filename, tag, k, ( long ) getpid() );
+
+  return name;
+}
+
+/*****************************************************************
+ * map_file - maps size bytes of a file, created with that size  *
+ * if writable                                                   *
+ *****************************************************************/
+
+static void *
+map_file( char *filename, size_t size, int writable )
+{
+  int fd;
+  void *p;
+
+  if ( writable ) { /* a byte at the end sets the size */
+    FILE *fh = dev_fopen( filename, "wb" );
+    if ( fseek( fh, ( long ) size - 1, SEEK_SET ) != 0 || fputc( 0, fh ) == EOF || fclose( fh ) != 0 )
+      dev_die( "cannot create %s", filename );
+  }
+
+  if ( ( fd = open( filename, writable ? O_RDWR : O_RDONLY ) ) < 0 )
+    dev_die( "cannot open %s", filename );
+
+  p = mmap( NULL, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0 );
+
+  close( fd ); /* the mapping remains valid */
+
+  if ( p == MAP_FAILED )
+    dev_die( "cannot map %s", filename );
+
+  return p;
+}
+
+/*****************************************************************
+ * put - appends a suffix and its lcp-value to a sink            *
+ *****************************************************************/
+
+static void
+put( sink_t *s, pos_t pos, pos_t lcp )
+{
+  if ( s->fh != NULL ) {
+
+    entry_t e;
+
+    e.pos = pos;
+    e.lcp = lcp;
+
+    if ( fwrite( &e, sizeof( entry_t ), 1, s->fh ) != 1 )
+      dev_die( "cannot write a run of the index" );
+
+  } else {
+
+    uint16_t x16 = ( uint16_t ) pos;
+    int32_t x32 = ( int32_t ) pos;
+    int64_t x64 = ( int64_t ) pos;
+    uint8_t x8 = lcp < VTREE_LCP_MAX ? ( uint8_t ) lcp : VTREE_LCP_MAX;
+    void *x = s->width == VTREE_WIDTH_16 ? ( void * ) &x16 : s->width == VTREE_WIDTH_32 ? ( void * ) &x32 : ( void * ) &x64;
+    int ok = fwrite( x, s->width, 1, s->suf ) == 1 && fwrite( &x8, 1, 1, s->lcp ) == 1;
+
+    if ( lcp >= VTREE_LCP_MAX ) {
+
+      lcp_exception_t e;
+
+      e.i = s->size;
+      e.lcp = lcp;
+
+      ok = ok && fwrite( &e, sizeof( lcp_exception_t ), 1, s->exc ) == 1;
+      s->lcpexc_size++;
+    }
+
+    if ( ! ok )
+      dev_die( "cannot write the tables of the index" );
+  }
+
+  s->size++;
+}
+
+/*****************************************************************
+ * next_entry, open_run, close_run - reading a run, whose file   *
+ * is removed once read                                          *
+ *****************************************************************/
+
+static void
+next_entry( run_t *r )
+{
+  r->more = fread( &r->head, sizeof( entry_t ), 1, r->fh ) == 1;
+}
+
+static void
+open_run( run_t *r, char *filename )
+{
+  r->filename = filename;
+  r->fh = dev_fopen( filename, "rb" );
+  next_entry( r );
+}
+
+static void
+close_run( run_t *r )
+{
+  fclose( r->fh );
+  remove( r->filename );
+  dev_free( r->filename );
+}
+
+/*****************************************************************
+ * loser_t - a node of the tournament tree of merge_runs: the    *
+ * run that lost there, and its lcp-value with the one that won  *
+ *****************************************************************/
+
+typedef struct {
+  int run;
+  pos_t lcp;
+} loser_t;
+
+#define EXTERNAL_FAN_IN 256 /* runs merged at once */
+
+/*****************************************************************
+ * play - the heads of the runs a and b, of lcp-values ha and hb *
+ * with the last suffix written, returns the run that comes      *
+ * first, l is set to the lcp-value of the two heads; an         *
+ * exhausted run comes last                                      *
+ *****************************************************************/
+
+static inline int
+play( symbol_t *text, run_t *r, int a, int b, pos_t ha, pos_t hb, pos_t *l )
+{
+  *l = 0;
+
+  if ( ! r[ b ].more )
+    return a;
+
+  if ( ! r[ a ].more )
+    return b;
+
+  return first_of( text, r[ a ].head.pos, r[ b ].head.pos, ha, hb, l ) ? a : b;
+}
+
+/*****************************************************************
+ * merge_runs - merges the num runs of r into s                  *
+ *                                                               *
+ * A tournament tree of losers: the leaves k..2k-1 are the runs, *
+ * an internal node keeps the run that lost there, and its       *
+ * lcp-value with the one that won.  The winner of a node is the *
+ * one of its subtree, hence once the winner of the root is      *
+ * written, its next suffix replays the matches on its path      *
+ * only, against losers whose lcp-values are with the suffix     *
+ * just written, see first_of.                                   *
+ *****************************************************************/
+
+static void
+merge_runs( symbol_t *text, run_t *r, int num, sink_t *s )
+{
+  loser_t *tree;
+  int *win, w;
+  pos_t h = 0, l; /* of the winner, with the last suffix written */
+
+  if ( num == 0 )
+    return;
+
+  tree = ( loser_t * ) dev_malloc( num * sizeof( loser_t ) );
+  win = ( int * ) dev_malloc( 2 * num * sizeof( int ) );
+
+  for ( int k=0; k<num; k++ )
+    win[ num + k ] = k;
+
+  for ( int k=num-1; k>=1; k-- ) { /* nothing written yet */
+
+    int a = win[ 2*k ], b = win[ 2*k+1 ];
+
+    win[ k ] = play( text, r, a, b, 0, 0, &l );
+    tree[ k ].run = win[ k ] == a ? b : a;
+    tree[ k ].lcp = l;
+  }
+
+  w = win[ 1 ];
+  dev_free( win );
+
+  while ( r[ w ].more ) {
+
+    put( s, r[ w ].head.pos, h );
+
+    next_entry( &r[ w ] );
+    h = r[ w ].head.lcp;
+
+    for ( int k=( num + w ) / 2; k>=1; k/=2 ) {
+
+      int x = tree[ k ].run;
+
+      if ( play( text, r, w, x, h, tree[ k ].lcp, &l ) == x ) {
+	tree[ k ].run = w;
+	h = tree[ k ].lcp;
+	w = x;
+      }
+
+      tree[ k ].lcp = l;
+    }
+  }
+
+  dev_free( tree );
+}
+
+/*****************************************************************
+ * create_runs - sorts the runs of at most size suffixes, and    *
+ * returns their files, numbered from 0                          *
+ *****************************************************************/
+
+static char **
+create_runs( symbol_t *text, pos_t n, pos_t size, char *filename, int *num_runs )
+{
+  entry_t *e = ( entry_t * ) dev_malloc( size * sizeof( entry_t ) );
+  entry_t *tmp = ( entry_t * ) dev_malloc( size * sizeof( entry_t ) );
+  char **runs = NULL;
+
+  *num_runs = 0;
+
+  for ( pos_t a=0; a<n; a+=size ) {
+
+    pos_t num = MIN( size, n - a );
+    FILE *fh;
+
+    for ( pos_t k=0; k<num; k++ )
+      e[ k ].pos = a + k;
+
+    sort_run( text, e, tmp, num );
+
+    runs = ( char ** ) dev_realloc( runs, ( *num_runs + 1 ) * sizeof( char * ) );
+    runs[ *num_runs ] = temporary_name( filename, "run", *num_runs );
+
+    fh = dev_fopen( runs[ *num_runs ], "wb" );
+
+    if ( fwrite( e, sizeof( entry_t ), num, fh ) != ( size_t ) num || fclose( fh ) != 0 )
+      dev_die( "cannot write %s", runs[ *num_runs ] );
+
+    ( *num_runs )++;
+  }
+
+  dev_free( e );
+  dev_free( tmp );
+
+  return runs;
+}
+
+/*****************************************************************
+ * merge_files - merges the num runs of the files names into s,  *
+ * or into a new run of the file name if not NULL, which is      *
+ * returned; the files of the runs are removed                   *
+ *****************************************************************/
+
+static char *
+merge_files( symbol_t *text, char **names, int num, sink_t *s, char *name )
+{
+  run_t *r = ( run_t * ) dev_malloc( ( num + 1 ) * sizeof( run_t ) );
+
+  for ( int k=0; k<num; k++ )
+    open_run( &r[ k ], names[ k ] );
+
+  if ( name != NULL )
+    s->fh = dev_fopen( name, "wb" );
+
+  merge_runs( text, r, num, s );
+
+  if ( name != NULL && fclose( s->fh ) != 0 )
+    dev_die( "cannot write %s", name );
+
+  for ( int k=0; k<num; k++ )
+    close_run( &r[ k ] );
+
+  dev_free( r );
+
+  return name;
+}
+
+/*****************************************************************
+ * store - cld[ i ] = x, using width bytes per entry             *
+ *****************************************************************/
+
+static inline void
+store( void *cld, int width, pos_t i, pos_t x )
+{
+  if ( width == VTREE_WIDTH_16 )
+    ( ( uint16_t * ) cld )[ i ] = ( uint16_t ) x;
+  else if ( width == VTREE_WIDTH_32 )
+    ( ( int32_t * ) cld )[ i ] = ( int32_t ) x;
+  else
+    ( ( int64_t * ) cld )[ i ] = ( int64_t ) x;
+}
+
+/*****************************************************************
+ * open_t - l-indices of equal lcp-values on the stack of        *
+ * create_childtab, from first to last                           *
+ *****************************************************************/
+
+typedef struct {
+  pos_t first;
+  pos_t last;
+  pos_t lcp;
+} open_t;
+
+/*****************************************************************
+ * create_childtab - the one-field child table of v, in a single *
+ * pass over lcptab                                              *
+ *                                                               *
+ * The passes of up/down and of next of construct.c use the same *
+ * stack, except that the former keeps the indices of equal      *
+ * lcp-values, which are merged here: next( last ) is the index  *
+ * that joins them, down( last ) the first index of the entry    *
+ * popped above it, and up( i ) the first index of the last one  *
+ * popped.  Only the last index of each entry can still change,  *
+ * the stack is as deep as the lcp-interval tree.                *
+ *****************************************************************/
+
+static void
+create_childtab( vtree_t *v, void *cld )
+{
+  pos_t capacity = 64, top = 0, e = 0;
+  open_t *stack = ( open_t * ) dev_malloc( capacity * sizeof( open_t ) );
+
+  stack[ 0 ].first = stack[ 0 ].last = stack[ 0 ].lcp = 0;
+  store( cld, v->width, 0, -1 );
+
+  for ( pos_t i=1; i<=v->length; i++ ) {
+
+    pos_t l = v->lcptab[ i ], last = -1;
+
+    if ( l == VTREE_LCP_MAX ) { /* the exceptions are read in order */
+      assert( e < v->lcpexc_size && v->lcpexc[ e ].i == i );
+      l = v->lcpexc[ e++ ].lcp;
+    }
+
+    store( cld, v->width, i, -1 );
+
+    while ( l < stack[ top ].lcp ) {
+
+      last = stack[ top-- ].first;
+
+      if ( l <= stack[ top ].lcp )
+	store( cld, v->width, stack[ top ].last, last ); /* down */
+    }
+
+    if ( last != -1 )
+      store( cld, v->width, i-1, last ); /* up( i ) */
+
+    if ( l == stack[ top ].lcp ) {
+      store( cld, v->width, stack[ top ].last, i ); /* next */
+      stack[ top ].last = i;
+      continue;
+    }
+
+    if ( ++top == capacity ) {
+      capacity *= 2;
+      stack = ( open_t * ) dev_realloc( stack, capacity * sizeof( open_t ) );
+    }
+
+    stack[ top ].first = stack[ top ].last = i;
+    stack[ top ].lcp = l;
+  }
+
+  dev_free( stack );
+}
+
+/*****************************************************************
+ * write_text - writes the symbols of a source to a file,        *
+ * followed by three 0, and returns their number                 *
+ *****************************************************************/
+
+static pos_t
+write_text( vtree_source_t source, void *arg, char *filename )
+{
+  symbol_t buf[ 4096 ];
+  FILE *fh = dev_fopen( filename, "wb" );
+  pos_t n = 0, num;
+
+  while ( ( num = source( buf, 4096, arg ) ) > 0 ) {
+
+    if ( sizeof( pos_t ) < VTREE_WIDTH_64 && ( double ) n + num >= VTREE_MAX_32 )
+      dev_die( "the text of %s needs -DPOS64", filename );
+
+    if ( fwrite( buf, sizeof( symbol_t ), num, fh ) != ( size_t ) num )
+      dev_die( "cannot write %s", filename );
+
+    n += num;
+  }
+
+  buf[ 0 ] = buf[ 1 ] = buf[ 2 ] = 0;
+
+  if ( fwrite( buf, sizeof( symbol_t ), 3, fh ) != 3 || fclose( fh ) != 0 )
+    dev_die( "cannot write %s", filename );
+
+  return n;
+}
+
+/*****************************************************************
+ * vtree_create_external_source - creates the index file of a    *
+ * text read from a source, in bounded memory                    *
+ * source, arg : the text, see vtree_source_t                    *
+ * alphabet : of the text                                        *
+ * filename : the index file                                     *
+ * memory : bytes for the runs, 16 per suffix                    *
+ *                                                               *
+ * The index file holds suftab, lcptab and childtab, it is       *
+ * returned mapped, see vtree_open_mmap.  The text is never held *
+ * in memory, the source writes it to a temporary file.  The     *
+ * temporary files, filename followed by a suffix, take about    *
+ * twice the space of the index.                                 *
+ *****************************************************************/
+
+vtree_t *
+vtree_create_external_source( vtree_source_t source, void *arg, alphabet_t *alphabet, char *filename, size_t memory )
+{
+  static char *tags[] = { "text", "suf", "lcp", "exc", "cld" };
+  pos_t n, size = MAX( memory / ( 2 * sizeof( entry_t ) ), 2 );
+  char *names[ 5 ], **runs;
+  int num_runs, next_run;
+  sink_t sink;
+  vtree_t v, *w;
+
+  for ( int k=0; k<5; k++ )
+    names[ k ] = temporary_name( filename, tags[ k ], 0 );
+
+  /* the text followed by three 0, mapped */
+
+  n = write_text( source, arg, names[ 0 ] );
+
+  memset( &v, 0, sizeof( vtree_t ) );
+
+  v.length = n;
+  v.alphabet_size = alphabet->size;
+  v.id = -1;
+  v.num_seqs = 1;
+  v.width = n < VTREE_MAX_16 ? VTREE_WIDTH_16 : n < VTREE_MAX_32 ? VTREE_WIDTH_32 : VTREE_WIDTH_64;
+  v.width = MAX( v.width, vtree_get_width() );
+
+  v.text = ( symbol_t * ) map_file( names[ 0 ], ( n + 3 ) * sizeof( symbol_t ), FALSE );
+
+  /* the runs, merged EXTERNAL_FAN_IN at a time, the last merge writes the tables */
+
+  runs = create_runs( v.text, n, size, filename, &num_runs );
+
+  next_run = num_runs; /* the merges are new runs */
+
+  while ( num_runs > EXTERNAL_FAN_IN ) {
+
+    int num = 0;
+
+    for ( int k=0; k<num_runs; k+=EXTERNAL_FAN_IN ) {
+
+      int m = MIN( EXTERNAL_FAN_IN, num_runs - k );
+
+      memset( &sink, 0, sizeof( sink_t ) );
+
+      runs[ num ] = merge_files( v.text, runs + k, m, &sink, temporary_name( filename, "run", next_run++ ) );
+
+      num++;
+    }
+
+    num_runs = num;
+  }
+
+  memset( &sink, 0, sizeof( sink_t ) );
+
+  sink.suf = dev_fopen( names[ 1 ], "wb" );
+  sink.lcp = dev_fopen( names[ 2 ], "wb" );
+  sink.exc = dev_fopen( names[ 3 ], "wb" );
+  sink.width = v.width;
+
+  ( void ) merge_files( v.text, runs, num_runs, &sink, NULL );
+
+  put( &sink, n, 0 ); /* suftab[ n ] = n, lcptab[ n ] = 0 */
+
+  if ( fclose( sink.suf ) != 0 || fclose( sink.lcp ) != 0 || fclose( sink.exc ) != 0 )
+    dev_die( "cannot write the tables of %s", filename );
+
+  dev_free( runs );
+
+  assert( sink.size == n + 1 && sink.lcpexc_size <= n );
+
+  /* the tables, mapped, then saved */
+
+  v.suftab = map_file( names[ 1 ], ( n + 1 ) * v.width, FALSE );
+  v.lcptab = ( uint8_t * ) map_file( names[ 2 ], ( n + 1 ) * sizeof( uint8_t ), FALSE );
+  v.lcpexc_size = sink.lcpexc_size;
+  v.lcpexc = v.lcpexc_size > 0 ? ( lcp_exception_t * ) map_file( names[ 3 ], v.lcpexc_size * sizeof( lcp_exception_t ), FALSE ) : NULL;
+
+  v.childtab = map_file( names[ 4 ], ( n + 1 ) * v.width, TRUE );
+
+  create_childtab( &v, v.childtab );
+
+  v.tables = v.embedded = VTREE_SUFTAB | VTREE_LCPTAB | VTREE_CHILDTAB;
+
+  vtree_save_tables( &v, filename, v.tables );
+
+  munmap( v.text, ( n + 3 ) * sizeof( symbol_t ) );
+  munmap( v.suftab, ( n + 1 ) * v.width );
+  munmap( v.lcptab, ( n + 1 ) * sizeof( uint8_t ) );
+  munmap( v.childtab, ( n + 1 ) * v.width );
+
+  if ( v.lcpexc != NULL )
+    munmap( v.lcpexc, v.lcpexc_size * sizeof( lcp_exception_t ) );
+
+  for ( int k=0; k<5; k++ ) {
+    remove( names[ k ] );
+    dev_free( names[ k ] );
+  }
+
+  w = vtree_open_mmap( filename );
+
+  if ( w == NULL )
+    dev_die( "cannot open %s", filename );
+
+  return w;
+}
+
+/*****************************************************************
+ * text_t - the source of vtree_create_external                  *
+ *****************************************************************/
+
+typedef struct {
+  symbol_t *text;
+  pos_t length;
+  pos_t next;
+} text_t;
+
+static pos_t
+read_text( symbol_t *buf, pos_t size, void *arg )
+{
+  text_t *t = ( text_t * ) arg;
+  pos_t num = MIN( size, t->length - t->next );
+
+  memcpy( buf, t->text + t->next, num * sizeof( symbol_t ) );
+  t->next += num;
+
+  return num;
+}
+
+/*****************************************************************
+ * vtree_create_external - creates the index file of a text in   *
+ * memory, see vtree_create_external_source                      *
+ *****************************************************************/
+
+vtree_t *
+vtree_create_external( dstring_t *text, char *filename, size_t memory )
+{
+  text_t t;
+
+  t.text = text->text;
+  t.length = text->length;
+  t.next = 0;
+
+  return vtree_create_external_source( read_text, &t, text->alphabet, filename, memory );
+}
@@ -0,0 +1,358 @@
+/*                               -*- Mode: C -*-
+ * fm.c --- backward search on the Burrows and Wheeler transformation
+ * Author          : Marcel Turcotte
+ * Created On      : Sat Oct 17 18:02:11 2026
+ * Last Modified By: Marcel Turcotte
+ * Last Modified On: Sat Oct 17 18:02:11 2026
+ *
+ * This copyrighted source code is freely distributed under the terms
+ * of the GNU General Public License.
+ * See the files COPYRIGHT and LICENSE for details.
+ *
+ * The FM-index counts the occurrences of a pattern in O( m ) steps,
+ * reading the pattern from right to left, using only bwtab and the
+ * tables of fm_index_t; neither the child table nor the suffix table
+ * is needed.  The positions are recovered from the sampled ones, see
+ * vtree_set_fm_step.
+ *
+ * A bidirectional index pairs the FM-index of the texts with that of
+ * the reversed texts.  The interval of a string in one index and
+ * that of its reverse in the other are kept in step, so that a
+ * string can be extended by a symbol on either side, see
+ * vtree_bidir_extend_left.
+ *
+ * @inproceedings{892127,
+ *  author = {Paolo Ferragina and Giovanni Manzini},
+ *  title = {Opportunistic data structures with applications},
+ *  booktitle = {Proc. 41st Annual Symposium on Foundations of
+ *               Computer Science},
+ *  year = {2000},
+ *  pages = {390--398}
+ *  }
+ *
+ * @inproceedings{LLKWY09,
+ *  author = {Tak-Wah Lam and Ruiqiang Li and Alan Tam and Simon Wong
+ *            and Edward Wu and Siu-Ming Yiu},
+ *  title = {High throughput short read alignment via bi-directional
+ *           BWT},
+ *  booktitle = {Proc. IEEE International Conference on
+ *               Bioinformatics and Biomedicine},
+ *  year = {2009},
+ *  pages = {31--36}
+ *  }
+ */
+
+#include "libdev.h"
+#include "libvtree.h"
+
+#include <string.h>
+
+/*****************************************************************
+ * fm_rank - occurrences of a in bwtab[ 0..r-1 ]                 *
+ *****************************************************************/
+
+static inline pos_t
+fm_rank( vtree_t *v, fm_index_t *t, symbol_t a, pos_t r )
+{
+  pos_t b = r / VTREE_FM_BLOCK;
+  pos_t result = t->occ[ ( long ) b * t->sigma + a ];
+
+  for ( pos_t k=b*VTREE_FM_BLOCK; k<r; k++ )
+    if ( v->bwtab[ k ] == a )
+      result++;
+
+  return result;
+}
+
+/*****************************************************************
+ * popcount64 -                                                  *
+ *****************************************************************/
+
+static inline int
+popcount64( uint64_t x )
+{
+#ifdef __GNUC__
+  return __builtin_popcountll( x );
+#else
+  int k = 0;
+  for ( ; x; x &= x - 1 )
+    k++;
+  return k;
+#endif
+}
+
+/*****************************************************************
+ * vtree_fm_count - number of occurrences of a pattern           *
+ * v : enhanced suffix array                                     *
+ * p, m : pattern and its length                                 *
+ * i, j : set to the interval of the suffixes starting with p,   *
+ *        if it occurs                                           *
+ *                                                               *
+ * The ranks i..j are those of suftab, hence vtree_fm_locate( v, *
+ * k ) equals vtree_get_suftab( v, k ).  A pattern that contains *
+ * a terminator or a separator does not occur.                   *
+ *****************************************************************/
+
+pos_t
+vtree_fm_count( vtree_t *v, symbol_t *p, pos_t m, pos_t *i, pos_t *j )
+{
+  fm_index_t *t;
+  pos_t lb = 0, rb = v->length; /* rows lb..rb-1 */
+
+  vtree_require( v, VTREE_FMTAB );
+
+  t = v->fmtab;
+
+  for ( pos_t d=m-1; d>=0 && lb < rb; d-- ) {
+
+    symbol_t a = p[ d ];
+
+    if ( a < 0 || a >= t->sigma )
+      return 0;
+
+    lb = t->count[ a ] + fm_rank( v, t, a, lb );
+    rb = t->count[ a ] + fm_rank( v, t, a, rb );
+  }
+
+  if ( lb >= rb )
+    return 0;
+
+  *i = lb;
+  *j = rb - 1;
+
+  return rb - lb;
+}
+
+/*****************************************************************
+ * vtree_fm_locate - position of the suffix of rank r            *
+ * v : enhanced suffix array                                     *
+ * r : rank, 0 <= r < v->length                                  *
+ *****************************************************************/
+
+pos_t
+vtree_fm_locate( vtree_t *v, pos_t r )
+{
+  fm_index_t *t;
+  pos_t d = 0;
+
+  vtree_require( v, VTREE_FMTAB );
+
+  t = v->fmtab;
+
+  while ( ! ( t->sampled[ r / 64 ] & ( ( uint64_t ) 1 << ( r % 64 ) ) ) ) {
+    symbol_t a = v->bwtab[ r ];
+    r = t->count[ a ] + fm_rank( v, t, a, r );
+    d++;
+  }
+
+  r = t->sampled_rank[ r / 64 ] + popcount64( t->sampled[ r / 64 ] & ( ( ( uint64_t ) 1 << ( r % 64 ) ) - 1 ) );
+
+  return t->samples[ r ] + d;
+}
+
+/*****************************************************************
+ * bidir_extend - extends the string w by each symbol a, on the  *
+ * side searched by backward search in v                         *
+ * v : index in which aw is searched                             *
+ * i, j : interval of w in v                                     *
+ * ri : first row of the reverse of w in the other index         *
+ * y : set to the intervals of aw, one per symbol, empty if      *
+ *     i > j                                                     *
+ * reversed : v is the index of the reversed texts, the fields   *
+ *            of y are swapped                                   *
+ *                                                               *
+ * The suffixes of the other index starting with the reverse of  *
+ * w are sorted by the symbol that follows it, the one that      *
+ * precedes w in v.  Those followed by a symbol smaller than a   *
+ * come first, a terminator or a separator after all the         *
+ * symbols.  The occurrences at i and j+1 are counted from the   *
+ * samples in a single pass over bwtab each.                     *
+ *****************************************************************/
+
+static void
+bidir_extend( vtree_t *v, pos_t i, pos_t j, pos_t ri, vtree_bi_interval_t *y, int reversed )
+{
+  fm_index_t *t = v->fmtab;
+  pos_t *lo = t->occ + ( long ) ( i / VTREE_FM_BLOCK ) * t->sigma;
+  pos_t *hi = t->occ + ( long ) ( ( j+1 ) / VTREE_FM_BLOCK ) * t->sigma;
+  pos_t smaller = 0;
+
+  /* the ranks are first kept in i and j */
+
+  for ( int a=0; a<t->sigma; a++ ) {
+    y[ a ].i = lo[ a ];
+    y[ a ].j = hi[ a ];
+  }
+
+  for ( pos_t k=i/VTREE_FM_BLOCK*VTREE_FM_BLOCK; k<i; k++ )
+    if ( v->bwtab[ k ] >= 0 && v->bwtab[ k ] < t->sigma )
+      y[ v->bwtab[ k ] ].i++;
+
+  for ( pos_t k=(j+1)/VTREE_FM_BLOCK*VTREE_FM_BLOCK; k<=j; k++ )
+    if ( v->bwtab[ k ] >= 0 && v->bwtab[ k ] < t->sigma )
+      y[ v->bwtab[ k ] ].j++;
+
+  for ( int a=0; a<t->sigma; a++ ) {
+
+    pos_t size = y[ a ].j - y[ a ].i, lb = t->count[ a ] + y[ a ].i;
+
+    if ( reversed ) {
+      y[ a ].ri = lb;
+      y[ a ].rj = lb + size - 1;
+      y[ a ].i = ri + smaller;
+      y[ a ].j = ri + smaller + size - 1;
+    } else {
+      y[ a ].i = lb;
+      y[ a ].j = lb + size - 1;
+      y[ a ].ri = ri + smaller;
+      y[ a ].rj = ri + smaller + size - 1;
+    }
+
+    smaller += size;
+  }
+}
+
+/*****************************************************************
+ * reverse_texts - the reversed texts, in the reverse order,     *
+ * each one with its terminator                                  *
+ * free_texts -                                                  *
+ *****************************************************************/
+
+static dstring_t **
+reverse_texts( dstring_t *texts[], int num_texts )
+{
+  dstring_t **reversed = ( dstring_t ** ) dev_malloc( num_texts * sizeof( dstring_t * ) );
+
+  for ( int s=0; s<num_texts; s++ ) {
+
+    dstring_t *t = texts[ num_texts-1-s ];
+    pos_t n = t->length - 1; /* without the terminator */
+
+    reversed[ s ] = dev_new_dstring( t->alphabet, t->length, 0 );
+
+    for ( pos_t p=0; p<n; p++ )
+      reversed[ s ]->text[ p ] = t->text[ n-1-p ];
+  }
+
+  return reversed;
+}
+
+static void
+free_texts( dstring_t *texts[], int num_texts )
+{
+  for ( int s=0; s<num_texts; s++ )
+    dev_free_dstring( texts[ s ] );
+
+  dev_free( texts );
+}
+
+/*****************************************************************
+ * vtree_create_bidir - creates the bidirectional index of texts *
+ * texts : digitalized texts, each one with its terminator       *
+ * num_texts : number of texts                                   *
+ *                                                               *
+ * The forward index is the generalized vtree of the texts, the  *
+ * reverse one that of the reversed texts, in the reverse order, *
+ * the reverse of their concatenation up to the separators.      *
+ * Both keep bwtab and the FM-index, the forward one also keeps  *
+ * suftab, which locates the occurrences of an interval.         *
+ *****************************************************************/
+
+vtree_bidir_t *
+vtree_create_bidir( dstring_t *texts[], int num_texts )
+{
+  vtree_bidir_t *b = ( vtree_bidir_t * ) dev_malloc( sizeof( vtree_bidir_t ) );
+  dstring_t **reversed = reverse_texts( texts, num_texts );
+
+  b->forward = vtree_create_generalized( texts, num_texts, VTREE_SUFTAB | VTREE_FMTAB );
+  b->reverse = vtree_create_generalized( reversed, num_texts, VTREE_FMTAB );
+  b->sigma = b->forward->fmtab->sigma;
+
+  free_texts( reversed, num_texts );
+
+  return b;
+}
+
+/*****************************************************************
+ * vtree_open_bidir_index - returns the bidirectional index of   *
+ * texts, see vtree_create_bidir                                 *
+ * prefix : the forward index is saved to prefix.fwd, the        *
+ *          reverse one to prefix.rev                            *
+ *                                                               *
+ * Both are mapped if the files hold them, otherwise they are    *
+ * created and saved for the next runs, see                      *
+ * vtree_open_generalized_index.  The files keep suftab and      *
+ * bwtab, the FM-indexes are built from them.                    *
+ *****************************************************************/
+
+vtree_bidir_t *
+vtree_open_bidir_index( char *prefix, dstring_t *texts[], int num_texts )
+{
+  vtree_bidir_t *b = ( vtree_bidir_t * ) dev_malloc( sizeof( vtree_bidir_t ) );
+  dstring_t **reversed = reverse_texts( texts, num_texts );
+  char *filename = ( char * ) dev_malloc( strlen( prefix ) + 8 );
+
+  sprintf( filename, "%s.fwd", prefix );
+  b->forward = vtree_open_generalized_index( filename, texts, num_texts, VTREE_SUFTAB | VTREE_FMTAB );
+
+  sprintf( filename, "%s.rev", prefix );
+  b->reverse = vtree_open_generalized_index( filename, reversed, num_texts, VTREE_FMTAB );
+
+  b->sigma = b->forward->fmtab->sigma;
+
+  dev_free( filename );
+  free_texts( reversed, num_texts );
+
+  return b;
+}
+
+/*****************************************************************
+ * vtree_free_bidir -                                            *
+ *****************************************************************/
+
+void
+vtree_free_bidir( vtree_bidir_t *b )
+{
+  vtree_free( b->forward );
+  vtree_free( b->reverse );
+  dev_free( b );
+}
+
+/*****************************************************************
+ * vtree_bidir_root - interval of the empty string, all the rows *
+ *****************************************************************/
+
+void
+vtree_bidir_root( vtree_bidir_t *b, vtree_bi_interval_t *x )
+{
+  x->i = x->ri = 0;
+  x->j = x->rj = b->forward->length - 1;
+}
+
+/*****************************************************************
+ * vtree_bidir_extend_left - intervals of aw                     *
+ * b : bidirectional index                                       *
+ * x : intervals of w and of its reverse, not empty              *
+ * y : set to the intervals of aw and of its reverse, for each   *
+ *     symbol a of the alphabet, b->sigma entries                *
+ *                                                               *
+ * An entry whose string does not occur has i > j, like a symbol *
+ * that is a terminator or a separator, which has no entry.      *
+ *****************************************************************/
+
+void
+vtree_bidir_extend_left( vtree_bidir_t *b, vtree_bi_interval_t *x, vtree_bi_interval_t *y )
+{
+  bidir_extend( b->forward, x->i, x->j, x->ri, y, FALSE );
+}
+
+/*****************************************************************
+ * vtree_bidir_extend_right - intervals of wa, see               *
+ * vtree_bidir_extend_left                                       *
+ *****************************************************************/
+
+void
+vtree_bidir_extend_right( vtree_bidir_t *b, vtree_bi_interval_t *x, vtree_bi_interval_t *y )
+{
+  bidir_extend( b->reverse, x->ri, x->rj, x->i, y, TRUE );
+}
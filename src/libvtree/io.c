@@ -0,0 +1,462 @@
+/*                               -*- Mode: C -*-
+ * io.c --- saving a vtree to a file and mapping it back into memory
+ * Author          : Marcel Turcotte
+ * Created On      : Sat Oct 17 15:12:40 2026
+ * Last Modified By: Marcel Turcotte
+ * Last Modified On: Sat Oct 17 15:12:40 2026
+ *
+ * This copyrighted source code is freely distributed under the terms
+ * of the GNU General Public License.
+ * See the files COPYRIGHT and LICENSE for details.
+ *
+ * An index file starts with a header, followed by the text and the
+ * tables of the vtree, in the layout used in memory.  Each section
+ * starts at a multiple of VTREE_FILE_ALIGN bytes, hence the tables
+ * can be used directly from a read-only mapping of the file, which
+ * the page cache shares between the processes using the same index.
+ *
+ * The file is written in the byte order of the machine, the header
+ * records it so that an index produced on a machine of different
+ * endianness is rejected.  The header also records the tables that
+ * were saved, the sections of the other ones are empty and they are
+ * built on demand once the file is mapped.
+ */
+
+#include "libdev.h"
+#include "libvtree.h"
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define VTREE_FILE_MAGIC "VTREEIDX"
+#define VTREE_FILE_ENDIAN 0x01020304
+
+/*****************************************************************
+ * Sections of an index file                                     *
+ *****************************************************************/
+
+enum { TEXT, SUFTAB, ISUFTAB, LCPTAB, LCPEXC, BWTAB, CHILDTAB, SEQSTART, NUM_SECTIONS };
+
+/*****************************************************************
+ * header_t - first bytes of an index file                       *
+ *****************************************************************/
+
+typedef struct {
+  char magic[ 8 ];
+  uint32_t version;
+  uint32_t endian;
+  uint32_t symbol_size; /* sizeof( symbol_t ) */
+  uint32_t pos_size;    /* sizeof( pos_t ) */
+  int64_t width;
+  int64_t length;
+  int64_t alphabet_size;
+  int64_t lcpexc_size;
+  int64_t num_seqs;
+  int64_t tables;
+  int64_t offset[ NUM_SECTIONS ];
+  int64_t size[ NUM_SECTIONS ];
+} header_t;
+
+/*****************************************************************
+ * section_sizes - number of bytes of each section of v, when    *
+ * the tables listed are saved                                   *
+ *****************************************************************/
+
+static void
+section_sizes( vtree_t *v, int tables, int64_t *size )
+{
+  int64_t n = v->length + 1;
+
+  size[ TEXT ] = ( v->length + 3 ) * sizeof( symbol_t );
+  size[ SUFTAB ] = tables & VTREE_SUFTAB ? n * v->width : 0;
+  size[ ISUFTAB ] = tables & VTREE_ISUFTAB ? n * v->width : 0;
+  size[ LCPTAB ] = tables & VTREE_LCPTAB ? n * sizeof( uint8_t ) : 0;
+  size[ LCPEXC ] = tables & VTREE_LCPTAB ? v->lcpexc_size * sizeof( lcp_exception_t ) : 0;
+  size[ BWTAB ] = tables & VTREE_BWTAB ? n * sizeof( symbol_t ) : 0;
+  size[ CHILDTAB ] = tables & VTREE_CHILDTAB ? n * v->width : 0;
+  size[ SEQSTART ] = v->num_seqs > 1 ? ( v->num_seqs + 1 ) * sizeof( pos_t ) : 0;
+}
+
+/*****************************************************************
+ * write_section - writes size bytes of p at offset, padding the *
+ * file with zeros up to offset                                  *
+ *****************************************************************/
+
+static void
+write_section( FILE *fh, char *filename, void *p, int64_t offset, int64_t size )
+{
+  static const char zeros[ VTREE_FILE_ALIGN ] = { 0 };
+  long pos = ftell( fh );
+
+  assert( pos >= 0 && offset - pos <= VTREE_FILE_ALIGN );
+
+  if ( fwrite( zeros, 1, offset - pos, fh ) != ( size_t ) ( offset - pos ) ||
+       ( size > 0 && fwrite( p, 1, size, fh ) != ( size_t ) size ) )
+    dev_die( "cannot write to %s", filename );
+}
+
+/*****************************************************************
+ * vtree_save - writes v to filename, with all the tables, which *
+ * are built first                                               *
+ *****************************************************************/
+
+void
+vtree_save( vtree_t *v, char *filename )
+{
+  vtree_save_tables( v, filename, VTREE_ALL );
+}
+
+/*****************************************************************
+ * vtree_save_tables - writes v to filename, with the tables     *
+ * listed, which are built first                                 *
+ * tables : a combination of VTREE_SUFTAB, ..., VTREE_CHILDTAB   *
+ *                                                               *
+ * The file is written under a temporary name then renamed,      *
+ * therefore a process opening the index at the same time sees   *
+ * either the old or the new file.                               *
+ *****************************************************************/
+
+void
+vtree_save_tables( vtree_t *v, char *filename, int tables )
+{
+  void *sections[ NUM_SECTIONS ];
+  char *tmp;
+  header_t h;
+  int64_t offset;
+  FILE *fh;
+
+  tables &= VTREE_ALL;
+
+  vtree_require( v, tables );
+
+  memset( &h, 0, sizeof( header_t ) );
+  memcpy( h.magic, VTREE_FILE_MAGIC, 8 );
+  h.version = VTREE_FILE_VERSION;
+  h.endian = VTREE_FILE_ENDIAN;
+  h.symbol_size = sizeof( symbol_t );
+  h.pos_size = sizeof( pos_t );
+  h.width = v->width;
+  h.length = v->length;
+  h.alphabet_size = v->alphabet_size;
+  h.lcpexc_size = tables & VTREE_LCPTAB ? v->lcpexc_size : 0;
+  h.num_seqs = v->num_seqs;
+  h.tables = tables;
+
+  section_sizes( v, tables, h.size );
+
+  offset = sizeof( header_t );
+
+  for ( int s=0; s<NUM_SECTIONS; s++ ) {
+    offset = ( offset + VTREE_FILE_ALIGN - 1 ) / VTREE_FILE_ALIGN * VTREE_FILE_ALIGN;
+    h.offset[ s ] = offset;
+    offset += h.size[ s ];
+  }
+
+  sections[ TEXT ] = v->text;
+  sections[ SUFTAB ] = v->suftab;
+  sections[ ISUFTAB ] = v->isuftab;
+  sections[ LCPTAB ] = v->lcptab;
+  sections[ LCPEXC ] = v->lcpexc;
+  sections[ BWTAB ] = v->bwtab;
+  sections[ CHILDTAB ] = v->childtab;
+  sections[ SEQSTART ] = v->seqstart;
+
+  tmp = ( char * ) dev_malloc( strlen( filename ) + 32 );
+  sprintf( tmp, "%s.%ld", filename, ( long ) getpid() );
+
+  fh = dev_fopen( tmp, "wb" );
+
+  if ( fwrite( &h, sizeof( header_t ), 1, fh ) != 1 )
+    dev_die( "cannot write to %s", tmp );
+
+  for ( int s=0; s<NUM_SECTIONS; s++ )
+    write_section( fh, tmp, sections[ s ], h.offset[ s ], h.size[ s ] );
+
+  if ( fclose( fh ) != 0 )
+    dev_die( "cannot write to %s", tmp );
+
+  if ( rename( tmp, filename ) != 0 )
+    dev_die( "cannot rename %s to %s", tmp, filename );
+
+  dev_free( tmp );
+}
+
+/*****************************************************************
+ * valid_header - true if h describes an index of this version,  *
+ * produced on a compatible machine, that fits in size bytes     *
+ *****************************************************************/
+
+static int
+valid_header( header_t *h, size_t size )
+{
+  vtree_t v;
+  int64_t expected[ NUM_SECTIONS ];
+
+  if ( memcmp( h->magic, VTREE_FILE_MAGIC, 8 ) != 0 ||
+       h->version != VTREE_FILE_VERSION ||
+       h->endian != VTREE_FILE_ENDIAN ||
+       h->symbol_size != sizeof( symbol_t ) ||
+       h->pos_size != sizeof( pos_t ) ||
+       ( h->width != VTREE_WIDTH_16 && h->width != VTREE_WIDTH_32 && h->width != VTREE_WIDTH_64 ) ||
+       h->length < 0 || h->lcpexc_size < 0 || h->num_seqs < 1 ||
+       ( h->tables & ~VTREE_ALL ) != 0 )
+    return FALSE;
+
+  v.length = h->length;
+  v.width = h->width;
+  v.lcpexc_size = h->lcpexc_size;
+  v.num_seqs = h->num_seqs;
+
+  section_sizes( &v, h->tables, expected );
+
+  for ( int s=0; s<NUM_SECTIONS; s++ )
+    if ( h->size[ s ] != expected[ s ] ||
+	 h->offset[ s ] % VTREE_FILE_ALIGN != 0 ||
+	 h->offset[ s ] < ( int64_t ) sizeof( header_t ) ||
+	 h->offset[ s ] + h->size[ s ] > ( int64_t ) size )
+      return FALSE;
+
+  return TRUE;
+}
+
+/*****************************************************************
+ * vtree_open_mmap - maps the index saved in filename            *
+ *                                                               *
+ * Returns NULL if the file cannot be opened, or if it is not an *
+ * index of this version produced on a compatible machine.  The  *
+ * mapping is read-only; vtree_free unmaps it.  The tables that  *
+ * were not saved are built in memory on demand.                 *
+ *****************************************************************/
+
+vtree_t *
+vtree_open_mmap( char *filename )
+{
+  struct stat st;
+  header_t *h;
+  vtree_t *v;
+  char *base;
+  int fd;
+
+  fd = open( filename, O_RDONLY );
+
+  if ( fd < 0 )
+    return NULL;
+
+  if ( fstat( fd, &st ) != 0 || st.st_size < ( off_t ) sizeof( header_t ) ) {
+    close( fd );
+    return NULL;
+  }
+
+  base = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+
+  close( fd ); /* the mapping remains valid */
+
+  if ( base == MAP_FAILED )
+    return NULL;
+
+  h = ( header_t * ) base;
+
+  if ( ! valid_header( h, st.st_size ) ) {
+    dev_log( 2, "%s is not a valid index", filename );
+    munmap( base, st.st_size );
+    return NULL;
+  }
+
+  v = ( vtree_t * ) dev_malloc( sizeof( vtree_t ) );
+
+  v->text = ( symbol_t * ) ( base + h->offset[ TEXT ] );
+  v->suftab = h->tables & VTREE_SUFTAB ? base + h->offset[ SUFTAB ] : NULL;
+  v->isuftab = h->tables & VTREE_ISUFTAB ? base + h->offset[ ISUFTAB ] : NULL;
+  v->lcptab = h->tables & VTREE_LCPTAB ? ( uint8_t * ) ( base + h->offset[ LCPTAB ] ) : NULL;
+  v->lcpexc = h->lcpexc_size > 0 ? ( lcp_exception_t * ) ( base + h->offset[ LCPEXC ] ) : NULL;
+  v->lcpexc_size = h->lcpexc_size;
+  v->bwtab = h->tables & VTREE_BWTAB ? ( symbol_t * ) ( base + h->offset[ BWTAB ] ) : NULL;
+  v->childtab = h->tables & VTREE_CHILDTAB ? base + h->offset[ CHILDTAB ] : NULL;
+  v->rmqtab = NULL;
+  v->kmertab = NULL;
+  v->fmtab = NULL;
+  v->sltab = NULL;
+  v->nodetab = NULL;
+  v->num_nodes = 0;
+  v->length = h->length;
+  v->alphabet_size = h->alphabet_size;
+  v->id = -1;
+  v->width = h->width;
+  v->tables = h->tables;
+  v->embedded = h->tables;
+  v->map = base;
+  v->map_size = st.st_size;
+  v->num_seqs = h->num_seqs;
+  v->seqstart = h->num_seqs > 1 ? ( pos_t * ) ( base + h->offset[ SEQSTART ] ) : NULL;
+
+  return v;
+}
+
+/*****************************************************************
+ * vtree_index_filename - name of the index of the i-th sequence *
+ * of a collection, prefix.i                                     *
+ *****************************************************************/
+
+char *
+vtree_index_filename( char *prefix, int i )
+{
+  char *filename = ( char * ) dev_malloc( strlen( prefix ) + 16 );
+
+  sprintf( filename, "%s.%d", prefix, i );
+
+  return filename;
+}
+
+/*****************************************************************
+ * holds_texts - true if v is the generalized vtree of texts,    *
+ * the vtree of the text itself when there is only one           *
+ *****************************************************************/
+
+static int
+holds_texts( vtree_t *v, dstring_t *texts[], int num_texts )
+{
+  pos_t start = 0;
+  symbol_t size = texts[ 0 ]->alphabet->size;
+
+  if ( v->num_seqs != num_texts || v->alphabet_size != size + num_texts - 1 )
+    return FALSE;
+
+  for ( int s=0; s<num_texts; s++ ) {
+
+    pos_t n = texts[ s ]->length;
+
+    if ( ( s > 0 && v->seqstart[ s ] != start ) || start + n > v->length )
+      return FALSE;
+
+    /* the terminator of text s is the separator size + s, a text alone is kept as is */
+
+    if ( memcmp( v->text + start, texts[ s ]->text, ( n - 1 ) * sizeof( symbol_t ) ) != 0 ||
+	 v->text[ start + n - 1 ] != ( num_texts == 1 ? texts[ s ]->text[ n - 1 ] : size + s ) )
+      return FALSE;
+
+    start += n;
+  }
+
+  return start == v->length;
+}
+
+/*****************************************************************
+ * kept_tables - the given tables and those they are read from,  *
+ * which build_tables keeps with them                            *
+ * saved_tables - tables of VTREE_ALL that are saved with an     *
+ * index, those from which the given ones are built without      *
+ * sorting the suffixes again                                    *
+ *****************************************************************/
+
+static int
+kept_tables( int tables )
+{
+  if ( tables & VTREE_SLTAB )
+    tables |= VTREE_CHILDTAB;
+
+  if ( tables & ( VTREE_CHILDTAB | VTREE_RMQTAB ) )
+    tables |= VTREE_LCPTAB;
+
+  if ( tables & VTREE_FMTAB )
+    tables |= VTREE_BWTAB;
+
+  return tables;
+}
+
+static int
+saved_tables( int tables )
+{
+  if ( tables & VTREE_SLTAB )
+    tables |= VTREE_SUFTAB | VTREE_ISUFTAB | VTREE_CHILDTAB;
+
+  if ( tables & VTREE_NODETAB )
+    tables |= VTREE_SUFTAB | VTREE_CHILDTAB;
+
+  if ( tables & ( VTREE_CHILDTAB | VTREE_RMQTAB ) )
+    tables |= VTREE_LCPTAB;
+
+  if ( tables & VTREE_FMTAB )
+    tables |= VTREE_BWTAB;
+
+  if ( tables & ( VTREE_LCPTAB | VTREE_BWTAB | VTREE_KMERTAB | VTREE_FMTAB ) )
+    tables |= VTREE_SUFTAB;
+
+  return tables & VTREE_ALL;
+}
+
+/*****************************************************************
+ * vtree_open_generalized_index - returns the generalized vtree  *
+ * of texts, see vtree_create_generalized                        *
+ * filename : index file                                         *
+ * texts, num_texts : the texts, each one with its terminator    *
+ * tables : the tables required                                  *
+ *                                                               *
+ * The vtree is mapped from filename if the file holds it,       *
+ * otherwise it is created and saved to filename for the next    *
+ * runs, with the tables of VTREE_ALL from which the required    *
+ * ones are built.  A file that holds the index of other texts   *
+ * is left as is, and the program stops.                         *
+ *****************************************************************/
+
+vtree_t *
+vtree_open_generalized_index( char *filename, dstring_t *texts[], int num_texts, int tables )
+{
+  int saved = saved_tables( tables );
+  vtree_t *v = vtree_open_mmap( filename );
+
+  if ( v != NULL ) {
+
+    if ( ! holds_texts( v, texts, num_texts ) )
+      dev_die( "%s is the index of other texts, remove it or choose another name", filename );
+
+    vtree_require( v, tables );
+
+    return v;
+  }
+
+  if ( access( filename, F_OK ) == 0 )
+    dev_die( "%s is not an index of this version, remove it or choose another name", filename );
+
+  v = vtree_create_generalized( texts, num_texts, tables | saved );
+
+  vtree_save_tables( v, filename, saved );
+
+  vtree_release( v, saved & ~kept_tables( tables ) );
+
+  return v;
+}
+
+/*****************************************************************
+ * vtree_open_index - returns the vtree of text, mapped from     *
+ * filename if the file holds the index of text, otherwise the   *
+ * vtree is created and saved to filename for the next runs      *
+ *                                                               *
+ * A file that holds the index of another text is left as is,    *
+ * and the program stops.                                        *
+ *****************************************************************/
+
+vtree_t *
+vtree_open_index( char *filename, dstring_t *text )
+{
+  vtree_t *v = vtree_open_mmap( filename );
+
+  if ( v != NULL ) {
+
+    if ( ! holds_texts( v, &text, 1 ) )
+      dev_die( "%s is the index of another text, remove it or choose another name", filename );
+
+    return v;
+  }
+
+  if ( access( filename, F_OK ) == 0 )
+    dev_die( "%s is not an index of this version, remove it or choose another name", filename );
+
+  v = vtree_create( text );
+
+  vtree_save( v, filename );
+
+  return v;
+}
@@ -10,40 +10,198 @@
  * See the files COPYRIGHT and LICENSE for details.
  *
  * Truong Ngyen's original work included an implementation of lce
- * based on LCA and RMQ.
- *
- * MT: I haven't had the time to integrate this into the new version
- * of Seed.
+ * based on LCA and RMQ.  The lce is now the range minimum of the
+ * lcp-values between the ranks of the two suffixes, answered by a
+ * block sparse table over lcptab (vtree_rmq).
  */
 
 #include "libdev.h"
 #include "libvtree.h"
 
 /*****************************************************************
- * vtree_lce - naive implementation of longest common extentions *
- * algorithm.                                                    *
+ * Specializations for each width of the index tables            *
+ *****************************************************************/
+
+#define INDEX_T uint16_t
+#define DECODE( x ) vtree_decode16( x )
+#define SPECIALIZE( name ) name##_16
+#include "lce_impl.h"
+#undef INDEX_T
+#undef DECODE
+#undef SPECIALIZE
+
+#define INDEX_T int32_t
+#define DECODE( x ) ( ( pos_t ) ( x ) )
+#define SPECIALIZE( name ) name##_32
+#include "lce_impl.h"
+#undef INDEX_T
+#undef DECODE
+#undef SPECIALIZE
+
+#define INDEX_T int64_t
+#define DECODE( x ) ( ( pos_t ) ( x ) )
+#define SPECIALIZE( name ) name##_64
+#include "lce_impl.h"
+#undef INDEX_T
+#undef DECODE
+#undef SPECIALIZE
+
+/*****************************************************************
+ * scan_min - minimum of lcptab[ l..r ], the exception table is   *
+ * searched only if the minimum exceeds VTREE_LCP_MAX - 1        *
+ *****************************************************************/
+
+static inline pos_t
+scan_min( vtree_t *v, pos_t l, pos_t r, pos_t result )
+{
+  for ( pos_t k=l; k<=r; k++ ) {
+    pos_t x = v->lcptab[ k ];
+    if ( x < VTREE_LCP_MAX ) {
+      if ( x < result )
+	result = x;
+    } else if ( result > VTREE_LCP_MAX ) {
+      x = vtree_lcp_exception( v, k );
+      if ( x < result )
+	result = x;
+    }
+  }
+
+  return result;
+}
+
+/*****************************************************************
+ * floor_log2 -                                                  *
+ *****************************************************************/
+
+static inline int
+floor_log2( pos_t x )
+{
+#ifdef __GNUC__
+  return 8 * sizeof( unsigned long long ) - 1 - __builtin_clzll( ( unsigned long long ) x );
+#else
+  int k = 0;
+  while ( x >>= 1 )
+    k++;
+  return k;
+#endif
+}
+
+/*****************************************************************
+ * vtree_rmq - minimum of the lcp-values of the ranks l..r       *
+ * v : input enhanced suffix array                               *
+ * l : first rank                                                *
+ * r : last rank, l <= r                                         *
+ *                                                               *
+ * The partial blocks at both ends are scanned, the full blocks  *
+ * in between are covered by two overlapping ranges of 2^k       *
+ * blocks, see rmq_t.                                            *
+ *****************************************************************/
+
+pos_t
+vtree_rmq( vtree_t *v, pos_t l, pos_t r )
+{
+  rmq_t *rmq;
+  pos_t bl, br, result, *row;
+  int k;
+
+  vtree_require( v, VTREE_LCPTAB | VTREE_RMQTAB );
+
+  assert( l <= r );
+
+  rmq = v->rmqtab;
+
+  bl = l / rmq->block + 1; /* first full block */
+  br = ( r + 1 ) / rmq->block; /* one past the last full block */
+
+  if ( bl >= br )
+    return scan_min( v, l, r, vtree_get_lcptab( v, l ) );
+
+  k = floor_log2( br - bl );
+  row = rmq->minima + ( long ) k * rmq->num_blocks;
+
+  result = MIN( row[ bl ], row[ br - ( ( pos_t ) 1 << k ) ] );
+
+  result = scan_min( v, l, bl * rmq->block - 1, result );
+
+  return scan_min( v, br * rmq->block, r, result );
+}
+
+/*****************************************************************
+ * vtree_lce - longest common extension of the suffixes i and j  *
  * v : input enhanced suffix array                               *
  * i : index                                                     *
  * j : index                                                     *
+ *                                                               *
+ * The minimum of the lcp-values between the ranks of i and j is *
+ * obtained from the range minimum query index, built on first   *
+ * use, unless vtree_set_rmq_block( 0 ) was called, in which     *
+ * case lcptab is scanned.                                       *
  *****************************************************************/
 
 pos_t
 vtree_lce( vtree_t *v, pos_t i, pos_t j )
 {
-  pos_t result, min, max, ri = v->isuftab[ i ], rj = v->isuftab[ j ];
+  if ( vtree_get_rmq_block() > 0 )
+    vtree_require( v, VTREE_ISUFTAB | VTREE_LCPTAB | VTREE_RMQTAB );
+  else
+    vtree_require( v, VTREE_ISUFTAB | VTREE_LCPTAB );
+
+  switch ( v->width ) {
+  case VTREE_WIDTH_16:
+    return lce_16( v, i, j );
+  case VTREE_WIDTH_32:
+    return lce_32( v, i, j );
+  default:
+    return lce_64( v, i, j );
+  }
+}
+
+/*****************************************************************
+ * vtree_lce_k - longest common extension of the suffixes i and  *
+ * j with at most k mismatches                                   *
+ * v : input enhanced suffix array                               *
+ * i : index                                                     *
+ * j : index                                                     *
+ * k : number of mismatches                                      *
+ * policy : compatible pairs of symbols, or NULL                 *
+ *                                                               *
+ * Each exact extension is one call to vtree_lce, followed by a  *
+ * jump over the compatible pair or mismatch that ends it.  The  *
+ * extension never jumps over the end of a text.                 *
+ *****************************************************************/
+
+pos_t
+vtree_lce_k( vtree_t *v, pos_t i, pos_t j, int k, lce_policy_t *policy )
+{
+  symbol_t separator = v->alphabet_size - ( v->num_seqs - 1 ); /* smallest terminator */
+  pos_t size = 0;
+  int num_compatible = 0;
 
   assert( i != j );
 
-  min = MIN( ri, rj );
-  max = MAX( ri, rj );
+  for ( ;; ) {
 
-  result = v->lcptab[ min+1 ];
+    symbol_t a, b;
 
-  for ( pos_t k=min+2; k<=max; k++ )
-    if ( v->lcptab[ k ] == 0 )
-      return 0;
-    else if ( v->lcptab[ k ] < result )
-      result = v->lcptab[ k ];
+    size += vtree_lce( v, i + size, j + size );
 
-  return result;
+    if ( i + size >= v->length || j + size >= v->length )
+      return size;
+
+    a = v->text[ i + size ];
+    b = v->text[ j + size ];
+
+    if ( a >= separator || b >= separator )
+      return size;
+
+    if ( policy != NULL && num_compatible < policy->max_compatible &&
+	 policy->compatible( a, b, policy->data ) )
+      num_compatible++;
+    else if ( k > 0 )
+      k--;
+    else
+      return size;
+
+    size++;
+  }
 }
@@ -0,0 +1,54 @@
+/*                               -*- Mode: C -*-
+ * lce_impl.h --- longest common extension for one table width
+ * Author          : Marcel Turcotte
+ * Created On      : Sat Oct 17 14:41:37 2026
+ * Last Modified By: Marcel Turcotte
+ * Last Modified On: Sat Oct 17 14:41:37 2026
+ *
+ * This copyrighted source code is freely distributed under the terms
+ * of the GNU General Public License.
+ * See the files COPYRIGHT and LICENSE for details.
+ *
+ * Included by lce.c once per width of the index tables, see
+ * access_impl.h for the macros that must be defined.
+ */
+
+/*****************************************************************
+ * lce - see vtree_lce                                           *
+ *****************************************************************/
+
+static pos_t
+SPECIALIZE( lce )( vtree_t *v, pos_t i, pos_t j )
+{
+  INDEX_T *isuftab = ( INDEX_T * ) v->isuftab;
+  uint8_t *lcptab = v->lcptab;
+  pos_t result, min, max, ri = DECODE( isuftab[ i ] ), rj = DECODE( isuftab[ j ] );
+
+  assert( i != j );
+
+  min = MIN( ri, rj );
+  max = MAX( ri, rj );
+
+  if ( v->rmqtab != NULL )
+    return vtree_rmq( v, min+1, max );
+
+  result = vtree_get_lcptab( v, min+1 );
+
+  /* the exception table is searched only if the minimum exceeds VTREE_LCP_MAX */
+
+  for ( pos_t k=min+2; k<=max; k++ ) {
+    pos_t l = lcptab[ k ];
+    if ( l == 0 )
+      return 0;
+    else if ( l < VTREE_LCP_MAX ) {
+      if ( l < result )
+	result = l;
+    } else if ( result > VTREE_LCP_MAX ) {
+      l = vtree_lcp_exception( v, k );
+      if ( l < result )
+	result = l;
+    }
+  }
+
+  return result;
+}
@@ -34,10 +34,119 @@
 #include "libdev.h"
 #include "vector.h"
 
+#include <stdint.h>
+
+/*****************************************************************
+ * Index tables                                                  *
+ *                                                               *
+ * The entries of suftab, isuftab and childtab are stored using  *
+ * 16, 32 or 64 bits, depending on the length of the text.  The  *
+ * tables are built using pos_t, then packed.  A text of         *
+ * VTREE_MAX_32 symbols or more needs 64 bits, and a pos_t of 64 *
+ * bits as well, see POS64 in libdev.h.                          *
+ *                                                               *
+ * With 16 bits, the value 0xFFFF stands for -1, hence the text  *
+ * must be shorter than VTREE_MAX_16.                            *
+ *****************************************************************/
+
+#define VTREE_WIDTH_AUTO 0
+#define VTREE_WIDTH_16 2
+#define VTREE_WIDTH_32 4
+#define VTREE_WIDTH_64 8
+
+#define VTREE_MAX_16 0xFFFFL
+#define VTREE_MAX_32 0x7FFFFFFFL
+
+#define vtree_decode16( x ) ( ( pos_t ) ( ( ( x ) + 1 ) & 0xFFFF ) - 1 )
+
+#define vtree_load( t, w, i )						\
+  ( ( w ) == VTREE_WIDTH_16 ? vtree_decode16( ( ( uint16_t * ) ( t ) )[ i ] ) : \
+    ( w ) == VTREE_WIDTH_32 ? ( pos_t ) ( ( int32_t * ) ( t ) )[ i ] :	\
+    ( pos_t ) ( ( int64_t * ) ( t ) )[ i ] )
+
+/*****************************************************************
+ * LCP table                                                     *
+ *                                                               *
+ * One byte per entry.  The values larger than or equal to       *
+ * VTREE_LCP_MAX are stored as VTREE_LCP_MAX in lcptab, and the  *
+ * actual value is found in the exception table, which is sorted *
+ * by index.                                                     *
+ *****************************************************************/
+
+#define VTREE_LCP_MAX 255
+
+typedef struct {
+  pos_t i;
+  pos_t lcp;
+} lcp_exception_t;
+
+/*****************************************************************
+ * Range minimum queries on the lcp table                        *
+ *                                                               *
+ * The lcp table is split into blocks of block entries, and the  *
+ * minima of 2^k consecutive blocks are stored for each k.  A    *
+ * query scans at most two partial blocks and reads two minima.  *
+ * Larger blocks need less memory, about n / block *             *
+ * log( n / block ) values, but make the scans longer.           *
+ *****************************************************************/
+
+#define VTREE_RMQ_BLOCK 32
+
+typedef struct {
+  int block;        /* entries of lcptab per block */
+  int levels;       /* number of rows of minima */
+  pos_t num_blocks;
+  pos_t *minima;    /* row k: minima of 2^k blocks starting at each block */
+} rmq_t;
+
+/*****************************************************************
+ * Prefix table                                                  *
+ *                                                               *
+ * The interval of the suffixes starting with each k-mer of the  *
+ * symbols that occur in the text, the k-mers being numbered in  *
+ * lexicographic order.  A search for a pattern of at least k    *
+ * symbols starts at depth k instead of the root.                *
+ *****************************************************************/
+
+typedef struct {
+  int k;
+  int sigma;       /* number of symbols indexed */
+  int *code;       /* rank of a symbol among the indexed ones, or -1 */
+  int code_size;   /* entries of code */
+  pos_t *bounds;   /* lb and rb of each k-mer, lb is -1 if it does not occur */
+} kmer_table_t;
+
+/*****************************************************************
+ * FM-index                                                      *
+ *                                                               *
+ * Backward search on bwtab.  count[ a ] is the number of        *
+ * suffixes that start with a symbol smaller than a, and the     *
+ * occurrences of each symbol in bwtab are stored every          *
+ * VTREE_FM_BLOCK rows, the other ones are counted from the      *
+ * previous sample.  The positions of the suffixes starting at a *
+ * multiple of step are kept, the other suffixes are located by  *
+ * walking back in the text to one of them.                      *
+ *****************************************************************/
+
+#define VTREE_FM_BLOCK 64
+#define VTREE_FM_STEP 32
+
+typedef struct {
+  int sigma;           /* symbols searched, those of the alphabet */
+  int step;            /* distance between the sampled positions */
+  pos_t *count;        /* suffixes starting with a smaller symbol */
+  pos_t *occ;          /* occ[ b*sigma + a ], a in bwtab before row b*VTREE_FM_BLOCK */
+  uint64_t *sampled;   /* one bit per row, set if its position is kept */
+  pos_t *sampled_rank; /* sampled rows before each word of sampled */
+  pos_t *samples;      /* positions of the sampled rows, in row order */
+} fm_index_t;
+
 /*****************************************************************
  * Child table                                                   *
  *                                                               *
- * The space can be reduced to one field, see Ref.               *
+ * The three fields are only used during the construction, the   *
+ * vtree stores a single field per index, see Ref. and           *
+ * vtree_get_childtab_up below.                                  *
  *****************************************************************/
 
 typedef struct {
@@ -46,46 +155,208 @@ typedef struct {
   pos_t next;
 } node_t;
 
+/*****************************************************************
+ * Node table                                                    *
+ *                                                               *
+ * The lcp-interval tree, leaves included, as an array of nodes  *
+ * in depth-first order.  The first child of an interval is the  *
+ * node that follows it, and next is the node that follows its   *
+ * subtree, hence its next sibling if it has one.  A step of a   *
+ * top-down search reads one node and the text, rather than the  *
+ * entries of childtab, lcptab and suftab, see vtree_node_first. *
+ *****************************************************************/
+
+typedef struct {
+  pos_t lb;    /* the interval lb..rb, a leaf if lb == rb */
+  pos_t rb;
+  pos_t lcp;   /* lcp-value, the length of the suffix for a leaf */
+  pos_t label; /* suftab[ lb ], where the suffixes of the interval start */
+  pos_t next;  /* the node that follows the subtree */
+} dfs_node_t;
+
 /*****************************************************************
  * Enhanced suffix array (vtree)                                 *
  *****************************************************************/
 
 typedef struct {
-  pos_t *suftab;  /* suffix array */
-  pos_t *isuftab; /* inverse suffix array, suftab^-1, rank */
-  pos_t *lcptab;  /* longest common prefix of S_suftab[i-1] and S_suftab[i] */
+  void *suftab;  /* suffix array */
+  void *isuftab; /* inverse suffix array, suftab^-1, rank */
+  uint8_t *lcptab;  /* longest common prefix of S_suftab[i-1] and S_suftab[i] */
+  lcp_exception_t *lcpexc; /* lcp-values larger than VTREE_LCP_MAX */
+  pos_t lcpexc_size;
   symbol_t *bwtab;  /* Burrows and Wheeler transformation */
-  node_t *childtab; /* child-table */ 
+  void *childtab; /* child-table */ 
+  rmq_t *rmqtab; /* range minimum queries on lcptab, see vtree_lce */
+  kmer_table_t *kmertab; /* intervals of the k-mers, see vtree_kmer_interval */
+  fm_index_t *fmtab; /* backward search on bwtab, see vtree_fm_count */
+  pos_t *sltab; /* suffix links of the lcp-intervals, see vtree_suffix_link */
+  dfs_node_t *nodetab; /* lcp-interval tree in depth-first order, the root first */
+  pos_t num_nodes;
   symbol_t *text;
   pos_t length;
   pos_t alphabet_size;
   int id;
+  int width; /* number of bytes per entry of the index tables */
+  int tables; /* tables built so far, see vtree_create_tables */
+  int embedded; /* tables stored in the same allocation as the vtree */
+  void *map; /* mapping of the index file, see vtree_open_mmap */
+  size_t map_size;
+  int num_seqs; /* number of texts, see vtree_create_generalized */
+  pos_t *seqstart; /* first position of each text, NULL if only one */
 } vtree_t;
 
+/*****************************************************************
+ * Builder                                                       *
+ *                                                               *
+ * Keeps the workspace of the construction (suffix sorting and   *
+ * child table) from one vtree to the next, which avoids the      *
+ * allocation of the temporary arrays when indexing many short   *
+ * sequences.  A builder must not be shared between threads.     *
+ *****************************************************************/
+
+typedef struct {
+  char *scratch;
+  size_t size; /* bytes allocated */
+  size_t top;  /* bytes in use */
+} vtree_builder_t;
+
 /*****************************************************************
  * Interface                                                     *
  *****************************************************************/
 
 /* construct.c */
 
+/*****************************************************************
+ * Suffix array construction algorithms                          *
+ *                                                               *
+ * VTREE_SA_AUTO selects SA-IS for texts of at least             *
+ * VTREE_SAIS_MIN_LENGTH symbols and skew otherwise (or when the *
+ * construction is parallel).                                    *
+ *****************************************************************/
+
+#define VTREE_SA_AUTO 0
+#define VTREE_SA_SKEW 1
+#define VTREE_SA_SAIS 2
+
+#define VTREE_SAIS_MIN_LENGTH 2048
+
+extern int vtree_set_sa_algorithm( int algorithm );
+
+extern int vtree_get_sa_algorithm( void );
+
+/*****************************************************************
+ * Parallel construction                                         *
+ *                                                               *
+ * The passes of skew over at least VTREE_PAR_MIN_LENGTH         *
+ * elements are split among the threads, the result does not    *
+ * depend on the number of threads.                              *
+ *****************************************************************/
+
+#define VTREE_PAR_MIN_LENGTH 65536
+
+extern int vtree_set_num_threads( int n );
+
+extern int vtree_get_num_threads( void );
+
+extern int vtree_set_width( int width );
+
+extern int vtree_get_width( void );
+
+extern int vtree_set_rmq_block( int block );
+
+extern int vtree_get_rmq_block( void );
+
+extern int vtree_set_kmer_length( int k );
+
+extern int vtree_get_kmer_length( void );
+
+extern int vtree_set_fm_step( int step );
+
+extern int vtree_get_fm_step( void );
+
 extern void vtree_set_id( vtree_t *v, int id );
 
 extern int vtree_get_id( vtree_t *v );
 
+/*****************************************************************
+ * Demand-driven construction                                    *
+ *                                                               *
+ * vtree_create_tables builds only the tables listed in tables,  *
+ * the other ones are built on first use by the functions of     *
+ * access.c, lce.c, fm.c, suflink.c, repeats.c and debug.c, or  *
+ * explicitly with vtree_require.  The macros vtree_get_* do not *
+ * build anything.                                               *
+ *                                                               *
+ * The child table and the range minimum query index depend on   *
+ * the lcp table, the suffix links on the child table, and the   *
+ * FM-index on bwtab, which are therefore kept with them.  The   *
+ * suffix table, from which the other tables are derived, is     *
+ * released if it was not requested.  vtree_release frees tables *
+ * that are no longer needed, releasing lcptab also releases     *
+ * childtab, rmqtab and sltab, releasing childtab also releases  *
+ * sltab, releasing bwtab also releases fmtab.  The node table   *
+ * is derived from suftab, lcptab and childtab but does not need *
+ * them once built.                                              *
+ *                                                               *
+ * A vtree that is shared between threads must be built with     *
+ * all the tables it needs before the threads start.             *
+ *****************************************************************/
+
+#define VTREE_SUFTAB 1
+#define VTREE_ISUFTAB 2
+#define VTREE_LCPTAB 4
+#define VTREE_BWTAB 8
+#define VTREE_CHILDTAB 16
+#define VTREE_ALL 31
+#define VTREE_RMQTAB 32 /* optional, not part of VTREE_ALL */
+#define VTREE_KMERTAB 64 /* optional, not part of VTREE_ALL */
+#define VTREE_FMTAB 128 /* optional, not part of VTREE_ALL */
+#define VTREE_SLTAB 256 /* optional, not part of VTREE_ALL */
+#define VTREE_NODETAB 512 /* optional, not part of VTREE_ALL */
+
+#define vtree_require( v, t ) ( ( ( ( v )->tables & ( t ) ) == ( t ) ) ? ( void ) 0 : _vtree_require( v, t ) )
+
 extern vtree_t *vtree_create( dstring_t *text );
 
+extern vtree_t *vtree_create_tables( dstring_t *text, int tables );
+
+extern void _vtree_require( vtree_t *v, int tables );
+
+extern void vtree_release( vtree_t *v, int tables );
+
 extern void vtree_free( vtree_t *vtree );
 
+extern vtree_builder_t *vtree_new_builder( void );
+
+extern void vtree_free_builder( vtree_builder_t *b );
+
+extern vtree_t *vtree_build( vtree_builder_t *b, dstring_t *text, int tables );
+
+extern vtree_t *vtree_create_generalized( dstring_t *texts[], int num_texts, int tables );
+
+extern vtree_t *vtree_extend( vtree_t *g, dstring_t *texts[], int num_texts, int tables );
+
+/* sais.c */
+
+extern void vtree_sais( pos_t *s, pos_t *SA, pos_t *ra, pos_t n, pos_t K );
+
 /* repeats.c */
 
 typedef struct {
   pos_t i;
   pos_t j;
+  pos_t node; /* the interval in nodetab, -1 if unknown */
 } interval2_t;
 
 extern interval2_t * new_interval2( pos_t i, pos_t j );
 extern vector_t *vtree_findall_smax_repeats( vtree_t *v );
 
+typedef void ( *vtree_match_fn_t )( vtree_t *v, pos_t length, pos_t *pos, int num, void *arg );
+
+extern void vtree_findall_mums( vtree_t *v, pos_t min_length, vtree_match_fn_t f, void *arg );
+
+extern void vtree_findall_mems( vtree_t *v, pos_t min_length, vtree_match_fn_t f, void *arg );
+
 /* access.c */
 
 typedef struct {
@@ -101,18 +372,86 @@ typedef struct {
   vector_t *childList;
 } interval4_t;
 
+/*****************************************************************
+ * vtree_child_iter_t - iterator over the child intervals of an  *
+ * lcp-interval, see vtree_child_first                           *
+ *****************************************************************/
+
+typedef struct {
+  pos_t i;     /* current child interval [i..j] */
+  pos_t j;
+  pos_t next;  /* left bound of the next child, -1 if none */
+  pos_t rb;    /* right bound of the parent */
+  int root;
+  pos_t node;  /* current child in nodetab, -1 if the child table is read */
+  pos_t end;   /* the node that follows the subtree of the parent */
+  pos_t label; /* suftab[ i ], where the suffixes of the child start */
+  vtree_t *v;
+} vtree_child_iter_t;
+
+/*****************************************************************
+ * Bottom-up traversal, see vtree_bottom_up                      *
+ *****************************************************************/
+
+typedef struct {
+  pos_t lcp;
+  pos_t lb;
+  pos_t rb;    /* -1 while the interval is open */
+  void *data;  /* data_size bytes, zeroed when the interval is opened */
+} vtree_node_t;
+
+typedef struct {
+  void ( *visit )( vtree_t *v, vtree_node_t *node, vtree_node_t *parent, void *arg );
+  void ( *leaf )( vtree_t *v, pos_t i, vtree_node_t *parent, void *arg ); /* or NULL */
+  size_t data_size;
+} vtree_bottom_up_t;
+
+extern void vtree_bottom_up( vtree_t *v, vtree_bottom_up_t *t, void *arg );
+
+extern int vtree_bottom_up_parallel( vtree_t *v, vtree_bottom_up_t *t, void *args[], int n );
+
 extern void vtree_traverse_with_array( vtree_t *v, void ( *f )( vtree_t *, interval3_t * ) );
 
 extern void vtree_traverse_and_process( vtree_t *v, void ( *f )( vtree_t *, interval4_t * ) );
 
 extern vector_t *vtree_getChildIntervals( vtree_t *v, interval2_t *interval );
 
+extern int vtree_child_first( vtree_t *v, pos_t i, pos_t j, vtree_child_iter_t *it );
+
+extern int vtree_child_next( vtree_child_iter_t *it );
+
+extern int vtree_node_first( vtree_t *v, pos_t k, vtree_child_iter_t *it );
+
+extern pos_t vtree_kmer_interval( vtree_t *v, symbol_t *p, pos_t m, pos_t *i, pos_t *j );
+
 extern interval2_t *vtree_getInterval( vtree_t *v, pos_t i, pos_t j, symbol_t a, int ( *cmp )( symbol_t, symbol_t ) );
 
+extern interval2_t *vtree_getChildInterval( vtree_t *v, interval2_t *interval, symbol_t a, int ( *cmp )( symbol_t, symbol_t ) );
+
+extern interval2_t *vtree_root_interval( vtree_t *v );
+
 extern pos_t vtree_getlcp( vtree_t *v, pos_t i, pos_t j );
 
 extern void vtree_find_exact_match( vtree_t *v, dstring_t *p );
 
+extern pos_t vtree_lcp_exception( vtree_t *v, pos_t i );
+
+extern void vtree_get_suffixes( vtree_t *v, pos_t i, pos_t j, pos_t *pos );
+
+#define VTREE_SUFFIX_BLOCK 256
+
+extern pos_t vtree_childtab_up( vtree_t *v, pos_t i );
+
+extern pos_t vtree_childtab_down( vtree_t *v, pos_t i );
+
+extern pos_t vtree_childtab_next( vtree_t *v, pos_t i );
+
+extern pos_t vtree_lindex( vtree_t *v, pos_t i, pos_t j );
+
+extern int vtree_seq_of( vtree_t *v, pos_t p );
+
+extern pos_t vtree_seq_end( vtree_t *v, int s );
+
 /*****************************************************************
  * vtree_get_childtab_up - wrapper returning childtab.up         *
  * vtree_get_childtab_down - wrapper returning childtab.down     *
@@ -120,19 +459,191 @@ extern void vtree_find_exact_match( vtree_t *v, dstring_t *p );
  * v : a pointer to an enhanced suffix array                     *
  * i : index into the childtab                                   *
  *                                                               *
- * Future versions may implement the space reduction technique   *
- * proposed by Abouelhoda, replacing up, down and next by a      *
- * a single value. Those wrappers will facilitate this change.   *
+ * The childtab implements the space reduction technique        *
+ * proposed by Abouelhoda, up, down and next are replaced by a   *
+ * single value cld and decoded using the lcp-values:            *
+ *                                                               *
+ *   up(i) = cld[i-1] if lcp[i-1] > lcp[i]                       *
+ *   down(i) = cld[i] if i < cld[i] and lcp[cld[i]] > lcp[i]     *
+ *   next(i) = cld[i] if i < cld[i] and lcp[cld[i]] = lcp[i]     *
+ *                                                               *
+ * When next(i) is defined, down(i) is up(next(i)).  Undefined   *
+ * values are -1, as before.                                     *
+ *                                                               *
+ * The wrappers test the width of the tables at each call, they  *
+ * are meant for occasional lookups and for the construction.    *
+ * The searches use the functions of access.c and lce.c, which   *
+ * select the width once, vtree_get_suffixes for a range of      *
+ * suftab, and it.label of the child iterators.                  *
+ *****************************************************************/
+
+#define vtree_get_suftab( v, i ) vtree_load( ( v )->suftab, ( v )->width, i )
+#define vtree_get_isuftab( v, i ) vtree_load( ( v )->isuftab, ( v )->width, i )
+#define vtree_get_lcptab( v, i ) ( ( v )->lcptab[ i ] < VTREE_LCP_MAX ? ( pos_t ) ( v )->lcptab[ i ] : vtree_lcp_exception( v, i ) )
+#define vtree_get_node( v, k ) ( ( v )->nodetab + ( k ) )
+
+#define vtree_get_childtab_up( v, i ) vtree_childtab_up( v, i )
+#define vtree_get_childtab_down( v, i ) vtree_childtab_down( v, i )
+#define vtree_get_childtab_next( v, i ) vtree_childtab_next( v, i )
+
+/*****************************************************************
+ * vtree_get_seq - text of the suffix of rank i, generalized     *
+ * vtrees                                                        *
+ *****************************************************************/
+
+#define vtree_get_seq( v, i ) vtree_seq_of( v, vtree_get_suftab( v, i ) )
+
+/* io.c */
+
+/*****************************************************************
+ * Index files                                                   *
+ *                                                               *
+ * VTREE_FILE_VERSION changes whenever the layout of the tables  *
+ * changes, older files are then rejected by vtree_open_mmap.    *
+ * An index file holds the text and some of the tables, those of *
+ * VTREE_ALL when written by vtree_save.                         *
+ *****************************************************************/
+
+#define VTREE_FILE_VERSION 3
+#define VTREE_FILE_ALIGN 64
+
+extern void vtree_save( vtree_t *v, char *filename );
+
+extern void vtree_save_tables( vtree_t *v, char *filename, int tables );
+
+extern vtree_t *vtree_open_mmap( char *filename );
+
+extern vtree_t *vtree_open_index( char *filename, dstring_t *text );
+
+extern vtree_t *vtree_open_generalized_index( char *filename, dstring_t *texts[], int num_texts, int tables );
+
+extern char *vtree_index_filename( char *prefix, int i );
+
+/* external.c */
+
+/*****************************************************************
+ * vtree_source_t - a text read in parts: writes at most size    *
+ * symbols to buf and returns their number, 0 at the end         *
  *****************************************************************/
 
-#define vtree_get_childtab_up( v, i ) v->childtab[ i ].up
-#define vtree_get_childtab_down( v, i ) v->childtab[ i ].down
-#define vtree_get_childtab_next( v, i ) v->childtab[ i ].next
+typedef pos_t ( *vtree_source_t )( symbol_t *buf, pos_t size, void *arg );
+
+extern vtree_t *vtree_create_external_source( vtree_source_t source, void *arg, alphabet_t *alphabet, char *filename, size_t memory );
+
+extern vtree_t *vtree_create_external( dstring_t *text, char *filename, size_t memory );
 
 /* lce.c */
 
 extern pos_t vtree_lce( vtree_t *v, pos_t i, pos_t j );
 
+extern pos_t vtree_rmq( vtree_t *v, pos_t l, pos_t r );
+
+/*****************************************************************
+ * Extensions with mismatches                                    *
+ *                                                               *
+ * A policy lets vtree_lce_k pair two distinct symbols a and b,  *
+ * a read from the first suffix and b from the second, when      *
+ * compatible( a, b, data ) is true, at most max_compatible      *
+ * times.  Such pairs do not count as mismatches.                *
+ *****************************************************************/
+
+typedef struct {
+  int ( *compatible )( symbol_t a, symbol_t b, void *data );
+  int max_compatible;
+  void *data;
+} lce_policy_t;
+
+extern pos_t vtree_lce_k( vtree_t *v, pos_t i, pos_t j, int k, lce_policy_t *policy );
+
+/* fm.c */
+
+extern pos_t vtree_fm_count( vtree_t *v, symbol_t *p, pos_t m, pos_t *i, pos_t *j );
+
+extern pos_t vtree_fm_locate( vtree_t *v, pos_t r );
+
+/*****************************************************************
+ * Bidirectional index                                           *
+ *                                                               *
+ * The FM-indexes of the texts and of the reversed texts.  A     *
+ * string w is represented by its interval i..j in forward and   *
+ * by that of its reverse, ri..rj, in reverse; both have the     *
+ * same size, the number of occurrences of w.                    *
+ *****************************************************************/
+
+typedef struct {
+  vtree_t *forward; /* generalized vtree of the texts, with suftab */
+  vtree_t *reverse; /* generalized vtree of the reversed texts */
+  int sigma;        /* symbols that extend a string */
+} vtree_bidir_t;
+
+typedef struct {
+  pos_t i, j;   /* rows of forward */
+  pos_t ri, rj; /* rows of reverse */
+} vtree_bi_interval_t;
+
+extern vtree_bidir_t *vtree_create_bidir( dstring_t *texts[], int num_texts );
+
+extern vtree_bidir_t *vtree_open_bidir_index( char *prefix, dstring_t *texts[], int num_texts );
+
+extern void vtree_free_bidir( vtree_bidir_t *b );
+
+extern void vtree_bidir_root( vtree_bidir_t *b, vtree_bi_interval_t *x );
+
+extern void vtree_bidir_extend_left( vtree_bidir_t *b, vtree_bi_interval_t *x, vtree_bi_interval_t *y );
+
+extern void vtree_bidir_extend_right( vtree_bidir_t *b, vtree_bi_interval_t *x, vtree_bi_interval_t *y );
+
+/* suflink.c */
+
+extern void vtree_suffix_link( vtree_t *v, pos_t i, pos_t j, pos_t *lb, pos_t *rb );
+
+extern void vtree_matching_statistics( vtree_t *v, symbol_t *q, pos_t m, pos_t *ms, pos_t *pos );
+
+/* sparse.c */
+
+/*****************************************************************
+ * Sparse suffix array                                           *
+ *                                                               *
+ * The enhanced suffix array of some suffixes of a text, those   *
+ * starting at the multiples of step or at chosen positions.     *
+ * index holds the text, suftab, lcptab and childtab, over the   *
+ * size indexed suffixes followed by the empty one: the root is  *
+ * 0..size, and index->length is size rather than the length of  *
+ * the text.  The functions of access.c that read only those     *
+ * tables apply to index, no other table can be built.  With a   *
+ * step of 8 and 32-bit entries, the tables take about 1.1 bytes *
+ * per symbol instead of 9.                                      *
+ *****************************************************************/
+
+typedef struct {
+  vtree_t *index;
+  pos_t length; /* of the text */
+  pos_t size;   /* number of suffixes indexed */
+  int step;     /* distance between them, 0 for chosen positions */
+} vtree_sparse_t;
+
+extern vtree_sparse_t *vtree_create_sparse( dstring_t *text, int step );
+
+extern vtree_sparse_t *vtree_create_sparse_at( dstring_t *text, pos_t *positions, pos_t num );
+
+extern void vtree_free_sparse( vtree_sparse_t *s );
+
+extern pos_t *vtree_sparse_find( vtree_sparse_t *s, symbol_t *p, pos_t m, pos_t *num );
+
+/* batch.c */
+
+/*****************************************************************
+ * Hits of vtree_find_batch                                      *
+ *****************************************************************/
+
+typedef struct {
+  int pattern; /* index of the pattern in the batch */
+  int seq;     /* text of a generalized vtree, 0 otherwise */
+  pos_t pos;   /* position in that text */
+} vtree_hit_t;
+
+extern vtree_hit_t *vtree_find_batch( vtree_t *v, dstring_t *patterns[], int num_patterns, pos_t *num_hits );
+
 /* debug.c */
 
 extern void vtree_print_tables( alphabet_t *a, vtree_t *v );
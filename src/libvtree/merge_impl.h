@@ -0,0 +1,112 @@
+/*                               -*- Mode: C -*-
+ * merge_impl.h --- comparison of suffixes by their lcp-values
+ * Author          : Marcel Turcotte
+ * Created On      : Sat Oct 17 16:05:12 2026
+ * Last Modified By: Marcel Turcotte
+ * Last Modified On: Sat Oct 17 16:05:12 2026
+ *
+ * This copyrighted source code is freely distributed under the terms
+ * of the GNU General Public License.
+ * See the files COPYRIGHT and LICENSE for details.
+ *
+ * Included by the files that merge sorted lists of suffixes, see
+ * external.c for the method.
+ */
+
+/*****************************************************************
+ * entry_t - a suffix and its lcp-value with the previous one in *
+ * a sorted list, 0 for the first one                            *
+ *****************************************************************/
+
+typedef struct {
+  pos_t pos;
+  pos_t lcp;
+} entry_t;
+
+/*****************************************************************
+ * text_lce - lcp-value of the suffixes p and q of text, distinct*
+ * suffixes of a text whose separators are unique                *
+ *****************************************************************/
+
+static inline pos_t
+text_lce( symbol_t *text, pos_t p, pos_t q )
+{
+  pos_t l = 0;
+
+  while ( text[ p + l ] == text[ q + l ] )
+    l++;
+
+  return l;
+}
+
+/*****************************************************************
+ * first_of - true if the suffix a comes before the suffix b     *
+ * ha, hb : lcp-values of a and b with the last suffix written,  *
+ *          which comes before both                              *
+ * l : set to the lcp-value of a and b                           *
+ *                                                               *
+ * If ha > hb, b differs from the last suffix before a does,     *
+ * hence a comes first, and the other way around.  Otherwise the *
+ * symbols from ha on are compared.                              *
+ *****************************************************************/
+
+static inline int
+first_of( symbol_t *text, pos_t a, pos_t b, pos_t ha, pos_t hb, pos_t *l )
+{
+  assert( a != b );
+
+  if ( ha != hb ) {
+    *l = MIN( ha, hb );
+    return ha > hb;
+  }
+
+  *l = ha + text_lce( text, a + ha, b + ha );
+
+  return text[ a + *l ] < text[ b + *l ];
+}
+
+/*****************************************************************
+ * sort_run - sorts the distinct suffixes of e[ 0..num-1 ] and   *
+ * sets their lcp-values, by merge sort, tmp has num entries     *
+ *****************************************************************/
+
+static inline void
+sort_run( symbol_t *text, entry_t *e, entry_t *tmp, pos_t num )
+{
+  pos_t half = num / 2, i = 0, j = half, k = 0, hi = 0, hj = 0, l;
+
+  if ( num < 2 ) {
+    e[ 0 ].lcp = 0;
+    return;
+  }
+
+  sort_run( text, e, tmp, half );
+  sort_run( text, e + half, tmp, num - half );
+
+  while ( i < half && j < num )
+    if ( first_of( text, e[ i ].pos, e[ j ].pos, hi, hj, &l ) ) {
+      tmp[ k ].pos = e[ i ].pos;
+      tmp[ k++ ].lcp = hi;
+      hj = l;
+      hi = ++i < half ? e[ i ].lcp : 0;
+    } else {
+      tmp[ k ].pos = e[ j ].pos;
+      tmp[ k++ ].lcp = hj;
+      hi = l;
+      hj = ++j < num ? e[ j ].lcp : 0;
+    }
+
+  for ( ; i < half; i++, k++ ) {
+    tmp[ k ].pos = e[ i ].pos;
+    tmp[ k ].lcp = hi;
+    hi = i+1 < half ? e[ i+1 ].lcp : 0;
+  }
+
+  for ( ; j < num; j++, k++ ) {
+    tmp[ k ].pos = e[ j ].pos;
+    tmp[ k ].lcp = hj;
+    hj = j+1 < num ? e[ j+1 ].lcp : 0;
+  }
+
+  memcpy( e, tmp, num * sizeof( entry_t ) );
+}
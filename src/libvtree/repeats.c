@@ -29,18 +29,20 @@ vtree_findall_smax_repeats( vtree_t *v )
   int i=0;
   vector_t *rs = dev_new_vector();
 
+  vtree_require( v, VTREE_LCPTAB | VTREE_BWTAB );
+
   while ( i < ( v->length-1 ) ) {
 
-    int j = i+1, l = v->lcptab[ j ];
+    int j = i+1, l = vtree_get_lcptab( v, j );
 
-    if ( v->lcptab[ i ] >= l ) {
+    if ( vtree_get_lcptab( v, i ) >= l ) {
       i++;
     } else { /* start of an lcp interval? */
 
-      while ( j < ( v->length-1 ) && v->lcptab[ j+1 ] == l )
+      while ( j < ( v->length-1 ) && vtree_get_lcptab( v, j+1 ) == l )
 	j++;
 
-      if ( v->lcptab[ j+1 ] >= l ) {
+      if ( vtree_get_lcptab( v, j+1 ) >= l ) {
 
 	i = j;
 
@@ -51,14 +53,18 @@ vtree_findall_smax_repeats( vtree_t *v )
 	symbol_t *seen = ( symbol_t * ) dev_malloc( size );
 	memset( seen, FALSE, size );
 
-	for ( int k=i; k<=j && distinct; k++ ) {
+	for ( pos_t k=i; k<=j && distinct; k++ ) {
 	  symbol_t c = v->bwtab[ k ];
+	  if ( c < 0 ) /* the suffix at position 0 */
+	    continue;
 	  if ( seen[ c ] )
 	    distinct = FALSE;
 	  else
 	    seen[ c ] = TRUE;
 	}
 
+	dev_free( seen );
+
 	if ( distinct ) {
 	  interval2_t *r = ( interval2_t * ) dev_malloc( sizeof( interval2_t ) );
 	  r->i = i;
@@ -74,12 +80,242 @@ vtree_findall_smax_repeats( vtree_t *v )
 }
 
 /*****************************************************************
- * vtree_findall_mums - finds all maximum unique matches (MUM)   *
+ * left_class - the symbol before the suffix of rank r, or       *
+ * sigma if there is none, or if it is a separator; two suffixes *
+ * are left-maximal if their classes differ or are both sigma    *
+ *****************************************************************/
+
+static inline symbol_t
+left_class( vtree_t *v, pos_t r, symbol_t sigma )
+{
+  symbol_t c = v->bwtab[ r ];
+
+  return c < 0 || c >= sigma ? sigma : c;
+}
+
+/*****************************************************************
+ * mum_t - state of vtree_findall_mums                           *
+ *****************************************************************/
+
+typedef struct {
+  pos_t min_length;
+  vtree_match_fn_t f;
+  void *arg;
+  pos_t *pos;       /* the occurrence in each sequence */
+  pos_t *suf;       /* the suffixes of an interval */
+} mum_t;
+
+/*****************************************************************
+ * mum_visit - reports the interval if it holds one suffix of    *
+ * each sequence and is left-maximal                             *
+ *****************************************************************/
+
+static void
+mum_visit( vtree_t *v, vtree_node_t *node, vtree_node_t *parent, void *arg )
+{
+  mum_t *s = ( mum_t * ) arg;
+  symbol_t sigma = v->alphabet_size - ( v->num_seqs - 1 ), c;
+  int left_maximal = FALSE;
+
+  if ( parent == NULL || node->rb - node->lb + 1 != v->num_seqs || node->lcp < s->min_length )
+    return;
+
+  for ( int k=0; k < v->num_seqs; k++ )
+    s->pos[ k ] = -1;
+
+  c = left_class( v, node->lb, sigma );
+
+  vtree_get_suffixes( v, node->lb, node->rb, s->suf );
+
+  for ( pos_t r=node->lb; r<=node->rb; r++ ) {
+
+    pos_t p = s->suf[ r - node->lb ];
+    int seq = vtree_seq_of( v, p );
+
+    if ( s->pos[ seq ] >= 0 ) /* twice in a sequence */
+      return;
+
+    s->pos[ seq ] = p;
+
+    if ( left_class( v, r, sigma ) != c || c == sigma )
+      left_maximal = TRUE;
+  }
+
+  if ( left_maximal )
+    s->f( v, node->lcp, s->pos, v->num_seqs, s->arg );
+}
+
+/*****************************************************************
+ * vtree_findall_mums - finds all the maximal unique matches     *
+ * (MUM) of the sequences of a generalized vtree                 *
+ * v : generalized enhanced suffix array, see                    *
+ *     vtree_create_generalized                                  *
+ * min_length : length of the shortest MUM reported, at least 1  *
+ * f : called as f( v, length, pos, num_seqs, arg ) for each     *
+ *     MUM, pos[ s ] being its position in the text of v within  *
+ *     the sequence s                                            *
  *                                                               *
+ * A MUM occurs exactly once in each sequence, and can neither   *
+ * be extended to the right, which makes it an lcp-interval of   *
+ * num_seqs suffixes, nor to the left, which bwtab tells.  The   *
+ * lcp-intervals are enumerated in one bottom-up traversal.      *
+ * With a single sequence, nothing is reported.                  *
  *****************************************************************/
 
 void
-vtree_findall_mums( vtree_t *v )
+vtree_findall_mums( vtree_t *v, pos_t min_length, vtree_match_fn_t f, void *arg )
 {
-  dev_die( "vtree_findall_mums: not implemented yet" );
+  vtree_bottom_up_t t = { mum_visit, NULL, 0 };
+  mum_t s;
+
+  if ( v->num_seqs < 2 )
+    return;
+
+  vtree_require( v, VTREE_SUFTAB | VTREE_LCPTAB | VTREE_BWTAB );
+
+  s.min_length = MAX( min_length, 1 );
+  s.f = f;
+  s.arg = arg;
+  s.pos = ( pos_t * ) dev_malloc( v->num_seqs * sizeof( pos_t ) );
+  s.suf = ( pos_t * ) dev_malloc( v->num_seqs * sizeof( pos_t ) );
+
+  vtree_bottom_up( v, &t, &s );
+
+  dev_free( s.pos );
+  dev_free( s.suf );
+}
+
+/*****************************************************************
+ * mem_t - state of vtree_findall_mems                           *
+ *                                                               *
+ * Each interval holds the suffixes below it in lists, one per   *
+ * left class, chained through next; data holds the heads and    *
+ * the tails of the lists, as ranks plus 1, 0 for none.  The     *
+ * suffixes are decoded once into suf, the pairs are read there. *
+ *****************************************************************/
+
+typedef struct {
+  pos_t min_length;
+  symbol_t sigma;
+  vtree_match_fn_t f;
+  void *arg;
+  pos_t *next;
+  pos_t *suf;       /* suftab */
+  pos_t *leaf;      /* the lists of a leaf */
+} mem_t;
+
+/*****************************************************************
+ * mem_merge - reports the pairs of suffixes of the lists of     *
+ * data and of the parent that are left-maximal and from two     *
+ * sequences, then appends the lists of data to the parent       *
+ *****************************************************************/
+
+static void
+mem_merge( vtree_t *v, mem_t *s, pos_t *data, vtree_node_t *parent )
+{
+  pos_t *head = ( pos_t * ) parent->data, *tail = head + s->sigma + 1;
+
+  if ( parent->lcp >= s->min_length )
+    for ( symbol_t a=0; a<=s->sigma; a++ )
+      for ( pos_t x=data[ a ]; x != 0; x=s->next[ x-1 ] )
+	for ( symbol_t b=0; b<=s->sigma; b++ ) {
+
+	  if ( a == b && a != s->sigma )
+	    continue;
+
+	  for ( pos_t y=head[ b ]; y != 0; y=s->next[ y-1 ] ) {
+
+	    pos_t pos[ 2 ], p = s->suf[ x-1 ], q = s->suf[ y-1 ];
+
+	    if ( v->num_seqs > 1 && vtree_seq_of( v, p ) == vtree_seq_of( v, q ) )
+	      continue;
+
+	    pos[ 0 ] = MIN( p, q );
+	    pos[ 1 ] = MAX( p, q );
+
+	    s->f( v, parent->lcp, pos, 2, s->arg );
+	  }
+	}
+
+  for ( symbol_t a=0; a<=s->sigma; a++ )
+    if ( data[ a ] != 0 ) {
+      if ( head[ a ] == 0 )
+	head[ a ] = data[ a ];
+      else
+	s->next[ tail[ a ]-1 ] = data[ a ];
+      tail[ a ] = data[ s->sigma + 1 + a ];
+    }
+}
+
+/*****************************************************************
+ * mem_leaf, mem_visit - callbacks of vtree_findall_mems         *
+ *****************************************************************/
+
+static void
+mem_leaf( vtree_t *v, pos_t i, vtree_node_t *parent, void *arg )
+{
+  mem_t *s = ( mem_t * ) arg;
+  symbol_t c = left_class( v, i, s->sigma );
+
+  s->leaf[ c ] = s->leaf[ s->sigma + 1 + c ] = i+1;
+  s->next[ i ] = 0;
+
+  mem_merge( v, s, s->leaf, parent );
+
+  s->leaf[ c ] = s->leaf[ s->sigma + 1 + c ] = 0;
+}
+
+static void
+mem_visit( vtree_t *v, vtree_node_t *node, vtree_node_t *parent, void *arg )
+{
+  if ( parent != NULL )
+    mem_merge( v, ( mem_t * ) arg, ( pos_t * ) node->data, parent );
+}
+
+/*****************************************************************
+ * vtree_findall_mems - finds all the maximal exact matches      *
+ * (MEM) of min_length or more                                   *
+ * v : enhanced suffix array, generalized or not                 *
+ * min_length : length of the shortest MEM reported, at least 1  *
+ * f : called as f( v, length, pos, 2, arg ) for each MEM, pos   *
+ *     holding its two positions in increasing order             *
+ *                                                               *
+ * A MEM is a pair of occurrences of a string that can be        *
+ * extended neither to the left nor to the right.  In a          *
+ * generalized vtree, both occurrences are in distinct           *
+ * sequences; otherwise they are the maximal repeated pairs of   *
+ * the text.  The pairs are those of the suffixes of two         *
+ * children of an lcp-interval, found in one bottom-up           *
+ * traversal, with distinct symbols before them.  The time is    *
+ * O( n sigma^2 ) plus the number of pairs tried.                *
+ *****************************************************************/
+
+void
+vtree_findall_mems( vtree_t *v, pos_t min_length, vtree_match_fn_t f, void *arg )
+{
+  mem_t s;
+  vtree_bottom_up_t t = { mem_visit, mem_leaf, 0 };
+
+  vtree_require( v, VTREE_SUFTAB | VTREE_LCPTAB | VTREE_BWTAB );
+
+  s.min_length = MAX( min_length, 1 );
+  s.sigma = v->alphabet_size - ( v->num_seqs - 1 );
+  s.f = f;
+  s.arg = arg;
+  s.next = ( pos_t * ) dev_malloc( MAX( v->length, 1 ) * sizeof( pos_t ) );
+  s.suf = ( pos_t * ) dev_malloc( MAX( v->length, 1 ) * sizeof( pos_t ) );
+
+  if ( v->length > 0 )
+    vtree_get_suffixes( v, 0, v->length-1, s.suf );
+
+  t.data_size = 2 * ( s.sigma + 1 ) * sizeof( pos_t );
+
+  s.leaf = ( pos_t * ) dev_malloc( t.data_size );
+  memset( s.leaf, 0, t.data_size );
+
+  vtree_bottom_up( v, &t, &s );
+
+  dev_free( s.next );
+  dev_free( s.suf );
+  dev_free( s.leaf );
 }
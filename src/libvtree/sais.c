@@ -0,0 +1,269 @@
+/*                               -*- Mode: C -*-
+ * sais.c --- suffix array construction by induced sorting (SA-IS)
+ * Author          : Marcel Turcotte
+ * Created On      : Sat Oct 17 09:12:40 2026
+ * Last Modified By: Marcel Turcotte
+ * Last Modified On: Sat Oct 17 09:12:40 2026
+ *
+ * This copyrighted source code is freely distributed under the terms
+ * of the GNU General Public License.
+ * See the files COPYRIGHT and LICENSE for details.
+ *
+ * __References__
+ *
+ * @Article{Nong2011,
+ *   author =	 {Nong, Ge and Zhang, Sen and Chan, Wai Hong},
+ *   title =	 {Two Efficient Algorithms for Linear Time Suffix
+ *               Array Construction},
+ *   journal =	 {IEEE Transactions on Computers},
+ *   volume =	 60,
+ *   number =	 10,
+ *   pages =	 {1471--1484},
+ *   year =	 2011
+ * }
+ *
+ * The original algorithm requires a unique and smallest sentinel at
+ * the end of the input.  The digital strings of Seed end with a
+ * terminator that is the largest symbol of the alphabet (and the test
+ * strings have no terminator at all).  Here, the sentinel is virtual:
+ * it sits at position n, is never stored, and is smaller than any
+ * symbol.  This is also what skew() assumes, therefore both algorithms
+ * produce the same suffix array.
+ */
+
+#include "libdev.h"
+#include "libvtree.h"
+
+#include <string.h>
+
+/*****************************************************************
+ * Type array - one bit per suffix, 1 for S-type, 0 for L-type   *
+ *****************************************************************/
+
+#define tget( i ) ( ( t[ ( i ) >> 3 ] & mask[ ( i ) & 7 ] ) ? 1 : 0 )
+#define tset( i, b ) t[ ( i ) >> 3 ] = ( b ) ? ( mask[ ( i ) & 7 ] | t[ ( i ) >> 3 ] ) : ( ~mask[ ( i ) & 7 ] & t[ ( i ) >> 3 ] )
+#define isLMS( i ) ( ( i ) > 0 && tget( i ) && ! tget( ( i ) - 1 ) )
+
+static const unsigned char mask[] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+
+/*****************************************************************
+ * get_buckets - computes the start (or end) of each bucket      *
+ * s : input string                                              *
+ * bkt : bucket array                                            *
+ * n : length of the string                                      *
+ * K : largest symbol                                            *
+ * end : true for the end of the buckets                         *
+ *****************************************************************/
+
+static void
+get_buckets( pos_t *s, pos_t *bkt, pos_t n, pos_t K, int end )
+{
+  pos_t sum = 0;
+
+  for ( pos_t c=0; c<=K; c++ )
+    bkt[ c ] = 0;
+
+  for ( pos_t i=0; i<n; i++ )
+    bkt[ s[ i ] ]++;
+
+  for ( pos_t c=0; c<=K; c++ ) {
+    sum += bkt[ c ];
+    bkt[ c ] = end ? sum : sum - bkt[ c ];
+  }
+}
+
+/*****************************************************************
+ * induce_L - induces the order of the L-type suffixes           *
+ *                                                               *
+ * The suffix n-1 is always L-type, it is induced first by the   *
+ * virtual sentinel.                                             *
+ *****************************************************************/
+
+static void
+induce_L( unsigned char *t, pos_t *SA, pos_t *s, pos_t *bkt, pos_t n, pos_t K )
+{
+  get_buckets( s, bkt, n, K, FALSE );
+
+  SA[ bkt[ s[ n-1 ] ]++ ] = n-1;
+
+  for ( pos_t i=0; i<n; i++ ) {
+    pos_t j = SA[ i ] - 1;
+    if ( SA[ i ] > 0 && ! tget( j ) )
+      SA[ bkt[ s[ j ] ]++ ] = j;
+  }
+}
+
+/*****************************************************************
+ * induce_S - induces the order of the S-type suffixes           *
+ *****************************************************************/
+
+static void
+induce_S( unsigned char *t, pos_t *SA, pos_t *s, pos_t *bkt, pos_t n, pos_t K )
+{
+  get_buckets( s, bkt, n, K, TRUE );
+
+  for ( pos_t i=n-1; i>=0; i-- ) {
+    pos_t j = SA[ i ] - 1;
+    if ( SA[ i ] > 0 && tget( j ) )
+      SA[ --bkt[ s[ j ] ] ] = j;
+  }
+}
+
+/*****************************************************************
+ * sais - recursive part of the algorithm                        *
+ * s : input string, symbols are in the range 0..K               *
+ * SA : suffix array                                             *
+ * n : length of the string                                      *
+ * K : largest symbol                                            *
+ *                                                               *
+ * The reduced string and its suffix array are stored into SA,   *
+ * therefore the only working space is the type array (n bits)   *
+ * and the buckets (K+1 entries) of each level.                  *
+ *****************************************************************/
+
+static void
+sais( pos_t *s, pos_t *SA, pos_t n, pos_t K )
+{
+  unsigned char *t;
+  pos_t *bkt, *s1, *SA1, n1, name, prev, j;
+
+  if ( n == 0 )
+    return;
+
+  t = ( unsigned char * ) dev_malloc( n / 8 + 1 );
+  bkt = ( pos_t * ) dev_malloc( ( K + 1 ) * sizeof( pos_t ) );
+
+  /* Classify the suffixes, the last one is L-type */
+
+  tset( n-1, 0 );
+
+  for ( pos_t i=n-2; i>=0; i-- )
+    tset( i, ( s[ i ] < s[ i+1 ] || ( s[ i ] == s[ i+1 ] && tget( i+1 ) ) ) ? 1 : 0 );
+
+  /* Stage 1: sort the LMS-substrings */
+
+  get_buckets( s, bkt, n, K, TRUE );
+
+  for ( pos_t i=0; i<n; i++ )
+    SA[ i ] = -1;
+
+  for ( pos_t i=1; i<n; i++ )
+    if ( isLMS( i ) )
+      SA[ --bkt[ s[ i ] ] ] = i;
+
+  induce_L( t, SA, s, bkt, n, K );
+  induce_S( t, SA, s, bkt, n, K );
+
+  /* Compact the sorted LMS-substrings into the first n1 cells */
+
+  n1 = 0;
+
+  for ( pos_t i=0; i<n; i++ )
+    if ( isLMS( SA[ i ] ) )
+      SA[ n1++ ] = SA[ i ];
+
+  /* Name the LMS-substrings, the one that reaches the virtual
+   * sentinel is necessarily unique.
+   */
+
+  for ( pos_t i=n1; i<n; i++ )
+    SA[ i ] = -1;
+
+  name = 0;
+  prev = -1;
+
+  for ( pos_t i=0; i<n1; i++ ) {
+
+    pos_t pos = SA[ i ];
+    int diff = FALSE;
+
+    for ( pos_t d=0; ; d++ ) {
+      if ( prev == -1 || pos+d == n || prev+d == n ||
+	   s[ pos+d ] != s[ prev+d ] || tget( pos+d ) != tget( prev+d ) ) {
+	diff = TRUE;
+	break;
+      } else if ( d > 0 && ( isLMS( pos+d ) || isLMS( prev+d ) ) ) {
+	break;
+      }
+    }
+
+    if ( diff ) {
+      name++;
+      prev = pos;
+    }
+
+    SA[ n1 + pos/2 ] = name - 1;
+  }
+
+  j = n-1;
+
+  for ( pos_t i=n-1; i>=n1; i-- )
+    if ( SA[ i ] >= 0 )
+      SA[ j-- ] = SA[ i ];
+
+  /* Stage 2: sort the reduced string, recursively if the names are
+   * not unique.
+   */
+
+  s1 = SA + n - n1;
+  SA1 = SA;
+
+  if ( name < n1 ) {
+
+    sais( s1, SA1, n1, name - 1 );
+
+  } else {
+
+    for ( pos_t i=0; i<n1; i++ )
+      SA1[ s1[ i ] ] = i;
+
+  }
+
+  /* Stage 3: induce the suffix array from the sorted LMS-suffixes */
+
+  j = 0;
+
+  for ( pos_t i=1; i<n; i++ )
+    if ( isLMS( i ) )
+      s1[ j++ ] = i;
+
+  for ( pos_t i=0; i<n1; i++ )
+    SA1[ i ] = s1[ SA1[ i ] ];
+
+  for ( pos_t i=n1; i<n; i++ )
+    SA[ i ] = -1;
+
+  get_buckets( s, bkt, n, K, TRUE );
+
+  for ( pos_t i=n1-1; i>=0; i-- ) {
+    j = SA[ i ];
+    SA[ i ] = -1;
+    SA[ --bkt[ s[ j ] ] ] = j;
+  }
+
+  induce_L( t, SA, s, bkt, n, K );
+  induce_S( t, SA, s, bkt, n, K );
+
+  dev_free( bkt );
+  dev_free( t );
+}
+
+/*****************************************************************
+ * vtree_sais - constructs the suffix array and its inverse      *
+ * s : source array                                              *
+ * SA : suffix array                                             *
+ * ra : rank array                                               *
+ * n : suffix array length                                       *
+ * K : number of keys (size of the alphabet)                     *
+ *                                                               *
+ * Same contract as skew(), see construct.c.                     *
+ *****************************************************************/
+
+void
+vtree_sais( pos_t *s, pos_t *SA, pos_t *ra, pos_t n, pos_t K )
+{
+  sais( s, SA, n, K );
+
+  for ( pos_t i=0; i<n; i++ )
+    ra[ SA[ i ] ] = i;
+}
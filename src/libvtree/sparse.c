@@ -0,0 +1,428 @@
+/*                               -*- Mode: C -*-
+ * sparse.c --- construction of and exact search in a sparse suffix array
+ * Author          : Marcel Turcotte
+ * Created On      : Sat Oct 17 22:41:09 2026
+ * Last Modified By: Marcel Turcotte
+ * Last Modified On: Sat Oct 17 22:41:09 2026
+ *
+ * This copyrighted source code is freely distributed under the terms
+ * of the GNU General Public License.
+ * See the files COPYRIGHT and LICENSE for details.
+ *
+ * When only the suffixes starting at the multiples of q are indexed,
+ * an occurrence of a pattern p of length m >= q at position t
+ * contains the indexed suffix t+o, where o = ( q - t % q ) % q.  For
+ * each offset o = 0..q-1, the suffix p[ o..m-1 ] is searched in the
+ * index, then the o symbols skipped are compared with the text.
+ * Each occurrence is found once, for its own offset.  The last
+ * offsets search short suffixes of p, whose intervals are larger,
+ * which is the price of the smaller index.
+ *
+ * @inproceedings{KU96,
+ *  author = {Juha K{\"a}rkk{\"a}inen and Esko Ukkonen},
+ *  title = {Sparse suffix trees},
+ *  booktitle = {Proc. 2nd Annual International Conference on
+ *               Computing and Combinatorics},
+ *  year = {1996},
+ *  pages = {219--230}
+ *  }
+ */
+
+#include "libdev.h"
+#include "libvtree.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "merge_impl.h"
+#include "construct_impl.h"
+
+/*****************************************************************
+ * name_blocks - names the blocks of step symbols starting at    *
+ * the multiples of step, in lexicographic order                 *
+ * text, n : the text and its length, the symbols past the end   *
+ *           of the text are read as 0                           *
+ * K : largest symbol                                            *
+ * s : set to the name of each block, from 1                     *
+ * size : number of blocks                                       *
+ *                                                               *
+ * The blocks are sorted by step passes of radix sort, from the  *
+ * last symbol to the first, returns the largest name.           *
+ *****************************************************************/
+
+#define block_symbol( k, d ) ( ( k ) * step + ( d ) < n ? text[ ( k ) * step + ( d ) ] : 0 )
+
+static pos_t
+name_blocks( symbol_t *text, pos_t n, int step, int K, pos_t *s, pos_t size )
+{
+  pos_t *a = ( pos_t * ) dev_malloc( size * sizeof( pos_t ) );
+  pos_t *b = ( pos_t * ) dev_malloc( size * sizeof( pos_t ) );
+  pos_t *c = ( pos_t * ) dev_malloc( ( K + 1 ) * sizeof( pos_t ) );
+  pos_t name = 1;
+
+  for ( pos_t k=0; k<size; k++ )
+    a[ k ] = k;
+
+  for ( int d=step-1; d>=0; d-- ) {
+
+    pos_t *t;
+
+    for ( pos_t x=0; x<=K; x++ )
+      c[ x ] = 0;
+
+    for ( pos_t k=0; k<size; k++ )
+      c[ block_symbol( a[ k ], d ) ]++;
+
+    for ( pos_t x=0, sum=0; x<=K; x++ ) {
+      pos_t t = c[ x ];
+      c[ x ] = sum;
+      sum += t;
+    }
+
+    for ( pos_t k=0; k<size; k++ )
+      b[ c[ block_symbol( a[ k ], d ) ]++ ] = a[ k ];
+
+    t = a;
+    a = b;
+    b = t;
+  }
+
+  s[ a[ 0 ] ] = name;
+
+  for ( pos_t k=1; k<size; k++ ) {
+
+    int d = 0;
+
+    while ( d < step && block_symbol( a[ k ], d ) == block_symbol( a[ k-1 ], d ) )
+      d++;
+
+    if ( d < step )
+      name++;
+
+    s[ a[ k ] ] = name;
+  }
+
+  dev_free( a );
+  dev_free( b );
+  dev_free( c );
+
+  return name;
+}
+
+#undef block_symbol
+
+/*****************************************************************
+ * sparse_index - completes a sparse suffix array                *
+ * v : the vtree of the text, without tables                     *
+ * SA : the size indexed suffixes in lexicographic order, one    *
+ *      more entry, set to the length of the text                *
+ * lcp : lcp[ r ], lcp-value of SA[ r-1 ] and SA[ r ]            *
+ *                                                               *
+ * SA is kept or released, lcp is left to the caller.            *
+ *****************************************************************/
+
+static vtree_sparse_t *
+sparse_index( vtree_t *v, pos_t *SA, pos_t *lcp, pos_t size, int step )
+{
+  vtree_sparse_t *s = ( vtree_sparse_t * ) dev_malloc( sizeof( vtree_sparse_t ) );
+
+  s->index = v;
+  s->length = v->length;
+  s->size = size;
+  s->step = step;
+
+  vtree_sparse_tables( v, SA, lcp, size );
+
+  return s;
+}
+
+/*****************************************************************
+ * vtree_create_sparse - creates the sparse suffix array of the  *
+ * suffixes starting at the multiples of step                    *
+ * dtext : the text                                              *
+ * step : distance between the indexed suffixes, at least 1      *
+ *                                                               *
+ * The blocks of step symbols starting at those positions are    *
+ * named in lexicographic order, the last one padded with 0.     *
+ * The suffixes of the string of names are then in the order of  *
+ * the suffixes they start, and are sorted as usual.  The        *
+ * lcp-values are computed in text order: the lcp-value of the   *
+ * suffix p + step is at least that of the suffix p minus step,  *
+ * hence the text is scanned O( 1 ) times.  The workspace has    *
+ * O( n / step ) entries (Karkkainen and Ukkonen, 1996).         *
+ *****************************************************************/
+
+vtree_sparse_t *
+vtree_create_sparse( dstring_t *dtext, int step )
+{
+  vtree_t *v = vtree_init_text( dtext );
+  pos_t n = v->length, size = ( n + step - 1 ) / step, l = 0;
+  pos_t *s, *SA, *ra;
+  vtree_sparse_t *sparse;
+
+  assert( step >= 1 && n > 0 );
+
+  s = ( pos_t * ) dev_malloc( ( size + 3 ) * sizeof( pos_t ) );
+  SA = ( pos_t * ) dev_malloc( ( size + 1 ) * sizeof( pos_t ) );
+  ra = ( pos_t * ) dev_malloc( ( size + 1 ) * sizeof( pos_t ) );
+
+  s[ size ] = s[ size+1 ] = s[ size+2 ] = 0;
+
+  vtree_suffix_array( s, size, name_blocks( v->text, n, step, v->alphabet_size, s, size ), SA, ra );
+
+  for ( pos_t r=0; r<size; r++ )
+    SA[ r ] *= step;
+
+  /* s[ k ], lcp-value of the suffix k*step and its predecessor */
+
+  for ( pos_t k=0; k<size; k++ ) {
+
+    pos_t p = k * step, q;
+
+    if ( ra[ k ] == 0 ) {
+      s[ k ] = l = 0;
+      continue;
+    }
+
+    q = SA[ ra[ k ] - 1 ];
+
+    while ( p + l < n && v->text[ p + l ] == v->text[ q + l ] )
+      l++;
+
+    s[ k ] = l;
+    l = MAX( l - step, 0 );
+  }
+
+  for ( pos_t r=0; r<size; r++ )
+    ra[ r ] = s[ SA[ r ] / step ];
+
+  dev_free( s );
+
+  sparse = sparse_index( v, SA, ra, size, step );
+
+  dev_free( ra );
+
+  return sparse;
+}
+
+/*****************************************************************
+ * vtree_create_sparse_at - creates the sparse suffix array of   *
+ * the suffixes starting at chosen positions                     *
+ * dtext : the text                                              *
+ * positions : distinct positions of the text, in any order      *
+ * num : number of positions, at least 1                         *
+ *                                                               *
+ * The suffixes are sorted by merge sort, which keeps the        *
+ * lcp-values of the heads with the last suffix output, see      *
+ * sort_run: a comparison resumes where these values leave off,  *
+ * and the lcp-values of the sorted suffixes come for free.      *
+ *****************************************************************/
+
+vtree_sparse_t *
+vtree_create_sparse_at( dstring_t *dtext, pos_t *positions, pos_t num )
+{
+  vtree_t *v = vtree_init_text( dtext );
+  entry_t *e = ( entry_t * ) dev_malloc( num * sizeof( entry_t ) );
+  entry_t *tmp = ( entry_t * ) dev_malloc( num * sizeof( entry_t ) );
+  pos_t *SA, *lcp;
+  vtree_sparse_t *s;
+
+  assert( num >= 1 );
+
+  for ( pos_t r=0; r<num; r++ ) {
+    assert( positions[ r ] >= 0 && positions[ r ] < v->length );
+    e[ r ].pos = positions[ r ];
+  }
+
+  sort_run( v->text, e, tmp, num );
+
+  dev_free( tmp );
+
+  SA = ( pos_t * ) dev_malloc( ( num + 1 ) * sizeof( pos_t ) );
+  lcp = ( pos_t * ) dev_malloc( ( num + 1 ) * sizeof( pos_t ) );
+
+  for ( pos_t r=0; r<num; r++ ) {
+    SA[ r ] = e[ r ].pos;
+    lcp[ r ] = e[ r ].lcp;
+  }
+
+  dev_free( e );
+
+  s = sparse_index( v, SA, lcp, num, 0 );
+
+  dev_free( lcp );
+
+  return s;
+}
+
+/*****************************************************************
+ * vtree_free_sparse -                                           *
+ *****************************************************************/
+
+void
+vtree_free_sparse( vtree_sparse_t *s )
+{
+  vtree_free( s->index );
+  dev_free( s );
+}
+
+/*****************************************************************
+ * sparse_interval - interval of the indexed suffixes starting   *
+ * with p, returns FALSE if there is none                        *
+ * s : sparse suffix array                                       *
+ * p, m : pattern and its length, m > 0                          *
+ * i, j : set to the interval                                    *
+ *                                                               *
+ * The lcp-interval tree is walked from the root, the symbols    *
+ * between the depth of an interval and that of its child are    *
+ * compared with the text of its first suffix.                   *
+ *****************************************************************/
+
+static int
+sparse_interval( vtree_sparse_t *s, symbol_t *p, pos_t m, pos_t *i, pos_t *j )
+{
+  vtree_t *v = s->index;
+  pos_t lb = 0, rb = v->length, d = 0;
+
+  while ( d < m ) {
+
+    vtree_child_iter_t it;
+    pos_t suf = -1, l;
+
+    for ( int more = vtree_child_first( v, lb, rb, &it ); more; more = vtree_child_next( &it ) ) {
+
+      pos_t q = it.label + d;
+
+      if ( q < s->length && v->text[ q ] == p[ d ] ) {
+	suf = q - d;
+	lb = it.i;
+	rb = it.j;
+	break;
+      }
+    }
+
+    if ( suf < 0 )
+      return FALSE;
+
+    l = lb == rb ? m : MIN( vtree_getlcp( v, lb, rb ), m );
+
+    for ( d++; d < l; d++ )
+      if ( suf + d >= s->length || v->text[ suf + d ] != p[ d ] )
+	return FALSE;
+
+    if ( lb == rb )
+      break;
+  }
+
+  *i = lb;
+  *j = rb;
+
+  return TRUE;
+}
+
+/*****************************************************************
+ * occurs_at - p[ 0..m-1 ] equals the text at position t         *
+ *****************************************************************/
+
+static inline int
+occurs_at( vtree_sparse_t *s, symbol_t *p, pos_t m, pos_t t )
+{
+  if ( t < 0 || t + m > s->length )
+    return FALSE;
+
+  for ( pos_t d=0; d<m; d++ )
+    if ( s->index->text[ t + d ] != p[ d ] )
+      return FALSE;
+
+  return TRUE;
+}
+
+/*****************************************************************
+ * compare_positions - increasing order                          *
+ *****************************************************************/
+
+static int
+compare_positions( const void *a, const void *b )
+{
+  pos_t x = *( pos_t * ) a, y = *( pos_t * ) b;
+
+  return x < y ? -1 : ( x > y );
+}
+
+/*****************************************************************
+ * add_position - appends t to the array pos of *num entries     *
+ *****************************************************************/
+
+static inline pos_t *
+add_position( pos_t *pos, pos_t *num, pos_t *capacity, pos_t t )
+{
+  if ( *num == *capacity ) {
+    *capacity = 2 * *capacity + 16;
+    pos = ( pos_t * ) dev_realloc( pos, *capacity * sizeof( pos_t ) );
+  }
+
+  pos[ ( *num )++ ] = t;
+
+  return pos;
+}
+
+/*****************************************************************
+ * vtree_sparse_find - occurrences of a pattern                  *
+ * s : sparse suffix array                                       *
+ * p, m : pattern and its length                                 *
+ * num : set to the number of occurrences                        *
+ *                                                               *
+ * Returns the positions of the occurrences in increasing order, *
+ * to be released with dev_free.  With a step of q, a pattern    *
+ * shorter than q can fall between two indexed suffixes, it is   *
+ * searched by a scan of the text.  With chosen positions, only  *
+ * the occurrences starting at one of them are found.            *
+ *****************************************************************/
+
+pos_t *
+vtree_sparse_find( vtree_sparse_t *s, symbol_t *p, pos_t m, pos_t *num )
+{
+  pos_t *pos = NULL, capacity = 0, i, j;
+  int step = s->step;
+
+  *num = 0;
+
+  if ( m <= 0 )
+    return ( pos_t * ) dev_malloc( sizeof( pos_t ) );
+
+  if ( step == 0 ) {
+
+    if ( sparse_interval( s, p, m, &i, &j ) )
+      for ( pos_t k=i; k<=j; k++ )
+	pos = add_position( pos, num, &capacity, vtree_get_suftab( s->index, k ) );
+
+  } else if ( m < step ) {
+
+    for ( pos_t t=0; t+m<=s->length; t++ )
+      if ( occurs_at( s, p, m, t ) )
+	pos = add_position( pos, num, &capacity, t );
+
+  } else {
+
+    for ( int o=0; o<step; o++ ) {
+
+      if ( ! sparse_interval( s, p + o, m - o, &i, &j ) )
+	continue;
+
+      for ( pos_t k=i; k<=j; k++ ) {
+
+	pos_t t = vtree_get_suftab( s->index, k ) - o;
+
+	if ( occurs_at( s, p, o, t ) ) /* the offsets skipped */
+	  pos = add_position( pos, num, &capacity, t );
+      }
+    }
+  }
+
+  if ( pos == NULL )
+    return ( pos_t * ) dev_malloc( sizeof( pos_t ) );
+
+  qsort( pos, *num, sizeof( pos_t ), compare_positions );
+
+  return pos;
+}
@@ -0,0 +1,181 @@
+/*                               -*- Mode: C -*-
+ * suflink.c --- suffix links and matching statistics
+ * Author          : Marcel Turcotte
+ * Created On      : Sat Oct 17 21:05:37 2026
+ * Last Modified By: Marcel Turcotte
+ * Last Modified On: Sat Oct 17 21:05:37 2026
+ *
+ * This copyrighted source code is freely distributed under the terms
+ * of the GNU General Public License.
+ * See the files COPYRIGHT and LICENSE for details.
+ *
+ * The matching statistics of a query against the text are computed
+ * by walking the lcp-interval tree as a suffix tree: the query is
+ * matched as far as possible, then the suffix link of the deepest
+ * interval passed leads to the match of the next suffix of the query,
+ * whose remaining symbols are skipped one edge at a time.  The query
+ * is never indexed.
+ *
+ * @article{CL94,
+ *  author = {William I. Chang and Eugene L. Lawler},
+ *  title = {Sublinear approximate string matching and biological
+ *           applications},
+ *  journal = {Algorithmica},
+ *  volume = {12},
+ *  year = {1994},
+ *  pages = {327--344}
+ *  }
+ */
+
+#include "libdev.h"
+#include "libvtree.h"
+
+/*****************************************************************
+ * vtree_suffix_link - suffix link of an lcp-interval            *
+ * v : enhanced suffix array                                     *
+ * i, j : an lcp-interval, i < j, other than the root            *
+ * lb, rb : set to the bounds of the interval it links to        *
+ *                                                               *
+ * The interval of the string aw links to the interval of w, the *
+ * root for a single symbol, see create_sltab.                   *
+ *****************************************************************/
+
+void
+vtree_suffix_link( vtree_t *v, pos_t i, pos_t j, pos_t *lb, pos_t *rb )
+{
+  pos_t k;
+
+  vtree_require( v, VTREE_SLTAB );
+
+  k = vtree_lindex( v, i, j );
+
+  *lb = v->sltab[ 2*k ];
+  *rb = v->sltab[ 2*k+1 ];
+}
+
+/*****************************************************************
+ * depth - lcp-value of the interval i..j, the symbols left in   *
+ * the text for a singleton                                      *
+ *****************************************************************/
+
+static inline pos_t
+depth( vtree_t *v, pos_t i, pos_t j )
+{
+  if ( i == j )
+    return v->length - vtree_get_suftab( v, i );
+
+  return j == v->length ? 0 : vtree_getlcp( v, i, j );
+}
+
+/*****************************************************************
+ * child - replaces i..j by its child whose suffixes have a at   *
+ * depth l, returns false if there is none                       *
+ *****************************************************************/
+
+static inline int
+child( vtree_t *v, pos_t *i, pos_t *j, pos_t l, symbol_t a )
+{
+  vtree_child_iter_t it;
+
+  for ( int more = vtree_child_first( v, *i, *j, &it ); more; more = vtree_child_next( &it ) ) {
+
+    pos_t p = it.label + l;
+
+    if ( p < v->length && v->text[ p ] == a ) {
+      *i = it.i;
+      *j = it.j;
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/*****************************************************************
+ * vtree_matching_statistics - longest match of each suffix of a *
+ * query                                                         *
+ * v : enhanced suffix array, generalized or not                 *
+ * q, m : query and its length                                   *
+ * ms : set to the length of the longest prefix of q[ p..m-1 ]   *
+ *      that occurs in the text, for p = 0..m-1                  *
+ * pos : if not NULL, set to a position of the text where that   *
+ *       prefix occurs, -1 if ms[ p ] is 0                       *
+ *                                                               *
+ * The time is O( m ) steps, each one a symbol compared or a     *
+ * child interval looked up, which is O( m sigma ).  A symbol of *
+ * the query that is not in the alphabet of the text, such as a  *
+ * terminator or a separator, matches nothing.                   *
+ *****************************************************************/
+
+void
+vtree_matching_statistics( vtree_t *v, symbol_t *q, pos_t m, pos_t *ms, pos_t *pos )
+{
+  symbol_t sigma = v->alphabet_size - ( v->num_seqs - 1 );
+  pos_t n = v->length, i = 0, j = n, d = 0, l;
+  pos_t pi = 0, pj = n, pl = 0; /* the deepest interval whose lcp-value is d or less */
+
+  vtree_require( v, VTREE_SUFTAB | VTREE_CHILDTAB | VTREE_SLTAB );
+
+  for ( pos_t p=0; p<m; p++ ) {
+
+    /* extends the match of q[ p.. ], the symbols d..l-1 are on the edge to i..j */
+
+    for ( ;; ) {
+
+      pos_t suf = vtree_get_suftab( v, i );
+
+      l = depth( v, i, j );
+
+      while ( d < l && p+d < m && q[ p+d ] >= 0 && q[ p+d ] < sigma && q[ p+d ] == v->text[ suf + d ] )
+	d++;
+
+      if ( d < l || p+d == m || i == j )
+	break;
+
+      pi = i;
+      pj = j;
+      pl = l;
+
+      if ( q[ p+d ] < 0 || q[ p+d ] >= sigma || ! child( v, &i, &j, l, q[ p+d ] ) )
+	break;
+    }
+
+    ms[ p ] = d;
+
+    if ( pos != NULL )
+      pos[ p ] = d > 0 ? vtree_get_suftab( v, i ) : -1;
+
+    if ( d == 0 )
+      continue; /* still at the root */
+
+    if ( i != j && d == l ) {
+      pi = i;
+      pj = j;
+      pl = l;
+    }
+
+    /* follows the suffix link of pi..pj, then skips down to the depth d-1 */
+
+    if ( pl > 0 )
+      vtree_suffix_link( v, pi, pj, &i, &j );
+    else {
+      i = 0;
+      j = n;
+    }
+
+    pi = i;
+    pj = j;
+    pl = MAX( pl-1, 0 );
+    d--;
+
+    while ( ( l = depth( v, i, j ) ) < d ) {
+
+      pi = i;
+      pj = j;
+      pl = l;
+
+      if ( ! child( v, &i, &j, l, q[ p+1+l ] ) )
+	dev_die( "vtree_matching_statistics: internal error, invalid suffix link" );
+    }
+  }
+}
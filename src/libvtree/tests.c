@@ -17,6 +17,7 @@
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
+#include <unistd.h>
 
 /*****************************************************************
  * alphabet - lower case letters alphabet                        *
@@ -111,17 +112,17 @@ display( char *s, dstring_t *ds, vtree_t *v )
 
   printf( "sa   = " );
   for ( int i=0; i<v->length; i++ )
-    printf( "[%2d]", v->suftab[ i ] );
+    printf( "[%2ld]", ( long ) vtree_get_suftab( v, i ) );
   printf( "\n" );
 
   printf( "ra   = " );
   for ( int i=0; i<v->length; i++ )
-    printf( "[%2d]", v->isuftab[ i ] );
+    printf( "[%2ld]", ( long ) vtree_get_isuftab( v, i ) );
   printf( "\n" );
 
   printf( "lcp  = " );
   for ( int i=0; i<v->length; i++ )
-    printf( "[%2d]", v->lcptab[ i ] );
+    printf( "[%2ld]", ( long ) vtree_get_lcptab( v, i ) );
   printf( "\n" );
 
   printf( "bw   = " );
@@ -131,17 +132,17 @@ display( char *s, dstring_t *ds, vtree_t *v )
 
   printf( "up   = " );
   for ( int i=0; i<v->length; i++ )
-    printf( "[%2d]", v->childtab[ i ].up );
+    printf( "[%2ld]", ( long ) vtree_get_childtab_up( v, i ) );
   printf( "\n" );
 
   printf( "down = " );
   for ( int i=0; i<v->length; i++ )
-    printf( "[%2d]", v->childtab[ i ].down );
+    printf( "[%2ld]", ( long ) vtree_get_childtab_down( v, i ) );
   printf( "\n" );
 
   printf( "next = " );
   for ( int i=0; i<v->length; i++ )
-    printf( "[%2d]", v->childtab[ i ].next );
+    printf( "[%2ld]", ( long ) vtree_get_childtab_next( v, i ) );
   printf( "\n" );
 
 }
@@ -169,17 +170,17 @@ display2( char *s, dstring_t *ds, vtree_t *v )
     printf( " %2d ", i );
     printf( "[%2c]", c );
     printf( "[%2d]", ds->text[ i ] );
-    printf( "[%2d]", v->suftab[ i ] );
-    printf( "[%2d]", v->isuftab[ i ] );
-    printf( "[%2d]", v->lcptab[ i ] );
+    printf( "[%2ld]", ( long ) vtree_get_suftab( v, i ) );
+    printf( "[%2ld]", ( long ) vtree_get_isuftab( v, i ) );
+    printf( "[%2ld]", ( long ) vtree_get_lcptab( v, i ) );
     printf( "[%2d]", v->bwtab[ i ] );
-    printf( "[%2d]", v->childtab[ i ].up );
-    printf( "[%2d]", v->childtab[ i ].down );
-    printf( "[%2d]", v->childtab[ i ].next );
+    printf( "[%2ld]", ( long ) vtree_get_childtab_up( v, i ) );
+    printf( "[%2ld]", ( long ) vtree_get_childtab_down( v, i ) );
+    printf( "[%2ld]", ( long ) vtree_get_childtab_next( v, i ) );
 
     printf( " " );
 
-    for ( int j=v->suftab[ i ]; j<v->length; j++ ) {
+    for ( int j=vtree_get_suftab( v, i ); j<v->length; j++ ) {
 
       if  ( dev_isspecial( &lowercase, ds->text[ j ] ) )
 	c = '$';
@@ -208,6 +209,71 @@ print_s( symbol_t *s, int n )
   printf( "\n" );
 }
 
+/*****************************************************************
+ * unpack - copies an index table of v into an array of pos_t    *
+ *****************************************************************/
+
+static pos_t *
+unpack( vtree_t *v, void *t, int n )
+{
+  pos_t *a = ( pos_t * ) dev_malloc( n * sizeof( pos_t ) );
+
+  for ( int i=0; i<n; i++ )
+    a[ i ] = vtree_load( t, v->width, i );
+
+  return a;
+}
+
+/*****************************************************************
+ * isChildTable - checks the decoded child table against the     *
+ * definitions of up, down and next (Abouelhoda et al.)          *
+ *****************************************************************/
+
+static int
+isChildTable( vtree_t *v ) 
+{
+  pos_t n = v->length;
+  pos_t *lcp = ( pos_t * ) dev_malloc( ( n+1 ) * sizeof( pos_t ) );
+  int ok = TRUE;
+
+  for ( pos_t i=0; i<=n; i++ )
+    lcp[ i ] = vtree_get_lcptab( v, i );
+
+  for ( pos_t i=0; i<=n && ok; i++ ) {
+
+    pos_t up = -1, down = -1, next = -1, min;
+
+    /* up: min q < i, lcp[q] > lcp[i] and lcp[k] >= lcp[q] for q < k < i */
+    min = -1;
+    for ( pos_t q=i-1; q>=0 && lcp[ q ] > lcp[ i ]; q-- )
+      if ( min == -1 || lcp[ q ] <= min ) {
+	min = lcp[ q ];
+	up = q;
+      }
+
+    /* down: max q > i, lcp[q] > lcp[i] and lcp[k] > lcp[q] for i < k < q */
+    min = -1;
+    for ( pos_t q=i+1; q<=n && lcp[ q ] > lcp[ i ]; q++ )
+      if ( min == -1 || lcp[ q ] < min ) {
+	min = lcp[ q ];
+	down = q;
+      }
+
+    /* next: min q > i, lcp[q] = lcp[i] and lcp[k] > lcp[i] for i < k < q */
+    for ( pos_t q=i+1; q<=n && lcp[ q ] >= lcp[ i ] && next == -1; q++ )
+      if ( lcp[ q ] == lcp[ i ] )
+	next = q;
+
+    ok = up == vtree_get_childtab_up( v, i ) &&
+      down == vtree_get_childtab_down( v, i ) &&
+      next == vtree_get_childtab_next( v, i );
+  }
+
+  dev_free( lcp );
+
+  return ok;
+}
+
 /*****************************************************************
  * isPermutation - checks if SA is a permutation                 *
  *****************************************************************/
@@ -283,11 +349,11 @@ isSorted( pos_t *SA, symbol_t *s, int n ) {
  *****************************************************************/
 
 static void
-generate_and_test() {
+generate_and_test( int algorithm ) {
 
-  int nmax = 8, b = 4;
+  int nmax = 8, b = 4, old = vtree_set_sa_algorithm( algorithm );
 
-  dev_log( 0, "testing all the strings of length 2..8 over a 4 letters alphabet" );
+  dev_log( 0, "testing all the strings of length 2..8 over a 4 letters alphabet (algorithm %d)", algorithm );
 
   for ( int n=2; n<=nmax;  n++) {
 
@@ -311,9 +377,16 @@ generate_and_test() {
 
       v = vtree_create( &ds );
 
-      assert( isSorted( v->suftab, v->text, n ) );
-      assert( isPermutation( v->suftab, n ) );
-      assert( isRank( v->isuftab, v->suftab, n ) );
+      pos_t *suftab = unpack( v, v->suftab, n );
+      pos_t *isuftab = unpack( v, v->isuftab, n );
+
+      assert( isSorted( suftab, v->text, n ) );
+      assert( isPermutation( suftab, n ) );
+      assert( isRank( isuftab, suftab, n ) );
+      assert( isChildTable( v ) );
+
+      dev_free( suftab );
+      dev_free( isuftab );
 
       vtree_free( v );
 
@@ -325,75 +398,2270 @@ generate_and_test() {
 
     dev_free( s );
   }
+
+  vtree_set_sa_algorithm( old );
+
   dev_log( 0, "done!" );
 }
 
 /*****************************************************************
- * f3 - a function applied to all the interior nodes of the vtree*
+ * compare_sa_algorithms - skew and SA-IS must produce the same  *
+ * suffix array, random and periodic strings.                    *
  *****************************************************************/
 
 static void
-f3( vtree_t *v, interval3_t *i )
-{
-  printf( "node <%d,%d,%d>\n", i->lcp, i->lb, i->rb );
+compare_sa_algorithms() {
+
+  int lengths[] = { 1, 2, 3, 17, 100, 1000, 5000, 50000 };
+  int alphabets[] = { 1, 2, 4, 26 };
+
+  dev_log( 0, "comparing skew and SA-IS on random and periodic strings" );
+
+  srand( 1 );
+
+  for ( int l=0; l < sizeof( lengths ) / sizeof( int ); l++ )
+    for ( int a=0; a < sizeof( alphabets ) / sizeof( int ); a++ )
+      for ( int periodic=0; periodic<2; periodic++ ) {
+
+	int n = lengths[ l ], b = alphabets[ a ];
+	int old = vtree_get_sa_algorithm();
+	vtree_t *v1, *v2;
+	dstring_t ds;
+
+	ds.text = ( symbol_t * ) dev_malloc( ( n+3 ) * sizeof( symbol_t ) );
+	ds.length = n;
+	ds.alphabet = &lowercase;
+
+	for ( int i=0; i<n; i++ )
+	  ds.text[ i ] = periodic ? 1 + ( i % 7 ) % b : 1 + rand() % b;
+
+	ds.text[ n ] = ds.text[ n+1 ] = ds.text[ n+2 ] = 0;
+
+	vtree_set_sa_algorithm( VTREE_SA_SKEW );
+	v1 = vtree_create( &ds );
+
+	vtree_set_sa_algorithm( VTREE_SA_SAIS );
+	v2 = vtree_create( &ds );
+
+	vtree_set_sa_algorithm( old );
+
+	for ( int i=0; i<n; i++ ) {
+	  assert( vtree_get_suftab( v1, i ) == vtree_get_suftab( v2, i ) );
+	  assert( vtree_get_isuftab( v1, i ) == vtree_get_isuftab( v2, i ) );
+	}
+
+	for ( int i=0; i<=n; i++ )
+	  assert( vtree_get_lcptab( v1, i ) == vtree_get_lcptab( v2, i ) );
+
+	vtree_free( v1 );
+	vtree_free( v2 );
+	dev_free( ds.text );
+      }
+
+  dev_log( 0, "done!" );
 }
 
 /*****************************************************************
- * f4 - a function applied to all the interior nodes of the vtree*
+ * compare_num_threads - the parallel construction must produce  *
+ * the same suffix array as the serial one.                      *
  *****************************************************************/
 
 static void
-f4( vtree_t *v, interval4_t *i )
-{
-  printf( "node <%d,%d,%d, [ ...(%d)... ]>\n", i->lcp, i->lb, i->rb, dev_vector_size( i->childList ) );
+compare_num_threads() {
+
+  int lengths[] = { VTREE_PAR_MIN_LENGTH + 1, 3 * VTREE_PAR_MIN_LENGTH };
+  int alphabets[] = { 2, 4, 26 };
+  int threads[] = { 2, 3, 8 };
+
+  dev_log( 0, "comparing serial and parallel constructions" );
+
+  srand( 2 );
+
+  for ( int l=0; l < sizeof( lengths ) / sizeof( int ); l++ )
+    for ( int a=0; a < sizeof( alphabets ) / sizeof( int ); a++ ) {
+
+      int n = lengths[ l ], b = alphabets[ a ];
+      int old = vtree_set_sa_algorithm( VTREE_SA_SKEW );
+      int old_threads = vtree_set_num_threads( 1 );
+      vtree_t *v1;
+      dstring_t ds;
+
+      ds.text = ( symbol_t * ) dev_malloc( ( n+3 ) * sizeof( symbol_t ) );
+      ds.length = n;
+      ds.alphabet = &lowercase;
+
+      for ( int i=0; i<n; i++ )
+	ds.text[ i ] = 1 + rand() % b;
+
+      ds.text[ n ] = ds.text[ n+1 ] = ds.text[ n+2 ] = 0;
+
+      v1 = vtree_create( &ds );
+
+      for ( int t=0; t < sizeof( threads ) / sizeof( int ); t++ ) {
+
+	vtree_t *v2;
+
+	vtree_set_num_threads( threads[ t ] );
+	v2 = vtree_create( &ds );
+
+	for ( int i=0; i<n; i++ ) {
+	  assert( vtree_get_suftab( v1, i ) == vtree_get_suftab( v2, i ) );
+	  assert( vtree_get_isuftab( v1, i ) == vtree_get_isuftab( v2, i ) );
+	}
+
+	for ( int i=0; i<=n; i++ )
+	  assert( vtree_get_lcptab( v1, i ) == vtree_get_lcptab( v2, i ) );
+
+	vtree_free( v2 );
+      }
+
+      vtree_set_num_threads( old_threads );
+      vtree_set_sa_algorithm( old );
+
+      vtree_free( v1 );
+      dev_free( ds.text );
+    }
+
+  dev_log( 0, "done!" );
 }
 
 /*****************************************************************
- * traverse_topdown -                                            *
+ * compare_widths - the tables and the queries must not depend   *
+ * on the width of the index tables.                             *
  *****************************************************************/
 
 static void
-traverse_topdown( vtree_t *v, interval2_t *i0 )
+compare_widths() {
+
+  int widths[] = { VTREE_WIDTH_16, VTREE_WIDTH_32, VTREE_WIDTH_64 };
+  int n = 2000, old = vtree_get_width();
+  vtree_t *v[ 3 ];
+  dstring_t ds;
+
+  dev_log( 0, "comparing 16, 32 and 64 bits tables" );
+
+  srand( 3 );
+
+  ds.text = ( symbol_t * ) dev_malloc( ( n+3 ) * sizeof( symbol_t ) );
+  ds.length = n;
+  ds.alphabet = &lowercase;
+
+  for ( int i=0; i<n; i++ )
+    ds.text[ i ] = 1 + rand() % 4;
+
+  ds.text[ n ] = ds.text[ n+1 ] = ds.text[ n+2 ] = 0;
+
+  for ( int w=0; w<3; w++ ) {
+    vtree_set_width( widths[ w ] );
+    v[ w ] = vtree_create( &ds );
+    assert( v[ w ]->width == widths[ w ] );
+  }
+
+  vtree_set_width( old );
+
+  for ( int w=0; w<3; w++ ) { /* decoded by range, a block at a time */
+
+    pos_t suf[ 300 ];
+
+    for ( pos_t i=0; i<n; i+=300 ) {
+      pos_t j = MIN( i+299, n-1 );
+      vtree_get_suffixes( v[ w ], i, j, suf );
+      for ( pos_t k=i; k<=j; k++ )
+	assert( suf[ k-i ] == vtree_get_suftab( v[ w ], k ) );
+    }
+  }
+
+  for ( int w=1; w<3; w++ ) {
+
+    for ( int i=0; i<=n; i++ ) {
+      if ( i<n ) {
+	assert( vtree_get_suftab( v[ 0 ], i ) == vtree_get_suftab( v[ w ], i ) );
+	assert( vtree_get_isuftab( v[ 0 ], i ) == vtree_get_isuftab( v[ w ], i ) );
+      }
+      assert( vtree_get_lcptab( v[ 0 ], i ) == vtree_get_lcptab( v[ w ], i ) );
+      assert( vtree_get_childtab_up( v[ 0 ], i ) == vtree_get_childtab_up( v[ w ], i ) );
+      assert( vtree_get_childtab_down( v[ 0 ], i ) == vtree_get_childtab_down( v[ w ], i ) );
+      assert( vtree_get_childtab_next( v[ 0 ], i ) == vtree_get_childtab_next( v[ w ], i ) );
+    }
+
+    for ( int k=0; k<1000; k++ ) {
+      pos_t i = rand() % n, j = rand() % n;
+      if ( i != j )
+	assert( vtree_lce( v[ 0 ], i, j ) == vtree_lce( v[ w ], i, j ) );
+    }
+
+    for ( symbol_t a=1; a<=4; a++ ) {
+      interval2_t *i1 = vtree_getInterval( v[ 0 ], 0, n, a, NULL );
+      interval2_t *i2 = vtree_getInterval( v[ w ], 0, n, a, NULL );
+      assert( i1->i == i2->i && i1->j == i2->j );
+      if ( i1->i != i1->j )
+	assert( vtree_getlcp( v[ 0 ], i1->i, i1->j ) == vtree_getlcp( v[ w ], i2->i, i2->j ) );
+      dev_free( i1 );
+      dev_free( i2 );
+    }
+  }
+
+  for ( int w=0; w<3; w++ )
+    vtree_free( v[ w ] );
+
+  dev_free( ds.text );
+
+  dev_log( 0, "done!" );
+}
+
+/*****************************************************************
+ * check_lcp_exceptions - long repeats produce lcp-values that   *
+ * do not fit into one byte.                                     *
+ *****************************************************************/
+
+static void
+check_lcp_exceptions() {
+
+  int n = 3000, old_threads;
+  vtree_t *v, *w;
+  dstring_t ds;
+
+  dev_log( 0, "testing lcp-values larger than %d", VTREE_LCP_MAX - 1 );
+
+  srand( 4 );
+
+  ds.text = ( symbol_t * ) dev_malloc( ( n+3 ) * sizeof( symbol_t ) );
+  ds.length = n;
+  ds.alphabet = &lowercase;
+
+  for ( int i=0; i<n; i++ )  /* a random prefix repeated 3 times, with mutations */
+    ds.text[ i ] = i < 1000 ? 1 + rand() % 4 : ( i % 400 == 0 ? 5 : ds.text[ i % 1000 ] );
+
+  ds.text[ n ] = ds.text[ n+1 ] = ds.text[ n+2 ] = 0;
+
+  v = vtree_create( &ds );
+
+  assert( v->lcpexc_size > 0 );
+
+  for ( int r=1; r<n; r++ ) {
+    pos_t i = vtree_get_suftab( v, r-1 ), j = vtree_get_suftab( v, r ), l = 0;
+    while ( i+l < n && j+l < n && ds.text[ i+l ] == ds.text[ j+l ] )
+      l++;
+    assert( vtree_get_lcptab( v, r ) == l );
+  }
+
+  for ( int k=0; k<2000; k++ ) {
+    pos_t i = rand() % n, j = rand() % n, l = 0;
+    if ( i == j )
+      continue;
+    while ( i+l < n && j+l < n && ds.text[ i+l ] == ds.text[ j+l ] )
+      l++;
+    assert( vtree_lce( v, i, j ) == l );
+  }
+
+  vtree_free( v );
+  dev_free( ds.text );
+
+  n = VTREE_PAR_MIN_LENGTH + 1000; /* the parallel construction */
+
+  ds.text = ( symbol_t * ) dev_malloc( ( n+3 ) * sizeof( symbol_t ) );
+  ds.length = n;
+
+  for ( int i=0; i<n; i++ )
+    ds.text[ i ] = i < 1000 ? 1 + rand() % 4 : ( i % 4000 == 0 ? 5 : ds.text[ i % 1000 ] );
+
+  ds.text[ n ] = ds.text[ n+1 ] = ds.text[ n+2 ] = 0;
+
+  old_threads = vtree_set_num_threads( 1 );
+  v = vtree_create_tables( &ds, VTREE_LCPTAB );
+
+  vtree_set_num_threads( 4 );
+  w = vtree_create_tables( &ds, VTREE_LCPTAB );
+
+  assert( w->lcpexc_size == v->lcpexc_size && v->lcpexc_size > 0 );
+
+  for ( int i=0; i<=n; i++ )
+    assert( vtree_get_lcptab( v, i ) == vtree_get_lcptab( w, i ) );
+
+  vtree_set_num_threads( old_threads );
+
+  vtree_free( v );
+  vtree_free( w );
+
+  dev_free( ds.text );
+
+  dev_log( 0, "done!" );
+}
+
+/*****************************************************************
+ * check_rmq - the range minimum queries must return the minimum *
+ * of the lcp-values for any block size                          *
+ *****************************************************************/
+
+static void
+check_rmq() {
+
+  int n = 5000, blocks[] = { 0, 1, 3, 32, 100, 10000 };
+  vtree_t *v;
+  dstring_t ds;
+
+  dev_log( 0, "testing the range minimum queries" );
+
+  srand( 6 );
+
+  ds.text = ( symbol_t * ) dev_malloc( ( n+3 ) * sizeof( symbol_t ) );
+  ds.length = n;
+  ds.alphabet = &lowercase;
+
+  for ( int i=0; i<n; i++ )  /* long repeats, for the lcp exceptions */
+    ds.text[ i ] = i < 1500 ? 1 + rand() % 4 : ( i % 700 == 0 ? 5 : ds.text[ i % 1500 ] );
+
+  ds.text[ n ] = ds.text[ n+1 ] = ds.text[ n+2 ] = 0;
+
+  for ( int b=0; b < sizeof( blocks ) / sizeof( int ); b++ ) {
+
+    int old = vtree_set_rmq_block( blocks[ b ] );
+
+    v = vtree_create_tables( &ds, VTREE_ISUFTAB | VTREE_LCPTAB );
+    assert( v->lcpexc_size > 0 );
+
+    for ( int k=0; k<2000; k++ ) {
+      pos_t i = rand() % n, j = rand() % n, l = 0;
+      if ( i == j )
+	continue;
+      while ( ds.text[ i+l ] == ds.text[ j+l ] )
+	l++;
+      assert( vtree_lce( v, i, j ) == l );
+    }
+
+    assert( ( v->rmqtab != NULL ) == ( blocks[ b ] > 0 ) );
+
+    for ( int k=0; k<2000; k++ ) {
+      pos_t l = rand() % ( n+1 ), r = k < 1000 ? l + rand() % 70 : rand() % ( n+1 ), min;
+      if ( r > n )
+	r = n;
+      if ( r < l ) {
+	min = l; l = r; r = min;
+      }
+      min = vtree_get_lcptab( v, l );
+      for ( pos_t m=l+1; m<=r; m++ )
+	min = MIN( min, vtree_get_lcptab( v, m ) );
+      assert( vtree_rmq( v, l, r ) == min );
+    }
+
+    vtree_release( v, VTREE_LCPTAB );
+    assert( v->rmqtab == NULL && ! ( v->tables & VTREE_RMQTAB ) );
+
+    vtree_free( v );
+    vtree_set_rmq_block( old );
+  }
+
+  dev_free( ds.text );
+
+  dev_log( 0, "done!" );
+}
+
+/*****************************************************************
+ * pair_12 - a policy pairing 1 with 2, for check_lce_k          *
+ *****************************************************************/
+
+static int
+pair_12( symbol_t a, symbol_t b, void *data )
 {
-  vector_t *childs;
+  return a == 1 && b == 2;
+}
 
-  printf( "node <%d, %d>\n", i0->i, i0->j );
+/*****************************************************************
+ * check_lce_k - the extensions with mismatches must be those of *
+ * a direct comparison of the suffixes                           *
+ *****************************************************************/
 
-  if ( i0->i == i0->j )
-    return;
+static void
+check_lce_k() {
 
-  childs = vtree_getChildIntervals( v, i0 );
+  int n = 2000;
+  lce_policy_t policy = { pair_12, 2, NULL };
+  dstring_t *ds;
+  vtree_t *v;
+  char *buffer;
 
-  for ( int k=0; k < dev_vector_size( childs ); k++ ) {
+  dev_log( 0, "testing the extensions with mismatches" );
 
-    interval2_t *child = ( interval2_t * ) dev_vector_get( childs, k );
+  srand( 8 );
 
-    traverse_topdown( v, child );
+  buffer = ( char * ) dev_malloc( n+1 );
+
+  for ( int i=0; i<n; i++ ) /* a few mutated copies of a prefix */
+    buffer[ i ] = i < 200 || rand() % 20 == 0 ? "ab"[ rand() % 2 ] : buffer[ i % 200 ];
 
+  buffer[ n ] = '\0';
+
+  ds = dev_digitalize( &lowercase, buffer ); /* the terminator ends the extensions */
+
+  v = vtree_create_tables( ds, VTREE_ISUFTAB | VTREE_LCPTAB );
+
+  for ( int t=0; t<5000; t++ ) {
+
+    pos_t i = rand() % n, j = rand() % n;
+    int k = rand() % 4;
+
+    if ( i == j )
+      continue;
+
+    for ( int p=0; p<2; p++ ) {
+
+      pos_t l = 0;
+      int mismatches = 0, compatible = 0;
+
+      while ( i+l < n && j+l < n ) {
+	symbol_t a = ds->text[ i+l ], b = ds->text[ j+l ];
+	if ( a != b ) {
+	  if ( p == 1 && compatible < policy.max_compatible && pair_12( a, b, NULL ) )
+	    compatible++;
+	  else if ( mismatches < k )
+	    mismatches++;
+	  else
+	    break;
+	}
+	l++;
+      }
+
+      assert( vtree_lce_k( v, i, j, k, p == 1 ? &policy : NULL ) == l );
+    }
   }
 
-  dev_free_vector( childs, free );
+  vtree_free( v );
+  dev_free_dstring( ds );
+  dev_free( buffer );
 
+  dev_log( 0, "done!" );
 }
 
 /*****************************************************************
- * main - main program                                           *
+ * compare_children - the iterator must yield the intervals of   *
+ * vtree_getChildIntervals, recursively                          *
  *****************************************************************/
 
-int
-main( void )
+static int
+compare_children( vtree_t *v, pos_t i, pos_t j )
 {
-  char *s1 = "mississippi", *s2 = "acaaacatat";
-  dstring_t *ds, *pattern;
+  interval2_t i0 = { i, j };
+  vector_t *childs = vtree_getChildIntervals( v, &i0 );
+  vtree_child_iter_t it;
+  int k = 0, count = 1;
+
+  for ( int more = vtree_child_first( v, i, j, &it ); more; more = vtree_child_next( &it ) ) {
+
+    interval2_t *child = ( interval2_t * ) dev_vector_get( childs, k++ );
+
+    assert( child->i == it.i && child->j == it.j && it.label == ( v->suftab != NULL ? vtree_get_suftab( v, it.i ) : -1 ) );
+
+    if ( it.i != it.j )
+      count += compare_children( v, it.i, it.j );
+  }
+
+  assert( k == dev_vector_size( childs ) );
+
+  dev_free_vector( childs, free );
+
+  return count;
+}
+
+/*****************************************************************
+ * check_child_iterator -                                        *
+ *****************************************************************/
+
+static void
+check_child_iterator() {
+
+  int widths[] = { VTREE_WIDTH_16, VTREE_WIDTH_32, VTREE_WIDTH_64 };
+  vtree_child_iter_t it;
+  dstring_t ds;
   vtree_t *v;
-  vector_t *rs, *nodes;
-  int n;
+  int n = 3000;
 
-  dev_init();
+  dev_log( 0, "testing the child iterator" );
 
-  banner();
+  srand( 9 );
+
+  ds.text = ( symbol_t * ) dev_malloc( ( n+3 ) * sizeof( symbol_t ) );
+  ds.length = n;
+  ds.alphabet = &lowercase;
+
+  for ( int i=0; i<n; i++ )
+    ds.text[ i ] = 1 + rand() % 4;
+
+  ds.text[ n ] = ds.text[ n+1 ] = ds.text[ n+2 ] = 0;
+
+  for ( int w=0; w < sizeof( widths ) / sizeof( int ); w++ ) {
+
+    int old = vtree_set_width( widths[ w ] );
+
+    v = vtree_create_tables( &ds, VTREE_CHILDTAB );
+
+    assert( compare_children( v, 0, n ) > 1 );
+    assert( ! vtree_child_first( v, 5, 5, &it ) );
+
+    vtree_free( v );
+    vtree_set_width( old );
+  }
+
+  dev_free( ds.text );
+
+  dev_log( 0, "done!" );
+}
+
+/*****************************************************************
+ * check_lazy_tables - the tables built on demand, or rebuilt    *
+ * after being released, must be those of vtree_create.         *
+ *****************************************************************/
+
+static void
+check_kmer_table() {
+
+  int n = 3000, lengths[] = { 1, 2, 3, 4, 20 };
+  vtree_t *v;
+  dstring_t ds;
+  symbol_t p[ 8 ];
+
+  dev_log( 0, "testing the prefix table" );
+
+  srand( 8 );
+
+  ds.text = ( symbol_t * ) dev_malloc( ( n+3 ) * sizeof( symbol_t ) );
+  ds.length = n;
+  ds.alphabet = &lowercase;
+
+  for ( int i=0; i<n; i++ )  /* 'e' is rare, 'f' does not occur */
+    ds.text[ i ] = i % 500 == 7 ? 5 : 1 + rand() % 4;
+
+  ds.text[ n ] = ds.text[ n+1 ] = ds.text[ n+2 ] = 0;
+
+  for ( int l=0; l < sizeof( lengths ) / sizeof( int ); l++ ) {
+
+    int old = vtree_set_kmer_length( lengths[ l ] );
+    pos_t k;
+
+    v = vtree_create_tables( &ds, VTREE_LCPTAB );
+    assert( v->kmertab == NULL );
+
+    k = vtree_kmer_interval( v, ds.text, 0, NULL, NULL );
+    assert( k == 0 && v->kmertab != NULL );
+    assert( ! ( v->tables & VTREE_SUFTAB ) );
+
+    k = v->kmertab->k;
+    assert( v->kmertab->sigma == 5 );
+    assert( k == MIN( lengths[ l ], 4 ) ); /* 5^4 <= 3000 < 5^5 */
+
+    vtree_require( v, VTREE_SUFTAB );
+
+    for ( int t=0; t<500; t++ ) {
+
+      pos_t m = 1 + rand() % 6, i = -1, j = -1, lb = -1, rb = -1, r;
+
+      for ( int d=0; d<m; d++ )
+	p[ d ] = t % 3 == 0 ? ds.text[ ( t*7 ) % ( n-6 ) + d ] : 1 + rand() % 6;
+
+      r = vtree_kmer_interval( v, p, m, &i, &j );
+
+      if ( m < k ) {
+	assert( r == 0 );
+	continue;
+      }
+
+      for ( pos_t s=0; s<n; s++ ) {
+	pos_t q = vtree_get_suftab( v, s ), d = 0;
+	while ( d < k && q+d < n && ds.text[ q+d ] == p[ d ] )
+	  d++;
+	if ( d == k ) {
+	  if ( lb < 0 )
+	    lb = s;
+	  rb = s;
+	}
+      }
+
+      if ( lb < 0 )
+	assert( r == -1 );
+      else
+	assert( r == k && i == lb && j == rb );
+    }
+
+    vtree_release( v, VTREE_KMERTAB );
+    assert( v->kmertab == NULL && ! ( v->tables & VTREE_KMERTAB ) );
+
+    vtree_free( v );
+    vtree_set_kmer_length( old );
+  }
+
+  dev_free( ds.text );
+
+  dev_log( 0, "done!" );
+}
+
+static void
+check_fm_index() {
+
+  int n = 4000, steps[] = { 1, 5, 32 }, num_texts = 3;
+  char buffer[ 301 ];
+  dstring_t ds, *texts[ 3 ];
+  vtree_t *v, *w;
+  symbol_t p[ 12 ];
+
+  dev_log( 0, "testing the FM-index" );
+
+  srand( 9 );
+
+  ds.text = ( symbol_t * ) dev_malloc( ( n+3 ) * sizeof( symbol_t ) );
+  ds.length = n;
+  ds.alphabet = &lowercase;
+
+  for ( int i=0; i<n; i++ )
+    ds.text[ i ] = i < 1000 ? 1 + rand() % 4 : ( i % 300 == 0 ? 5 : ds.text[ i % 1000 ] );
+
+  ds.text[ n-1 ] = lowercase.size; /* terminator */
+  ds.text[ n ] = ds.text[ n+1 ] = ds.text[ n+2 ] = 0;
+
+  w = vtree_create_tables( &ds, VTREE_SUFTAB );
+
+  for ( int s=0; s < sizeof( steps ) / sizeof( int ); s++ ) {
+
+    int old = vtree_set_fm_step( steps[ s ] );
+
+    v = vtree_create_tables( &ds, VTREE_FMTAB );
+    assert( v->tables == ( VTREE_BWTAB | VTREE_FMTAB ) );
+
+    for ( pos_t r=0; r<n; r++ )
+      assert( vtree_fm_locate( v, r ) == vtree_get_suftab( w, r ) );
+
+    for ( int t=0; t<300; t++ ) {
+
+      pos_t m = 1 + rand() % 12, i = -1, j = -1, count = 0, lb = -1, rb = -1;
+
+      for ( int d=0; d<m; d++ )
+	p[ d ] = t % 2 == 0 ? ds.text[ ( t*37 ) % ( n-12 ) + d ] : 1 + rand() % 6;
+
+      for ( pos_t r=0; r<n; r++ ) {
+	pos_t q = vtree_get_suftab( w, r ), d = 0;
+	while ( d < m && q+d < n && ds.text[ q+d ] == p[ d ] )
+	  d++;
+	if ( d == m ) {
+	  if ( lb < 0 )
+	    lb = r;
+	  rb = r;
+	  count++;
+	}
+      }
+
+      assert( vtree_fm_count( v, p, m, &i, &j ) == count );
+      assert( count == 0 || ( i == lb && j == rb ) );
+    }
+
+    vtree_release( v, VTREE_BWTAB );
+    assert( v->fmtab == NULL && v->tables == 0 );
+
+    vtree_free( v );
+    vtree_set_fm_step( old );
+  }
+
+  vtree_free( w );
+  dev_free( ds.text );
+
+  /* the separators of a generalized vtree */
+
+  for ( int s=0; s<num_texts; s++ ) {
+
+    int m = 1 + rand() % 300;
+
+    for ( int i=0; i<m; i++ )
+      buffer[ i ] = "acgt"[ rand() % 4 ];
+
+    buffer[ m ] = '\0';
+
+    texts[ s ] = dev_digitalize( &lowercase, buffer );
+  }
+
+  v = vtree_create_generalized( texts, num_texts, VTREE_SUFTAB | VTREE_FMTAB );
+
+  for ( pos_t r=0; r<v->length; r++ )
+    assert( vtree_fm_locate( v, r ) == vtree_get_suftab( v, r ) );
+
+  for ( int s=0; s<num_texts; s++ ) {
+
+    pos_t i, j, m = MIN( texts[ s ]->length - 1, 8 );
+
+    assert( vtree_fm_count( v, texts[ s ]->text, m, &i, &j ) >= 1 );
+
+    for ( pos_t r=i; r<=j; r++ )
+      for ( pos_t d=0; d<m; d++ )
+	assert( v->text[ vtree_get_suftab( v, r ) + d ] == texts[ s ]->text[ d ] );
+
+    assert( vtree_fm_count( v, texts[ s ]->text, texts[ s ]->length, &i, &j ) == 0 );
+  }
+
+  vtree_free( v );
+
+  for ( int s=0; s<num_texts; s++ )
+    dev_free_dstring( texts[ s ] );
+
+  dev_log( 0, "done!" );
+}
+
+/*****************************************************************
+ * check_bidir - each extension by the bidirectional index must  *
+ * give the intervals found by backward search, of the string in *
+ * forward and of its reverse in reverse                         *
+ *****************************************************************/
+
+static void
+check_bidir() {
+
+  int num_texts = 3;
+  char buffer[ 1001 ], prefix[ 64 ], filename[ 72 ];
+  dstring_t *texts[ 3 ];
+  symbol_t w[ 64 ], rw[ 64 ];
+
+  dev_log( 0, "testing the bidirectional index" );
+
+  srand( 17 );
+
+  for ( int s=0; s<num_texts; s++ ) {
+
+    int n = 1 + rand() % 1000;
+
+    for ( int i=0; i<n; i++ )
+      buffer[ i ] = i >= 100 && s != 1 ? buffer[ rand() % 4 == 0 ? rand() % i : i - 100 ] : "acgt"[ rand() % 4 ];
+
+    buffer[ n ] = '\0';
+
+    texts[ s ] = dev_digitalize( &lowercase, buffer );
+  }
+
+  sprintf( prefix, "/tmp/vtree-tests.%ld", ( long ) getpid() );
+
+  for ( int g=1; g<=num_texts; g++ ) {
+
+    vtree_bidir_t *b = vtree_create_bidir( texts, g ), *c;
+    vtree_bi_interval_t x, *y = ( vtree_bi_interval_t * ) dev_malloc( b->sigma * sizeof( vtree_bi_interval_t ) );
+
+    assert( b->forward->length == b->reverse->length );
+
+    /* saved by the first call, mapped by the second one */
+
+    for ( int k=0; k<2; k++ ) {
+
+      c = vtree_open_bidir_index( prefix, texts, g );
+
+      assert( ( c->forward->map != NULL ) == ( k == 1 ) && ( c->reverse->map != NULL ) == ( k == 1 ) );
+      assert( c->sigma == b->sigma && c->forward->length == b->forward->length );
+
+      for ( pos_t i=0; i<b->forward->length; i++ ) {
+	assert( vtree_get_suftab( c->forward, i ) == vtree_get_suftab( b->forward, i ) );
+	assert( c->forward->bwtab[ i ] == b->forward->bwtab[ i ] );
+	assert( c->reverse->bwtab[ i ] == b->reverse->bwtab[ i ] );
+      }
+
+      vtree_free_bidir( c );
+    }
+
+    sprintf( filename, "%s.fwd", prefix );
+    remove( filename );
+    sprintf( filename, "%s.rev", prefix );
+    remove( filename );
+
+    for ( int k=0; k<100; k++ ) {
+
+      int lo = 32, hi = 32; /* the string is w[ lo..hi-1 ] */
+
+      vtree_bidir_root( b, &x );
+
+      for ( int step=0; step<30; step++ ) {
+
+	int left = rand() % 2, num = 0;
+
+	if ( left )
+	  vtree_bidir_extend_left( b, &x, y );
+	else
+	  vtree_bidir_extend_right( b, &x, y );
+
+	for ( symbol_t a=0; a<b->sigma; a++ ) {
+
+	  pos_t i, j, ri, rj, m = hi - lo + 1, count;
+
+	  w[ left ? lo-1 : hi ] = a;
+
+	  for ( pos_t d=0; d<m; d++ )
+	    rw[ d ] = w[ ( left ? hi-1 : hi ) - d ];
+
+	  count = vtree_fm_count( b->forward, w + ( left ? lo-1 : lo ), m, &i, &j );
+
+	  assert( vtree_fm_count( b->reverse, rw, m, &ri, &rj ) == count );
+
+	  if ( count == 0 )
+	    assert( y[ a ].i > y[ a ].j );
+	  else {
+	    assert( y[ a ].i == i && y[ a ].j == j );
+	    assert( y[ a ].ri == ri && y[ a ].rj == rj );
+	    num++;
+	  }
+	}
+
+	if ( num == 0 )
+	  break;
+
+	/* a random extension that occurs */
+
+	symbol_t a = 0;
+
+	for ( int c = rand() % num; y[ a ].i > y[ a ].j || c-- > 0; a++ )
+	  ;
+
+	w[ left ? --lo : hi++ ] = a;
+	x = y[ a ];
+      }
+    }
+
+    dev_free( y );
+    vtree_free_bidir( b );
+  }
+
+  for ( int s=0; s<num_texts; s++ )
+    dev_free_dstring( texts[ s ] );
+
+  dev_log( 0, "done!" );
+}
+
+static void
+check_batch() {
+
+  int num_texts = 4, num_patterns = 400, threads[] = { 1, 3 };
+  char buffer[ 1001 ];
+  dstring_t *texts[ 4 ], *patterns[ 400 ];
+  vtree_hit_t *hits;
+  vtree_t *v;
+
+  dev_log( 0, "testing the batched search" );
+
+  srand( 10 );
+
+  for ( int s=0; s<num_texts; s++ ) {
+
+    int n = 1 + rand() % 1000;
+
+    for ( int i=0; i<n; i++ )
+      buffer[ i ] = i >= 100 && s % 2 == 0 ? buffer[ i % 100 ] : "acgt"[ rand() % 4 ];
+
+    buffer[ n ] = '\0';
+
+    texts[ s ] = dev_digitalize( &lowercase, buffer );
+  }
+
+  /* substrings, their prefixes, duplicates and random strings */
+
+  for ( int k=0; k<num_patterns; k++ ) {
+
+    dstring_t *t = texts[ rand() % num_texts ];
+    int m = rand() % 12, p = rand() % t->length;
+
+    patterns[ k ] = dev_new_dstring( &lowercase, m+1, 0 );
+    patterns[ k ]->length = m; /* no terminator */
+
+    if ( k > 0 && k % 5 == 0 ) {
+      patterns[ k ]->length = MIN( m, patterns[ k-1 ]->length );
+      for ( int d=0; d<patterns[ k ]->length; d++ )
+	patterns[ k ]->text[ d ] = patterns[ k-1 ]->text[ d ];
+    } else {
+      for ( int d=0; d<m; d++ )
+	patterns[ k ]->text[ d ] = k % 3 == 0 || p+d >= t->length - 1 ? 1 + rand() % 4 : t->text[ p+d ];
+    }
+  }
+
+  for ( int g=1; g<=2; g++ ) {
+
+    v = g == 1 ? vtree_create( texts[ 0 ] ) : vtree_create_generalized( texts, num_texts, VTREE_ALL );
+
+    for ( int t=0; t < sizeof( threads ) / sizeof( int ); t++ ) {
+
+      int old = vtree_set_num_threads( threads[ t ] );
+      pos_t num_hits, h = 0;
+
+      hits = vtree_find_batch( v, patterns, num_patterns, &num_hits );
+
+      for ( int k=0; k<num_patterns; k++ ) {
+
+	pos_t m = patterns[ k ]->length;
+
+	for ( int s=0; s < ( g == 1 ? 1 : num_texts ); s++ )
+	  for ( pos_t p=0; m > 0 && p + m < texts[ s ]->length; p++ ) {
+
+	    pos_t d = 0;
+
+	    while ( d < m && texts[ s ]->text[ p+d ] == patterns[ k ]->text[ d ] )
+	      d++;
+
+	    if ( d == m ) {
+	      assert( h < num_hits );
+	      assert( hits[ h ].pattern == k && hits[ h ].seq == s && hits[ h ].pos == p );
+	      h++;
+	    }
+	  }
+      }
+
+      assert( h == num_hits );
+
+      dev_free( hits );
+      vtree_set_num_threads( old );
+    }
+
+    vtree_free( v );
+  }
+
+  for ( int k=0; k<num_patterns; k++ )
+    dev_free_dstring( patterns[ k ] );
+
+  for ( int s=0; s<num_texts; s++ )
+    dev_free_dstring( texts[ s ] );
+
+  dev_log( 0, "done!" );
+}
+
+/*****************************************************************
+ * collect_t - intervals visited by the bottom-up traversals     *
+ *****************************************************************/
+
+typedef struct {
+  interval3_t *nodes;
+  pos_t size;
+  pos_t roots;  /* leaves below the roots */
+} collect_t;
+
+static collect_t *with_array; /* the collection of collect_array */
+
+static void
+collect_leaf( vtree_t *v, pos_t i, vtree_node_t *parent, void *arg )
+{
+  assert( parent->lb <= i && parent->rb == -1 );
+  ( ( pos_t * ) parent->data )[ 0 ]++;
+}
+
+static void
+collect_node( vtree_t *v, vtree_node_t *node, vtree_node_t *parent, void *arg )
+{
+  collect_t *c = ( collect_t * ) arg;
+  pos_t leaves = ( ( pos_t * ) node->data )[ 0 ];
+
+  assert( leaves == node->rb - node->lb + 1 - ( node->rb == v->length ) );
+
+  if ( parent == NULL ) {
+    c->roots += leaves;
+    return;
+  }
+
+  assert( parent->lcp < node->lcp && parent->lb <= node->lb && parent->rb == -1 );
+  ( ( pos_t * ) parent->data )[ 0 ] += leaves;
+
+  c->nodes[ c->size ].lcp = node->lcp;
+  c->nodes[ c->size ].lb = node->lb;
+  c->nodes[ c->size++ ].rb = node->rb;
+}
+
+static void
+collect_array( vtree_t *v, interval3_t *node )
+{
+  with_array->nodes[ with_array->size++ ] = *node;
+}
+
+static void
+collect_topdown( vtree_t *v, pos_t i, pos_t j, collect_t *c )
+{
+  vtree_child_iter_t it;
+
+  if ( j < v->length ) {
+    c->nodes[ c->size ].lcp = vtree_getlcp( v, i, j );
+    c->nodes[ c->size ].lb = i;
+    c->nodes[ c->size++ ].rb = j;
+  }
+
+  for ( int more = vtree_child_first( v, i, j, &it ); more; more = vtree_child_next( &it ) )
+    if ( it.i < it.j )
+      collect_topdown( v, it.i, it.j, c );
+}
+
+static int
+compare_nodes( const void *a, const void *b )
+{
+  const interval3_t *x = a, *y = b;
+
+  if ( x->lb != y->lb )
+    return x->lb < y->lb ? -1 : 1;
+
+  return x->rb > y->rb ? -1 : ( x->rb < y->rb );
+}
+
+static void
+check_bottom_up() {
+
+  int n = 5000, num_ranges;
+  vtree_bottom_up_t t = { collect_node, collect_leaf, sizeof( pos_t ) };
+  collect_t ref, seq, array, par[ 4 ];
+  void *args[ 4 ];
+  dstring_t ds;
+  vtree_t *v;
+
+  dev_log( 0, "testing the bottom-up traversals" );
+
+  srand( 12 );
+
+  ds.text = ( symbol_t * ) dev_malloc( ( n+3 ) * sizeof( symbol_t ) );
+  ds.length = n;
+  ds.alphabet = &lowercase;
+
+  for ( int i=0; i<n; i++ )
+    ds.text[ i ] = i < 700 ? 1 + rand() % 4 : ( i % 350 == 0 ? 5 : ds.text[ i % 700 ] );
+
+  ds.text[ n-1 ] = lowercase.size; /* terminator */
+  ds.text[ n ] = ds.text[ n+1 ] = ds.text[ n+2 ] = 0;
+
+  v = vtree_create( &ds );
+
+  ref.nodes = ( interval3_t * ) dev_malloc( n * sizeof( interval3_t ) );
+  seq.nodes = ( interval3_t * ) dev_malloc( n * sizeof( interval3_t ) );
+  array.nodes = ( interval3_t * ) dev_malloc( n * sizeof( interval3_t ) );
+  ref.size = seq.size = array.size = 0;
+  seq.roots = 0;
+
+  collect_topdown( v, 0, v->length, &ref );
+  qsort( ref.nodes, ref.size, sizeof( interval3_t ), compare_nodes );
+
+  vtree_bottom_up( v, &t, &seq );
+  assert( seq.roots == n );
+
+  with_array = &array;
+  vtree_traverse_with_array( v, collect_array );
+
+  assert( seq.size == ref.size && array.size == ref.size );
+
+  for ( pos_t k=0; k<seq.size; k++ ) /* same order */
+    assert( memcmp( seq.nodes + k, array.nodes + k, sizeof( interval3_t ) ) == 0 );
+
+  qsort( seq.nodes, seq.size, sizeof( interval3_t ), compare_nodes );
+
+  for ( pos_t k=0; k<seq.size; k++ )
+    assert( memcmp( seq.nodes + k, ref.nodes + k, sizeof( interval3_t ) ) == 0 );
+
+  /* the union of the ranges */
+
+  for ( int r=1; r<=4; r++ ) {
+
+    pos_t size = 0, roots = 0;
+
+    for ( int k=0; k<r; k++ ) {
+      par[ k ].nodes = ( interval3_t * ) dev_malloc( n * sizeof( interval3_t ) );
+      par[ k ].size = par[ k ].roots = 0;
+      args[ k ] = par + k;
+    }
+
+    num_ranges = vtree_bottom_up_parallel( v, &t, args, r );
+    assert( num_ranges >= 1 && num_ranges <= r );
+    assert( r == 1 || num_ranges > 1 );
+
+    for ( int k=0; k<num_ranges; k++ ) {
+      memcpy( seq.nodes + size, par[ k ].nodes, par[ k ].size * sizeof( interval3_t ) );
+      size += par[ k ].size;
+      roots += par[ k ].roots;
+    }
+
+    assert( roots == n && size == ref.size );
+
+    qsort( seq.nodes, size, sizeof( interval3_t ), compare_nodes );
+
+    for ( pos_t k=0; k<size; k++ )
+      assert( memcmp( seq.nodes + k, ref.nodes + k, sizeof( interval3_t ) ) == 0 );
+
+    for ( int k=0; k<r; k++ )
+      dev_free( par[ k ].nodes );
+  }
+
+  dev_free( ref.nodes );
+  dev_free( seq.nodes );
+  dev_free( array.nodes );
+  vtree_free( v );
+  dev_free( ds.text );
+
+  dev_log( 0, "done!" );
+}
+
+static void
+check_lazy_tables() {
+
+  int n = 3000;
+  vtree_t *v, *w;
+  dstring_t ds;
+
+  dev_log( 0, "testing the demand-driven construction" );
+
+  srand( 5 );
+
+  ds.text = ( symbol_t * ) dev_malloc( ( n+3 ) * sizeof( symbol_t ) );
+  ds.length = n;
+  ds.alphabet = &lowercase;
+
+  for ( int i=0; i<n; i++ )
+    ds.text[ i ] = 1 + rand() % 4;
+
+  ds.text[ n ] = ds.text[ n+1 ] = ds.text[ n+2 ] = 0;
+
+  v = vtree_create( &ds );
+
+  w = vtree_create_tables( &ds, VTREE_ISUFTAB | VTREE_LCPTAB );
+  assert( w->tables == ( VTREE_ISUFTAB | VTREE_LCPTAB ) );
+  assert( w->suftab == NULL && w->bwtab == NULL && w->childtab == NULL );
+
+  for ( int k=0; k<1000; k++ ) {
+    pos_t i = rand() % n, j = rand() % n;
+    if ( i != j )
+      assert( vtree_lce( v, i, j ) == vtree_lce( w, i, j ) );
+  }
+
+  for ( symbol_t a=1; a<=4; a++ ) { /* requires suftab and childtab */
+    interval2_t *i1 = vtree_getInterval( v, 0, n, a, NULL );
+    interval2_t *i2 = vtree_getInterval( w, 0, n, a, NULL );
+    assert( i1->i == i2->i && i1->j == i2->j );
+    dev_free( i1 );
+    dev_free( i2 );
+  }
+
+  assert( w->tables == ( ( VTREE_ALL & ~VTREE_BWTAB ) | VTREE_RMQTAB ) ); /* vtree_lce built rmqtab */
+
+  vtree_release( w, VTREE_SUFTAB | VTREE_LCPTAB );
+  assert( w->tables == VTREE_ISUFTAB );
+  assert( w->suftab == NULL && w->lcptab == NULL && w->childtab == NULL );
+
+  vtree_require( w, VTREE_ALL );
+
+  for ( int i=0; i<=n; i++ ) {
+    if ( i<n ) {
+      assert( vtree_get_suftab( v, i ) == vtree_get_suftab( w, i ) );
+      assert( vtree_get_isuftab( v, i ) == vtree_get_isuftab( w, i ) );
+      assert( v->bwtab[ i ] == w->bwtab[ i ] );
+    }
+    assert( vtree_get_lcptab( v, i ) == vtree_get_lcptab( w, i ) );
+    assert( vtree_get_childtab_up( v, i ) == vtree_get_childtab_up( w, i ) );
+    assert( vtree_get_childtab_down( v, i ) == vtree_get_childtab_down( w, i ) );
+    assert( vtree_get_childtab_next( v, i ) == vtree_get_childtab_next( w, i ) );
+  }
+
+  vtree_free( w );
+
+  w = vtree_create_tables( &ds, VTREE_BWTAB );
+  assert( w->tables == VTREE_BWTAB );
+
+  for ( int i=0; i<n; i++ )
+    assert( v->bwtab[ i ] == w->bwtab[ i ] );
+
+  vtree_free( w );
+  vtree_free( v );
+  dev_free( ds.text );
+
+  dev_log( 0, "done!" );
+}
+
+/*****************************************************************
+ * check_builder - the vtrees created with a builder, which      *
+ * reuses its workspace, must be those of vtree_create.          *
+ *****************************************************************/
+
+static void
+check_builder() {
+
+  int lengths[] = { 1, 2, 3, 50, 7, 500, 20, 3000, 10 };
+  vtree_builder_t *b;
+  dstring_t ds;
+
+  dev_log( 0, "testing the builder" );
+
+  srand( 6 );
+
+  b = vtree_new_builder();
+
+  for ( int k=0; k<9; k++ ) {
+
+    int n = lengths[ k ];
+    vtree_t *v, *w;
+
+    ds.text = ( symbol_t * ) dev_malloc( ( n+3 ) * sizeof( symbol_t ) );
+    ds.length = n;
+    ds.alphabet = &lowercase;
+
+    for ( int i=0; i<n; i++ )
+      ds.text[ i ] = 1 + rand() % 4;
+
+    ds.text[ n ] = ds.text[ n+1 ] = ds.text[ n+2 ] = 0;
+
+    v = vtree_create( &ds );
+
+    w = vtree_build( b, &ds, VTREE_SUFTAB | VTREE_CHILDTAB );
+    assert( b->top == 0 );
+    assert( w->tables == ( VTREE_SUFTAB | VTREE_LCPTAB | VTREE_CHILDTAB ) );
+    assert( w->embedded == w->tables );
+
+    vtree_release( w, VTREE_CHILDTAB );
+    vtree_require( w, VTREE_ALL );
+
+    for ( int i=0; i<=n; i++ ) {
+      if ( i<n ) {
+	assert( vtree_get_suftab( v, i ) == vtree_get_suftab( w, i ) );
+	assert( vtree_get_isuftab( v, i ) == vtree_get_isuftab( w, i ) );
+	assert( v->bwtab[ i ] == w->bwtab[ i ] );
+      }
+      assert( vtree_get_lcptab( v, i ) == vtree_get_lcptab( w, i ) );
+      assert( vtree_get_childtab_up( v, i ) == vtree_get_childtab_up( w, i ) );
+      assert( vtree_get_childtab_down( v, i ) == vtree_get_childtab_down( w, i ) );
+      assert( vtree_get_childtab_next( v, i ) == vtree_get_childtab_next( w, i ) );
+    }
+
+    vtree_free( w );
+    vtree_free( v );
+    dev_free( ds.text );
+  }
+
+  vtree_free_builder( b );
+
+  dev_log( 0, "done!" );
+}
+
+/*****************************************************************
+ * check_index_files - a vtree mapped from a file must answer    *
+ * like the one that was saved                                   *
+ *****************************************************************/
+
+static void
+check_index_files() {
+
+  int n = 3000;
+  char filename[ 64 ];
+  vtree_t *v, *w;
+  dstring_t ds;
+  FILE *fh;
+
+  dev_log( 0, "testing the index files" );
+
+  sprintf( filename, "/tmp/vtree-tests.%ld", ( long ) getpid() );
+
+  srand( 7 );
+
+  ds.text = ( symbol_t * ) dev_malloc( ( n+3 ) * sizeof( symbol_t ) );
+  ds.length = n;
+  ds.alphabet = &lowercase;
+
+  for ( int i=0; i<n; i++ ) /* long repeats, for the lcp exceptions */
+    ds.text[ i ] = i < 1000 ? 1 + rand() % 4 : ds.text[ i % 1000 ];
+
+  ds.text[ n ] = ds.text[ n+1 ] = ds.text[ n+2 ] = 0;
+
+  v = vtree_create_tables( &ds, VTREE_SUFTAB );
+
+  vtree_save( v, filename );
+
+  w = vtree_open_mmap( filename );
+  assert( w != NULL && w->map != NULL );
+  assert( w->length == n && w->width == v->width && w->tables == VTREE_ALL );
+  assert( w->lcpexc_size == v->lcpexc_size && v->lcpexc_size > 0 );
+
+  for ( int i=0; i<n+3; i++ )
+    assert( w->text[ i ] == v->text[ i ] );
+
+  for ( int i=0; i<=n; i++ ) {
+    if ( i<n ) {
+      assert( vtree_get_suftab( v, i ) == vtree_get_suftab( w, i ) );
+      assert( vtree_get_isuftab( v, i ) == vtree_get_isuftab( w, i ) );
+      assert( v->bwtab[ i ] == w->bwtab[ i ] );
+    }
+    assert( vtree_get_lcptab( v, i ) == vtree_get_lcptab( w, i ) );
+    assert( vtree_get_childtab_up( v, i ) == vtree_get_childtab_up( w, i ) );
+    assert( vtree_get_childtab_down( v, i ) == vtree_get_childtab_down( w, i ) );
+    assert( vtree_get_childtab_next( v, i ) == vtree_get_childtab_next( w, i ) );
+  }
+
+  for ( int k=0; k<1000; k++ ) {
+    pos_t i = rand() % n, j = rand() % n;
+    if ( i != j )
+      assert( vtree_lce( v, i, j ) == vtree_lce( w, i, j ) );
+  }
+
+  vtree_release( w, VTREE_LCPTAB ); /* rebuilt outside of the mapping */
+  vtree_require( w, VTREE_CHILDTAB );
+  assert( vtree_getlcp( w, 0, n-1 ) == vtree_getlcp( v, 0, n-1 ) );
+
+  vtree_free( w );
+
+  w = vtree_open_index( filename, &ds ); /* same text, mapped */
+  assert( w->map != NULL );
+  vtree_free( w );
+
+  remove( filename );
+
+  ds.text[ 0 ] = 5;
+
+  w = vtree_open_index( filename, &ds ); /* no index, created and saved */
+  assert( w->map == NULL && w->text[ 0 ] == 5 );
+  vtree_free( w );
+
+  w = vtree_open_mmap( filename );
+  assert( w != NULL && w->text[ 0 ] == 5 );
+  vtree_free( w );
+
+  fh = fopen( filename, "r+" ); /* not an index */
+  fputs( "garbage", fh );
+  fclose( fh );
+  assert( vtree_open_mmap( filename ) == NULL );
+
+  remove( filename );
+  assert( vtree_open_mmap( filename ) == NULL );
+
+  vtree_free( v );
+  dev_free( ds.text );
+
+  dev_log( 0, "done!" );
+}
+
+/*****************************************************************
+ * check_generalized - the suffixes of each text of a generalized *
+ * vtree must be in the order of the vtree of the text alone     *
+ *****************************************************************/
+
+static void
+check_generalized() {
+
+  int num_texts = 6;
+  char filename[ 64 ], *buffer;
+  dstring_t *texts[ 6 ];
+  vtree_t *vs[ 6 ], *g, *w;
+  pos_t count[ 6 ];
+
+  dev_log( 0, "testing the generalized vtrees" );
+
+  sprintf( filename, "/tmp/vtree-tests.%ld", ( long ) getpid() );
+
+  srand( 11 );
+
+  buffer = ( char * ) dev_malloc( 201 );
+
+  for ( int s=0; s<num_texts; s++ ) {
+
+    int n = 1 + rand() % 200;
+
+    for ( int i=0; i<n; i++ )
+      buffer[ i ] = "acgt"[ rand() % ( s == 2 ? 1 : 4 ) ];
+
+    buffer[ n ] = '\0';
+
+    texts[ s ] = dev_digitalize( &lowercase, buffer );
+  }
+
+  for ( int s=0; s<num_texts; s++ )
+    vs[ s ] = vtree_create_tables( texts[ s ], VTREE_SUFTAB );
+
+  for ( int k=1; k<=num_texts; k++ ) {
+
+    g = vtree_create_generalized( texts, k, VTREE_SUFTAB );
+
+    assert( g->num_seqs == k );
+
+    for ( int s=0; s<k; s++ ) {
+      assert( vtree_seq_end( g, s ) - g->seqstart[ s ] == texts[ s ]->length - 1 );
+      count[ s ] = 0;
+    }
+
+    for ( pos_t i=0; i<g->length; i++ ) {
+
+      pos_t p = vtree_get_suftab( g, i );
+      int s = vtree_get_seq( g, i );
+
+      assert( g->seqstart[ s ] <= p && p < g->seqstart[ s+1 ] );
+      assert( vtree_get_suftab( vs[ s ], count[ s ] ) == p - g->seqstart[ s ] );
+
+      count[ s ]++;
+    }
+
+    for ( int s=0; s<k; s++ )
+      assert( count[ s ] == texts[ s ]->length );
+
+    vtree_save( g, filename );
+
+    w = vtree_open_mmap( filename );
+    assert( w != NULL && w->num_seqs == k );
+
+    for ( int s=1; s<k; s++ )
+      assert( w->seqstart[ s ] == g->seqstart[ s ] );
+
+    vtree_free( w );
+
+    /* created and saved, then mapped by the next call */
+
+    remove( filename );
+
+    for ( int c=0; c<2; c++ ) {
+
+      w = vtree_open_generalized_index( filename, texts, k, VTREE_SUFTAB | VTREE_NODETAB );
+
+      assert( ( w->map != NULL ) == ( c == 1 ) && w->num_seqs == k );
+      assert( w->tables & VTREE_NODETAB && ( c == 1 || ! ( w->tables & VTREE_LCPTAB ) ) );
+
+      for ( pos_t i=0; i<=g->length; i++ )
+	assert( vtree_get_suftab( w, i ) == vtree_get_suftab( g, i ) );
+
+      vtree_free( w );
+    }
+
+    vtree_free( g );
+  }
+
+  remove( filename );
+
+  for ( int s=0; s<num_texts; s++ ) {
+    vtree_free( vs[ s ] );
+    dev_free_dstring( texts[ s ] );
+  }
+
+  dev_free( buffer );
+
+  dev_log( 0, "done!" );
+}
+
+/*****************************************************************
+ * check_extend - extending a vtree must give the tables of the  *
+ * generalized vtree of all the texts                            *
+ *****************************************************************/
+
+static void
+check_extend() {
+
+  int num_texts = 5;
+  char *buffer, *common;
+  dstring_t *texts[ 5 ];
+  vtree_t *f, *g, *e;
+
+  dev_log( 0, "testing the extension of vtrees" );
+
+  srand( 13 );
+
+  buffer = ( char * ) dev_malloc( 701 );
+  common = ( char * ) dev_malloc( 401 );
+
+  for ( int i=0; i<400; i++ ) /* shared by the texts, for the lcp exceptions */
+    common[ i ] = "acgt"[ rand() % 4 ];
+
+  for ( int s=0; s<num_texts; s++ ) {
+
+    int n = 1 + rand() % 700;
+
+    for ( int i=0; i<n; i++ )
+      buffer[ i ] = i >= 100 && i < 500 ? common[ i-100 ] : "acgt"[ rand() % 4 ];
+
+    buffer[ n ] = '\0';
+
+    texts[ s ] = dev_digitalize( &lowercase, buffer );
+  }
+
+  f = vtree_create_generalized( texts, num_texts, VTREE_ALL );
+
+  assert( f->lcpexc_size > 0 );
+
+  for ( int k=1; k<num_texts; k++ ) {
+
+    if ( k == 1 )
+      g = vtree_create_tables( texts[ 0 ], VTREE_SUFTAB ); /* an ordinary vtree */
+    else
+      g = vtree_create_generalized( texts, k, VTREE_SUFTAB );
+
+    e = vtree_extend( g, texts + k, num_texts - k, VTREE_ALL );
+
+    assert( e->length == f->length && e->num_seqs == f->num_seqs );
+    assert( e->alphabet_size == f->alphabet_size && e->lcpexc_size == f->lcpexc_size );
+
+    for ( int s=0; s<=num_texts; s++ )
+      assert( e->seqstart[ s ] == f->seqstart[ s ] );
+
+    for ( pos_t i=0; i<f->length+3; i++ )
+      assert( e->text[ i ] == f->text[ i ] );
+
+    for ( pos_t i=0; i<=f->length; i++ ) {
+      assert( vtree_get_suftab( e, i ) == vtree_get_suftab( f, i ) );
+      assert( vtree_get_isuftab( e, i ) == vtree_get_isuftab( f, i ) );
+      assert( vtree_get_lcptab( e, i ) == vtree_get_lcptab( f, i ) );
+      assert( vtree_get_childtab_up( e, i ) == vtree_get_childtab_up( f, i ) );
+      assert( vtree_get_childtab_down( e, i ) == vtree_get_childtab_down( f, i ) );
+      assert( vtree_get_childtab_next( e, i ) == vtree_get_childtab_next( f, i ) );
+      if ( i < f->length )
+	assert( e->bwtab[ i ] == f->bwtab[ i ] );
+    }
+
+    vtree_free( e );
+
+    e = vtree_extend( g, texts + k, num_texts - k, VTREE_CHILDTAB ); /* without the suffix array */
+
+    assert( e->tables == ( VTREE_LCPTAB | VTREE_CHILDTAB ) );
+    assert( vtree_getlcp( e, 0, e->length - 1 ) == vtree_getlcp( f, 0, f->length - 1 ) );
+
+    vtree_free( e );
+    vtree_free( g );
+  }
+
+  vtree_free( f );
+
+  for ( int s=0; s<num_texts; s++ )
+    dev_free_dstring( texts[ s ] );
+
+  dev_free( buffer );
+  dev_free( common );
+
+  dev_log( 0, "done!" );
+}
+
+/*****************************************************************
+ * tuples_t - the MUMs and MEMs reported, as length and up to 3  *
+ * positions, -1 for none                                        *
+ *****************************************************************/
+
+typedef struct {
+  pos_t ( *items )[ 4 ];
+  pos_t size;
+} tuples_t;
+
+static void
+add_tuple( tuples_t *t, pos_t length, pos_t *pos, int num )
+{
+  t->items = dev_realloc( t->items, ( t->size + 1 ) * sizeof( t->items[ 0 ] ) );
+
+  t->items[ t->size ][ 0 ] = length;
+
+  for ( int k=0; k<3; k++ )
+    t->items[ t->size ][ k+1 ] = k < num ? pos[ k ] : -1;
+
+  t->size++;
+}
+
+static void
+collect_match( vtree_t *v, pos_t length, pos_t *pos, int num, void *arg )
+{
+  assert( num <= 3 );
+
+  add_tuple( ( tuples_t * ) arg, length, pos, num );
+}
+
+static int
+compare_tuples( const void *a, const void *b )
+{
+  const pos_t *x = a, *y = b;
+
+  for ( int k=0; k<4; k++ )
+    if ( x[ k ] != y[ k ] )
+      return x[ k ] < y[ k ] ? -1 : 1;
+
+  return 0;
+}
+
+/*****************************************************************
+ * check_mums - MUMs and MEMs against a brute-force enumeration  *
+ * over the text of the vtree                                    *
+ *****************************************************************/
+
+static void
+check_mums() {
+
+  int num_texts = 3;
+  char first[ 81 ], buffer[ 81 ];
+  dstring_t *texts[ 3 ];
+
+  dev_log( 0, "testing the MUMs and MEMs" );
+
+  srand( 12 );
+
+  /* the others share segments of the first text, the second one has a repeat */
+
+  for ( int s=0; s<num_texts; s++ ) {
+
+    int n = 40 + rand() % 40, a = rand() % 30;
+
+    for ( int i=0; i<n; i++ )
+      if ( s > 0 && i >= a && i < a + 12 )
+	buffer[ i ] = first[ i - a + 5 * s ];
+      else if ( s == 1 && i >= 60 )
+	buffer[ i ] = buffer[ i - 50 ];
+      else
+	buffer[ i ] = "acgt"[ rand() % 4 ];
+
+    buffer[ n ] = '\0';
+
+    if ( s == 0 )
+      strcpy( first, buffer );
+
+    texts[ s ] = dev_digitalize( &lowercase, buffer );
+  }
+
+  for ( int k=1; k<=num_texts; k++ )
+    for ( pos_t min_length=1; min_length<=4; min_length+=3 ) {
+
+      vtree_t *v = vtree_create_generalized( texts, k, VTREE_SUFTAB );
+      symbol_t *x = v->text, sigma = v->alphabet_size - ( k - 1 );
+      tuples_t found = { NULL, 0 }, expected = { NULL, 0 };
+
+      /* MEMs, the pairs of positions of two sequences, or of the text, that are left- and right-maximal */
+
+      vtree_findall_mems( v, min_length, collect_match, &found );
+
+      for ( pos_t p=0; p<v->length; p++ )
+	for ( pos_t q=p+1; q<v->length; q++ ) {
+
+	  pos_t l = 0, pos[ 2 ] = { p, q };
+
+	  if ( k > 1 && vtree_seq_of( v, p ) == vtree_seq_of( v, q ) )
+	    continue;
+
+	  if ( p > 0 && x[ p-1 ] == x[ q-1 ] && x[ p-1 ] < sigma )
+	    continue;
+
+	  while ( q+l < v->length && x[ p+l ] == x[ q+l ] && x[ p+l ] < sigma )
+	    l++;
+
+	  if ( l >= min_length )
+	    add_tuple( &expected, l, pos, 2 );
+	}
+
+      assert( found.size == expected.size );
+
+      qsort( found.items, found.size, sizeof( found.items[ 0 ] ), compare_tuples );
+      qsort( expected.items, expected.size, sizeof( expected.items[ 0 ] ), compare_tuples );
+
+      for ( pos_t i=0; i<found.size; i++ )
+	assert( compare_tuples( found.items[ i ], expected.items[ i ] ) == 0 );
+
+      /* MUMs, the substrings of the first sequence that occur once in each sequence and are maximal */
+
+      found.size = expected.size = 0;
+
+      vtree_findall_mums( v, min_length, collect_match, &found );
+
+      for ( pos_t p=0; k > 1 && p < v->seqstart[ 1 ]; p++ )
+	for ( pos_t l=min_length; p+l <= v->seqstart[ 1 ] && x[ p+l-1 ] < sigma; l++ ) {
+
+	  pos_t pos[ 3 ];
+	  int count[ 3 ] = { 0, 0, 0 }, left = FALSE, right = FALSE, unique = TRUE;
+
+	  for ( pos_t q=0; q+l <= v->length; q++ ) {
+
+	    pos_t d = 0;
+
+	    while ( d < l && x[ q+d ] == x[ p+d ] )
+	      d++;
+
+	    if ( d == l ) {
+	      int s = vtree_seq_of( v, q );
+	      count[ s ]++;
+	      pos[ s ] = q;
+	    }
+	  }
+
+	  for ( int s=0; s<k; s++ )
+	    unique = unique && count[ s ] == 1;
+
+	  if ( ! unique )
+	    continue;
+
+	  for ( int s=0; s<k; s++ ) {
+	    left = left || pos[ s ] == 0 || x[ pos[ s ]-1 ] >= sigma || x[ pos[ s ]-1 ] != x[ pos[ 0 ]-1 ];
+	    right = right || x[ pos[ s ]+l ] >= sigma || x[ pos[ s ]+l ] != x[ pos[ 0 ]+l ];
+	  }
+
+	  if ( left && right )
+	    add_tuple( &expected, l, pos, k );
+	}
+
+      assert( found.size == expected.size );
+
+      qsort( found.items, found.size, sizeof( found.items[ 0 ] ), compare_tuples );
+      qsort( expected.items, expected.size, sizeof( expected.items[ 0 ] ), compare_tuples );
+
+      for ( pos_t i=0; i<found.size; i++ )
+	assert( compare_tuples( found.items[ i ], expected.items[ i ] ) == 0 );
+
+      dev_free( found.items );
+      dev_free( expected.items );
+      vtree_free( v );
+    }
+
+  for ( int s=0; s<num_texts; s++ )
+    dev_free_dstring( texts[ s ] );
+
+  dev_log( 0, "done!" );
+}
+
+/*****************************************************************
+ * check_link - the suffix link of each lcp-interval, against    *
+ * the definition                                                *
+ *****************************************************************/
+
+static void
+check_link( vtree_t *v, vtree_node_t *node, vtree_node_t *parent, void *arg )
+{
+  pos_t lb, rb, a, b, m = node->lcp - 1;
+
+  if ( parent == NULL )
+    return;
+
+  vtree_suffix_link( v, node->lb, node->rb, &lb, &rb );
+
+  a = vtree_get_isuftab( v, vtree_get_suftab( v, node->lb ) + 1 );
+  b = vtree_get_isuftab( v, vtree_get_suftab( v, node->rb ) + 1 );
+
+  assert( lb <= a && b <= rb );
+
+  if ( m == 0 ) {
+    assert( lb == 0 && rb == v->length );
+    return;
+  }
+
+  assert( vtree_getlcp( v, lb, rb ) == m );
+  assert( vtree_get_lcptab( v, lb ) < m && vtree_get_lcptab( v, rb+1 ) < m );
+}
+
+/*****************************************************************
+ * check_matching_statistics - suffix links, and matching        *
+ * statistics against a brute-force search                       *
+ *****************************************************************/
+
+static void
+check_matching_statistics() {
+
+  int num_texts = 3;
+  char buffer[ 2001 ];
+  dstring_t *texts[ 3 ];
+  pos_t ms[ 300 ], pos[ 300 ];
+  symbol_t q[ 300 ];
+
+  dev_log( 0, "testing the suffix links and matching statistics" );
+
+  srand( 13 );
+
+  for ( int s=0; s<num_texts; s++ ) {
+
+    int n = 1 + rand() % 2000;
+
+    for ( int i=0; i<n; i++ )
+      buffer[ i ] = i >= 200 && s != 1 ? buffer[ rand() % 4 == 0 ? rand() % i : i - 200 ] : "acgt"[ rand() % 4 ];
+
+    buffer[ n ] = '\0';
+
+    texts[ s ] = dev_digitalize( &lowercase, buffer );
+  }
+
+  for ( int g=1; g<=2; g++ ) {
+
+    vtree_t *v = g == 1 ? vtree_create( texts[ 0 ] ) : vtree_create_generalized( texts, num_texts, VTREE_ALL );
+    vtree_bottom_up_t t = { check_link, NULL, 0 };
+    symbol_t sigma = v->alphabet_size - ( v->num_seqs - 1 );
+
+    vtree_require( v, VTREE_SLTAB );
+
+    assert( v->tables & VTREE_ISUFTAB ); /* requested by vtree_create */
+
+    vtree_bottom_up( v, &t, NULL );
+
+    /* queries made of pieces of the texts, with mutations and a terminator */
+
+    for ( int k=0; k<50; k++ ) {
+
+      pos_t m = rand() % 300;
+
+      for ( pos_t p=0; p<m; p++ ) {
+	dstring_t *x = texts[ rand() % num_texts ];
+	q[ p ] = p > 0 && rand() % 20 != 0 ? x->text[ rand() % x->length ] : 1 + rand() % 4;
+	if ( p > 0 && rand() % 10 != 0 ) {
+	  pos_t r = rand() % ( x->length - 1 );
+	  for ( ; p < m && r < x->length - 1 && rand() % 30 != 0; p++, r++ )
+	    q[ p ] = x->text[ r ];
+	  p--;
+	}
+      }
+
+      if ( m > 0 && k % 5 == 0 )
+	q[ rand() % m ] = v->alphabet_size;
+
+      vtree_matching_statistics( v, q, m, ms, k % 2 == 0 ? pos : NULL );
+
+      for ( pos_t p=0; p<m; p++ ) {
+
+	pos_t best = 0;
+
+	for ( pos_t r=0; r<v->length; r++ ) {
+	  pos_t d = 0;
+	  while ( p+d < m && r+d < v->length && q[ p+d ] < sigma && q[ p+d ] == v->text[ r+d ] )
+	    d++;
+	  best = MAX( best, d );
+	}
+
+	assert( ms[ p ] == best );
+
+	if ( k % 2 == 0 ) {
+	  assert( ( pos[ p ] < 0 ) == ( best == 0 ) );
+	  for ( pos_t d=0; d<best; d++ )
+	    assert( v->text[ pos[ p ] + d ] == q[ p+d ] );
+	}
+      }
+    }
+
+    vtree_release( v, VTREE_CHILDTAB );
+    assert( ! ( v->tables & VTREE_SLTAB ) && v->sltab == NULL );
+
+    vtree_free( v );
+  }
+
+  for ( int s=0; s<num_texts; s++ )
+    dev_free_dstring( texts[ s ] );
+
+  dev_log( 0, "done!" );
+}
+
+/*****************************************************************
+ * check_nodes - the subtree of node k of the node table against *
+ * the child table of w, returns the node that follows it        *
+ *****************************************************************/
+
+static pos_t
+check_nodes( vtree_t *v, vtree_t *w, pos_t k )
+{
+  dfs_node_t *node = vtree_get_node( v, k );
+  vtree_child_iter_t it, jt;
+  pos_t c = k+1;
+
+  assert( node->label == vtree_get_suftab( w, node->lb ) );
+
+  if ( node->lb == node->rb ) {
+    assert( node->lcp == w->length - node->label );
+    assert( ! vtree_node_first( v, k, &it ) );
+    return c;
+  }
+
+  assert( node->lcp == ( node->rb == w->length ? 0 : vtree_getlcp( w, node->lb, node->rb ) ) );
+
+  for ( int more = vtree_node_first( v, k, &it ), more2 = vtree_child_first( w, node->lb, node->rb, &jt );
+	more || more2;
+	more = vtree_child_next( &it ), more2 = vtree_child_next( &jt ) ) {
+
+    assert( more && more2 );
+    assert( it.node == c && it.i == jt.i && it.j == jt.j && it.label == jt.label );
+
+    c = check_nodes( v, w, c );
+  }
+
+  assert( node->next == c );
+
+  return c;
+}
+
+/*****************************************************************
+ * check_node_table - the lcp-interval tree of the node table    *
+ * must be that of the child table, and the child intervals of   *
+ * vtree_getChildInterval those of vtree_getInterval             *
+ *****************************************************************/
+
+static void
+check_node_table() {
+
+  int num_texts = 3;
+  char buffer[ 1001 ];
+  dstring_t *texts[ 3 ];
+
+  dev_log( 0, "testing the node table" );
+
+  srand( 19 );
+
+  for ( int s=0; s<num_texts; s++ ) {
+
+    int n = 1 + rand() % 1000;
+
+    for ( int i=0; i<n; i++ )
+      buffer[ i ] = i >= 50 && s != 1 ? buffer[ rand() % 4 == 0 ? rand() % i : i - 50 ] : "acgt"[ rand() % 4 ];
+
+    buffer[ n ] = '\0';
+
+    texts[ s ] = dev_digitalize( &lowercase, buffer );
+  }
+
+  for ( int g=1; g<=2; g++ ) {
+
+    vtree_t *w = g == 1 ? vtree_create( texts[ 0 ] ) : vtree_create_generalized( texts, num_texts, VTREE_ALL );
+    vtree_t *v = g == 1 ? vtree_create_tables( texts[ 0 ], VTREE_SUFTAB | VTREE_NODETAB ) :
+      vtree_create_generalized( texts, num_texts, VTREE_SUFTAB | VTREE_NODETAB );
+    interval2_t *root;
+
+    assert( v->tables == ( VTREE_SUFTAB | VTREE_NODETAB ) ); /* the other ones were temporary */
+    assert( v->num_nodes <= 2 * v->length + 1 );
+    assert( check_nodes( v, w, 0 ) == v->num_nodes );
+
+    /* descending along each suffix of the text */
+
+    root = vtree_root_interval( v );
+    assert( root->node == 0 );
+
+    for ( pos_t p=0; p<v->length; p += 1 + rand() % 7 ) {
+
+      interval2_t *x = new_interval2( root->i, root->j ), *y;
+
+      x->node = 0;
+
+      while ( x->i != x->j ) {
+
+	pos_t l = vtree_get_node( v, x->node )->lcp;
+	interval2_t *z;
+
+	if ( p + l >= v->length )
+	  break;
+
+	y = vtree_getChildInterval( v, x, v->text[ p + l ], NULL );
+	z = vtree_getInterval( w, x->i, x->j, v->text[ p + l ], NULL );
+
+	assert( y != NULL && z != NULL && y->i == z->i && y->j == z->j && y->node >= 0 );
+	assert( vtree_get_node( v, y->node )->lb == y->i );
+
+	dev_free( z );
+	dev_free( x );
+	x = y;
+      }
+
+      assert( x->i == x->j ? vtree_get_suftab( v, x->i ) == p : TRUE );
+
+      dev_free( x );
+    }
+
+    dev_free( root );
+
+    vtree_release( v, VTREE_NODETAB );
+    assert( v->nodetab == NULL && v->tables == VTREE_SUFTAB );
+
+    vtree_free( v );
+    vtree_free( w );
+  }
+
+  for ( int s=0; s<num_texts; s++ )
+    dev_free_dstring( texts[ s ] );
+
+  dev_log( 0, "done!" );
+}
+
+/*****************************************************************
+ * check_sparse - the sparse suffix array must hold the indexed  *
+ * suffixes in the order of the full one, and find the           *
+ * occurrences found by a scan of the text                       *
+ *****************************************************************/
+
+static void
+check_sparse() {
+
+  int n = 3000, steps[] = { 1, 2, 3, 8, 13 };
+  dstring_t ds;
+  vtree_t *w;
+  symbol_t p[ 40 ];
+
+  dev_log( 0, "testing the sparse suffix array" );
+
+  srand( 23 );
+
+  ds.text = ( symbol_t * ) dev_malloc( ( n+3 ) * sizeof( symbol_t ) );
+  ds.length = n;
+  ds.alphabet = &lowercase;
+
+  for ( int i=0; i<n; i++ ) /* long repeats, hence lcp exceptions */
+    ds.text[ i ] = i < 600 || rand() % 100 == 0 ? 1 + rand() % 4 : ds.text[ i - 600 ];
+
+  ds.text[ n-1 ] = lowercase.size; /* terminator */
+  ds.text[ n ] = ds.text[ n+1 ] = ds.text[ n+2 ] = 0;
+
+  w = vtree_create_tables( &ds, VTREE_SUFTAB );
+
+  for ( int c=0; c <= sizeof( steps ) / sizeof( int ); c++ ) {
+
+    int step = c < sizeof( steps ) / sizeof( int ) ? steps[ c ] : 0;
+    pos_t *positions = ( pos_t * ) dev_malloc( n * sizeof( pos_t ) ), num = 0, r = 0;
+    vtree_sparse_t *s;
+
+    /* the chosen positions, the text between two of them is at most 40 */
+
+    for ( pos_t q=n-1; q>=0; q -= 1 + rand() % 40 )
+      positions[ num++ ] = q;
+
+    s = step > 0 ? vtree_create_sparse( &ds, step ) : vtree_create_sparse_at( &ds, positions, num );
+
+    assert( s->size == ( step > 0 ? ( n + step - 1 ) / step : num ) );
+    assert( s->index->length == s->size && s->length == n );
+    assert( s->index->tables == ( VTREE_SUFTAB | VTREE_LCPTAB | VTREE_CHILDTAB ) );
+
+    for ( pos_t k=0; k<n; k++ ) {
+
+      pos_t q = vtree_get_suftab( w, k );
+      int indexed = FALSE;
+
+      for ( pos_t x=0; x<num && step == 0 && ! indexed; x++ )
+	indexed = positions[ x ] == q;
+
+      if ( step > 0 ? q % step == 0 : indexed ) {
+
+	pos_t l = 0;
+
+	assert( vtree_get_suftab( s->index, r ) == q );
+
+	if ( r > 0 )
+	  while ( ds.text[ q + l ] == ds.text[ vtree_get_suftab( s->index, r-1 ) + l ] )
+	    l++;
+
+	assert( vtree_get_lcptab( s->index, r ) == l );
+
+	r++;
+      }
+    }
+
+    assert( r == s->size && vtree_get_lcptab( s->index, r ) == 0 );
+    assert( step != 1 || s->index->lcpexc_size > 0 );
+    assert( isChildTable( s->index ) );
+
+    for ( int t=0; t<300; t++ ) {
+
+      pos_t m = 1 + rand() % ( t % 3 == 0 ? 40 : 12 ), count = 0, found, *pos;
+
+      for ( int d=0; d<m; d++ )
+	p[ d ] = t % 2 == 0 ? ds.text[ ( t*37 ) % ( n-40 ) + d ] : 1 + rand() % 4;
+
+      pos = vtree_sparse_find( s, p, m, &found );
+
+      for ( pos_t q=0; q+m<=n; q++ ) {
+
+	int indexed = step != 0, d = 0;
+
+	for ( pos_t x=0; x<num && ! indexed; x++ )
+	  indexed = positions[ x ] == q;
+
+	while ( d < m && ds.text[ q+d ] == p[ d ] )
+	  d++;
+
+	if ( d == m && indexed ) {
+	  assert( count < found && pos[ count ] == q );
+	  count++;
+	}
+      }
+
+      assert( count == found );
+
+      dev_free( pos );
+    }
+
+    vtree_free_sparse( s );
+    dev_free( positions );
+  }
+
+  vtree_free( w );
+  dev_free( ds.text );
+
+  dev_log( 0, "done!" );
+}
+
+/*****************************************************************
+ * read_parts - a source of a dstring, in parts of 1 to 7        *
+ * symbols, see vtree_create_external_source                     *
+ *****************************************************************/
+
+static pos_t
+read_parts( symbol_t *buf, pos_t size, void *arg )
+{
+  static pos_t next = 0;
+  dstring_t *ds = ( dstring_t * ) arg;
+  pos_t num = MIN( MIN( size, 1 + rand() % 7 ), ds->length - next );
+
+  memcpy( buf, ds->text + next, num * sizeof( symbol_t ) );
+  next = num > 0 ? next + num : 0; /* once read, from the start */
+
+  return num;
+}
+
+/*****************************************************************
+ * check_external - the index file built in bounded memory must  *
+ * hold the tables of vtree_create, for any number of runs, more *
+ * than EXTERNAL_FAN_IN for 16*7 bytes, and from a text in       *
+ * memory or read from a source                                  *
+ *****************************************************************/
+
+static void
+check_external() {
+
+  int n = 3000;
+  size_t memory[] = { 0, 16*7, 16*100, 16*2000, 1 << 20 };
+  char filename[ 64 ];
+  dstring_t ds;
+  vtree_t *v, *w;
+
+  dev_log( 0, "testing the external construction" );
+
+  sprintf( filename, "/tmp/vtree-tests.%ld", ( long ) getpid() );
+
+  srand( 29 );
+
+  ds.text = ( symbol_t * ) dev_malloc( ( n+3 ) * sizeof( symbol_t ) );
+  ds.length = n;
+  ds.alphabet = &lowercase;
+
+  for ( int i=0; i<n; i++ ) /* long repeats, hence lcp exceptions */
+    ds.text[ i ] = i < 700 || rand() % 100 == 0 ? 1 + rand() % 4 : ds.text[ i - 700 ];
+
+  ds.text[ n ] = ds.text[ n+1 ] = ds.text[ n+2 ] = 0;
+
+  v = vtree_create_tables( &ds, VTREE_SUFTAB | VTREE_ISUFTAB | VTREE_LCPTAB | VTREE_CHILDTAB );
+
+  for ( int c=0; c < sizeof( memory ) / sizeof( size_t ); c++ ) {
+
+    int old = vtree_set_width( c == 2 ? VTREE_WIDTH_64 : VTREE_WIDTH_AUTO );
+
+    if ( c % 2 == 0 )
+      w = vtree_create_external( &ds, filename, memory[ c ] );
+    else
+      w = vtree_create_external_source( read_parts, &ds, ds.alphabet, filename, memory[ c ] );
+
+    vtree_set_width( old );
+
+    assert( w != NULL && w->map != NULL && w->length == n );
+    assert( w->width == ( c == 2 ? VTREE_WIDTH_64 : v->width ) );
+    assert( w->tables == ( VTREE_SUFTAB | VTREE_LCPTAB | VTREE_CHILDTAB ) );
+    assert( w->lcpexc_size == v->lcpexc_size && v->lcpexc_size > 0 );
+
+    for ( int i=0; i<=n; i++ ) {
+      assert( vtree_get_suftab( v, i ) == vtree_get_suftab( w, i ) );
+      assert( vtree_get_lcptab( v, i ) == vtree_get_lcptab( w, i ) );
+      assert( vtree_get_childtab_up( v, i ) == vtree_get_childtab_up( w, i ) );
+      assert( vtree_get_childtab_down( v, i ) == vtree_get_childtab_down( w, i ) );
+      assert( vtree_get_childtab_next( v, i ) == vtree_get_childtab_next( w, i ) );
+    }
+
+    vtree_require( w, VTREE_ISUFTAB ); /* not saved, built on demand */
+
+    for ( int i=0; i<n; i++ )
+      assert( vtree_get_isuftab( v, i ) == vtree_get_isuftab( w, i ) );
+
+    vtree_free( w );
+  }
+
+  remove( filename );
+
+  vtree_free( v );
+  dev_free( ds.text );
+
+  dev_log( 0, "done!" );
+}
+
+/*****************************************************************
+ * f3 - a function applied to all the interior nodes of the vtree*
+ *****************************************************************/
+
+static void
+f3( vtree_t *v, interval3_t *i )
+{
+  printf( "node <%ld,%ld,%ld>\n", ( long ) i->lcp, ( long ) i->lb, ( long ) i->rb );
+}
+
+/*****************************************************************
+ * f4 - a function applied to all the interior nodes of the vtree*
+ *****************************************************************/
+
+static void
+f4( vtree_t *v, interval4_t *i )
+{
+  printf( "node <%ld,%ld,%ld, [ ...(%d)... ]>\n", ( long ) i->lcp, ( long ) i->lb, ( long ) i->rb, dev_vector_size( i->childList ) );
+}
+
+/*****************************************************************
+ * traverse_topdown -                                            *
+ *****************************************************************/
+
+static void
+traverse_topdown( vtree_t *v, interval2_t *i0 )
+{
+  vector_t *childs;
+
+  printf( "node <%ld, %ld>\n", ( long ) i0->i, ( long ) i0->j );
+
+  if ( i0->i == i0->j )
+    return;
+
+  childs = vtree_getChildIntervals( v, i0 );
+
+  for ( int k=0; k < dev_vector_size( childs ); k++ ) {
+
+    interval2_t *child = ( interval2_t * ) dev_vector_get( childs, k );
+
+    traverse_topdown( v, child );
+
+  }
+
+  dev_free_vector( childs, free );
+
+}
+
+/*****************************************************************
+ * main - main program                                           *
+ *****************************************************************/
+
+int
+main( void )
+{
+  char *s1 = "mississippi", *s2 = "acaaacatat";
+  dstring_t *ds, *pattern;
+  vtree_t *v;
+  vector_t *rs, *nodes;
+  int n;
+
+  dev_init();
+
+  banner();
+
+  generate_and_test( VTREE_SA_SKEW );
+
+  generate_and_test( VTREE_SA_SAIS );
+
+  compare_sa_algorithms();
+
+  compare_num_threads();
+
+  compare_widths();
+
+  check_lcp_exceptions();
+
+  check_rmq();
+
+  check_lce_k();
+
+  check_child_iterator();
+
+  check_kmer_table();
+
+  check_fm_index();
+
+  check_bidir();
+
+  check_batch();
+
+  check_bottom_up();
+
+  check_lazy_tables();
+
+  check_builder();
+
+  check_index_files();
+
+  check_generalized();
+
+  check_extend();
+
+  check_mums();
+
+  check_matching_statistics();
+
+  check_node_table();
+
+  check_sparse();
 
-  generate_and_test();
+  check_external();
 
   ds = dev_digitalize( &lowercase, s1 );
   v = vtree_create( ds );
@@ -412,7 +2680,7 @@ main( void )
   rs = vtree_findall_smax_repeats( v );
   for ( int i=0; i < dev_vector_size( rs ); i++ ) {
     interval2_t *interval = dev_vector_get( rs, i );
-    printf( "repeat <%d,%d>\n", interval->i, interval->j );
+    printf( "repeat <%ld,%ld>\n", ( long ) interval->i, ( long ) interval->j );
   }
 
   dev_free_vector( rs, free );